@@ -0,0 +1,46 @@
+# impulse_generate_messages(<target> SCHEMAS <file.imp>... [OUTPUT_DIR <dir>])
+#
+# Runs impulse_gen on each schema before <target> is compiled. <schema>.imp becomes <OUTPUT_DIR>/<schema>.hpp
+# (default: ${CMAKE_CURRENT_BINARY_DIR}/impulse_generated), and OUTPUT_DIR is added to the target's include path.
+# Headers are regenerated when a schema or the generator changes. The generator is the impulse_gen target of this
+# build, else the one find_package(impulse) imported, else an impulse_gen program on the PATH.
+
+function(impulse_generate_messages target)
+  cmake_parse_arguments(ARG "" "OUTPUT_DIR" "SCHEMAS" ${ARGN})
+  if(NOT ARG_SCHEMAS)
+    message(FATAL_ERROR "impulse_generate_messages: no SCHEMAS given for ${target}")
+  endif()
+  if(NOT ARG_OUTPUT_DIR)
+    set(ARG_OUTPUT_DIR "${CMAKE_CURRENT_BINARY_DIR}/impulse_generated")
+  endif()
+  if(TARGET impulse_gen)
+    set(generator impulse_gen)
+  elseif(TARGET impulse::impulse_gen)
+    set(generator impulse::impulse_gen)
+  else()
+    find_program(IMPULSE_GEN_EXECUTABLE impulse_gen)
+    if(NOT IMPULSE_GEN_EXECUTABLE)
+      message(FATAL_ERROR "impulse_generate_messages: no impulse_gen target or program found")
+    endif()
+    set(generator "${IMPULSE_GEN_EXECUTABLE}")
+  endif()
+
+  set(headers)
+  foreach(schema IN LISTS ARG_SCHEMAS)
+    get_filename_component(schema_path "${schema}" ABSOLUTE)
+    get_filename_component(schema_name "${schema}" NAME_WE)
+    set(header "${ARG_OUTPUT_DIR}/${schema_name}.hpp")
+    add_custom_command(
+      OUTPUT "${header}"
+      COMMAND ${CMAKE_COMMAND} -E make_directory "${ARG_OUTPUT_DIR}"
+      COMMAND ${generator} "${schema_path}" "${header}"
+      DEPENDS "${schema_path}" ${generator}
+      COMMENT "Generating ${schema_name}.hpp from ${schema}"
+      VERBATIM
+    )
+    list(APPEND headers "${header}")
+  endforeach()
+
+  target_sources(${target} PRIVATE ${headers})
+  target_include_directories(${target} PRIVATE "${ARG_OUTPUT_DIR}")
+endfunction()
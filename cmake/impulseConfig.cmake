@@ -0,0 +1,4 @@
+# find_package(impulse): the header library as impulse::impulse, the schema compiler as impulse::impulse_gen and
+# impulse_generate_messages()
+include("${CMAKE_CURRENT_LIST_DIR}/impulseTargets.cmake")
+include("${CMAKE_CURRENT_LIST_DIR}/ImpulseGenerate.cmake")
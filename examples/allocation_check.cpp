@@ -0,0 +1,67 @@
+// Counts heap allocations in this program; must come before any impulse include
+#define IMPULSE_COUNT_ALLOCATIONS
+#include "impulse/util/memory.hpp"
+
+#include "impulse/network/raw.hpp"
+#include "impulse/protocol/message.hpp"
+#include "impulse/protocol/transport.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory_resource>
+#include <thread>
+
+// Checks that sending and receiving Position through Transport allocates nothing once warmed up.
+// Two nodes on a veth pair in one process:
+//   sudo ip link add raw0 type veth peer name raw1 && sudo ip link set raw0 up && sudo ip link set raw1 up
+//   sudo ./allocation_check raw0 raw1
+
+using namespace impulse;
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <interface_a> <interface_b>" << std::endl;
+        return 1;
+    }
+
+    // Internal buffers come from a fixed arena; anything the library still allocates shows up in the counts
+    static char arena[256 * 1024];
+    std::pmr::monotonic_buffer_resource buffer(arena, sizeof(arena), std::pmr::null_memory_resource());
+    CountingResource resource(&buffer);
+
+    RawEthernetInterface a(argv[1], "fd00:dead:beef::a"), b(argv[2], "fd00:dead:beef::b");
+    a.set_memory_resource(&resource);
+    b.set_memory_resource(&resource);
+    if (!a.start() || !b.start()) {
+        return 1;
+    }
+
+    Transport<Position> sender("position", &a), receiver("position", &b);
+    sender.set_memory_resource(&resource);
+    receiver.set_memory_resource(&resource);
+    std::atomic<uint64_t> received{0};
+    receiver.set_message_handler([&](const Position &, const std::string &, uint16_t) { ++received; });
+    b.set_message_callback([&](const std::string &message, const std::string &from_addr, uint16_t from_port) {
+        receiver.handle_incoming_message(message, from_addr, from_port);
+    });
+
+    Position position = {};
+    auto exchange = [&](int count) {
+        for (int i = 0; i < count; ++i) {
+            position.pose.point.x = i;
+            sender.send_message(position);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    };
+
+    exchange(100); // warm-up: buffers grow to their working size, neighbours are learned
+    uint64_t heap_before = heap_allocations(), resource_before = resource.allocations(), received_before = received;
+    exchange(5000);
+
+    uint64_t heap = heap_allocations() - heap_before, pmr = resource.allocations() - resource_before;
+    std::cout << received - received_before << " messages received; " << heap << " heap and " << pmr
+              << " memory resource allocations in steady state" << std::endl;
+    return heap == 0 && pmr == 0 ? 0 : 1;
+}
@@ -12,6 +12,7 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 class Agent {
   private:
@@ -20,7 +21,6 @@ class Agent {
     impulse::Transport<impulse::Discovery> discovery_;
     impulse::Transport<impulse::Communication> communication_;
     impulse::Transport<impulse::Position> position_;
-    impulse::Transport<impulse::Position> lora_position_;
 
   public:
     std::map<std::string, impulse::Discovery> all_discoveries_;
@@ -31,8 +31,7 @@ class Agent {
                  impulse::NetworkInterface *lora_interface, impulse::Discovery &discovery_msg,
                  impulse::Communication &communication_msg)
         : name_(name), address_(network_interface->get_address()), discovery_(name, network_interface),
-          communication_(name, network_interface), position_(name, network_interface),
-          lora_position_(name, lora_interface) {
+          communication_(name, network_interface), position_(name, network_interface) {
 
         all_discoveries_[address_] = discovery_msg;
         discovery_.set_message_handler([this](const impulse::Discovery &msg, const std::string address,
@@ -44,22 +43,21 @@ class Agent {
                                                   const uint16_t) { all_communication_[address] = msg; });
         communication_.set_broadcast(communication_msg);
 
+        // Positions go out on LAN and LoRa at once; whichever copy arrives first is delivered, the other dropped
+        position_.add_path(lora_interface);
         position_.set_message_handler([this](const impulse::Position &msg, const std::string address, const uint16_t) {
             all_position_[address] = msg;
         });
 
         network_interface->set_message_callback(
-            [this](const std::string &message, const std::string &from_addr, uint16_t from_port) {
+            [this, network_interface](const std::string &message, const std::string &from_addr, uint16_t from_port) {
                 discovery_.handle_incoming_message(message, from_addr, from_port);
                 communication_.handle_incoming_message(message, from_addr, from_port);
-                position_.handle_incoming_message(message, from_addr, from_port);
+                position_.handle_incoming_message(message, from_addr, from_port, network_interface);
             });
-
-        lora_position_.set_message_handler([this](const impulse::Position &msg, const std::string address,
-                                                  const uint16_t) { all_position_[address] = msg; });
         lora_interface->set_message_callback(
-            [this](const std::string &message, const std::string &from_addr, uint16_t /* from_port */) {
-                lora_position_.handle_incoming_message(message, from_addr, 0);
+            [this, lora_interface](const std::string &message, const std::string &from_addr, uint16_t /* port */) {
+                position_.handle_incoming_message(message, from_addr, 0, lora_interface);
             });
     }
 
@@ -68,8 +66,9 @@ class Agent {
     inline void update_position(const impulse::Position &position) {
         all_position_[address_] = position;
         position_.send_message(position);
-        lora_position_.send_message(position);
     }
+
+    inline std::vector<impulse::PathStats> position_paths() { return position_.get_path_stats(); }
 };
 
 std::atomic<bool> should_exit{false};
@@ -102,6 +101,19 @@ int main(int argc, char *argv[]) {
     }
 
     impulse::LoRaInterface lora(lora_port, lan.get_address());
+    // Messages are consumed through the callback only; nothing drains the pull queue
+    lora.set_delivery_mode(impulse::DeliveryMode::callback);
+    // Position updates are only useful while fresh: send them ahead of bulk traffic, replace a queued update with
+    // the newer one, and drop it rather than send it late
+    lora.set_tx_classifier([](const std::string &, const std::string &msg) {
+        impulse::TxOptions options;
+        if (msg.size() == sizeof(impulse::Position) + impulse::redundancy::ENVELOPE_SIZE) {
+            options.priority = impulse::TxPriority::high;
+            options.max_age = std::chrono::seconds(2);
+            options.coalesce_key = 1;
+        }
+        return options;
+    });
     if (!lora.start()) {
         std::cerr << "Failed to start LoRa interface" << std::endl;
         return 1;
@@ -147,6 +159,10 @@ int main(int argc, char *argv[]) {
         for (const auto &[ipv6, agent] : participant.all_position_) {
             std::cout << "    - " << ipv6 << ": " << agent.to_string() << std::endl;
         }
+        for (const auto &path : participant.position_paths()) {
+            std::cout << "    path " << path.name << ": first " << path.first << ", late " << path.duplicates
+                      << " (mean " << path.mean_lag.count() << " us behind)" << std::endl;
+        }
 
         position_msg.pose.point = {40.7128 + 0.1 * count, -74.0060 + 0.1 * count, 0.0};
         participant.update_position(position_msg);
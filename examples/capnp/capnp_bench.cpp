@@ -0,0 +1,244 @@
+#include "impulse/protocol/capnp.hpp"
+#include "impulse/protocol/message.hpp"
+#include "impulse/protocol/view.hpp"
+
+#include "robot.capnp.h" // capnp_generate_cpp from robot.capnp
+#include "robot.hpp"     // impulse_gen from ../schema/robot.imp
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Cap'n Proto read in place against memcpy structs and impulse_gen types, doing per message what Transport does
+// on receive: match, deserialize (or view in place), then read one field or all of them. Encode times include
+// building the message.
+//   ./capnp_bench [iterations]
+
+using namespace impulse;
+
+// The memcpy-struct way to carry a mission: room for as many waypoints as it may ever have
+struct __attribute__((packed)) FixedWaypoint {
+    double x;
+    double y;
+    float speed;
+};
+
+struct __attribute__((packed)) FixedMission : public Message {
+    static constexpr size_t MAX_WAYPOINTS = 100;
+    uint64_t timestamp;
+    char name[32];
+    uint16_t count;
+    FixedWaypoint waypoints[MAX_WAYPOINTS];
+
+    inline void serialize(char *buffer) const override { memcpy(buffer, this, sizeof(FixedMission)); }
+    inline void deserialize(const char *buffer) override { memcpy(this, buffer, sizeof(FixedMission)); }
+    inline uint32_t get_size() const override { return sizeof(FixedMission); }
+    inline std::string to_string() const override { return "FixedMission{count=" + std::to_string(count) + "}"; }
+    inline void set_timestamp(uint64_t timestamp) override { this->timestamp = timestamp; }
+};
+
+struct Row {
+    std::string name;
+    size_t bytes = 0;
+    double encode = 0;
+    double read_one = 0;
+    double read_all = 0;
+};
+
+template <typename T> inline void keep(const T &value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+template <typename F> inline double ns_per_op(size_t iterations, F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        f(i);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+// Receive the way Transport does and hand the message to `read`
+template <typename MessageT, typename F> inline void receive(const char *data, size_t size, F &&read) {
+    if (message_matches<MessageT>(data, size)) {
+        MessageT msg;
+        msg.deserialize(data);
+        read(msg);
+    }
+}
+
+// Or the way Transport hands it to a view handler
+template <typename MessageT, typename F> inline void view_of(const char *data, size_t size, F &&read) {
+    if (message_matches<MessageT>(data, size)) {
+        read(View<MessageT>(data, size));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    alignas(8) static char buffer[8192];
+    std::vector<Row> rows;
+
+    {
+        Position out = {};
+        out.pose.point = {1.5, -2.5, 0.25};
+        Row row{"Position (memcpy)", out.get_size()};
+        row.encode = ns_per_op(iterations, [&](size_t i) {
+            out.timestamp = i;
+            out.serialize(buffer);
+            keep(buffer);
+        });
+        row.read_one = ns_per_op(iterations, [&](size_t) {
+            receive<Position>(buffer, row.bytes, [](const Position &msg) { keep(msg.pose.point.x); });
+        });
+        row.read_all = ns_per_op(iterations, [&](size_t) {
+            receive<Position>(buffer, row.bytes, [](const Position &msg) {
+                const auto &p = msg.pose;
+                keep(p.point.x + p.point.y + p.point.z + p.angle.roll + p.angle.pitch + p.angle.yaw + msg.timestamp);
+            });
+        });
+        rows.push_back(row);
+
+        Row view{"Position (View)", row.bytes, row.encode}; // same bytes
+        view.read_one = ns_per_op(iterations, [&](size_t) {
+            view_of<Position>(buffer, row.bytes, [](const View<Position> &msg) {
+                keep(msg.get<&Position::pose, &concord::Pose::point, &concord::Point::x>());
+            });
+        });
+        view.read_all = ns_per_op(iterations, [&](size_t) {
+            view_of<Position>(buffer, row.bytes, [](const View<Position> &msg) {
+                auto p = msg.get<&Position::pose>();
+                keep(p.point.x + p.point.y + p.point.z + p.angle.roll + p.angle.pitch + p.angle.yaw +
+                     msg.get<&Position::timestamp>());
+            });
+        });
+        rows.push_back(view);
+    }
+
+    {
+        robot::Pose2D out;
+        out.x = 1.5;
+        out.y = -2.5;
+        Row row{"Pose2D (impulse_gen)", out.get_size()};
+        row.encode = ns_per_op(iterations, [&](size_t i) {
+            out.timestamp = i;
+            out.serialize(buffer);
+            keep(buffer);
+        });
+        row.read_one = ns_per_op(iterations, [&](size_t) {
+            receive<robot::Pose2D>(buffer, row.bytes, [](const robot::Pose2D &msg) { keep(msg.x); });
+        });
+        row.read_all = ns_per_op(iterations, [&](size_t) {
+            receive<robot::Pose2D>(buffer, row.bytes, [](const robot::Pose2D &msg) {
+                keep(msg.x + msg.y + msg.yaw + msg.speed + msg.mode + msg.timestamp);
+            });
+        });
+        rows.push_back(row);
+
+        Row view{"Pose2D (View)", row.bytes, row.encode};
+        view.read_one = ns_per_op(iterations, [&](size_t) {
+            view_of<robot::Pose2D>(buffer, row.bytes, [](const robot::Pose2D::View &msg) { keep(msg.x()); });
+        });
+        view.read_all = ns_per_op(iterations, [&](size_t) {
+            view_of<robot::Pose2D>(buffer, row.bytes, [](const robot::Pose2D::View &msg) {
+                keep(msg.x() + msg.y() + msg.yaw() + msg.speed() + msg.mode() + msg.timestamp());
+            });
+        });
+        rows.push_back(view);
+    }
+
+    // Aligned as it is straight out of a receive buffer, then shifted as behind a redundancy envelope
+    for (size_t shift : {size_t(0), size_t(2)}) {
+        using Pose = CapnpMessage<robot_capnp::Pose>;
+        Pose out;
+        char *data = buffer + shift;
+        Row row{shift ? "capnp Pose, unaligned" : "capnp Pose", 0};
+        row.encode = ns_per_op(iterations, [&](size_t i) {
+            auto pose = out.init();
+            pose.setTimestamp(i);
+            pose.setX(1.5);
+            pose.setY(-2.5);
+            pose.setZ(0.25);
+            out.serialize(data);
+            keep(buffer);
+        });
+        row.bytes = out.get_size();
+        row.read_one = ns_per_op(iterations, [&](size_t) {
+            receive<Pose>(data, row.bytes, [](const Pose &msg) { keep(msg.get().getX()); });
+        });
+        row.read_all = ns_per_op(iterations, [&](size_t) {
+            receive<Pose>(data, row.bytes, [](const Pose &msg) {
+                auto p = msg.get();
+                keep(p.getX() + p.getY() + p.getZ() + p.getRoll() + p.getPitch() + p.getYaw() + p.getTimestamp());
+            });
+        });
+        rows.push_back(row);
+    }
+
+    for (size_t count : {size_t(10), size_t(100)}) {
+        FixedMission out = {};
+        strncpy(out.name, "survey north field", sizeof(out.name));
+        out.count = static_cast<uint16_t>(count);
+        for (size_t i = 0; i < count; ++i) {
+            out.waypoints[i] = {double(i), -double(i), 1.5f};
+        }
+        Row row{"FixedMission (memcpy), " + std::to_string(count) + " wp", out.get_size()};
+        row.encode = ns_per_op(iterations, [&](size_t i) {
+            out.timestamp = i;
+            out.serialize(buffer);
+            keep(buffer);
+        });
+        row.read_one = ns_per_op(iterations, [&](size_t) {
+            receive<FixedMission>(buffer, row.bytes, [](const FixedMission &msg) { keep(msg.waypoints[0].x); });
+        });
+        row.read_all = ns_per_op(iterations, [&](size_t) {
+            receive<FixedMission>(buffer, row.bytes, [](const FixedMission &msg) {
+                double sum = 0;
+                for (size_t i = 0; i < msg.count; ++i) {
+                    sum += msg.waypoints[i].x;
+                }
+                keep(sum);
+            });
+        });
+        rows.push_back(row);
+    }
+
+    for (size_t count : {size_t(10), size_t(100)}) {
+        using Mission = CapnpMessage<robot_capnp::Mission>;
+        Mission out;
+        Row row{"capnp Mission, " + std::to_string(count) + " wp", 0};
+        row.encode = ns_per_op(iterations, [&](size_t i) {
+            auto mission = out.init();
+            mission.setTimestamp(i);
+            mission.setName("survey north field");
+            auto waypoints = mission.initWaypoints(static_cast<unsigned>(count));
+            for (unsigned j = 0; j < count; ++j) {
+                waypoints[j].setX(j);
+                waypoints[j].setY(-double(j));
+                waypoints[j].setSpeed(1.5f);
+            }
+            out.serialize(buffer);
+            keep(buffer);
+        });
+        row.bytes = out.get_size();
+        row.read_one = ns_per_op(iterations, [&](size_t) {
+            receive<Mission>(buffer, row.bytes, [](const Mission &msg) { keep(msg.get().getWaypoints()[0].getX()); });
+        });
+        row.read_all = ns_per_op(iterations, [&](size_t) {
+            receive<Mission>(buffer, row.bytes, [](const Mission &msg) {
+                double sum = 0;
+                for (auto waypoint : msg.get().getWaypoints()) {
+                    sum += waypoint.getX();
+                }
+                keep(sum);
+            });
+        });
+        rows.push_back(row);
+    }
+
+    printf("%-34s %8s %12s %12s %12s\n", "message", "bytes", "encode ns", "read 1 ns", "read all ns");
+    for (const auto &row : rows) {
+        printf("%-34s %8zu %12.1f %12.1f %12.1f\n", row.name.c_str(), row.bytes, row.encode, row.read_one,
+               row.read_all);
+    }
+    return 0;
+}
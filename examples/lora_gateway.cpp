@@ -0,0 +1,139 @@
+#include "impulse/network/lan.hpp"
+#include "impulse/network/lora.hpp"
+#include "impulse/protocol/gateway.hpp"
+#include "impulse/protocol/message.hpp"
+#include "impulse/protocol/transport.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace impulse;
+
+std::atomic<bool> should_exit{false};
+
+void signal_handler(int) { should_exit = true; }
+
+// Position over LoRa: [P][x][y][z][yaw] as floats, 17 bytes instead of the full message
+static constexpr size_t COMPACT_SIZE = 17;
+
+static bool is_compact_position(const char *data, size_t size) { return size == COMPACT_SIZE && data[0] == 'P'; }
+
+static std::string encode_position(const std::string &msg) {
+    // Senders on several paths put a redundancy envelope in front; the compact form does without it
+    size_t offset = message_matches<Position>(msg.data(), msg.size()) ? 0 : redundancy::ENVELOPE_SIZE;
+    Position position;
+    position.deserialize(msg.data() + offset);
+    float fields[4] = {static_cast<float>(position.pose.point.x), static_cast<float>(position.pose.point.y),
+                       static_cast<float>(position.pose.point.z), static_cast<float>(position.pose.angle.yaw)};
+    std::string out(COMPACT_SIZE, 'P');
+    memcpy(out.data() + 1, fields, sizeof(fields));
+    return out;
+}
+
+static std::string decode_position(const std::string &msg) {
+    float fields[4];
+    memcpy(fields, msg.data() + 1, sizeof(fields));
+    Position position = {};
+    position.timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    position.pose.point = {fields[0], fields[1], fields[2]};
+    position.pose.angle.yaw = fields[3];
+    std::string out(position.get_size(), '\0');
+    position.serialize(out.data());
+    return out;
+}
+
+// The robot side: positions the gateway sends over LoRa arrive compact behind a relay header. Expanding them back
+// to the full form, header kept, lets a Transport<Position> on the LoRa interface take them like any other.
+static int run_robot(const char *serial_port, const char *node_ipv6) {
+    LoRaInterface lora(serial_port, node_ipv6);
+    lora.set_delivery_mode(DeliveryMode::callback);
+    if (!lora.start()) {
+        std::cerr << "Failed to start LoRa interface" << std::endl;
+        return 1;
+    }
+    Transport<Position> positions("position", &lora);
+    positions.set_message_handler([](const Position &msg, const std::string &from, uint16_t) {
+        std::cout << from << ": " << msg.to_string() << std::endl;
+    });
+    lora.set_message_callback([&](const std::string &msg, const std::string &from, uint16_t port) {
+        size_t header = msg.size() > relay::HEADER_SIZE && memcmp(msg.data(), relay::MAGIC, sizeof(relay::MAGIC)) == 0
+                            ? relay::HEADER_SIZE
+                            : 0;
+        if (is_compact_position(msg.data() + header, msg.size() - header)) {
+            std::string full = msg.substr(0, header) + decode_position(msg.substr(header));
+            positions.handle_incoming_message(full, from, port);
+        } else {
+            positions.handle_incoming_message(msg, from, port);
+        }
+    });
+
+    while (!should_exit) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    bool robot = argc == 4 && strcmp(argv[1], "--robot") == 0;
+    if (argc != 3 && !robot) {
+        std::cerr << "Usage: " << argv[0] << " <lan_interface> <serial_port>" << std::endl;
+        std::cerr << "       " << argv[0] << " --robot <serial_port> <node_ipv6>" << std::endl;
+        std::cerr << "Example: " << argv[0] << " eno2 /dev/ttyUSB0" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+    if (robot) {
+        return run_robot(argv[2], argv[3]);
+    }
+
+    LanInterface lan(argv[1]);
+    if (!lan.start()) {
+        std::cerr << "Failed to start LAN interface" << std::endl;
+        return 1;
+    }
+    LoRaInterface lora(argv[2], lan.get_address());
+    lora.set_delivery_mode(DeliveryMode::callback);
+    if (!lora.start()) {
+        std::cerr << "Failed to start LoRa interface" << std::endl;
+        return 1;
+    }
+
+    GatewayConfig config;
+    config.lora_bytes_per_second = 40.0; // roughly 1% duty cycle at SF9/125 kHz
+    Gateway gateway(&lan, &lora, config);
+
+    // Positions: one per robot every two seconds in compact form; discovery stays on the LAN
+    auto position = gateway_topic<Position>("position", std::chrono::seconds(2));
+    position.encode = encode_position;
+    position.decode = decode_position;
+    position.match_compact = [](const std::string &msg) { return is_compact_position(msg.data(), msg.size()); };
+    gateway.add_topic(position);
+
+    auto discovery = gateway_topic<Discovery>("discovery");
+    discovery.to_lora = false;
+    gateway.add_topic(discovery);
+
+    gateway.attach();
+    std::cout << "Gateway bridging " << lan.get_interface_name() << " and " << lora.get_interface_name()
+              << std::endl;
+
+    while (!should_exit) {
+        std::this_thread::sleep_for(std::chrono::seconds(5));
+        auto stats = gateway.get_stats();
+        std::cout << "LAN -> LoRa: " << stats.to_lora.forwarded << " forwarded (" << stats.to_lora.bytes
+                  << " bytes), " << stats.to_lora.superseded << " superseded, " << stats.waiting << " waiting"
+                  << std::endl;
+        std::cout << "LoRa -> LAN: " << stats.to_lan.forwarded << " forwarded (" << stats.to_lan.bytes
+                  << " bytes), " << stats.to_lan.loops << " loops dropped" << std::endl;
+    }
+
+    std::cout << "Shutting down..." << std::endl;
+    return 0;
+}
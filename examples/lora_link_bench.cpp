@@ -0,0 +1,54 @@
+#include "impulse/network/lora.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace impulse;
+
+static void print_result(const LinkBenchmark &result) {
+    std::cout << std::setw(9) << result.baud_rate << " baud: " << result.responses << "/" << result.requests
+              << " responses, error rate " << std::setprecision(3) << result.error_rate() * 100.0 << "%, "
+              << "mean RTT " << result.mean_round_trip.count() << " us, throughput " << std::fixed
+              << std::setprecision(1) << result.throughput_bps / 1000.0 << " kbit/s" << std::defaultfloat
+              << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " <serial_port> <ipv6_address> [max_baud] [rtscts]" << std::endl;
+        std::cout << "Example: " << argv[0] << " /dev/ttyUSB0 fd00:dead:beef::42 3000000 rtscts" << std::endl;
+        return 1;
+    }
+
+    SerialConfig config;
+    config.max_baud_rate = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 3000000;
+    config.hardware_flow_control = argc > 4 && std::string(argv[4]) == "rtscts";
+
+    std::cout << "=== LoRa Serial Link Benchmark ===" << std::endl;
+
+    try {
+        auto lora = std::make_unique<LoRaInterface>(argv[1], argv[2], config);
+        if (!lora->start()) {
+            std::cerr << "Failed to start LoRa interface" << std::endl;
+            return 1;
+        }
+
+        // Baseline at the default rate
+        print_result(lora->benchmark_link());
+
+        // Walk up through the candidate rates, keeping the fastest one that passes
+        uint32_t best = lora->negotiate_baud_rate(config.max_baud_rate);
+        std::cout << "Negotiated " << best << " baud" << std::endl;
+        print_result(lora->benchmark_link(1000, 16));
+
+        lora->stop();
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
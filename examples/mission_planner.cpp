@@ -0,0 +1,156 @@
+#include "impulse/network/lan.hpp"
+#include "impulse/protocol/message.hpp"
+#include "impulse/protocol/transport.hpp"
+#include "impulse/protocol/wire.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include <thread>
+
+// A variable-length message: a planner hands out missions with any number of waypoints and tasks. On receive the
+// strings and arrays are decoded into the transport's arena, which is released in one step after the handler.
+
+using namespace impulse;
+
+struct Waypoint {
+    double x;
+    double y;
+    float speed;
+};
+
+struct Mission : public Message {
+    static constexpr uint16_t TYPE_ID = 0x0201;
+    static constexpr size_t WAYPOINT_SIZE = 20;
+
+    uint64_t timestamp = 0;
+    std::pmr::string name;
+    std::pmr::vector<Waypoint> waypoints;
+    std::pmr::vector<std::pmr::string> tasks;
+
+    // [type ID:2][length:2][timestamp:8][name][waypoints][tasks], the length covering everything after it
+    inline void encode(wire::Writer &out) const {
+        out.put(TYPE_ID);
+        size_t section = out.begin_section();
+        out.put(timestamp);
+        out.string(name);
+        out.repeated(waypoints, [](wire::Writer &w, const Waypoint &waypoint) {
+            w.put(waypoint.x);
+            w.put(waypoint.y);
+            w.put(waypoint.speed);
+        });
+        out.repeated(tasks, [](wire::Writer &w, const std::pmr::string &task) { w.string(task); });
+        out.end_section(section);
+    }
+
+    inline static bool matches(const char *data, size_t size) {
+        return size >= 4 && wire::get<uint16_t>(data) == TYPE_ID && wire::get<uint16_t>(data + 2) == size - 4;
+    }
+
+    inline bool deserialize(const char *data, size_t size, std::pmr::memory_resource *arena) {
+        reset_resource(name, arena);
+        reset_resource(waypoints, arena);
+        reset_resource(tasks, arena);
+
+        wire::Reader in(data, size);
+        in.get<uint16_t>();
+        wire::Reader body = in.section();
+        timestamp = body.get<uint64_t>();
+        name = body.string();
+        waypoints.resize(body.count(WAYPOINT_SIZE));
+        for (auto &waypoint : waypoints) {
+            waypoint.x = body.get<double>();
+            waypoint.y = body.get<double>();
+            waypoint.speed = body.get<float>();
+        }
+        size_t task_count = body.count(2);
+        tasks.reserve(task_count);
+        for (size_t i = 0; i < task_count; ++i) {
+            tasks.emplace_back(body.string());
+        }
+        return body.ok(); // fields appended by a newer sender stay unread
+    }
+
+    inline void deserialize(const char *buffer) override {
+        deserialize(buffer, 4 + wire::get<uint16_t>(buffer + 2), std::pmr::get_default_resource());
+    }
+
+    inline void serialize(char *buffer) const override {
+        wire::Writer out(buffer);
+        encode(out);
+    }
+
+    inline uint32_t get_size() const override {
+        wire::Writer out;
+        encode(out);
+        return static_cast<uint32_t>(out.size());
+    }
+
+    inline std::string to_string() const override {
+        return "Mission{name=" + std::string(name) + ", waypoints=" + std::to_string(waypoints.size()) +
+               ", tasks=" + std::to_string(tasks.size()) + "}";
+    }
+
+    inline void set_timestamp(uint64_t timestamp) override { this->timestamp = timestamp; }
+};
+
+std::atomic<bool> should_exit{false};
+
+void signal_handler(int) { should_exit = true; }
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <interface>" << std::endl;
+        std::cerr << "Example: " << argv[0] << " eno2" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    LanInterface planner_lan(argv[1]), robot_lan(argv[1]);
+    if (!planner_lan.start() || !robot_lan.start()) {
+        std::cerr << "Failed to start LAN interfaces" << std::endl;
+        return 1;
+    }
+
+    Transport<Mission> planner("planner", &planner_lan), robot("robot", &robot_lan);
+    robot.set_message_handler([](const Mission &mission, const std::string &from, uint16_t) {
+        // Strings and waypoints live in the arena until this returns; copy the mission to keep it
+        double length = 0;
+        for (size_t i = 1; i < mission.waypoints.size(); ++i) {
+            length += std::hypot(mission.waypoints[i].x - mission.waypoints[i - 1].x,
+                                 mission.waypoints[i].y - mission.waypoints[i - 1].y);
+        }
+        std::cout << from << ": " << mission.to_string() << ", " << length << " m";
+        for (const auto &task : mission.tasks) {
+            std::cout << " [" << task << "]";
+        }
+        std::cout << std::endl;
+    });
+    robot_lan.set_message_callback([&](const std::string &message, const std::string &from_addr, uint16_t port) {
+        robot.handle_incoming_message(message, from_addr, port);
+    });
+
+    Mission mission;
+    for (int round = 1; !should_exit; ++round) {
+        mission.name = "survey row " + std::to_string(round);
+        mission.waypoints.clear();
+        for (int i = 0; i < 5 * round % 120; ++i) {
+            mission.waypoints.push_back({i * 2.5, (i % 2) * 30.0, 1.2f});
+        }
+        mission.tasks = {"sample soil", "photograph canopy"};
+        if (round % 3 == 0) {
+            mission.tasks.emplace_back("return to charger");
+        }
+        planner.send_message(mission);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    std::cout << "Shutting down..." << std::endl;
+    return 0;
+}
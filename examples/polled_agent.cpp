@@ -0,0 +1,76 @@
+#include "impulse/network/lan.hpp"
+#include "impulse/network/poller.hpp"
+#include "impulse/protocol/message.hpp"
+#include "impulse/protocol/transport.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <string>
+
+// A whole agent on the main thread: the library starts no threads of its own, and one poll() per control cycle
+// serves the socket, the position broadcast and the control step.
+
+using namespace impulse;
+
+std::atomic<bool> should_exit{false};
+
+void signal_handler(int) { should_exit = true; }
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <interface>" << std::endl;
+        std::cerr << "Example: " << argv[0] << " eno2" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    LanInterface lan(argv[1]);
+    lan.set_threading(Threading::polled);
+    if (!lan.start()) {
+        std::cerr << "Failed to start LAN interface" << std::endl;
+        return 1;
+    }
+
+    Transport<Position> position(lan.get_address(), &lan, Threading::polled);
+    std::map<std::string, Position> others;
+    position.set_message_handler(
+        [&](const Position &msg, const std::string &from, uint16_t) { others[from] = msg; }); // no locking needed
+    lan.set_message_callback([&](const std::string &message, const std::string &from_addr, uint16_t from_port) {
+        position.handle_incoming_message(message, from_addr, from_port);
+    });
+
+    Position own = {};
+    own.pose.point = {40.7128, -74.0060, 0.0};
+    position.set_broadcast(own, std::chrono::milliseconds(200));
+
+    Poller poller;
+    poller.add(&lan);
+    poller.add(&position);
+
+    const auto cycle = std::chrono::milliseconds(50);
+    auto next_step = std::chrono::steady_clock::now() + cycle;
+    uint64_t steps = 0;
+    while (!should_exit) {
+        auto wait = std::max(next_step - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+        poller.poll_once(std::chrono::ceil<std::chrono::milliseconds>(wait));
+        if (std::chrono::steady_clock::now() < next_step) {
+            continue;
+        }
+        next_step += cycle;
+
+        // Control step at 20 Hz
+        own.pose.point.x += 1e-5;
+        position.set_broadcast(own, std::chrono::milliseconds(200));
+        if (++steps % 100 == 0) {
+            std::cout << "Step " << steps << ": " << others.size() << " other agents in view" << std::endl;
+        }
+    }
+
+    std::cout << "Shutting down..." << std::endl;
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "impulse/network/raw.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Two nodes on a veth pair:
+//   sudo ip link add raw0 type veth peer name raw1 && sudo ip link set raw0 up && sudo ip link set raw1 up
+//   sudo ./raw_ethernet raw0 fd00::1     and     sudo ./raw_ethernet raw1 fd00::2
+
+using namespace impulse;
+
+std::atomic<bool> should_exit{false};
+
+void signal_handler(int) { should_exit = true; }
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <interface> <node_ipv6>" << std::endl;
+        std::cerr << "Example: " << argv[0] << " raw0 fd00::1" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    RawEthernetInterface raw(argv[1], argv[2]);
+    // On a PREEMPT_RT kernel: keep the receive thread on CPU 1 above the rest of the robot software
+    ThreadConfig receive_config;
+    receive_config.cpus = {1};
+    receive_config.policy = SchedPolicy::fifo;
+    receive_config.priority = 80;
+    raw.set_thread_config(ThreadRole::receive, receive_config);
+    lock_memory();
+    std::atomic<uint64_t> received{0};
+    raw.set_message_callback([&](const std::string &msg, const std::string &from, uint16_t) {
+        if (received++ % 1000 == 0) {
+            std::cout << "Received \"" << msg << "\" from " << from << std::endl;
+        }
+    });
+    if (!raw.start()) {
+        return 1;
+    }
+
+    int round = 0;
+    while (!should_exit) {
+        // A burst of 100 frames leaves with a single system call
+        {
+            auto batch = raw.batch();
+            for (int i = 0; i < 100; ++i) {
+                raw.multicast_message("burst " + std::to_string(round) + "/" + std::to_string(i));
+            }
+        }
+        ++round;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        auto stats = raw.get_stats();
+        auto latency = raw.get_wakeup_stats(ThreadRole::receive);
+        std::cout << "sent " << stats.frames_sent << " in " << stats.tx_kicks << " syscalls, received "
+                  << stats.frames_received << " in " << stats.blocks_received << " wake-ups, " << stats.rx_dropped
+                  << " dropped; " << raw.get_neighbors().size() << " neighbours; receive latency "
+                  << latency.mean.count() << " us mean, " << latency.p99.count() << " us p99" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace impulse {
+
+    // Radio settings the controller tunes
+    struct LinkSettings {
+        uint8_t spreading_factor = 7;
+        uint32_t bandwidth_hz = 125000;
+        int8_t tx_power_dbm = 14;
+
+        inline bool operator==(const LinkSettings &) const = default;
+    };
+
+    struct AdrConfig {
+        bool enabled = false;
+        double margin_db = 10.0; // installation margin kept above the demodulation floor
+        double step_db = 3.0;    // link budget one step of SF, bandwidth or power is worth
+        uint8_t min_spreading_factor = 7;
+        uint8_t max_spreading_factor = 12;
+        uint32_t min_bandwidth_hz = 125000;
+        uint32_t max_bandwidth_hz = 125000; // raise to 250000/500000 where the region allows it
+        int8_t min_tx_power_dbm = 2;
+        int8_t max_tx_power_dbm = 14;
+        size_t snr_history = 20;    // SNR samples kept per peer; the best one is used, as in LoRaWAN ADR
+        size_t min_samples = 5;     // no decision for a peer before this many samples
+        double max_loss = 0.10;     // measured frame loss above this forces a more robust setting
+        // Also tune spreading factor and bandwidth. Only honoured with per_destination: nodes on different SF/BW
+        // cannot hear each other, and each node decides from its own neighbours, so a fleet sharing one setting
+        // would split. Without it only tx power is tuned.
+        bool adapt_modulation = false;
+        // Tune per destination through the firmware (config type 0x06) instead of one setting for all peers
+        bool per_destination = false;
+        std::chrono::seconds interval = std::chrono::seconds(60); // minimum time between changes
+    };
+
+    // Adaptive data rate in the style of the LoRaWAN network-server algorithm. The best recent SNR of a link, less
+    // the demodulation floor of the current spreading factor and the installation margin, is converted to steps;
+    // surplus steps are spent on a faster spreading factor, then wider bandwidth, then lower power, and a deficit
+    // (or measured loss) first raises power, then narrows bandwidth, then slows the spreading factor.
+    class AdrController {
+      private:
+        struct Link {
+            std::deque<double> snr; // measured at the bandwidth in use when heard
+            uint32_t bandwidth_hz = 0;
+            double loss = 0.0;
+        };
+
+        AdrConfig config_;
+        std::map<std::string, Link> links_;
+
+        // Lowest SNR the SX127x demodulator decodes at each spreading factor
+        inline static double required_snr(uint8_t sf) { return -5.0 - 2.5 * (sf - 6); }
+
+        inline bool adapts_modulation() const { return config_.adapt_modulation && config_.per_destination; }
+
+      public:
+        inline explicit AdrController(const AdrConfig &config = {}) : config_(config) {}
+
+        inline void set_config(const AdrConfig &config) { config_ = config; }
+        inline const AdrConfig &config() const { return config_; }
+
+        inline void observe_snr(const std::string &peer, double snr_db, uint32_t bandwidth_hz) {
+            auto &link = links_[peer];
+            if (link.bandwidth_hz != bandwidth_hz) {
+                link.snr.clear(); // samples at another bandwidth see a different noise floor
+                link.bandwidth_hz = bandwidth_hz;
+            }
+            link.snr.push_back(snr_db);
+            while (link.snr.size() > config_.snr_history) {
+                link.snr.pop_front();
+            }
+        }
+
+        inline void observe_loss(const std::string &peer, double loss) { links_[peer].loss = loss; }
+
+        inline void forget(const std::string &peer) { links_.erase(peer); }
+
+        // Settings for one peer, starting from the current ones. Unchanged while there is too little data.
+        inline LinkSettings recommend_for(const std::string &peer, const LinkSettings &current) const {
+            auto it = links_.find(peer);
+            if (it == links_.end()) {
+                return current;
+            }
+            const Link &link = it->second;
+            LinkSettings next = current;
+
+            int steps = 0;
+            if (link.loss > config_.max_loss) {
+                steps = -1;
+            } else if (link.snr.size() >= config_.min_samples && link.bandwidth_hz == current.bandwidth_hz) {
+                double best = *std::max_element(link.snr.begin(), link.snr.end());
+                double margin = best - required_snr(current.spreading_factor) - config_.margin_db;
+                steps = static_cast<int>(std::floor(margin / config_.step_db));
+            }
+
+            if (adapts_modulation()) {
+                while (steps > 0 && next.spreading_factor > config_.min_spreading_factor) {
+                    --next.spreading_factor;
+                    --steps;
+                }
+                while (steps > 0 && next.bandwidth_hz < config_.max_bandwidth_hz) {
+                    next.bandwidth_hz *= 2;
+                    --steps;
+                }
+            }
+            while (steps > 0 && next.tx_power_dbm - config_.step_db >= config_.min_tx_power_dbm) {
+                next.tx_power_dbm -= static_cast<int8_t>(config_.step_db);
+                --steps;
+            }
+            while (steps < 0 && next.tx_power_dbm < config_.max_tx_power_dbm) {
+                next.tx_power_dbm = static_cast<int8_t>(
+                    std::min<double>(next.tx_power_dbm + config_.step_db, config_.max_tx_power_dbm));
+                ++steps;
+            }
+            if (adapts_modulation()) {
+                while (steps < 0 && next.bandwidth_hz > config_.min_bandwidth_hz) {
+                    next.bandwidth_hz /= 2;
+                    ++steps;
+                }
+                while (steps < 0 && next.spreading_factor < config_.max_spreading_factor) {
+                    ++next.spreading_factor;
+                    ++steps;
+                }
+            }
+            return next;
+        }
+
+        // One setting that still reaches every listed peer: the most robust of the per-peer recommendations
+        inline LinkSettings recommend(const std::vector<std::string> &peers, const LinkSettings &current) const {
+            if (peers.empty()) {
+                return current;
+            }
+            LinkSettings combined{config_.min_spreading_factor, config_.max_bandwidth_hz, config_.min_tx_power_dbm};
+            if (!adapts_modulation()) {
+                combined.spreading_factor = current.spreading_factor;
+                combined.bandwidth_hz = current.bandwidth_hz;
+            }
+            for (const auto &peer : peers) {
+                LinkSettings link = recommend_for(peer, current);
+                combined.spreading_factor = std::max(combined.spreading_factor, link.spreading_factor);
+                combined.bandwidth_hz = std::min(combined.bandwidth_hz, link.bandwidth_hz);
+                combined.tx_power_dbm = std::max(combined.tx_power_dbm, link.tx_power_dbm);
+            }
+            return combined;
+        }
+    };
+
+} // namespace impulse
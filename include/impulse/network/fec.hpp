@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace impulse {
+
+    struct FecConfig {
+        bool enabled = false;
+        uint8_t fixed_group_size = 0; // data frames per parity frame; 0 adapts to measured loss
+        uint8_t min_group_size = 2;
+        uint8_t max_group_size = 16;
+        double target_residual_loss = 0.01; // acceptable chance a group loses more than parity can repair
+        double min_loss = 0.005;            // below this measured loss no parity is sent
+        std::chrono::milliseconds flush_timeout = std::chrono::milliseconds(500); // close idle groups early
+    };
+
+    struct FecStats {
+        uint64_t data_frames = 0;
+        uint64_t parity_frames = 0;
+        uint64_t frames_lost = 0;      // gaps seen on receive, before recovery
+        uint64_t frames_recovered = 0; // rebuilt from parity
+    };
+
+    // Data frames per parity frame for a link with frame loss probability `loss`: the largest group for which losing
+    // two or more of the group + parity frames (unrecoverable with XOR parity) stays under the target.
+    inline uint8_t fec_group_size(double loss, const FecConfig &config) {
+        if (config.fixed_group_size) {
+            return config.fixed_group_size;
+        }
+        if (loss < config.min_loss) {
+            return 0;
+        }
+        for (int k = config.max_group_size; k > config.min_group_size; --k) {
+            int n = k + 1;
+            double none = std::pow(1.0 - loss, n);
+            double one = n * loss * std::pow(1.0 - loss, n - 1);
+            if (1.0 - none - one <= config.target_residual_loss) {
+                return k;
+            }
+        }
+        return config.min_group_size;
+    }
+
+    // XOR parity across groups of consecutive frames to one destination. A receiver that misses any single frame of
+    // a group rebuilds it from the parity frame, without a round trip.
+    //
+    //   data   [FEC_DATA][seq][payload]
+    //   parity [FEC_PARITY][first seq][count][length xor:2][payload xor, padded to the longest frame]
+    namespace fec {
+        static constexpr uint8_t FEC_DATA = 0xFC;
+        static constexpr uint8_t FEC_PARITY = 0xFD;
+        static constexpr size_t DATA_HEADER = 2;
+        static constexpr size_t PARITY_HEADER = 5;
+    } // namespace fec
+
+    class FecEncoder {
+      private:
+        struct Group {
+            uint8_t next_seq = 0;
+            uint8_t first = 0;
+            uint8_t count = 0;
+            uint16_t length_xor = 0;
+            std::vector<uint8_t> parity;
+            std::chrono::steady_clock::time_point started;
+        };
+
+        std::map<std::string, Group> groups_;
+        uint64_t data_frames_ = 0;
+        uint64_t parity_frames_ = 0;
+
+        inline std::string close(Group &group) {
+            std::string frame;
+            frame.reserve(fec::PARITY_HEADER + group.parity.size());
+            frame.push_back(static_cast<char>(fec::FEC_PARITY));
+            frame.push_back(static_cast<char>(group.first));
+            frame.push_back(static_cast<char>(group.count));
+            frame.push_back(static_cast<char>(group.length_xor >> 8));
+            frame.push_back(static_cast<char>(group.length_xor & 0xFF));
+            frame.append(reinterpret_cast<const char *>(group.parity.data()), group.parity.size());
+            group.count = 0;
+            group.length_xor = 0;
+            group.parity.clear(); // keeps capacity for the next group
+            ++parity_frames_;
+            return frame;
+        }
+
+      public:
+        // Fold a payload into the destination's current group and return its data header. When the group reaches
+        // `group_size` frames the parity frame is written to `parity` and true is returned.
+        inline bool add(const std::string &dest, const uint8_t *payload, size_t size, uint8_t group_size,
+                        std::chrono::steady_clock::time_point now, std::array<uint8_t, fec::DATA_HEADER> &header,
+                        std::string &parity) {
+            auto &group = groups_[dest];
+            uint8_t seq = group.next_seq++;
+            header = {fec::FEC_DATA, seq};
+            ++data_frames_;
+
+            if (group_size == 0) {
+                // Still sequenced so the receiver keeps measuring loss, but no group is formed
+                group.count = 0;
+                return false;
+            }
+            if (group.count == 0) {
+                group.first = seq;
+                group.started = now;
+            }
+            if (group.parity.size() < size) {
+                group.parity.resize(size, 0);
+            }
+            for (size_t i = 0; i < size; ++i) {
+                group.parity[i] ^= payload[i];
+            }
+            group.length_xor ^= static_cast<uint16_t>(size);
+            ++group.count;
+
+            if (group.count >= group_size) {
+                parity = close(group);
+                return true;
+            }
+            return false;
+        }
+
+        // Take back the frame `add` returned a header for last, because it never went on air. Its sequence number
+        // is reused, so the receiver sees no gap. When that frame closed the group, `parity` is the frame `add`
+        // produced; it is narrowed to the frames that were sent, and emptied if there are none.
+        inline void retract(const std::string &dest, const uint8_t *payload, size_t size, bool closed,
+                            std::string &parity) {
+            auto it = groups_.find(dest);
+            if (it == groups_.end()) {
+                return;
+            }
+            auto &group = it->second;
+            --group.next_seq;
+            --data_frames_;
+
+            if (closed) {
+                if (parity.size() < fec::PARITY_HEADER + size || parity[2] == 0) {
+                    return;
+                }
+                parity[2] = static_cast<char>(static_cast<uint8_t>(parity[2]) - 1);
+                parity[3] = static_cast<char>(static_cast<uint8_t>(parity[3]) ^ (size >> 8));
+                parity[4] = static_cast<char>(static_cast<uint8_t>(parity[4]) ^ (size & 0xFF));
+                for (size_t i = 0; i < size; ++i) {
+                    parity[fec::PARITY_HEADER + i] ^= static_cast<char>(payload[i]);
+                }
+                if (parity[2] == 0) {
+                    parity.clear();
+                    --parity_frames_;
+                }
+                return;
+            }
+            if (group.count == 0) {
+                return; // not part of a group (no parity at this loss)
+            }
+            for (size_t i = 0; i < size && i < group.parity.size(); ++i) {
+                group.parity[i] ^= payload[i];
+            }
+            group.length_xor ^= static_cast<uint16_t>(size);
+            --group.count;
+        }
+
+        // Parity frames for groups idle past `timeout`, as (destination, frame) pairs
+        inline void flush_expired(std::chrono::steady_clock::time_point now, std::chrono::milliseconds timeout,
+                                  std::vector<std::pair<std::string, std::string>> &out) {
+            for (auto &[dest, group] : groups_) {
+                if (group.count > 0 && now - group.started >= timeout) {
+                    out.emplace_back(dest, close(group));
+                }
+            }
+        }
+
+        inline std::chrono::steady_clock::time_point next_flush(std::chrono::milliseconds timeout) const {
+            auto next = std::chrono::steady_clock::time_point::max();
+            for (const auto &[dest, group] : groups_) {
+                if (group.count > 0) {
+                    next = std::min(next, group.started + timeout);
+                }
+            }
+            return next;
+        }
+
+        // Adds the transmit counters to receive-side stats
+        inline FecStats stats(FecStats receive) const {
+            receive.data_frames = data_frames_;
+            receive.parity_frames = parity_frames_;
+            return receive;
+        }
+
+        inline void clear() { groups_.clear(); }
+    };
+
+    class FecDecoder {
+      private:
+        static constexpr int64_t RESYNC_GAP = 64; // larger jumps are a restarted sender, not loss
+
+        struct Stream {
+            bool started = false;
+            uint32_t next = 0; // next expected sequence, extended beyond 8 bits
+            std::array<std::string, 256> frames;
+            std::array<uint32_t, 256> stamp{}; // frames[i] is valid when stamp[i] == its extended sequence + 1
+        };
+
+        std::map<std::pair<std::string, bool>, Stream> streams_;
+        std::map<std::string, double> loss_; // per peer, EWMA of frame loss
+        FecStats stats_;
+
+        inline uint32_t extend(const Stream &stream, uint8_t seq) const {
+            return stream.next + static_cast<int8_t>(seq - static_cast<uint8_t>(stream.next));
+        }
+
+        inline void record(const std::string &peer, uint32_t lost) {
+            double &loss = loss_[peer];
+            stats_.frames_lost += lost;
+            for (uint32_t i = 0; i < lost; ++i) {
+                loss += (1.0 - loss) / 32.0;
+            }
+        }
+
+        inline void advance(Stream &stream, const std::string &peer, uint32_t to) {
+            int64_t gap = static_cast<int64_t>(to) - stream.next;
+            if (gap > 0 && gap <= RESYNC_GAP) {
+                record(peer, static_cast<uint32_t>(gap));
+            }
+            stream.next = to;
+        }
+
+      public:
+        // Strip the FEC layer from a received payload. Returns true with `payload` pointing at the data to deliver;
+        // false for parity frames and duplicates. Frames rebuilt from parity are appended to `recovered`. Payloads
+        // without an FEC header pass through unchanged.
+        inline bool receive(const std::string &peer, bool broadcast, const char *data, size_t size,
+                            std::string_view &payload, std::vector<std::string> &recovered) {
+            const auto *bytes = reinterpret_cast<const uint8_t *>(data);
+            if (size < fec::DATA_HEADER || (bytes[0] != fec::FEC_DATA && bytes[0] != fec::FEC_PARITY)) {
+                payload = std::string_view(data, size);
+                return true;
+            }
+
+            auto &stream = streams_[{peer, broadcast}];
+            if (bytes[0] == fec::FEC_DATA) {
+                if (!stream.started) {
+                    stream.started = true;
+                    stream.next = bytes[1];
+                }
+                uint32_t seq = extend(stream, bytes[1]);
+                size_t slot = seq & 0xFF;
+                if (stream.stamp[slot] == seq + 1) {
+                    return false; // already delivered, possibly rebuilt from parity
+                }
+                if (static_cast<int32_t>(seq - stream.next) >= 0) {
+                    advance(stream, peer, seq);
+                    stream.next = seq + 1;
+                    loss_[peer] -= loss_[peer] / 32.0;
+                }
+                stream.frames[slot].assign(data + fec::DATA_HEADER, size - fec::DATA_HEADER);
+                stream.stamp[slot] = seq + 1;
+                payload = stream.frames[slot];
+                return true;
+            }
+
+            if (size < fec::PARITY_HEADER || !stream.started) {
+                return false;
+            }
+            uint32_t first = extend(stream, bytes[1]);
+            uint32_t end = first + bytes[2];
+            if (static_cast<int32_t>(end - stream.next) > 0) {
+                advance(stream, peer, end); // the tail of the group never arrived
+            }
+
+            uint32_t missing = 0;
+            size_t missing_count = 0;
+            for (uint32_t seq = first; seq != end; ++seq) {
+                if (stream.stamp[seq & 0xFF] != seq + 1) {
+                    missing = seq;
+                    ++missing_count;
+                }
+            }
+            if (missing_count != 1) {
+                return false;
+            }
+
+            uint16_t length = (bytes[3] << 8) | bytes[4];
+            std::string rebuilt(data + fec::PARITY_HEADER, size - fec::PARITY_HEADER);
+            for (uint32_t seq = first; seq != end; ++seq) {
+                if (seq == missing) {
+                    continue;
+                }
+                const auto &frame = stream.frames[seq & 0xFF];
+                length ^= static_cast<uint16_t>(frame.size());
+                for (size_t i = 0; i < frame.size() && i < rebuilt.size(); ++i) {
+                    rebuilt[i] ^= frame[i];
+                }
+            }
+            if (length > rebuilt.size()) {
+                return false; // inconsistent group, e.g. frames from before a sender restart
+            }
+            rebuilt.resize(length);
+
+            stream.frames[missing & 0xFF] = rebuilt;
+            stream.stamp[missing & 0xFF] = missing + 1;
+            recovered.push_back(std::move(rebuilt));
+            ++stats_.frames_recovered;
+            return false;
+        }
+
+        // Measured frame loss from `peer`; by reciprocity also the estimate for frames sent to it
+        inline double loss(const std::string &peer) const {
+            auto it = loss_.find(peer);
+            return it == loss_.end() ? 0.0 : it->second;
+        }
+
+        inline double worst_loss() const {
+            double worst = 0.0;
+            for (const auto &[peer, loss] : loss_) {
+                worst = std::max(worst, loss);
+            }
+            return worst;
+        }
+
+        inline const FecStats &stats() const { return stats_; }
+        inline void clear() {
+            streams_.clear();
+            loss_.clear();
+        }
+    };
+
+} // namespace impulse
@@ -1,13 +1,21 @@
 #pragma once
 
+#include "impulse/network/poller.hpp"
+#include "impulse/util/memory.hpp"
+#include "impulse/util/realtime.hpp"
+
+#include <array>
 #include <cstdint>
 #include <functional>
+#include <iostream>
+#include <memory_resource>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace impulse {
 
-    class NetworkInterface {
+    class NetworkInterface : public Pollable {
       public:
         virtual ~NetworkInterface() = default;
 
@@ -15,6 +23,8 @@ namespace impulse {
         virtual bool start() = 0;
         virtual void stop() = 0;
 
+        // Whether messages can go out now. Interfaces turn this false when a send fails because the link is down,
+        // so a caller can tell after multicast_message whether the message left (the outbox relies on it).
         virtual bool is_connected() const = 0;
 
         virtual void send_message(const std::string &dest_addr, uint16_t dest_port, const std::string &msg) = 0;
@@ -29,13 +39,60 @@ namespace impulse {
         virtual void
         set_message_callback(std::function<void(const std::string &, const std::string &, uint16_t)> callback) = 0;
 
+        // Called after the messages of one receive batch have gone to the message callback, so consumers can
+        // process them in bulk (see Transport::end_of_batch). Interfaces that receive one message at a time never
+        // call it.
+        virtual void set_batch_end_callback(std::function<void()> callback) { batch_end_callback_ = callback; }
+
+        // Choose before start() whether the interface runs its own threads or is driven through poll_once (see
+        // Pollable). Interfaces that cannot work without threads refuse the polled mode.
+        virtual bool set_threading(Threading threading) {
+            if (threading == Threading::polled) {
+                std::cerr << get_interface_name() << ": this interface needs its own threads" << std::endl;
+                return false;
+            }
+            return true;
+        }
+        inline Threading get_threading() const { return threading_; }
+
+        inline void poll_once(std::chrono::milliseconds) override {}
+
+        // Affinity, real-time priority and name of the interface's threads in a role; set before start()
+        inline void set_thread_config(ThreadRole role, const ThreadConfig &config) {
+            thread_configs_[static_cast<size_t>(role)] = config;
+        }
+
+        // Where the interface's internal buffers come from; set before start(). Once they have grown to the
+        // largest message, sending and receiving no longer allocate. Interfaces that still allocate per message
+        // refuse a resource rather than ignore it.
+        virtual bool set_memory_resource(std::pmr::memory_resource *) {
+            std::cerr << get_interface_name() << ": this interface allocates per message and cannot take a memory "
+                      << "resource" << std::endl;
+            return false;
+        }
+
+        // Lateness of the threads in a role: timed waits past their deadline, or received messages picked up
+        // after the kernel timestamped them. Roles an interface does not measure report no samples.
+        inline WakeupStats get_wakeup_stats(ThreadRole role) const {
+            return wakeup_[static_cast<size_t>(role)].stats();
+        }
+
       protected:
         // Common fields that interfaces might use
         std::string address_;
         std::string interface_name_;
         uint16_t port_;
         std::function<void(const std::string &, const std::string &, uint16_t)> message_callback_;
+        std::function<void()> batch_end_callback_;
         bool running_ = false;
+        Threading threading_ = Threading::threads;
+        std::array<ThreadConfig, THREAD_ROLE_COUNT> thread_configs_;
+        std::array<WakeupMonitor, THREAD_ROLE_COUNT> wakeup_;
+        std::pmr::memory_resource *memory_resource_ = std::pmr::get_default_resource();
+
+        inline void configure_thread(ThreadRole role, std::thread &thread, const std::string &default_name) {
+            apply_thread_config(thread, thread_configs_[static_cast<size_t>(role)], default_name);
+        }
     };
 
 } // namespace impulse
@@ -2,17 +2,21 @@
 
 #include "impulse/network/interface.hpp"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <ctime>
 #include <fcntl.h>
 #include <functional>
 #include <iostream>
+#include <memory_resource>
 #include <linux/if_tun.h>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <random>
 #include <string>
 #include <sys/ioctl.h>
@@ -25,6 +29,11 @@ namespace impulse {
 
     enum struct ipv6_type { OS, ULA, DHCP };
 
+    struct LanStats {
+        uint64_t datagrams_received = 0;
+        uint64_t truncated = 0; // longer than the receive size (see set_receive_size); dropped, the rest is lost
+    };
+
     class LanInterface : public NetworkInterface {
       private:
         int socket_fd_;
@@ -103,38 +112,161 @@ namespace impulse {
             return true;
         }
 
-        inline void receive_loop() {
-            char buffer[1024];
-            struct sockaddr_in6 from;
-            socklen_t from_len;
+        // Link state for is_connected: the interface flags, re-read at most every LINK_CHECK_INTERVAL, and send
+        // errors that show the link is gone in between
+        static constexpr std::chrono::milliseconds LINK_CHECK_INTERVAL{100};
+        mutable std::atomic<int64_t> link_checked_{0}; // steady clock, ns; 0 = never
+        mutable std::atomic<bool> link_up_{true};
 
-            while (running_) {
-                from_len = sizeof(from);
-                ssize_t received =
-                    recvfrom(socket_fd_, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr *)&from, &from_len);
+        inline static int64_t steady_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
 
-                if (received > 0) {
-                    char addr_str[INET6_ADDRSTRLEN];
-                    inet_ntop(AF_INET6, &from.sin6_addr, addr_str, sizeof(addr_str));
+        inline bool link_up() const {
+            int64_t now = steady_ns();
+            int64_t checked = link_checked_;
+            if (checked != 0 && now - checked < std::chrono::nanoseconds(LINK_CHECK_INTERVAL).count()) {
+                return link_up_;
+            }
+            link_checked_ = now;
+            struct ifreq ifr;
+            memset(&ifr, 0, sizeof(ifr));
+            strncpy(ifr.ifr_name, interface_name_.c_str(), IFNAMSIZ - 1);
+            if (ioctl(socket_fd_, SIOCGIFFLAGS, &ifr) < 0) {
+                link_up_ = false; // the interface is gone
+            } else {
+                // A TUN device we created has no carrier until something attaches to it; it only has to be up
+                int required = owns_interface_ ? IFF_UP : (IFF_UP | IFF_RUNNING);
+                link_up_ = (ifr.ifr_flags & required) == required;
+            }
+            return link_up_;
+        }
 
-                    // Skip messages from ourselves
-                    if (std::string(addr_str) == address_) {
-                        continue;
-                    }
+        // A send failed; errors that mean the link or our address is gone hold the link down until the next check
+        inline void send_failed(int error) {
+            if (error == ENETDOWN || error == ENETUNREACH || error == EHOSTUNREACH || error == EADDRNOTAVAIL ||
+                error == ENODEV) {
+                link_up_ = false;
+                link_checked_ = steady_ns();
+            }
+        }
 
-                    // If callback is set, call it with the binary data
-                    if (message_callback_) {
-                        std::string message(buffer, received);
-                        message_callback_(message, std::string(addr_str), ntohs(from.sin6_port));
-                    } else {
-                        // Fallback to text printing for non-callback users
-                        buffer[std::min((ssize_t)1023, received)] = '\0';
-                        std::cout << address_ << " received: \"" << buffer << "\" from [" << addr_str
-                                  << "]:" << ntohs(from.sin6_port) << std::endl;
-                    }
+        // Drain up to RECV_BATCH datagrams per wake-up with one recvmmsg call, then signal the end of the batch
+        static constexpr unsigned RECV_BATCH = 64;
+        static constexpr size_t MAX_DATAGRAM = 65527;    // largest UDP payload over IPv6 without jumbograms
+        static constexpr size_t DEFAULT_DATAGRAM = 1452; // an Ethernet MTU less the IPv6 and UDP headers
+        size_t recv_size_ = DEFAULT_DATAGRAM;
+        std::atomic<uint64_t> datagrams_received_{0};
+        std::atomic<uint64_t> truncated_{0};
+
+        // Allocated from memory_resource_ by start(); the strings handed to the callback keep their capacity
+        std::pmr::vector<char> recv_buffers_;
+        std::pmr::vector<struct sockaddr_in6> recv_from_;
+        std::pmr::vector<struct iovec> recv_iov_;
+        std::pmr::vector<struct mmsghdr> recv_msgs_;
+        // Kernel receive timestamps (SO_TIMESTAMPNS), for the receive wake-up latency
+        static constexpr size_t RECV_CONTROL = CMSG_SPACE(sizeof(struct timespec));
+        std::pmr::vector<char> recv_control_;
+        std::string recv_message_;
+        std::string recv_addr_;
+
+        inline void allocate_receive_buffers() {
+            reset_resource(recv_buffers_, memory_resource_);
+            reset_resource(recv_from_, memory_resource_);
+            reset_resource(recv_iov_, memory_resource_);
+            reset_resource(recv_msgs_, memory_resource_);
+            reset_resource(recv_control_, memory_resource_);
+            recv_buffers_.resize(RECV_BATCH * recv_size_);
+            recv_from_.resize(RECV_BATCH);
+            recv_iov_.resize(RECV_BATCH);
+            recv_msgs_.resize(RECV_BATCH);
+            recv_control_.resize(RECV_BATCH * RECV_CONTROL);
+            recv_message_.reserve(recv_size_);
+            recv_addr_.reserve(INET6_ADDRSTRLEN);
+        }
+
+        inline void record_receive_latency(const struct msghdr &hdr, const struct timespec &now) {
+            for (auto *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(const_cast<struct msghdr *>(&hdr), cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                    struct timespec stamp;
+                    memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+                    wakeup_[static_cast<size_t>(ThreadRole::receive)].record(std::chrono::nanoseconds(
+                        (now.tv_sec - stamp.tv_sec) * 1000000000LL + (now.tv_nsec - stamp.tv_nsec)));
+                    return;
                 }
+            }
+        }
 
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        // Receive and deliver what is queued on the socket without blocking; number of datagrams read
+        inline int receive_batch() {
+            int fd = socket_fd_;
+            if (fd < 0) {
+                return 0;
+            }
+            for (unsigned i = 0; i < RECV_BATCH; ++i) {
+                recv_iov_[i] = {recv_buffers_.data() + i * recv_size_, recv_size_};
+                recv_msgs_[i] = {};
+                recv_msgs_[i].msg_hdr.msg_name = &recv_from_[i];
+                recv_msgs_[i].msg_hdr.msg_namelen = sizeof(recv_from_[i]);
+                recv_msgs_[i].msg_hdr.msg_iov = &recv_iov_[i];
+                recv_msgs_[i].msg_hdr.msg_iovlen = 1;
+                recv_msgs_[i].msg_hdr.msg_control = recv_control_.data() + i * RECV_CONTROL;
+                recv_msgs_[i].msg_hdr.msg_controllen = RECV_CONTROL;
+            }
+            int received = recvmmsg(fd, recv_msgs_.data(), RECV_BATCH, MSG_DONTWAIT, nullptr);
+            if (received <= 0) {
+                return 0;
+            }
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            for (int i = 0; i < received; ++i) {
+                record_receive_latency(recv_msgs_[i].msg_hdr, now);
+            }
+            datagrams_received_.fetch_add(received, std::memory_order_relaxed);
+
+            bool delivered = false;
+            for (int i = 0; i < received; ++i) {
+                char *buffer = recv_buffers_.data() + i * recv_size_;
+                size_t length = recv_msgs_[i].msg_len;
+                if (recv_msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    truncated_.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                char addr_str[INET6_ADDRSTRLEN];
+                inet_ntop(AF_INET6, &recv_from_[i].sin6_addr, addr_str, sizeof(addr_str));
+
+                // Skip messages from ourselves
+                if (address_ == addr_str) {
+                    continue;
+                }
+
+                // If callback is set, call it with the binary data
+                if (message_callback_) {
+                    recv_message_.assign(buffer, length);
+                    recv_addr_.assign(addr_str);
+                    message_callback_(recv_message_, recv_addr_, ntohs(recv_from_[i].sin6_port));
+                    delivered = true;
+                } else {
+                    // Fallback to text printing for non-callback users
+                    buffer[std::min(recv_size_ - 1, length)] = '\0';
+                    std::cout << address_ << " received: \"" << buffer << "\" from [" << addr_str
+                              << "]:" << ntohs(recv_from_[i].sin6_port) << std::endl;
+                }
+            }
+            if (delivered && batch_end_callback_) {
+                batch_end_callback_();
+            }
+            return received;
+        }
+
+        inline void receive_loop() {
+            while (running_) {
+                struct pollfd pfd = {socket_fd_, POLLIN, 0};
+                if (pfd.fd >= 0 && poll(&pfd, 1, 10) > 0) {
+                    receive_batch();
+                }
             }
         }
 
@@ -253,6 +385,9 @@ namespace impulse {
             int reuse = 1;
             setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 
+            int timestamps = 1;
+            setsockopt(socket_fd_, SOL_SOCKET, SO_TIMESTAMPNS, &timestamps, sizeof(timestamps));
+
             // Enable multicast loopback so we receive our own messages
             int loop = 1;
             setsockopt(socket_fd_, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop));
@@ -275,8 +410,12 @@ namespace impulse {
                 }
             }
 
+            allocate_receive_buffers();
             running_ = true;
-            receive_thread_ = std::thread(&LanInterface::receive_loop, this);
+            if (threading_ == Threading::threads) {
+                receive_thread_ = std::thread(&LanInterface::receive_loop, this);
+                configure_thread(ThreadRole::receive, receive_thread_, "lan-rx");
+            }
 
             return true;
         }
@@ -317,6 +456,7 @@ namespace impulse {
             inet_pton(AF_INET6, address_.c_str(), &src_addr.sin6_addr);
 
             if (bind(send_fd, (struct sockaddr *)&src_addr, sizeof(src_addr)) < 0) {
+                send_failed(errno);
                 close(send_fd);
                 return;
             }
@@ -335,6 +475,8 @@ namespace impulse {
 
             if (sent > 0) {
                 std::cout << address_ << " sent: \"" << msg << "\" to [" << dest_addr << "]:" << dest_port << std::endl;
+            } else if (sent < 0) {
+                send_failed(errno);
             }
 
             close(send_fd);
@@ -361,6 +503,7 @@ namespace impulse {
             inet_pton(AF_INET6, address_.c_str(), &src_addr.sin6_addr);
 
             if (bind(mcast_fd, (struct sockaddr *)&src_addr, sizeof(src_addr)) < 0) {
+                send_failed(errno);
                 close(mcast_fd);
                 return;
             }
@@ -378,7 +521,8 @@ namespace impulse {
 
             ssize_t sent = sendto(mcast_fd, msg.c_str(), msg.length(), 0, (struct sockaddr *)&dest, sizeof(dest));
 
-            if (sent > 0) {
+            if (sent < 0) {
+                send_failed(errno);
             }
 
             close(mcast_fd);
@@ -402,6 +546,7 @@ namespace impulse {
             inet_pton(AF_INET6, address_.c_str(), &src_addr.sin6_addr);
 
             if (bind(send_fd, (struct sockaddr *)&src_addr, sizeof(src_addr)) < 0) {
+                send_failed(errno);
                 close(send_fd);
                 return;
             }
@@ -423,7 +568,9 @@ namespace impulse {
                     continue;
                 }
 
-                sendto(send_fd, msg.c_str(), msg.length(), 0, (struct sockaddr *)&dest, sizeof(dest));
+                if (sendto(send_fd, msg.c_str(), msg.length(), 0, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+                    send_failed(errno);
+                }
             }
 
             close(send_fd);
@@ -437,7 +584,62 @@ namespace impulse {
             message_callback_ = callback;
         }
 
-        inline bool is_connected() const override { return running_ && socket_fd_ >= 0; }
+        // Also false while the interface is down or has lost its carrier, and right after a send failed for that
+        inline bool is_connected() const override { return running_ && socket_fd_ >= 0 && link_up(); }
+
+        // Largest datagram received whole, set before start(); longer ones are counted as truncated and dropped.
+        // The default takes what fits in one Ethernet frame, about 90 KiB of buffers for a batch. Raise it for
+        // messages that travel fragmented, up to any UDP datagram at RECV_BATCH times that (4 MiB).
+        inline bool set_receive_size(size_t size) {
+            if (running_) {
+                std::cerr << address_ << ": set the receive size before start()" << std::endl;
+                return false;
+            }
+            recv_size_ = std::clamp<size_t>(size, 1, MAX_DATAGRAM);
+            return true;
+        }
+
+        inline LanStats get_stats() const {
+            LanStats stats;
+            stats.datagrams_received = datagrams_received_.load(std::memory_order_relaxed);
+            stats.truncated = truncated_.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+        // Receive buffers come from `resource` from the next start()
+        inline bool set_memory_resource(std::pmr::memory_resource *resource) override {
+            memory_resource_ = resource;
+            return true;
+        }
+
+        // Polled mode: no receive thread; datagrams are delivered from poll_once on the caller's thread
+        inline bool set_threading(Threading threading) override {
+            if (running_) {
+                std::cerr << address_ << ": set the threading mode before start()" << std::endl;
+                return false;
+            }
+            threading_ = threading;
+            return true;
+        }
+
+        inline std::vector<int> get_poll_fds() const override {
+            if (threading_ != Threading::polled || socket_fd_ < 0) {
+                return {};
+            }
+            return {socket_fd_};
+        }
+
+        inline void poll_once(std::chrono::milliseconds timeout) override {
+            if (threading_ != Threading::polled || !running_) {
+                return;
+            }
+            if (timeout.count() > 0 && wait_readable(get_poll_fds(), timeout, next_deadline()) <= 0) {
+                return;
+            }
+            // A short batch means the socket is empty; under a flood the rest waits for the next call
+            for (int i = 0; i < 16 && receive_batch() == static_cast<int>(RECV_BATCH); ++i) {
+            }
+        }
 
         // LAN-specific methods
         inline const std::string &get_ipv6() const { return address_; }
@@ -1,22 +1,40 @@
 #pragma once
 
+#include "impulse/network/adr.hpp"
+#include "impulse/network/fec.hpp"
 #include "impulse/network/interface.hpp"
+#include "impulse/network/neighbors.hpp"
+#include "impulse/network/scheduler.hpp"
+#include "impulse/network/serial_framing.hpp"
+#include "impulse/network/short_address.hpp"
+#include "impulse/util/memory.hpp"
+#include "impulse/util/ring_buffer.hpp"
 #include <algorithm>
 #include <arpa/inet.h>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <deque>
 #include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <linux/serial.h>
 #include <map>
+#include <memory_resource>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <poll.h>
 #include <regex>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
-#include <sys/select.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <termios.h>
 #include <thread>
 #include <unistd.h>
@@ -31,7 +49,11 @@ namespace impulse {
         CMD_GET_STATUS = 0x03,
         CMD_SET_CONFIG = 0x04,
         CMD_RESET_NODE = 0x05,
-        CMD_GET_NEIGHBORS = 0x06
+        CMD_GET_NEIGHBORS = 0x06, // [1 byte: first entry index]
+        CMD_SET_BAUD = 0x07,    // [4 bytes: baud, big-endian]; firmware ACKs at the old rate, then switches
+        CMD_SEND_SHORT = 0x08,  // [2 bytes: length][2 bytes: dest short ID][N bytes: payload]
+        CMD_SET_SHORT_ID = 0x09, // [2 bytes: own short ID]; enables short-address frames on the air
+        CMD_SET_FRAMING = 0x0A   // [1 byte: version]; firmware ACKs in the old framing, then switches
     };
 
     enum ResponseType : uint8_t {
@@ -39,7 +61,11 @@ namespace impulse {
         RESP_NACK = 0x81,
         RESP_STATUS = 0x82,
         RESP_MESSAGE = 0x83,
-        RESP_ERROR = 0x84
+        RESP_ERROR = 0x84,
+        RESP_MESSAGE_SHORT = 0x85, // [1 byte: broadcast][2 bytes: src short ID][2 bytes: length][N bytes: payload]
+        // [1 byte: total entries][1 byte: first index][1 byte: count][count x 22 bytes: 16 IPv6, 1 hops,
+        //  2 RSSI dBm (0x8000 = n/a), 1 SNR dB (0x80 = n/a), 2 seconds since heard]
+        RESP_NEIGHBORS = 0x86
     };
 
     enum ErrorCode : uint8_t {
@@ -51,6 +77,36 @@ namespace impulse {
         ERR_CHECKSUM_FAILED = 0x06
     };
 
+    // Host-to-radio serial link settings (always 8N1)
+    struct SerialConfig {
+        uint32_t baud_rate = 115200; // any rate; non-standard rates are set through termios2
+        bool hardware_flow_control = false; // RTS/CTS
+        // Negotiate the fastest rate the firmware and adapter sustain, up to max_baud_rate, during start()
+        bool negotiate_baud = false;
+        uint32_t max_baud_rate = 3000000;
+        // Switch to length-prefixed, CRC-checked framing (FramingVersion::v2) during start() if the firmware has it
+        bool negotiate_framing = false;
+        // Reopen the port after the radio resets or re-enumerates, then replay the node configuration
+        bool auto_reconnect = true;
+        std::chrono::milliseconds reconnect_backoff_min = std::chrono::milliseconds(250);
+        std::chrono::milliseconds reconnect_backoff_max = std::chrono::seconds(10);
+        std::chrono::seconds heartbeat_interval = std::chrono::seconds(30);
+        uint8_t max_missed_heartbeats = 2; // unanswered status probes before the link is declared dead
+    };
+
+    // Result of LoRaInterface::benchmark_link
+    struct LinkBenchmark {
+        uint32_t baud_rate = 0;
+        uint32_t requests = 0;
+        uint32_t responses = 0;
+        uint32_t errors = 0; // timeouts and malformed responses
+        std::chrono::microseconds elapsed{0};
+        std::chrono::microseconds mean_round_trip{0};
+        double throughput_bps = 0.0; // payload bits moved over the serial link per second
+
+        inline double error_rate() const { return requests == 0 ? 0.0 : double(errors) / requests; }
+    };
+
     struct LoRaStatus {
         std::string current_ipv6;
         bool radio_active;
@@ -60,6 +116,35 @@ namespace impulse {
         uint16_t uptime_seconds;
     };
 
+    // Outcome of a command sent to the radio. `completed` is false when the deadline passed, the write failed
+    // or the interface stopped before the firmware answered.
+    struct CommandResult {
+        uint32_t sequence = 0;
+        uint8_t command = 0;
+        bool completed = false;
+        ResponseType response_type = RESP_ERROR;
+        std::vector<uint8_t> response;
+
+        inline bool ok() const { return completed && response_type != RESP_NACK && response_type != RESP_ERROR; }
+    };
+
+    using CommandCallback = std::function<void(const CommandResult &)>;
+
+    // How received LoRa messages reach the application
+    enum struct DeliveryMode : uint8_t {
+        callback = 0, // message callback only
+        queue = 1,    // bounded pull queue only (drain_messages / get_pending_messages)
+        both = 2,
+    };
+
+    struct ReceiveStats {
+        uint64_t received = 0;
+        uint64_t queued = 0;
+        uint64_t dropped = 0; // queue overflows
+        size_t queue_size = 0;
+        size_t queue_capacity = 0;
+    };
+
     struct IncomingMessage {
         std::string source_addr;
         std::string message;
@@ -71,24 +156,133 @@ namespace impulse {
       private:
         // Serial communication
         std::string serial_port_;
+        SerialConfig serial_config_;
+        std::atomic<uint32_t> baud_rate_;
         int serial_fd_;
-        bool serial_connected_;
+        std::atomic<bool> serial_connected_;
 
         // Threading
         std::thread listen_thread_;
         std::thread heartbeat_thread_;
         std::atomic<bool> running_;
+        int wake_fd_; // eventfd used to break the listen thread out of poll()
+        std::mutex heartbeat_mutex_;
+        std::condition_variable heartbeat_wake_;
+        uint64_t heartbeat_generation_ = 0; // bumped to make the heartbeat re-plan its next wake-up
+        std::chrono::steady_clock::time_point last_status_check_;
+        std::chrono::steady_clock::time_point last_neighbor_poll_;
+        std::atomic<uint8_t> missed_heartbeats_{0};
+        std::atomic<bool> status_in_flight_{false}; // a heartbeat status probe is waiting for its answer
+
+        // Polled mode: poll_once does the work of all three threads on the caller's thread. It is next due at
+        // poll_deadline_; the port is reopened one attempt per call once reconnect_at_ has passed.
+        std::chrono::steady_clock::time_point poll_deadline_;
+        std::chrono::steady_clock::time_point reconnect_at_;
+        std::chrono::milliseconds reconnect_backoff_{0};
+
+        // Transmit scheduling: frames wait here until airtime, duty cycle and pacing allow them on air
+        std::thread tx_thread_;
+        TxScheduler tx_scheduler_;
+        mutable std::mutex tx_queue_mutex_;
+        std::condition_variable tx_queue_wake_;
+        std::vector<std::pair<std::string, std::string>> fec_flushed_; // parity of idle FEC groups; transmit side only
+        // Frames that went on air, kept for their buffers: the next frames are built in them. Guarded by
+        // tx_queue_mutex_, allocated from memory_resource_ by start().
+        std::pmr::vector<TxFrame> spare_frames_;
+        static constexpr size_t SPARE_FRAMES = 16;
+        TxOptions default_tx_options_;
+        std::function<TxOptions(const std::string &dest_addr, const std::string &msg)> tx_classifier_;
 
         // Message handling
-        std::queue<IncomingMessage> incoming_messages_;
+        RingBuffer<IncomingMessage> incoming_messages_;
+        std::string callback_message_; // listen side only; handed to the callback, keeping their capacity
+        std::string callback_source_;
         mutable std::mutex message_queue_mutex_;
         std::condition_variable message_available_;
-
-        // Command synchronization
-        mutable std::mutex command_mutex_;
-        std::condition_variable command_response_;
-        std::map<uint8_t, std::vector<uint8_t>> pending_responses_;
-        std::chrono::milliseconds command_timeout_;
+        std::atomic<DeliveryMode> delivery_mode_;
+        std::atomic<uint64_t> received_count_;
+
+        // Command pipeline. In framing v2 each command carries its sequence ID (wire_sequence) and the firmware
+        // echoes it, so a response completes exactly the command it answers and a lost one fails only its own.
+        // v1 responses carry no sequence; the firmware answers in order, so each completes the oldest command of
+        // its type. Once a v1 command times out or a frame is dropped that order cannot be trusted: every v1
+        // command of the type in flight fails, answers of the type are discarded for one more timeout, and
+        // commands of the type submitted meanwhile are held back and written when it is over.
+        // tx_mutex_ orders registration with the serial write; the listen thread only takes it to swap the port.
+        // Queue nodes come from command_pool_, which start() puts on memory_resource_ and which recycles them.
+        struct PendingCommand {
+            uint32_t sequence;
+            std::chrono::steady_clock::time_point deadline;
+            std::chrono::milliseconds timeout;
+            std::shared_ptr<std::promise<CommandResult>> promise;
+            CommandCallback callback;
+            bool tagged = false;       // written in v2, answered by sequence
+            bool written = true;       // false while held back by a v1 resynchronisation
+            std::vector<uint8_t> held; // command data to write once it is over
+        };
+        std::mutex tx_mutex_;
+        FramingVersion tx_framing_ = FramingVersion::v1; // guarded by tx_mutex_
+        std::vector<uint8_t> tx_packet_;                 // encoded command, guarded by tx_mutex_
+        std::mutex pending_mutex_;
+        std::unique_ptr<std::pmr::unsynchronized_pool_resource> command_pool_;
+        std::pmr::map<uint8_t, std::pmr::deque<PendingCommand>> pending_commands_;
+        std::map<uint8_t, std::chrono::steady_clock::time_point> resync_until_; // v1 answers discarded until then
+        uint32_t next_sequence_;
+        std::atomic<std::chrono::milliseconds> command_timeout_;
+
+        // Short addressing: 16-bit IDs instead of 16-byte addresses on the air, when the firmware supports it
+        ShortAddressTable short_addresses_;
+        bool short_addressing_requested_;
+        std::atomic<bool> short_addressing_;
+
+        // Reconnection: the listen thread reopens the port, the heartbeat thread then replays the configuration.
+        // Transmissions wait in the scheduler until the link is configured again.
+        struct ReplayState {
+            std::optional<uint8_t> tx_power;
+            std::optional<uint32_t> frequency_hz;
+            std::optional<uint8_t> hop_limit;
+            std::optional<uint8_t> spreading_factor;
+            std::optional<uint32_t> bandwidth_hz;
+        };
+        std::string reconnect_port_; // stable /dev/serial/by-id alias of serial_port_, when there is one
+        std::atomic<bool> link_ready_;
+        std::atomic<bool> reconnect_requested_;
+        std::atomic<bool> replay_pending_;
+        std::atomic<uint32_t> replay_round_{0}; // answers from an abandoned replay are ignored
+        std::atomic<bool> baud_pending_{false}; // replayed; the heartbeat negotiates the line rate, then resumes
+        std::atomic<uint32_t> reconnects_;
+        std::mutex replay_mutex_;
+        ReplayState replay_;
+
+        // Response framing; the framer belongs to the listen thread, which mirrors its stats for readers
+        SerialFramer framer_{&LoRaInterface::v1_frame_length};
+        std::vector<uint8_t> rx_frame_; // the frame being acted on; reused, like the framer
+        uint64_t discarded_bytes_ = 0; // framer discards already acted on
+        mutable std::mutex framing_stats_mutex_;
+        FramingStats framing_stats_;
+
+        // Neighbour table, refreshed page by page with CMD_GET_NEIGHBORS and from frames we receive
+        NeighborCache neighbors_;
+        std::atomic<std::chrono::seconds> neighbor_interval_;
+
+        // Optional forward error correction, applied when a frame actually goes on air so that frames dropped or
+        // coalesced by the scheduler never end up inside a parity group
+        mutable std::mutex fec_mutex_;
+        FecConfig fec_config_;
+        FecEncoder fec_encoder_;
+        FecDecoder fec_decoder_;
+        std::string fec_payload_;                // listen thread only
+        std::vector<std::string> fec_recovered_; // listen thread only
+
+        // Adaptive data rate, driven from the heartbeat thread with neighbour SNR and FEC loss measurements. Settings
+        // are pushed with callback commands; adr_mutex_ only guards the state, never a wait for the firmware.
+        std::mutex adr_mutex_;
+        AdrController adr_;
+        LinkSettings link_settings_;
+        std::map<std::string, LinkSettings> destination_settings_;
+        std::map<std::string, std::chrono::steady_clock::time_point> adr_sampled_; // last neighbour entry sampled
+        std::chrono::steady_clock::time_point adr_last_change_;
+        uint32_t adr_in_flight_ = 0; // ADR commands not answered yet; no new round starts until they are
 
         // Node state
         std::string node_ipv6_;
@@ -97,6 +291,7 @@ namespace impulse {
 
         // Broadcast address constant
         static constexpr const char *BROADCAST_IPV6 = "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff";
+        static constexpr size_t NEIGHBOR_ENTRY_SIZE = 22;
 
         // Address conversion helpers
         inline std::vector<uint8_t> string_to_ipv6_bytes(const std::string &addr) {
@@ -130,21 +325,124 @@ namespace impulse {
             return inet_pton(AF_INET6, addr.c_str(), &(sa.sin6_addr)) == 1;
         }
 
+        // Kernel termios2 (asm-generic/termbits.h). <asm/termbits.h> cannot be included next to <termios.h>, so the
+        // layout and the ioctls are spelled out here; they are only used for rates without a Bxxx constant.
+        struct serial_termios2 {
+            tcflag_t c_iflag;
+            tcflag_t c_oflag;
+            tcflag_t c_cflag;
+            tcflag_t c_lflag;
+            cc_t c_line;
+            cc_t c_cc[19];
+            speed_t c_ispeed;
+            speed_t c_ospeed;
+        };
+
+        inline static speed_t standard_baud(uint32_t baud_rate) {
+            switch (baud_rate) {
+            case 9600:
+                return B9600;
+            case 19200:
+                return B19200;
+            case 38400:
+                return B38400;
+            case 57600:
+                return B57600;
+            case 115200:
+                return B115200;
+            case 230400:
+                return B230400;
+            case 460800:
+                return B460800;
+            case 500000:
+                return B500000;
+            case 576000:
+                return B576000;
+            case 921600:
+                return B921600;
+            case 1000000:
+                return B1000000;
+            case 1152000:
+                return B1152000;
+            case 1500000:
+                return B1500000;
+            case 2000000:
+                return B2000000;
+            case 2500000:
+                return B2500000;
+            case 3000000:
+                return B3000000;
+            case 3500000:
+                return B3500000;
+            case 4000000:
+                return B4000000;
+            default:
+                return B0;
+            }
+        }
+
+        // Switch the line to the given rate and flow control, waiting for queued output to drain first
+        inline bool apply_line_settings(uint32_t baud_rate, bool hardware_flow_control) {
+            tcdrain(serial_fd_);
+
+            struct termios options;
+            if (tcgetattr(serial_fd_, &options) != 0) {
+                return false;
+            }
+
+            if (hardware_flow_control) {
+                options.c_cflag |= CRTSCTS;
+            } else {
+                options.c_cflag &= ~CRTSCTS;
+            }
+
+            speed_t speed = standard_baud(baud_rate);
+            if (speed != B0) {
+                cfsetispeed(&options, speed);
+                cfsetospeed(&options, speed);
+                if (tcsetattr(serial_fd_, TCSANOW, &options) != 0) {
+                    return false;
+                }
+            } else {
+                if (tcsetattr(serial_fd_, TCSANOW, &options) != 0) {
+                    return false;
+                }
+
+                constexpr tcflag_t BOTHER_FLAG = 0010000; // BOTHER: rate given in c_ispeed/c_ospeed
+                struct serial_termios2 options2;
+                if (ioctl(serial_fd_, _IOR('T', 0x2A, struct serial_termios2), &options2) != 0) {
+                    return false;
+                }
+                options2.c_cflag &= ~CBAUD;
+                options2.c_cflag |= BOTHER_FLAG;
+                options2.c_ispeed = baud_rate;
+                options2.c_ospeed = baud_rate;
+                if (ioctl(serial_fd_, _IOW('T', 0x2B, struct serial_termios2), &options2) != 0) {
+                    return false;
+                }
+            }
+
+            baud_rate_ = baud_rate;
+            return true;
+        }
+
         // Serial operations
-        inline bool open_serial_port() {
-            serial_fd_ = open(serial_port_.c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
+        inline bool open_serial_port(const std::string &path) {
+            // Open non-blocking so a missing carrier cannot hang open(), then switch to blocking I/O:
+            // reads are only issued after poll() reports data, and writes must not be cut short.
+            serial_fd_ = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
             if (serial_fd_ == -1) {
                 return false;
             }
+            int flags = fcntl(serial_fd_, F_GETFL);
+            if (flags != -1) {
+                fcntl(serial_fd_, F_SETFL, flags & ~O_NONBLOCK);
+            }
 
             // Configure serial port
             struct termios options;
             tcgetattr(serial_fd_, &options);
 
-            // Set baud rate to 115200
-            cfsetispeed(&options, B115200);
-            cfsetospeed(&options, B115200);
-
             // 8N1
             options.c_cflag &= ~PARENB; // No parity
             options.c_cflag &= ~CSTOPB; // 1 stop bit
@@ -160,11 +458,30 @@ namespace impulse {
             // Raw output
             options.c_oflag &= ~OPOST;
 
-            // No flow control
+            // No flow control, and no translation of the binary protocol bytes (0x0D, 0x11, 0x13, ...)
             options.c_iflag &= ~(IXON | IXOFF | IXANY);
+            options.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
+
+            // read() returns whatever is buffered without waiting; poll() does the waiting
+            options.c_cc[VMIN] = 0;
+            options.c_cc[VTIME] = 0;
 
-            // Apply settings
+            // Apply settings, then the configured rate and flow control
             tcsetattr(serial_fd_, TCSANOW, &options);
+            if (!apply_line_settings(serial_config_.baud_rate, serial_config_.hardware_flow_control)) {
+                std::cerr << "Unsupported serial settings on " << serial_port_ << ": " << serial_config_.baud_rate
+                          << " baud" << std::endl;
+                close(serial_fd_);
+                serial_fd_ = -1;
+                return false;
+            }
+
+            // Ask the driver to push received bytes up immediately (e.g. 1 ms FTDI latency timer)
+            struct serial_struct serial_info;
+            if (ioctl(serial_fd_, TIOCGSERIAL, &serial_info) == 0) {
+                serial_info.flags |= ASYNC_LOW_LATENCY;
+                ioctl(serial_fd_, TIOCSSERIAL, &serial_info);
+            }
 
             // Flush buffers
             tcflush(serial_fd_, TCIOFLUSH);
@@ -186,330 +503,1562 @@ namespace impulse {
                 return false;
             }
 
-            ssize_t bytes_written = write(serial_fd_, data.data(), data.size());
-            return bytes_written == static_cast<ssize_t>(data.size());
+            size_t offset = 0;
+            while (offset < data.size()) {
+                ssize_t bytes_written = write(serial_fd_, data.data() + offset, data.size() - offset);
+                if (bytes_written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                offset += bytes_written;
+            }
+            return true;
         }
 
-        inline std::vector<uint8_t> read_serial(size_t max_bytes = 1024) {
-            std::vector<uint8_t> data;
-
+        inline ssize_t read_serial(uint8_t *buffer, size_t max_bytes) {
             if (serial_fd_ == -1) {
-                return data;
+                return -1;
             }
 
-            std::vector<uint8_t> buffer(max_bytes);
-            ssize_t bytes_read = read(serial_fd_, buffer.data(), max_bytes);
+            ssize_t bytes_read;
+            do {
+                bytes_read = read(serial_fd_, buffer, max_bytes);
+            } while (bytes_read < 0 && errno == EINTR);
 
-            if (bytes_read > 0) {
-                data.assign(buffer.begin(), buffer.begin() + bytes_read);
-            }
+            return bytes_read;
+        }
 
-            return data;
+        // Wake the listen thread out of poll() (used on shutdown)
+        inline void wake_listener() {
+            if (wake_fd_ != -1) {
+                uint64_t one = 1;
+                ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+                (void)ignored;
+            }
         }
 
-        // Protocol handling
-        inline bool send_command(SerialCommand cmd, const std::vector<uint8_t> &data = {}) {
-            if (!serial_connected_) {
-                return false;
+        // Block until the serial port has data, the timeout (-1 = none) expires or the listener is woken.
+        // Returns 1 when data is readable, 0 on timeout or wake-up and -1 on a fatal port error.
+        inline int wait_serial_readable(int timeout_ms) {
+            struct pollfd fds[2] = {{serial_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+
+            int ready = poll(fds, 2, timeout_ms);
+            if (ready < 0) {
+                return errno == EINTR ? 0 : -1;
             }
 
-            std::lock_guard<std::mutex> lock(command_mutex_);
+            if (fds[1].revents & POLLIN) {
+                uint64_t counter;
+                ssize_t ignored = read(wake_fd_, &counter, sizeof(counter));
+                (void)ignored;
+            }
 
-            // Prepare command packet
-            std::vector<uint8_t> packet;
-            packet.push_back(static_cast<uint8_t>(cmd));
-            packet.insert(packet.end(), data.begin(), data.end());
+            if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                return -1;
+            }
 
-            return write_serial(packet);
+            return (fds[0].revents & POLLIN) ? 1 : 0;
         }
 
-        inline bool wait_for_response(SerialCommand cmd, std::vector<uint8_t> &response,
-                                      std::chrono::milliseconds timeout = std::chrono::milliseconds(5000)) {
-            std::unique_lock<std::mutex> lock(command_mutex_);
+        // Protocol handling
+        inline static void complete_command(PendingCommand &pending, CommandResult &result) {
+            result.sequence = pending.sequence;
+            if (pending.callback) {
+                pending.callback(result);
+            }
+            if (pending.promise) {
+                pending.promise->set_value(std::move(result));
+            }
+        }
 
-            auto wait_result = command_response_.wait_for(lock, timeout, [this, cmd] {
-                return pending_responses_.find(static_cast<uint8_t>(cmd)) != pending_responses_.end();
-            });
+        // Sequence number a v2 frame carries for a command; 0 is left for frames that answer none
+        inline static uint16_t wire_sequence(uint32_t sequence) { return static_cast<uint16_t>(sequence % 0xFFFF + 1); }
+
+        // Register the command in the pipeline and write it to the radio. Every command is registered, even
+        // fire-and-forget ones, so that the response FIFO of its type stays aligned with what the firmware saw.
+        // Returns whether the command reached the serial port (or is held back until a resynchronisation ends).
+        inline bool dispatch_command(SerialCommand cmd, const std::vector<uint8_t> &data,
+                                     std::shared_ptr<std::promise<CommandResult>> promise, CommandCallback callback,
+                                     std::chrono::milliseconds timeout, uint32_t *sequence_out = nullptr) {
+            if (timeout <= std::chrono::milliseconds::zero()) {
+                timeout = command_timeout_.load();
+            }
 
-            if (wait_result) {
-                response = pending_responses_[static_cast<uint8_t>(cmd)];
-                pending_responses_.erase(static_cast<uint8_t>(cmd));
+            std::unique_lock<std::mutex> tx_lock(tx_mutex_);
+            bool tagged = tx_framing_ == FramingVersion::v2;
+
+            uint32_t sequence;
+            bool earliest = true;
+            bool held = false;
+            auto now = std::chrono::steady_clock::now();
+            auto deadline = now + timeout;
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                sequence = next_sequence_++;
+                auto resync = resync_until_.find(cmd);
+                held = !tagged && resync != resync_until_.end() && resync->second > now;
+                for (const auto &[type, queue] : pending_commands_) {
+                    if (!queue.empty() && queue.front().deadline <= deadline) {
+                        earliest = false;
+                    }
+                }
+                pending_commands_[cmd].push_back({sequence, deadline, timeout, std::move(promise), std::move(callback),
+                                                  tagged, !held, held ? data : std::vector<uint8_t>{}});
+            }
+            if (sequence_out) {
+                *sequence_out = sequence;
+            }
+            if (held) {
+                wake_listener(); // it writes the command once answers of this type can be told apart again
                 return true;
             }
 
+            SerialFramer::encode_command(tx_framing_, cmd, data, tx_packet_, tagged ? wire_sequence(sequence) : 0);
+            if (serial_connected_ && write_serial(tx_packet_)) {
+                if (cmd == CMD_SET_FRAMING && !data.empty()) {
+                    // The firmware reads everything after this command in the new framing
+                    tx_framing_ = static_cast<FramingVersion>(data[0]);
+                }
+                tx_lock.unlock();
+                if (earliest) {
+                    wake_listener(); // re-arm the listener's poll timeout for the new deadline
+                }
+                return true;
+            }
+            tx_lock.unlock();
+            fail_command(cmd, sequence);
             return false;
         }
 
-        inline void parse_response(const std::vector<uint8_t> &packet) {
-            if (packet.size() < 5) {
-                return;
+        // Withdraw an entry whose write failed and fail it immediately
+        inline void fail_command(uint8_t cmd, uint32_t sequence) {
+            PendingCommand failed{};
+            bool found = false;
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                auto &queue = pending_commands_[cmd];
+                for (auto it = queue.begin(); it != queue.end(); ++it) {
+                    if (it->sequence == sequence) {
+                        failed = std::move(*it);
+                        queue.erase(it);
+                        found = true;
+                        break;
+                    }
+                }
             }
+            if (found) {
+                CommandResult result;
+                result.command = cmd;
+                complete_command(failed, result);
+            }
+        }
 
-            ResponseType response_type = static_cast<ResponseType>(packet[4]);
-            std::vector<uint8_t> data(packet.begin() + 5, packet.end());
-
-            switch (response_type) {
-            case RESP_MESSAGE: {
-                if (data.size() >= 19) { // flag + src + len
-                    bool is_broadcast = data[0] != 0;
-                    std::vector<uint8_t> src_bytes(data.begin() + 1, data.begin() + 17);
-                    std::string src_addr = ipv6_bytes_to_string(src_bytes);
-                    uint16_t msg_len = (data[17] << 8) | data[18];
+        // Fire-and-forget command; returns whether it reached the serial port
+        inline bool send_command(SerialCommand cmd, const std::vector<uint8_t> &data = {}) {
+            if (!serial_connected_) {
+                return false;
+            }
 
-                    if (data.size() >= 19 + msg_len) {
-                        std::string message(data.begin() + 19, data.begin() + 19 + msg_len);
+            return dispatch_command(cmd, data, nullptr, nullptr, std::chrono::milliseconds::zero());
+        }
 
-                        // Add to message queue
-                        {
-                            std::lock_guard<std::mutex> lock(message_queue_mutex_);
-                            incoming_messages_.push(
-                                {src_addr, message, is_broadcast, std::chrono::steady_clock::now()});
+        // Complete the command a firmware response answers: by sequence when the frame carries one (`cmd` -1 =
+        // whichever type it is), else the oldest v1 command of type `cmd`
+        inline void resolve_command(int cmd, ResponseType type, const std::vector<uint8_t> &data, uint16_t sequence) {
+            PendingCommand pending{};
+            uint8_t command = 0;
+            bool found = false;
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                for (auto &[queue_type, queue] : pending_commands_) {
+                    if (cmd != -1 && queue_type != cmd) {
+                        continue;
+                    }
+                    if (sequence == 0) {
+                        auto resync = resync_until_.find(queue_type);
+                        if (resync != resync_until_.end() && resync->second > std::chrono::steady_clock::now()) {
+                            return; // possibly the late answer to a command that already failed
                         }
-                        message_available_.notify_one();
+                    }
+                    auto it = std::find_if(queue.begin(), queue.end(), [sequence](const PendingCommand &pending) {
+                        return sequence == 0 ? pending.written && !pending.tagged
+                                             : pending.tagged && wire_sequence(pending.sequence) == sequence;
+                    });
+                    if (it != queue.end()) {
+                        pending = std::move(*it);
+                        queue.erase(it);
+                        command = queue_type;
+                        found = true;
+                        break;
+                    }
+                }
+            }
+            if (!found) {
+                return; // the answer to a command that already failed
+            }
 
-                        // Call callback if set
-                        if (message_callback_) {
-                            message_callback_(message, src_addr, 0);
-                        }
+            CommandResult result;
+            result.command = command;
+            result.completed = true;
+            result.response_type = type;
+            if (pending.callback || pending.promise) {
+                result.response = data; // `data` is the listener's buffer; fire-and-forget commands need no copy
+            }
+            complete_command(pending, result);
+        }
+
+        // Oldest in-flight command across all types, used for v1 responses that do not name their command
+        inline int oldest_pending_command() {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            int oldest = -1;
+            uint32_t oldest_sequence = 0;
+            for (const auto &[type, queue] : pending_commands_) {
+                for (const auto &pending : queue) {
+                    if (!pending.written || pending.tagged) {
+                        continue;
                     }
+                    if (oldest == -1 || pending.sequence - oldest_sequence > UINT32_MAX / 2) {
+                        oldest = type;
+                        oldest_sequence = pending.sequence;
+                    }
+                    break;
                 }
-                break;
             }
+            return oldest;
+        }
 
-            case RESP_ACK:
-            case RESP_NACK:
-            case RESP_STATUS:
-            case RESP_ERROR: {
-                // Store response for waiting command
-                std::lock_guard<std::mutex> lock(command_mutex_);
-                if (!data.empty()) {
-                    uint8_t original_cmd = data[0];
-                    pending_responses_[original_cmd] = data;
+        // v1 answers of `type` can no longer be matched by order: fail what is in flight and discard answers for
+        // as long as the longest of those commands (and `timeout`) was given. Caller holds pending_mutex_.
+        inline void resync_type(uint8_t type, std::pmr::deque<PendingCommand> &queue,
+                                std::chrono::steady_clock::time_point now, std::chrono::milliseconds timeout,
+                                std::vector<std::pair<uint8_t, PendingCommand>> &failed) {
+            for (auto it = queue.begin(); it != queue.end();) {
+                if (it->written && !it->tagged) {
+                    timeout = std::max(timeout, it->timeout);
+                    failed.emplace_back(type, std::move(*it));
+                    it = queue.erase(it);
+                } else {
+                    ++it;
                 }
-                command_response_.notify_all();
-                break;
             }
+            if (timeout > std::chrono::milliseconds::zero()) {
+                auto &until = resync_until_[type];
+                until = std::max(until, now + timeout);
             }
         }
 
-        // Background threads
-        inline void listen_thread_func() {
-            std::vector<uint8_t> buffer;
-            const std::vector<uint8_t> HEADER = {0xAA, 0xBB, 0xCC, 0xDD};
-
-            while (running_) {
-                auto data = read_serial(1024);
-                if (!data.empty()) {
-                    buffer.insert(buffer.end(), data.begin(), data.end());
-
-                    // Look for complete packets starting with header
-                    while (buffer.size() >= 5) { // Header + response type
-                        auto header_pos = std::search(buffer.begin(), buffer.end(), HEADER.begin(), HEADER.end());
-
-                        if (header_pos == buffer.end()) {
-                            // No header found, clear buffer
-                            buffer.clear();
-                            break;
-                        }
+        // A v1 frame was dropped; whichever command it answered, the order of every type is in doubt
+        inline void frame_dropped() {
+            auto now = std::chrono::steady_clock::now();
+            std::vector<std::pair<uint8_t, PendingCommand>> failed;
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                for (auto &[type, queue] : pending_commands_) {
+                    resync_type(type, queue, now, std::chrono::milliseconds::zero(), failed);
+                }
+            }
+            for (auto &[type, pending] : failed) {
+                CommandResult result;
+                result.command = type;
+                complete_command(pending, result);
+            }
+        }
 
-                        // Remove data before header
-                        if (header_pos != buffer.begin()) {
-                            buffer.erase(buffer.begin(), header_pos);
+        // Write commands that were held back while their type resynchronised
+        inline void write_held_commands(const std::vector<std::pair<uint8_t, uint32_t>> &ready) {
+            std::vector<uint8_t> data;
+            for (auto [cmd, sequence] : ready) {
+                bool written = false;
+                {
+                    std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+                    bool tagged = tx_framing_ == FramingVersion::v2;
+                    {
+                        std::lock_guard<std::mutex> lock(pending_mutex_);
+                        for (auto &pending : pending_commands_[cmd]) {
+                            if (pending.sequence == sequence && !pending.written) {
+                                data = std::move(pending.held);
+                                pending.written = true;
+                                pending.tagged = tagged;
+                                pending.deadline = std::chrono::steady_clock::now() + pending.timeout;
+                                written = true;
+                                break;
+                            }
                         }
+                    }
+                    if (!written) {
+                        continue; // completed meanwhile
+                    }
+                    SerialFramer::encode_command(tx_framing_, cmd, data, tx_packet_,
+                                                 tagged ? wire_sequence(sequence) : 0);
+                    written = serial_connected_ && write_serial(tx_packet_);
+                    if (written && cmd == CMD_SET_FRAMING && !data.empty()) {
+                        tx_framing_ = static_cast<FramingVersion>(data[0]);
+                    }
+                }
+                if (!written) {
+                    fail_command(cmd, sequence);
+                }
+            }
+        }
 
-                        if (buffer.size() < 5) {
-                            break; // Need more data
+        // Fail commands whose deadline has passed (or all of them), write held-back commands whose type is in step
+        // again, and return the next deadline in ms (-1 = none)
+        inline int expire_commands(bool all = false) {
+            auto now = std::chrono::steady_clock::now();
+            std::vector<std::pair<uint8_t, PendingCommand>> expired;
+            std::vector<std::pair<uint8_t, uint32_t>> ready;
+            std::chrono::steady_clock::time_point next_deadline = std::chrono::steady_clock::time_point::max();
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                if (all) {
+                    resync_until_.clear();
+                }
+                for (auto it = resync_until_.begin(); it != resync_until_.end();) {
+                    it = it->second <= now ? resync_until_.erase(it) : std::next(it);
+                }
+                for (auto &[type, queue] : pending_commands_) {
+                    auto resync = resync_until_.find(type);
+                    bool resyncing = resync != resync_until_.end();
+                    auto lost_order = std::chrono::milliseconds::zero(); // timeout of an expired v1 command
+                    for (auto it = queue.begin(); it != queue.end();) {
+                        if (all || (it->written && it->deadline <= now)) {
+                            if (it->written && !it->tagged) {
+                                lost_order = std::max(lost_order, it->timeout);
+                            }
+                            expired.emplace_back(type, std::move(*it));
+                            it = queue.erase(it);
+                            continue;
                         }
-
-                        ResponseType response_type = static_cast<ResponseType>(buffer[4]);
-
-                        // Determine expected packet length based on response type
-                        size_t expected_length = 5; // Header + response type
-
-                        switch (response_type) {
-                        case RESP_ACK:
-                            expected_length += 1; // Original command
-                            break;
-                        case RESP_NACK:
-                            expected_length += 2; // Original command + error code
-                            break;
-                        case RESP_STATUS:
-                            expected_length += 25; // Status data
-                            break;
-                        case RESP_MESSAGE:
-                            if (buffer.size() >= 5 + 1 + 16 + 2) { // Need length bytes
-                                uint16_t msg_len = (buffer[5 + 1 + 16] << 8) | buffer[5 + 1 + 16 + 1];
-                                expected_length += 1 + 16 + 2 + msg_len; // flag + src + len + payload
+                        if (!it->written) {
+                            if (resyncing) {
+                                next_deadline = std::min(next_deadline, resync->second);
                             } else {
-                                break; // Need more data
+                                ready.emplace_back(type, it->sequence);
                             }
-                            break;
-                        case RESP_ERROR:
-                            expected_length += 1; // Error code (minimum)
-                            break;
-                        }
-
-                        if (buffer.size() >= expected_length) {
-                            // Extract complete packet
-                            std::vector<uint8_t> packet(buffer.begin(), buffer.begin() + expected_length);
-                            buffer.erase(buffer.begin(), buffer.begin() + expected_length);
-
-                            // Process the packet
-                            parse_response(packet);
                         } else {
-                            break; // Need more data
+                            next_deadline = std::min(next_deadline, it->deadline);
                         }
+                        ++it;
+                    }
+                    if (lost_order > std::chrono::milliseconds::zero() && !all) {
+                        resync_type(type, queue, now, lost_order, expired);
+                        next_deadline = std::min(next_deadline, resync_until_[type]);
                     }
-                } else {
-                    // No data available, small delay to prevent busy waiting
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
                 }
             }
-        }
-
-        inline void heartbeat_thread_func() {
-            auto last_status_check = std::chrono::steady_clock::now();
-            const auto status_interval = std::chrono::seconds(30);
 
-            while (running_) {
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-
-                auto now = std::chrono::steady_clock::now();
-                if (now - last_status_check >= status_interval) {
-                    // Periodic status check to ensure connection is alive
-                    get_status();
-                    last_status_check = now;
-                }
+            for (auto &[type, pending] : expired) {
+                CommandResult result;
+                result.command = type;
+                complete_command(pending, result);
+            }
+            if (!ready.empty()) {
+                write_held_commands(ready);
+                return 0; // their deadlines start now
             }
-        }
-
-      public:
-        inline explicit LoRaInterface(const std::string &serial_port, const std::string &node_ipv6)
-            : serial_port_(serial_port), serial_fd_(-1), serial_connected_(false), running_(false),
-              command_timeout_(std::chrono::milliseconds(5000)), node_ipv6_(node_ipv6) {
-
-            interface_name_ = "LoRa-" + serial_port;
 
-            // IPv6 address must be provided - same as LAN interface
-            // This should match the system's IPv6 from LAN interface
-            if (node_ipv6_.empty()) {
-                std::cerr << "ERROR: LoRa interface requires IPv6 address (same as LAN interface)" << std::endl;
-                throw std::runtime_error("LoRa interface requires IPv6 address");
+            if (next_deadline == std::chrono::steady_clock::time_point::max()) {
+                return -1;
             }
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(next_deadline - now).count();
+            return static_cast<int>(std::max<int64_t>(remaining, 0));
         }
 
-        inline virtual ~LoRaInterface() { stop(); }
+        inline static bool is_broadcast_address(const uint8_t *bytes) {
+            return std::all_of(bytes, bytes + 16, [](uint8_t b) { return b == 0xFF; });
+        }
 
-        // NetworkInterface implementation
-        inline bool start() override {
-            if (running_) {
-                return true;
+        // Merge one page of the firmware's neighbour list and request the next one, if any
+        inline void handle_neighbor_page(const CommandResult &result) {
+            if (!result.completed || result.response_type != RESP_NEIGHBORS || result.response.size() < 3) {
+                return;
             }
 
-            // Open serial connection
-            if (!open_serial_port()) {
-                std::cerr << "Failed to open serial port: " << serial_port_ << std::endl;
-                return false;
+            const auto &data = result.response;
+            uint8_t total = data[0];
+            uint8_t first = data[1];
+            uint8_t count = data[2];
+            if (data.size() < 3 + count * NEIGHBOR_ENTRY_SIZE) {
+                return;
             }
 
-            running_ = true;
-
-            // Start background threads
-            listen_thread_ = std::thread(&LoRaInterface::listen_thread_func, this);
-            heartbeat_thread_ = std::thread(&LoRaInterface::heartbeat_thread_func, this);
-
-            // Wait a moment for connection to stabilize
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
-
-            // Set the node's IPv6 address (must match LAN interface)
-            if (!set_node_ipv6(node_ipv6_)) {
-                std::cerr << "Failed to set IPv6 address on LoRa node: " << node_ipv6_ << std::endl;
-                stop();
-                return false;
+            for (size_t i = 0; i < count; ++i) {
+                const uint8_t *entry = data.data() + 3 + i * NEIGHBOR_ENTRY_SIZE;
+                char address[INET6_ADDRSTRLEN];
+                if (inet_ntop(AF_INET6, entry, address, sizeof(address)) == nullptr) {
+                    continue;
+                }
+                uint16_t raw_rssi = (entry[17] << 8) | entry[18];
+                std::optional<int16_t> rssi;
+                if (raw_rssi != 0x8000) {
+                    rssi = static_cast<int16_t>(raw_rssi);
+                }
+                std::optional<int8_t> snr;
+                if (entry[19] != 0x80) {
+                    snr = static_cast<int8_t>(entry[19]);
+                }
+                neighbors_.report(address, entry[16], rssi, snr, std::chrono::seconds((entry[20] << 8) | entry[21]));
             }
 
-            // Get initial status
-            current_status_ = get_status();
-
-            std::cout << "LoRa interface started on " << serial_port_ << " with IPv6: " << get_address() << std::endl;
+            unsigned next = first + count;
+            if (count > 0 && next < total && running_) {
+                request_neighbor_page(static_cast<uint8_t>(next));
+            } else {
+                neighbors_.publish();
+            }
+        }
 
-            return true;
+        inline void request_neighbor_page(uint8_t first) {
+            submit_command(CMD_GET_NEIGHBORS, {first}, [this](const CommandResult &result) {
+                handle_neighbor_page(result);
+            });
         }
 
-        inline void stop() override {
-            if (!running_) {
+        // Strip the FEC layer (if enabled) and deliver the payload plus any frames it let us rebuild
+        inline void deliver_message(const uint8_t *src_bytes, const char *payload, size_t msg_len, bool is_broadcast) {
+            char src_addr[INET6_ADDRSTRLEN];
+            if (inet_ntop(AF_INET6, src_bytes, src_addr, sizeof(src_addr)) == nullptr) {
                 return;
             }
+            if (!is_broadcast_address(src_bytes)) {
+                neighbors_.observe(src_addr);
+            }
 
-            running_ = false;
-
-            // Wake up any waiting threads
-            message_available_.notify_all();
-            command_response_.notify_all();
-
-            // Join threads
-            if (listen_thread_.joinable()) {
-                listen_thread_.join();
+            bool deliver = true;
+            fec_recovered_.clear();
+            {
+                std::lock_guard<std::mutex> lock(fec_mutex_);
+                if (fec_config_.enabled) {
+                    std::string_view data;
+                    deliver = fec_decoder_.receive(src_addr, is_broadcast, payload, msg_len, data, fec_recovered_);
+                    if (deliver) {
+                        // The view points into decoder state; copy it out before the lock is released
+                        fec_payload_.assign(data);
+                        payload = fec_payload_.data();
+                        msg_len = fec_payload_.size();
+                    }
+                }
             }
-            if (heartbeat_thread_.joinable()) {
-                heartbeat_thread_.join();
+            if (deliver) {
+                deliver_payload(src_addr, payload, msg_len, is_broadcast);
+            }
+            for (const auto &recovered : fec_recovered_) {
+                deliver_payload(src_addr, recovered.data(), recovered.size(), is_broadcast);
             }
-
-            close_serial_port();
-            std::cout << "LoRa interface stopped" << std::endl;
         }
 
-        inline void send_message(const std::string &dest_addr, uint16_t /* dest_port */,
-                                 const std::string &msg) override {
-            if (!running_ || !serial_connected_) {
-                std::cerr << "LoRa interface not connected" << std::endl;
-                return;
+        // Hand a received message to the callback and/or the pull queue, per the delivery mode
+        inline void deliver_payload(const char *src_addr, const char *payload, size_t msg_len, bool is_broadcast) {
+            ++received_count_;
+            DeliveryMode mode = delivery_mode_;
+
+            if (mode != DeliveryMode::callback) {
+                // Fill a ring slot in place so its strings keep their capacity across messages
+                {
+                    std::lock_guard<std::mutex> lock(message_queue_mutex_);
+                    incoming_messages_.push_with([&](IncomingMessage &slot) {
+                        slot.source_addr.assign(src_addr);
+                        slot.message.assign(payload, msg_len);
+                        slot.is_broadcast = is_broadcast;
+                        slot.received_time = std::chrono::steady_clock::now();
+                    });
+                }
+                message_available_.notify_one();
             }
 
-            // Validate destination address
-            if (!is_valid_ipv6(dest_addr)) {
-                std::cerr << "Invalid IPv6 address: " << dest_addr << std::endl;
-                return;
+            if (mode != DeliveryMode::queue && message_callback_) {
+                callback_message_.assign(payload, msg_len);
+                callback_source_.assign(src_addr);
+                message_callback_(callback_message_, callback_source_, 0);
             }
+        }
 
-            // Convert destination to bytes
-            auto dest_bytes = string_to_ipv6_bytes(dest_addr);
-            if (dest_bytes.size() != 16) {
-                std::cerr << "IPv6 address conversion failed" << std::endl;
-                return;
+        inline void parse_response(ResponseType response_type, const std::vector<uint8_t> &data, uint16_t sequence) {
+            switch (response_type) {
+            case RESP_MESSAGE: {
+                if (data.size() >= 19) { // flag + src + len
+                    size_t msg_len = (data[17] << 8) | data[18];
+                    if (data.size() >= 19 + msg_len) {
+                        deliver_message(data.data() + 1, reinterpret_cast<const char *>(data.data()) + 19, msg_len,
+                                        data[0] != 0);
+                    }
+                }
+                break;
             }
 
-            // Prepare command data: [2 bytes: length][16 bytes: dest][N bytes: payload]
-            std::vector<uint8_t> command_data;
+            case RESP_MESSAGE_SHORT: {
+                if (data.size() >= 5) { // flag + src ID + len
+                    uint16_t src_id = (data[1] << 8) | data[2];
+                    size_t msg_len = (data[3] << 8) | data[4];
+                    auto src_bytes = short_addresses_.expand(src_id);
+                    if (src_bytes && data.size() >= 5 + msg_len) {
+                        deliver_message(src_bytes->data(), reinterpret_cast<const char *>(data.data()) + 5, msg_len,
+                                        data[0] != 0);
+                    }
+                }
+                break;
+            }
 
-            // Payload length (big-endian)
-            uint16_t payload_len = msg.length();
-            command_data.push_back((payload_len >> 8) & 0xFF);
-            command_data.push_back(payload_len & 0xFF);
+            case RESP_ACK:
+            case RESP_NACK: {
+                // Data starts with the command being answered
+                if (!data.empty()) {
+                    uint8_t original_cmd = data[0];
+                    resolve_command(original_cmd, response_type, data, sequence);
+                }
+                break;
+            }
 
-            // Destination IPv6
-            command_data.insert(command_data.end(), dest_bytes.begin(), dest_bytes.end());
+            case RESP_STATUS:
+                // Status payload carries no command byte; it always answers CMD_GET_STATUS
+                resolve_command(CMD_GET_STATUS, response_type, data, sequence);
+                break;
 
-            // Message payload
-            command_data.insert(command_data.end(), msg.begin(), msg.end());
+            case RESP_NEIGHBORS:
+                resolve_command(CMD_GET_NEIGHBORS, response_type, data, sequence);
+                break;
 
-            // Send command
-            if (send_command(CMD_SEND_MESSAGE, command_data)) {
-                std::cout << "LoRa message sent to " << dest_addr << ": " << msg.substr(0, 50)
-                          << (msg.length() > 50 ? "..." : "") << std::endl;
-            } else {
-                std::cerr << "Failed to send LoRa message to " << dest_addr << std::endl;
+            case RESP_ERROR: {
+                // Errors only carry a code. In v2 the sequence names the command; in v1 the firmware is serial, so
+                // it refers to the oldest command in flight.
+                int command = sequence != 0 ? -1 : oldest_pending_command();
+                if (sequence != 0 || command != -1) {
+                    resolve_command(command, response_type, data, sequence);
+                }
+                break;
+            }
             }
         }
 
-        inline void multicast_message(const std::string &msg) override { send_message(BROADCAST_IPV6, 0, msg); }
+        // Background threads
+        // Record a setting the firmware accepted, so a reconnected radio gets it again
+        template <typename T> inline void remember(std::optional<T> ReplayState::*field, T value) {
+            std::lock_guard<std::mutex> lock(replay_mutex_);
+            replay_.*field = value;
+        }
 
-        inline void multicast_to_group(const std::vector<std::string> &dest_addrs, uint16_t dest_port,
+        // udev alias that survives re-enumeration (ttyUSB0 coming back as ttyUSB1), or the port itself
+        inline static std::string stable_device_path(const std::string &port) {
+            std::error_code ec;
+            auto target = std::filesystem::canonical(port, ec);
+            if (ec) {
+                return port;
+            }
+            for (const char *dir : {"/dev/serial/by-id", "/dev/serial/by-path"}) {
+                for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+                    std::error_code link_ec;
+                    auto resolved = std::filesystem::canonical(entry.path(), link_ec);
+                    if (!link_ec && resolved == target) {
+                        return entry.path().string();
+                    }
+                }
+            }
+            return port;
+        }
+
+        inline void link_lost(const std::string &reason) {
+            std::cerr << "LoRa serial link on " << serial_port_ << " lost: " << reason << std::endl;
+            link_ready_ = false;
+            {
+                std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+                close_serial_port();
+            }
+            expire_commands(true); // nothing will answer them now
+            reconnect_backoff_ = serial_config_.reconnect_backoff_min;
+            reconnect_at_ = std::chrono::steady_clock::now() + reconnect_backoff_;
+        }
+
+        // One attempt at reopening the port; on success the heartbeat replays the configuration
+        inline bool reopen_serial_port() {
+            bool opened;
+            {
+                std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+                opened = open_serial_port(reconnect_port_);
+                tx_framing_ = FramingVersion::v1; // the radio comes back with its defaults
+            }
+            if (!opened) {
+                return false;
+            }
+            framer_.reset();
+            framer_.set_version(FramingVersion::v1);
+            ++reconnects_;
+            std::cout << "LoRa serial link on " << reconnect_port_ << " reopened" << std::endl;
+
+            replay_pending_ = true;
+            wake_heartbeat();
+            return true;
+        }
+
+        // Listen thread: reopen the port with exponential backoff, then hand over to the heartbeat for replay
+        inline void reconnect() {
+            if (serial_connected_) {
+                link_lost("not answering");
+            }
+            reconnect_requested_ = false;
+
+            auto backoff = serial_config_.reconnect_backoff_min;
+            while (running_) {
+                wait_serial_readable(static_cast<int>(backoff.count())); // only the wake-up descriptor is open
+                if (!running_ || reopen_serial_port()) {
+                    return;
+                }
+                backoff = std::min(backoff * 2, serial_config_.reconnect_backoff_max);
+            }
+        }
+
+        // reconnect() for polled mode: one attempt per call, none before the backoff has passed
+        inline void poll_reconnect(std::chrono::steady_clock::time_point now) {
+            if (serial_connected_) {
+                link_lost("not answering");
+            }
+            reconnect_requested_ = false;
+            if (now < reconnect_at_ || reopen_serial_port()) {
+                return;
+            }
+            reconnect_backoff_ = std::min(reconnect_backoff_ * 2, serial_config_.reconnect_backoff_max);
+            reconnect_at_ = now + reconnect_backoff_;
+        }
+
+        // In polled mode the eventfd also brings the application's loop round to poll_once
+        inline void wake_heartbeat() {
+            {
+                std::lock_guard<std::mutex> lock(heartbeat_mutex_);
+                ++heartbeat_generation_;
+                heartbeat_wake_.notify_all();
+            }
+            if (threading_ == Threading::polled) {
+                wake_listener();
+            }
+        }
+
+        // Heartbeat thread: bring a reopened radio back to the configuration it had. Nothing here waits for the
+        // firmware. Probes are re-sent from their callbacks until the radio answers, then the whole configuration is
+        // written in one go; the firmware handles commands in order, so the answer to a final status request means
+        // it has taken everything before it.
+        inline void replay_configuration() {
+            replay_pending_ = false;
+            uint32_t round = ++replay_round_;
+            probe_until_ready(std::chrono::steady_clock::now() + command_timeout_.load(), [this, round](bool ready) {
+                if (round != replay_round_) {
+                    return;
+                }
+                if (!ready) {
+                    reconnect_requested_ = true;
+                    wake_listener();
+                    return;
+                }
+                write_configuration(round);
+            });
+        }
+
+        // Status probes until one is answered or `deadline` passes
+        inline void probe_until_ready(std::chrono::steady_clock::time_point deadline, std::function<void(bool)> done) {
+            const auto probe_interval = std::chrono::milliseconds(100);
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                                                   std::chrono::steady_clock::now());
+            if (!running_ || remaining <= std::chrono::milliseconds::zero()) {
+                done(false);
+                return;
+            }
+            submit_command(
+                CMD_GET_STATUS, {},
+                [this, deadline, done](const CommandResult &result) {
+                    if (result.completed) {
+                        done(true);
+                    } else if (!serial_connected_ || reconnect_requested_) {
+                        done(false); // the port is gone; no point probing it
+                    } else {
+                        probe_until_ready(deadline, done);
+                    }
+                },
+                std::max(std::min(probe_interval, remaining), std::chrono::milliseconds(1)));
+        }
+
+        // The framing goes first: what follows is written in whichever framing the firmware accepted
+        inline void write_configuration(uint32_t round) {
+            if (!serial_config_.negotiate_framing) {
+                write_settings(round);
+                return;
+            }
+            request_framing(FramingVersion::v2, [this, round](bool) {
+                if (round == replay_round_) {
+                    write_settings(round);
+                }
+            });
+        }
+
+        inline void write_settings(uint32_t round) {
+            set_node_ipv6(node_ipv6_);
+
+            ReplayState state;
+            {
+                std::lock_guard<std::mutex> lock(replay_mutex_);
+                state = replay_;
+            }
+            if (state.frequency_hz) {
+                set_frequency(*state.frequency_hz);
+            }
+            if (state.tx_power) {
+                set_tx_power(*state.tx_power);
+            }
+            if (state.hop_limit) {
+                set_hop_limit(*state.hop_limit);
+            }
+            if (state.spreading_factor) {
+                set_spreading_factor(*state.spreading_factor);
+            }
+            if (state.bandwidth_hz) {
+                set_bandwidth(*state.bandwidth_hz);
+            }
+            std::map<std::string, LinkSettings> destinations;
+            {
+                std::lock_guard<std::mutex> lock(adr_mutex_);
+                destinations = destination_settings_;
+            }
+            for (const auto &[dest, settings] : destinations) {
+                push_destination_settings(dest, settings, [](bool) {});
+            }
+            if (short_addressing_requested_) {
+                request_short_addressing([](bool) {});
+            }
+
+            submit_command(CMD_GET_STATUS, {}, [this, round](const CommandResult &result) {
+                if (round != replay_round_) {
+                    return;
+                }
+                if (!result.completed) {
+                    reconnect_requested_ = true; // silent again before it took the configuration
+                    wake_listener();
+                    return;
+                }
+                record_status(result);
+                if (serial_config_.negotiate_baud && threading_ == Threading::threads) {
+                    // Takes blocking link checks, so on the heartbeat thread; polled, the port keeps its rate
+                    baud_pending_ = true;
+                    wake_heartbeat();
+                } else {
+                    finish_replay();
+                }
+            });
+        }
+
+        inline void finish_replay() {
+            link_ready_ = true;
+            {
+                std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+                tx_queue_wake_.notify_all();
+            }
+            wake_heartbeat();
+            std::cout << "LoRa node on " << serial_port_ << " reconfigured, resuming transmissions" << std::endl;
+        }
+
+        // v1 responses carry no length; it follows from the response type and, for some types, a length field
+        inline static size_t v1_frame_length(const uint8_t *frame, size_t available) {
+            size_t length = 5; // header + response type
+            switch (static_cast<ResponseType>(frame[4])) {
+            case RESP_ACK:
+                return length + 1; // original command
+            case RESP_NACK:
+                return length + 2; // original command + error code
+            case RESP_STATUS:
+                return length + 25;
+            case RESP_ERROR:
+                return length + 1; // error code (minimum)
+            case RESP_MESSAGE:
+                if (available < 5 + 1 + 16 + 2) {
+                    return SIZE_MAX; // need the length field
+                }
+                return length + 1 + 16 + 2 + ((frame[5 + 1 + 16] << 8) | frame[5 + 1 + 16 + 1]);
+            case RESP_MESSAGE_SHORT:
+                if (available < 5 + 1 + 2 + 2) {
+                    return SIZE_MAX;
+                }
+                return length + 1 + 2 + 2 + ((frame[5 + 1 + 2] << 8) | frame[5 + 1 + 2 + 1]);
+            case RESP_NEIGHBORS:
+                if (available < 5 + 3) {
+                    return SIZE_MAX;
+                }
+                return length + 3 + frame[5 + 2] * NEIGHBOR_ENTRY_SIZE;
+            }
+            return length;
+        }
+
+        // v1 bytes the framer had to skip may have been a response; resynchronise before parsing past them. v2
+        // frames are matched by sequence, so a dropped one only fails its own command when it times out.
+        inline void check_dropped_frames() {
+            uint64_t discarded = framer_.stats().discarded_bytes;
+            if (discarded != discarded_bytes_ && framer_.version() == FramingVersion::v1) {
+                frame_dropped();
+            }
+            discarded_bytes_ = discarded;
+        }
+
+        // Wait up to `timeout_ms` (-1 = no limit) for the radio, then act on every complete frame it sent. Returns
+        // whether anything was read.
+        inline bool receive_serial(int timeout_ms) {
+            int ready = wait_serial_readable(timeout_ms);
+            if (ready == 0) {
+                return false;
+            }
+            if (ready < 0) {
+                if (running_) {
+                    link_lost("port error or hang-up");
+                }
+                return false;
+            }
+
+            uint8_t chunk[1024];
+            ssize_t bytes_read = read_serial(chunk, sizeof(chunk));
+            if (bytes_read > 0) {
+                framer_.feed(chunk, bytes_read);
+                uint8_t type;
+                uint16_t sequence;
+                while (framer_.next(type, rx_frame_, sequence)) {
+                    check_dropped_frames();
+                    parse_response(static_cast<ResponseType>(type), rx_frame_, sequence);
+                }
+                check_dropped_frames();
+                std::lock_guard<std::mutex> lock(framing_stats_mutex_);
+                framing_stats_ = framer_.stats();
+            } else if (bytes_read < 0 && errno != EAGAIN) {
+                link_lost(strerror(errno));
+            }
+            return bytes_read > 0;
+        }
+
+        inline void listen_thread_func() {
+            while (running_) {
+                if (!serial_connected_ || reconnect_requested_) {
+                    if (!serial_config_.auto_reconnect) {
+                        break;
+                    }
+                    reconnect();
+                    continue;
+                }
+                receive_serial(expire_commands());
+            }
+
+            // Nothing will answer in-flight commands any more
+            expire_commands(true);
+        }
+
+        // Wait for the outcome of a command. Polled, nothing else reads the port, so the caller's thread does until
+        // the answer is in; every command has a deadline, so this ends.
+        template <typename T> inline T await_result(std::future<T> future) {
+            if (threading_ == Threading::polled) {
+                while (running_ && future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    receive_serial(expire_commands());
+                }
+            }
+            return future.get();
+        }
+
+        // When the heartbeat's periodic work is next due
+        inline std::chrono::steady_clock::time_point maintenance_due() const {
+            return std::min(last_status_check_ + serial_config_.heartbeat_interval,
+                            last_neighbor_poll_ + neighbor_interval_.load());
+        }
+
+        // The heartbeat's periodic work, without waiting for the firmware: the neighbour table and ADR are fed from
+        // command callbacks, and the status probe counts as missed when its callback sees no answer
+        inline void maintain_link(std::chrono::steady_clock::time_point now) {
+            if (now - last_neighbor_poll_ >= neighbor_interval_.load()) {
+                // Fetched asynchronously, page by page, on the listen thread
+                neighbors_.publish();
+                request_neighbor_page(0);
+                last_neighbor_poll_ = now;
+                run_adr(now);
+            }
+
+            if (now - last_status_check_ >= serial_config_.heartbeat_interval && !status_in_flight_) {
+                // Periodic status check to ensure connection is alive; a radio that stopped answering is reopened
+                last_status_check_ = now;
+                status_in_flight_ = true;
+                submit_command(CMD_GET_STATUS, {}, [this](const CommandResult &result) {
+                    status_in_flight_ = false;
+                    if (!record_status(result).current_ipv6.empty()) {
+                        missed_heartbeats_ = 0;
+                    } else if (++missed_heartbeats_ >= serial_config_.max_missed_heartbeats &&
+                               serial_config_.auto_reconnect && link_ready_) {
+                        missed_heartbeats_ = 0;
+                        link_ready_ = false;
+                        reconnect_requested_ = true;
+                        wake_listener();
+                    }
+                });
+            }
+        }
+
+        inline void heartbeat_thread_func() {
+            while (running_) {
+                if (replay_pending_) {
+                    replay_configuration();
+                    missed_heartbeats_ = 0;
+                    continue;
+                }
+                if (baud_pending_.exchange(false)) {
+                    negotiate_baud_rate(serial_config_.max_baud_rate);
+                    finish_replay();
+                    continue;
+                }
+
+                auto next_wake = maintenance_due();
+                {
+                    std::unique_lock<std::mutex> lock(heartbeat_mutex_);
+                    uint64_t generation = heartbeat_generation_;
+                    auto woken = [this, generation] { return !running_ || heartbeat_generation_ != generation; };
+                    if (replay_pending_ || baud_pending_) {
+                        continue;
+                    }
+                    if (link_ready_) {
+                        if (!heartbeat_wake_.wait_until(lock, next_wake, woken)) {
+                            wakeup_[static_cast<size_t>(ThreadRole::maintenance)].record_wakeup(next_wake);
+                        }
+                    } else {
+                        heartbeat_wake_.wait(lock, woken); // reconnecting; the listen thread wakes us when it is back
+                    }
+                }
+                if (!running_) {
+                    break;
+                }
+                if (!link_ready_) {
+                    continue;
+                }
+                maintain_link(std::chrono::steady_clock::now());
+            }
+        }
+
+        inline static std::vector<uint8_t> config_u32(uint8_t type, uint32_t value) {
+            return {type, static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+                    static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value & 0xFF)};
+        }
+
+        // Feed the controller with fresh neighbour samples and apply its recommendation. Never waits for the firmware:
+        // the changes are sent as callback commands and recorded as the answers arrive.
+        inline void run_adr(std::chrono::steady_clock::time_point now) {
+            std::vector<std::pair<std::string, LinkSettings>> destination_changes;
+            LinkSettings current;
+            LinkSettings next;
+            {
+                std::lock_guard<std::mutex> lock(adr_mutex_);
+                if (!adr_.config().enabled) {
+                    return;
+                }
+
+                std::vector<std::string> peers;
+                auto table = neighbors_.snapshot();
+                for (const auto &neighbor : table->entries) {
+                    if (neighbor.hop_count > 1) {
+                        continue; // only direct links are ours to tune
+                    }
+                    peers.push_back(neighbor.address);
+                    auto &sampled = adr_sampled_[neighbor.address];
+                    if (neighbor.snr_db && neighbor.last_heard > sampled) {
+                        adr_.observe_snr(neighbor.address, *neighbor.snr_db, link_settings_.bandwidth_hz);
+                        sampled = neighbor.last_heard;
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> fec_lock(fec_mutex_);
+                    if (fec_config_.enabled) {
+                        for (const auto &peer : peers) {
+                            adr_.observe_loss(peer, fec_decoder_.loss(peer));
+                        }
+                    }
+                }
+
+                if (adr_in_flight_ > 0 || now - adr_last_change_ < adr_.config().interval) {
+                    return;
+                }
+
+                current = link_settings_;
+                if (adr_.config().per_destination) {
+                    for (const auto &peer : peers) {
+                        auto it = destination_settings_.find(peer);
+                        LinkSettings from = it == destination_settings_.end() ? link_settings_ : it->second;
+                        LinkSettings to = adr_.recommend_for(peer, from);
+                        if (to != from) {
+                            destination_changes.emplace_back(peer, to);
+                        }
+                    }
+                    next = current;
+                } else {
+                    next = adr_.recommend(peers, link_settings_);
+                }
+                adr_in_flight_ = static_cast<uint32_t>(destination_changes.size()) + link_changes(current, next);
+                if (adr_in_flight_ > 0) {
+                    adr_last_change_ = now;
+                }
+            }
+
+            for (const auto &[peer, settings] : destination_changes) {
+                push_destination_settings(peer, settings, [this](bool accepted) {
+                    std::lock_guard<std::mutex> lock(adr_mutex_);
+                    --adr_in_flight_;
+                    if (!accepted && adr_.config().per_destination) {
+                        std::cerr << "LoRa firmware rejected per-destination settings, using one setting for all"
+                                  << std::endl;
+                        AdrConfig config = adr_.config();
+                        config.per_destination = false;
+                        adr_.set_config(config);
+                    }
+                });
+            }
+            apply_link_settings(current, next);
+        }
+
+        inline static uint32_t link_changes(const LinkSettings &current, const LinkSettings &next) {
+            return (next.spreading_factor != current.spreading_factor) + (next.bandwidth_hz != current.bandwidth_hz) +
+                   (next.tx_power_dbm != current.tx_power_dbm);
+        }
+
+        // Send per-destination settings (config type 0x06); `done` learns whether the firmware took them. Called
+        // without adr_mutex_, which the answer takes to record them.
+        inline void push_destination_settings(const std::string &dest_addr, const LinkSettings &settings,
+                                              std::function<void(bool)> done) {
+            if (!is_valid_ipv6(dest_addr)) {
+                done(false);
+                return;
+            }
+            std::vector<uint8_t> config_data = {0x06};
+            auto dest_bytes = string_to_ipv6_bytes(dest_addr);
+            config_data.insert(config_data.end(), dest_bytes.begin(), dest_bytes.end());
+            auto bandwidth = config_u32(0, settings.bandwidth_hz);
+            config_data.push_back(settings.spreading_factor);
+            config_data.insert(config_data.end(), bandwidth.begin() + 1, bandwidth.end());
+            config_data.push_back(static_cast<uint8_t>(settings.tx_power_dbm));
+            submit_command(CMD_SET_CONFIG, config_data,
+                           [this, dest = ipv6_bytes_to_string(dest_bytes), settings,
+                            done = std::move(done)](const CommandResult &result) {
+                               if (result.ok()) {
+                                   std::lock_guard<std::mutex> lock(adr_mutex_);
+                                   destination_settings_[dest] = settings;
+                               }
+                               done(result.ok());
+                           });
+        }
+
+        // Push changed settings to the firmware; only accepted changes are recorded, as their answers arrive. The
+        // caller counted link_changes() into adr_in_flight_; the last answer moves the scheduler to the result.
+        inline void apply_link_settings(const LinkSettings &current, const LinkSettings &next) {
+            auto change = [this](std::vector<uint8_t> config, std::function<void(LinkSettings &)> record) {
+                submit_command(CMD_SET_CONFIG, config, [this, record](const CommandResult &result) {
+                    bool last;
+                    {
+                        std::lock_guard<std::mutex> lock(adr_mutex_);
+                        if (result.ok()) {
+                            record(link_settings_);
+                        }
+                        last = --adr_in_flight_ == 0;
+                    }
+                    if (last) {
+                        follow_link_settings();
+                    }
+                });
+            };
+            if (next.spreading_factor != current.spreading_factor) {
+                change({0x04, next.spreading_factor}, [this, sf = next.spreading_factor](LinkSettings &settings) {
+                    settings.spreading_factor = sf;
+                    remember(&ReplayState::spreading_factor, sf);
+                });
+            }
+            if (next.bandwidth_hz != current.bandwidth_hz) {
+                change(config_u32(0x05, next.bandwidth_hz), [this, bw = next.bandwidth_hz](LinkSettings &settings) {
+                    settings.bandwidth_hz = bw;
+                    remember(&ReplayState::bandwidth_hz, bw);
+                });
+            }
+            if (next.tx_power_dbm != current.tx_power_dbm) {
+                auto power = static_cast<uint8_t>(next.tx_power_dbm);
+                change({0x01, power}, [this, power](LinkSettings &settings) {
+                    settings.tx_power_dbm = static_cast<int8_t>(power);
+                    remember(&ReplayState::tx_power, power);
+                });
+            }
+        }
+
+        // Airtime accounting follows the modulation actually in use
+        inline void follow_link_settings() {
+            LinkSettings settings = get_link_settings();
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            LoRaModulation modulation = tx_scheduler_.modulation();
+            modulation.spreading_factor = settings.spreading_factor;
+            modulation.bandwidth_hz = settings.bandwidth_hz;
+            tx_scheduler_.set_modulation(modulation);
+            std::cout << "LoRa ADR: SF" << int(settings.spreading_factor) << ", " << settings.bandwidth_hz / 1000
+                      << " kHz, " << int(settings.tx_power_dbm) << " dBm" << std::endl;
+        }
+
+        // Put the next frame the scheduler releases on air. When none may go yet, returns false with `wake_at` set
+        // to when to ask again. Caller holds `lock` on tx_queue_mutex_; it is released while the frame is written.
+        inline bool transmit_next(std::unique_lock<std::mutex> &lock, std::chrono::steady_clock::time_point &wake_at) {
+            auto now = std::chrono::steady_clock::now();
+            auto flush_at = std::chrono::steady_clock::time_point::max();
+            {
+                // Close FEC groups that went idle so their parity is not held back indefinitely
+                std::lock_guard<std::mutex> fec_lock(fec_mutex_);
+                if (fec_config_.enabled) {
+                    fec_flushed_.clear();
+                    fec_encoder_.flush_expired(now, fec_config_.flush_timeout, fec_flushed_);
+                    for (auto &[dest, parity] : fec_flushed_) {
+                        enqueue_parity(dest, parity, now);
+                    }
+                    flush_at = fec_encoder_.next_flush(fec_config_.flush_timeout);
+                }
+            }
+
+            auto frame = tx_scheduler_.pop_ready(now, wake_at);
+            wake_at = std::min(wake_at, flush_at);
+            if (!frame) {
+                return false;
+            }
+
+            lock.unlock();
+            // Airtime was charged on the coded size (see set_coding_overhead), so the header fits the slot
+            std::string parity;
+            bool fec_coded = !frame->encoded && fec_enabled();
+            bool has_parity = fec_coded && fec_encode(*frame, now, parity);
+            bool sent = send_command(static_cast<SerialCommand>(frame->command), frame->command_data);
+            if (!sent && !link_ready_ && running_) {
+                // Lost with the link; send it once the radio is back. The FEC header is already in place.
+                frame->encoded = true;
+                std::lock_guard<std::mutex> requeue_lock(tx_queue_mutex_);
+                if (has_parity) {
+                    enqueue_parity(frame->dest_addr, parity, std::chrono::steady_clock::now());
+                    has_parity = false;
+                }
+                tx_scheduler_.requeue(std::move(*frame));
+            } else if (!sent) {
+                std::cerr << "Failed to send LoRa message to " << frame->dest_addr << std::endl;
+                if (fec_coded) {
+                    // Parity must only cover frames that went on air
+                    fec_retract(*frame, has_parity, parity);
+                    has_parity = !parity.empty();
+                }
+            }
+            lock.lock();
+            if (has_parity) {
+                enqueue_parity(frame->dest_addr, parity, std::chrono::steady_clock::now());
+            }
+            if (frame->command_data.capacity() > 0 && spare_frames_.size() < SPARE_FRAMES) {
+                spare_frames_.push_back(std::move(*frame)); // not requeued: its buffers go to the next frame built
+            }
+            return true;
+        }
+
+        inline void tx_thread_func() {
+            std::unique_lock<std::mutex> lock(tx_queue_mutex_);
+
+            while (running_) {
+                if (!link_ready_) {
+                    // Queued frames wait out a reconnection instead of failing against a dead port
+                    tx_queue_wake_.wait(lock, [this] { return link_ready_ || !running_; });
+                    continue;
+                }
+
+                std::chrono::steady_clock::time_point wake_at;
+                if (transmit_next(lock, wake_at)) {
+                    continue;
+                }
+                if (wake_at == std::chrono::steady_clock::time_point::max()) {
+                    tx_queue_wake_.wait(lock);
+                } else if (tx_queue_wake_.wait_until(lock, wake_at) == std::cv_status::timeout) {
+                    // Paced frames go out at wake_at; lateness here is added to their airtime slot
+                    wakeup_[static_cast<size_t>(ThreadRole::transmit)].record_wakeup(wake_at);
+                }
+            }
+        }
+
+        // An empty frame to build, in the buffers of one that already went on air. Caller holds tx_queue_mutex_.
+        inline TxFrame spare_frame() {
+            TxFrame frame;
+            if (!spare_frames_.empty()) {
+                frame.command_data = std::move(spare_frames_.back().command_data);
+                frame.dest_addr = std::move(spare_frames_.back().dest_addr);
+                spare_frames_.pop_back();
+            }
+            return frame;
+        }
+
+        // Serial command for sending `msg` to `dest_addr`, using a short ID when both ends have one. Written into
+        // the frame's own buffers, so a frame from spare_frame() allocates nothing.
+        inline bool build_frame(const std::string &dest_addr, const std::string &msg, TxFrame &frame) {
+            ShortAddressTable::Bytes dest_bytes;
+            if (inet_pton(AF_INET6, dest_addr.c_str(), dest_bytes.data()) != 1) {
+                std::cerr << "Invalid IPv6 address: " << dest_addr << std::endl;
+                return false;
+            }
+            char canonical[INET6_ADDRSTRLEN];
+            if (inet_ntop(AF_INET6, dest_bytes.data(), canonical, sizeof(canonical)) == nullptr) {
+                std::cerr << "IPv6 address conversion failed" << std::endl;
+                return false;
+            }
+
+            auto &command_data = frame.command_data;
+            command_data.clear();
+            uint16_t payload_len = msg.length();
+            command_data.push_back((payload_len >> 8) & 0xFF);
+            command_data.push_back(payload_len & 0xFF);
+
+            auto dest_id = short_addressing_ ? short_addresses_.lookup(dest_bytes) : std::nullopt;
+
+            if (dest_id) {
+                // [2 bytes: length][2 bytes: dest short ID][N bytes: payload]; both addresses travel as IDs
+                frame.command = CMD_SEND_SHORT;
+                command_data.push_back(*dest_id >> 8);
+                command_data.push_back(*dest_id & 0xFF);
+                frame.payload_size = msg.length() + 2 * 2;
+            } else {
+                // [2 bytes: length][16 bytes: dest][N bytes: payload]
+                frame.command = CMD_SEND_MESSAGE;
+                command_data.insert(command_data.end(), dest_bytes.begin(), dest_bytes.end());
+                frame.payload_size = msg.length() + 2 * 16;
+            }
+
+            // Message payload
+            command_data.insert(command_data.end(), msg.begin(), msg.end());
+
+            // Canonical form, so per-destination state (coalescing, FEC groups) matches received addresses
+            frame.dest_addr.assign(canonical);
+            return true;
+        }
+
+        // Add the FEC header to a frame about to go on air. Returns true with `parity` set when this frame closed
+        // a group.
+        inline bool fec_encode(TxFrame &frame, std::chrono::steady_clock::time_point now, std::string &parity) {
+            std::lock_guard<std::mutex> lock(fec_mutex_);
+            if (!fec_config_.enabled) {
+                return false;
+            }
+
+            // Payload follows the length and the destination (short ID or full address)
+            size_t offset = 2 + (frame.command == CMD_SEND_SHORT ? 2 : 16);
+            if (frame.command_data.size() < offset) {
+                return false;
+            }
+            double loss = frame.dest_addr == BROADCAST_IPV6 ? fec_decoder_.worst_loss()
+                                                             : fec_decoder_.loss(frame.dest_addr);
+            std::array<uint8_t, fec::DATA_HEADER> header;
+            bool closed = fec_encoder_.add(frame.dest_addr, frame.command_data.data() + offset,
+                                           frame.command_data.size() - offset, fec_group_size(loss, fec_config_), now,
+                                           header, parity);
+
+            frame.command_data.insert(frame.command_data.begin() + offset, header.begin(), header.end());
+            uint16_t payload_len = frame.command_data.size() - offset;
+            frame.command_data[0] = payload_len >> 8;
+            frame.command_data[1] = payload_len & 0xFF;
+            frame.payload_size += header.size();
+            return closed;
+        }
+
+        // Undo fec_encode for a frame that was not sent
+        inline void fec_retract(TxFrame &frame, bool closed, std::string &parity) {
+            size_t offset = 2 + (frame.command == CMD_SEND_SHORT ? 2 : 16);
+            if (frame.command_data.size() < offset + fec::DATA_HEADER) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(fec_mutex_);
+            const uint8_t *payload = frame.command_data.data() + offset + fec::DATA_HEADER;
+            fec_encoder_.retract(frame.dest_addr, payload, frame.command_data.size() - offset - fec::DATA_HEADER,
+                                 closed, parity);
+        }
+
+        inline bool fec_enabled() {
+            std::lock_guard<std::mutex> lock(fec_mutex_);
+            return fec_config_.enabled;
+        }
+
+        // Queue a parity frame ahead of ordinary traffic. Caller holds tx_queue_mutex_.
+        inline void enqueue_parity(const std::string &dest_addr, const std::string &parity,
+                                   std::chrono::steady_clock::time_point now) {
+            TxFrame frame = spare_frame();
+            if (!build_frame(dest_addr, parity, frame)) {
+                return;
+            }
+            frame.options.priority = TxPriority::high;
+            frame.encoded = true;
+            tx_scheduler_.enqueue(std::move(frame), now);
+        }
+
+        // Tell the firmware our short ID; short frames are only used once it has accepted it
+        inline void request_short_addressing(std::function<void(bool)> done) {
+            auto own_id = short_addresses_.lookup(node_ipv6_);
+            if (!own_id) {
+                std::cerr << "No short address for " << node_ipv6_ << ", using full addresses" << std::endl;
+                done(false);
+                return;
+            }
+
+            std::vector<uint8_t> data = {static_cast<uint8_t>(*own_id >> 8), static_cast<uint8_t>(*own_id & 0xFF)};
+            submit_command(CMD_SET_SHORT_ID, data, [this, done](const CommandResult &result) {
+                short_addressing_ = result.ok();
+                if (!short_addressing_) {
+                    std::cerr << "LoRa firmware does not support short addresses, using full addresses" << std::endl;
+                }
+                done(result.ok());
+            });
+        }
+
+        inline bool activate_short_addressing() {
+            auto done = std::make_shared<std::promise<bool>>();
+            auto accepted = done->get_future();
+            request_short_addressing([done](bool ok) { done->set_value(ok); });
+            return await_result(std::move(accepted));
+        }
+
+        // Probe the firmware until it answers a status request. Boards that reset when the port is opened
+        // become usable as soon as they reply, instead of after a fixed settle delay.
+        inline bool wait_for_firmware_ready(std::chrono::milliseconds timeout) {
+            const auto probe_interval = std::chrono::milliseconds(100);
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+
+            while (running_ && std::chrono::steady_clock::now() < deadline) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now());
+                auto probe = submit_command(CMD_GET_STATUS, {}, std::max(std::min(probe_interval, remaining),
+                                                                         std::chrono::milliseconds(1)));
+                if (await_result(std::move(probe)).completed) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Parse a status answer and keep it as the current status; empty if there was none
+        inline LoRaStatus record_status(const CommandResult &result) {
+            LoRaStatus status = {};
+            if (result.completed && result.response_type == RESP_STATUS) {
+                const auto &response = result.response;
+                if (response.size() >= 25) {
+                    // Parse status response: [16 bytes IPv6][1 byte radio][1 byte power][4 bytes freq][1 byte hop][2
+                    // bytes uptime]
+                    std::vector<uint8_t> ipv6_bytes(response.begin(), response.begin() + 16);
+                    status.current_ipv6 = ipv6_bytes_to_string(ipv6_bytes);
+                    status.radio_active = response[16] != 0;
+                    status.tx_power = response[17];
+                    status.frequency_hz =
+                        (response[18] << 24) | (response[19] << 16) | (response[20] << 8) | response[21];
+                    status.hop_limit = response[22];
+                    status.uptime_seconds = (response[23] << 8) | response[24];
+
+                    {
+                        std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+                        tx_scheduler_.set_frequency(status.frequency_hz);
+                    }
+
+                    std::lock_guard<std::mutex> lock(status_mutex_);
+                    current_status_ = status;
+                }
+            }
+
+            return status;
+        }
+
+      public:
+        inline explicit LoRaInterface(const std::string &serial_port, const std::string &node_ipv6,
+                                      const SerialConfig &serial_config = {})
+            : serial_port_(serial_port), serial_config_(serial_config), baud_rate_(serial_config.baud_rate),
+              serial_fd_(-1), serial_connected_(false), running_(false), wake_fd_(-1),
+              delivery_mode_(DeliveryMode::both), received_count_(0), next_sequence_(0),
+              command_timeout_(std::chrono::milliseconds(5000)), short_addressing_requested_(false),
+              short_addressing_(false), link_ready_(false), reconnect_requested_(false), replay_pending_(false),
+              reconnects_(0), neighbor_interval_(std::chrono::seconds(10)), node_ipv6_(node_ipv6) {
+
+            interface_name_ = "LoRa-" + serial_port;
+
+            // IPv6 address must be provided - same as LAN interface
+            // This should match the system's IPv6 from LAN interface
+            if (node_ipv6_.empty()) {
+                std::cerr << "ERROR: LoRa interface requires IPv6 address (same as LAN interface)" << std::endl;
+                throw std::runtime_error("LoRa interface requires IPv6 address");
+            }
+        }
+
+        inline virtual ~LoRaInterface() { stop(); }
+
+        // NetworkInterface implementation
+        inline bool start() override {
+            if (running_) {
+                return true;
+            }
+
+            // Open serial connection
+            if (!open_serial_port(serial_port_)) {
+                std::cerr << "Failed to open serial port: " << serial_port_ << std::endl;
+                return false;
+            }
+
+            // Transmit queue, spare frames and command pipeline move onto the resource set since the last start()
+            {
+                std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+                tx_scheduler_.set_memory_resource(memory_resource_);
+                reset_resource(spare_frames_, memory_resource_);
+            }
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                auto pool = std::make_unique<std::pmr::unsynchronized_pool_resource>(memory_resource_);
+                reset_resource(pending_commands_, pool.get()); // nothing is pending while stopped
+                command_pool_ = std::move(pool);
+            }
+
+            // A freshly opened port always starts in v1 framing
+            framer_.reset();
+            framer_.set_version(FramingVersion::v1);
+            {
+                std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+                tx_framing_ = FramingVersion::v1;
+            }
+
+            wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd_ == -1) {
+                std::cerr << "Failed to create LoRa wake descriptor: " << strerror(errno) << std::endl;
+                close_serial_port();
+                return false;
+            }
+
+            // Before the listen thread exists: it reads this to reopen the port if the link drops during start()
+            reconnect_port_ = stable_device_path(serial_port_);
+            last_status_check_ = std::chrono::steady_clock::now();
+            last_neighbor_poll_ = last_status_check_ - neighbor_interval_.load(); // first poll right away
+            poll_deadline_ = last_status_check_;
+            running_ = true;
+
+            // Start background threads; polled, the waits below read the port on this thread instead
+            if (threading_ == Threading::threads) {
+                listen_thread_ = std::thread(&LoRaInterface::listen_thread_func, this);
+                heartbeat_thread_ = std::thread(&LoRaInterface::heartbeat_thread_func, this);
+                tx_thread_ = std::thread(&LoRaInterface::tx_thread_func, this);
+                configure_thread(ThreadRole::receive, listen_thread_, "lora-rx");
+                configure_thread(ThreadRole::maintenance, heartbeat_thread_, "lora-heartbeat");
+                configure_thread(ThreadRole::transmit, tx_thread_, "lora-tx");
+            }
+
+            // Wait for the firmware to answer instead of sleeping for a fixed period
+            if (!wait_for_firmware_ready(command_timeout_)) {
+                std::cerr << "LoRa node on " << serial_port_ << " did not answer status probe, continuing" << std::endl;
+            }
+
+            if (serial_config_.negotiate_framing && !set_framing(FramingVersion::v2)) {
+                std::cerr << "LoRa firmware on " << serial_port_ << " does not support framing v2, using v1"
+                          << std::endl;
+            }
+
+            // Set the node's IPv6 address (must match LAN interface)
+            if (!set_node_ipv6(node_ipv6_)) {
+                std::cerr << "Failed to set IPv6 address on LoRa node: " << node_ipv6_ << std::endl;
+                stop();
+                return false;
+            }
+
+            // Get initial status
+            current_status_ = get_status();
+
+            if (short_addressing_requested_) {
+                activate_short_addressing();
+            }
+
+            if (serial_config_.negotiate_baud) {
+                negotiate_baud_rate(serial_config_.max_baud_rate);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+                link_ready_ = true;
+                tx_queue_wake_.notify_all();
+            }
+            wake_heartbeat();
+
+            std::cout << "LoRa interface started on " << serial_port_ << " with IPv6: " << get_address() << std::endl;
+
+            return true;
+        }
+
+        inline void stop() override {
+            if (!running_) {
+                return;
+            }
+
+            running_ = false;
+            link_ready_ = false;
+
+            // Wake up any waiting threads
+            wake_listener();
+            {
+                std::lock_guard<std::mutex> lock(heartbeat_mutex_);
+                heartbeat_wake_.notify_all();
+            }
+            {
+                std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+                tx_queue_wake_.notify_all();
+            }
+            message_available_.notify_all();
+
+            // Join threads
+            if (listen_thread_.joinable()) {
+                listen_thread_.join();
+            }
+            if (heartbeat_thread_.joinable()) {
+                heartbeat_thread_.join();
+            }
+            if (tx_thread_.joinable()) {
+                tx_thread_.join();
+            }
+
+            close_serial_port();
+            expire_commands(true);
+            if (wake_fd_ != -1) {
+                close(wake_fd_);
+                wake_fd_ = -1;
+            }
+            std::cout << "LoRa interface stopped" << std::endl;
+        }
+
+        inline void send_message(const std::string &dest_addr, uint16_t /* dest_port */,
+                                 const std::string &msg) override {
+            send_message(dest_addr, msg, tx_classifier_ ? tx_classifier_(dest_addr, msg) : default_tx_options_);
+        }
+
+        // Queue a message for the transmit scheduler with explicit priority, expiry and coalescing
+        inline bool send_message(const std::string &dest_addr, const std::string &msg, const TxOptions &options) {
+            // While a reconnection is under way frames are queued and go out once the radio is back
+            if (!running_ || (!serial_connected_ && !serial_config_.auto_reconnect)) {
+                std::cerr << "LoRa interface not connected" << std::endl;
+                return false;
+            }
+
+            bool queued, oversized;
+            {
+                std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+                TxFrame frame = spare_frame();
+                if (!build_frame(dest_addr, msg, frame)) {
+                    return false;
+                }
+                frame.options = options;
+                oversized = tx_scheduler_.exceeds_budget(frame);
+                queued = tx_scheduler_.enqueue(std::move(frame), std::chrono::steady_clock::now());
+                tx_queue_wake_.notify_one();
+            }
+            if (queued && threading_ == Threading::polled) {
+                wake_listener(); // the application's loop comes round to poll_once, which sends it
+            }
+            if (!queued && oversized) {
+                std::cerr << "LoRa frame to " << dest_addr << " exceeds the duty-cycle budget, dropped" << std::endl;
+            } else if (!queued) {
+                std::cerr << "LoRa transmit queue full, dropped message to " << dest_addr << std::endl;
+            }
+            return queued;
+        }
+
+        inline void multicast_message(const std::string &msg) override { send_message(BROADCAST_IPV6, 0, msg); }
+
+        inline void multicast_to_group(const std::vector<std::string> &dest_addrs, uint16_t dest_port,
                                        const std::string &msg) override {
+            // The transmit scheduler paces these; no need to sleep between them
             for (const auto &addr : dest_addrs) {
                 send_message(addr, dest_port, msg);
-                // Small delay between messages to avoid overwhelming the radio
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
             }
         }
 
@@ -556,33 +2105,18 @@ namespace impulse {
                 return status;
             }
 
-            std::vector<uint8_t> response;
-            if (send_command(CMD_GET_STATUS) && wait_for_response(CMD_GET_STATUS, response)) {
-                if (response.size() >= 25) {
-                    // Parse status response: [16 bytes IPv6][1 byte radio][1 byte power][4 bytes freq][1 byte hop][2
-                    // bytes uptime]
-                    std::vector<uint8_t> ipv6_bytes(response.begin(), response.begin() + 16);
-                    status.current_ipv6 = ipv6_bytes_to_string(ipv6_bytes);
-                    status.radio_active = response[16] != 0;
-                    status.tx_power = response[17];
-                    status.frequency_hz =
-                        (response[18] << 24) | (response[19] << 16) | (response[20] << 8) | response[21];
-                    status.hop_limit = response[22];
-                    status.uptime_seconds = (response[23] << 8) | response[24];
-
-                    std::lock_guard<std::mutex> lock(status_mutex_);
-                    current_status_ = status;
-                }
-            }
-
-            return status;
+            return record_status(await_result(submit_command(CMD_GET_STATUS)));
         }
 
         inline bool reset_node() { return send_command(CMD_RESET_NODE); }
 
         inline bool set_tx_power(uint8_t power) {
             std::vector<uint8_t> config_data = {0x01, power}; // Config type 0x01 = TX power
-            return send_command(CMD_SET_CONFIG, config_data);
+            if (!send_command(CMD_SET_CONFIG, config_data)) {
+                return false;
+            }
+            remember(&ReplayState::tx_power, power);
+            return true;
         }
 
         inline bool set_frequency(uint32_t frequency_hz) {
@@ -591,35 +2125,532 @@ namespace impulse {
             config_data.push_back((frequency_hz >> 16) & 0xFF);
             config_data.push_back((frequency_hz >> 8) & 0xFF);
             config_data.push_back(frequency_hz & 0xFF);
-            return send_command(CMD_SET_CONFIG, config_data);
+            if (!send_command(CMD_SET_CONFIG, config_data)) {
+                return false;
+            }
+            remember(&ReplayState::frequency_hz, frequency_hz);
+
+            // Duty-cycle accounting follows the sub-band we now transmit in
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            tx_scheduler_.set_frequency(frequency_hz);
+            return true;
         }
 
         inline bool set_hop_limit(uint8_t hop_limit) {
             std::vector<uint8_t> config_data = {0x03, hop_limit}; // Config type 0x03 = hop limit
-            return send_command(CMD_SET_CONFIG, config_data);
+            if (!send_command(CMD_SET_CONFIG, config_data)) {
+                return false;
+            }
+            remember(&ReplayState::hop_limit, hop_limit);
+            return true;
+        }
+
+        // Hop limit last set through this interface, else the one the firmware reported
+        inline uint8_t get_hop_limit() {
+            {
+                std::lock_guard<std::mutex> lock(replay_mutex_);
+                if (replay_.hop_limit) {
+                    return *replay_.hop_limit;
+                }
+            }
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            return current_status_.hop_limit;
+        }
+
+        inline bool set_spreading_factor(uint8_t spreading_factor) {
+            std::vector<uint8_t> config_data = {0x04, spreading_factor}; // Config type 0x04 = spreading factor
+            if (!send_command(CMD_SET_CONFIG, config_data)) {
+                return false;
+            }
+            remember(&ReplayState::spreading_factor, spreading_factor);
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            LoRaModulation modulation = tx_scheduler_.modulation();
+            modulation.spreading_factor = spreading_factor;
+            tx_scheduler_.set_modulation(modulation);
+            return true;
+        }
+
+        inline bool set_bandwidth(uint32_t bandwidth_hz) {
+            if (!send_command(CMD_SET_CONFIG, config_u32(0x05, bandwidth_hz))) { // Config type 0x05 = bandwidth
+                return false;
+            }
+            remember(&ReplayState::bandwidth_hz, bandwidth_hz);
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            LoRaModulation modulation = tx_scheduler_.modulation();
+            modulation.bandwidth_hz = bandwidth_hz;
+            tx_scheduler_.set_modulation(modulation);
+            return true;
+        }
+
+        // Settings the firmware uses for frames to one destination (config type 0x06). Needs firmware that
+        // receives on every spreading factor; returns false when the firmware rejects it.
+        inline bool set_destination_settings(const std::string &dest_addr, const LinkSettings &settings) {
+            auto done = std::make_shared<std::promise<bool>>();
+            auto accepted = done->get_future();
+            push_destination_settings(dest_addr, settings, [done](bool ok) { done->set_value(ok); });
+            return await_result(std::move(accepted));
+        }
+
+        // Adaptive data rate. In the default mode one setting serves every direct neighbour, tuned for the weakest;
+        // spreading factor and bandwidth must match at both ends, so all nodes should run it with the same config.
+        inline void set_adr(const AdrConfig &config) {
+            std::lock_guard<std::mutex> lock(adr_mutex_);
+            if (config.enabled && !adr_.config().enabled) {
+                // Start from what the radio is actually using
+                {
+                    std::lock_guard<std::mutex> tx_lock(tx_queue_mutex_);
+                    link_settings_.spreading_factor = tx_scheduler_.modulation().spreading_factor;
+                    link_settings_.bandwidth_hz = tx_scheduler_.modulation().bandwidth_hz;
+                }
+                std::lock_guard<std::mutex> status_lock(status_mutex_);
+                if (current_status_.tx_power) {
+                    link_settings_.tx_power_dbm = static_cast<int8_t>(current_status_.tx_power);
+                }
+            }
+            adr_.set_config(config);
+        }
+
+        inline LinkSettings get_link_settings() {
+            std::lock_guard<std::mutex> lock(adr_mutex_);
+            return link_settings_;
+        }
+
+        // Short addressing. Requires every node in the fleet to agree on the table (see ShortAddressTable) and
+        // firmware that understands CMD_SET_SHORT_ID; otherwise frames keep full addresses.
+        inline void enable_short_addressing(bool enable = true) {
+            short_addressing_requested_ = enable;
+            if (!enable) {
+                short_addressing_ = false;
+            } else if (running_) {
+                activate_short_addressing();
+            }
+        }
+
+        inline bool short_addressing_active() const { return short_addressing_; }
+
+        // Explicit IDs for nodes outside the derivable fleet prefix; must be identical on every node
+        inline ShortAddressTable &short_address_table() { return short_addresses_; }
+
+        // Neighbour table. The snapshot is immutable and can be held and read from any thread without locking.
+        inline std::shared_ptr<const NeighborTable> get_neighbors() const { return neighbors_.snapshot(); }
+
+        inline void set_neighbor_refresh(std::chrono::seconds interval,
+                                         std::chrono::seconds expiry = std::chrono::minutes(5)) {
+            neighbor_interval_ = interval;
+            neighbors_.set_expiry(expiry);
+            wake_heartbeat();
+        }
+
+        // Serial link
+        inline uint32_t get_baud_rate() const { return baud_rate_; }
+
+        // Ask the firmware to change rate and follow it. If the radio cannot be heard reliably at the new rate the
+        // link goes back to the previous one (the firmware reverts on its own when the host stays silent).
+        inline bool set_baud_rate(uint32_t baud_rate) {
+            uint32_t previous = baud_rate_;
+            if (!running_ || baud_rate == previous) {
+                return running_;
+            }
+
+            std::vector<uint8_t> data = {static_cast<uint8_t>(baud_rate >> 24), static_cast<uint8_t>(baud_rate >> 16),
+                                         static_cast<uint8_t>(baud_rate >> 8), static_cast<uint8_t>(baud_rate)};
+            if (!await_result(submit_command(CMD_SET_BAUD, data)).ok()) {
+                return false; // refused, or firmware without rate switching
+            }
+
+            bool switched;
+            {
+                std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+                switched = apply_line_settings(baud_rate, serial_config_.hardware_flow_control);
+            }
+
+            const auto probe_timeout = std::chrono::milliseconds(500);
+            bool answering = switched && wait_for_firmware_ready(probe_timeout);
+            if (answering && benchmark_link(32).errors == 0) {
+                std::cout << "LoRa serial link on " << serial_port_ << " now at " << baud_rate << " baud" << std::endl;
+                return true;
+            }
+
+            // Go back; if the firmware still hears us, tell it to follow
+            if (answering) {
+                data = {static_cast<uint8_t>(previous >> 24), static_cast<uint8_t>(previous >> 16),
+                        static_cast<uint8_t>(previous >> 8), static_cast<uint8_t>(previous)};
+                await_result(submit_command(CMD_SET_BAUD, data, probe_timeout));
+            }
+            {
+                std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+                apply_line_settings(previous, serial_config_.hardware_flow_control);
+            }
+            wait_for_firmware_ready(command_timeout_);
+            return false;
+        }
+
+        // Step down from the fastest candidate rate until one passes the link check
+        inline uint32_t negotiate_baud_rate(uint32_t max_baud_rate) {
+            static constexpr uint32_t CANDIDATES[] = {4000000, 3000000, 2000000, 1500000, 1000000,
+                                                      921600,  460800,  230400};
+            for (uint32_t candidate : CANDIDATES) {
+                if (candidate > max_baud_rate || candidate <= baud_rate_) {
+                    continue;
+                }
+                if (set_baud_rate(candidate)) {
+                    break;
+                }
+            }
+            return baud_rate_;
+        }
+
+        // Switch both directions of the serial link to another framing. The host frames everything written after
+        // CMD_SET_FRAMING in the new format, and parses everything after the firmware's ACK in it.
+        inline bool set_framing(FramingVersion version) {
+            if (!running_) {
+                return false;
+            }
+            auto done = std::make_shared<std::promise<bool>>();
+            auto accepted = done->get_future();
+            request_framing(version, [done](bool ok) { done->set_value(ok); });
+            return await_result(std::move(accepted));
+        }
+
+        // set_framing without waiting; `done` gets the outcome
+        inline void request_framing(FramingVersion version, std::function<void(bool)> done) {
+            FramingVersion previous;
+            {
+                std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+                previous = tx_framing_;
+            }
+            if (previous == version) {
+                done(true);
+                return;
+            }
+
+            submit_command(CMD_SET_FRAMING, {static_cast<uint8_t>(version)},
+                           [this, version, previous, done](const CommandResult &result) {
+                               // On the listen thread, before it parses the bytes that follow the ACK
+                               if (result.ok()) {
+                                   framer_.set_version(version);
+                                   std::cout << "LoRa serial link on " << serial_port_ << " now using framing v"
+                                             << static_cast<int>(version) << std::endl;
+                               } else {
+                                   // Refused or unanswered: the firmware still expects the old framing
+                                   std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+                                   tx_framing_ = previous;
+                               }
+                               done(result.ok());
+                           });
+        }
+
+        inline FramingVersion get_framing() {
+            std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+            return tx_framing_;
+        }
+
+        inline FramingStats get_framing_stats() const {
+            std::lock_guard<std::mutex> lock(framing_stats_mutex_);
+            return framing_stats_;
+        }
+
+        // Measure the serial link with pipelined status round trips (`window` in flight at a time)
+        inline LinkBenchmark benchmark_link(uint32_t requests = 200, uint32_t window = 8) {
+            LinkBenchmark result;
+            result.baud_rate = baud_rate_;
+            if (!running_) {
+                return result;
+            }
+
+            constexpr size_t REQUEST_BYTES = 1;
+            constexpr size_t RESPONSE_BYTES = 5 + 25;
+            std::deque<std::pair<std::chrono::steady_clock::time_point, std::future<CommandResult>>> in_flight;
+            std::chrono::microseconds total_round_trip{0};
+
+            auto collect = [&]() {
+                auto &[sent_at, future] = in_flight.front();
+                CommandResult response = await_result(std::move(future));
+                if (response.completed && response.response_type == RESP_STATUS && response.response.size() >= 25) {
+                    ++result.responses;
+                    auto round_trip = std::chrono::steady_clock::now() - sent_at;
+                    total_round_trip += std::chrono::duration_cast<std::chrono::microseconds>(round_trip);
+                } else {
+                    ++result.errors;
+                }
+                in_flight.pop_front();
+            };
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < requests; ++i) {
+                if (in_flight.size() >= std::max<uint32_t>(window, 1)) {
+                    collect();
+                }
+                in_flight.emplace_back(std::chrono::steady_clock::now(), submit_command(CMD_GET_STATUS));
+                ++result.requests;
+            }
+            while (!in_flight.empty()) {
+                collect();
+            }
+
+            result.elapsed =
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            if (result.responses > 0) {
+                result.mean_round_trip = total_round_trip / result.responses;
+            }
+            if (result.elapsed.count() > 0) {
+                double bits = 8.0 * (result.requests * REQUEST_BYTES + result.responses * RESPONSE_BYTES);
+                result.throughput_bps = bits * 1e6 / result.elapsed.count();
+            }
+            return result;
+        }
+
+        // Transmit queue, command pipeline and spare frames come from `resource` from the next start(). Frames are
+        // built and responses parsed in buffers that keep their capacity, so once warmed up sending and receiving
+        // no longer allocate; with FEC enabled, parity groups still do.
+        inline bool set_memory_resource(std::pmr::memory_resource *resource) override {
+            memory_resource_ = resource;
+            return true;
+        }
+
+        // Polled mode: no threads; poll_once reads the radio, runs the heartbeat and puts queued frames on air, all
+        // on the caller's thread. Blocking calls such as start() or get_status() read the port themselves while
+        // they wait, so make them from that thread too. The baud rate is not renegotiated after a reconnection.
+        inline bool set_threading(Threading threading) override {
+            if (running_) {
+                std::cerr << interface_name_ << ": set the threading mode before start()" << std::endl;
+                return false;
+            }
+            threading_ = threading;
+            return true;
+        }
+
+        // The serial port, and the wake-up descriptor that signals new frames to send and commands to time
+        inline std::vector<int> get_poll_fds() const override {
+            if (threading_ != Threading::polled || wake_fd_ < 0) {
+                return {};
+            }
+            if (serial_fd_ < 0) {
+                return {wake_fd_}; // reconnecting
+            }
+            return {serial_fd_, wake_fd_};
+        }
+
+        inline std::chrono::steady_clock::time_point next_deadline() override {
+            if (threading_ != Threading::polled || !running_) {
+                return std::chrono::steady_clock::time_point::max();
+            }
+            return poll_deadline_;
+        }
+
+        inline void poll_once(std::chrono::milliseconds timeout) override {
+            if (threading_ != Threading::polled || !running_) {
+                return;
+            }
+            if (timeout.count() > 0) {
+                // The listen thread's wait, up to the deadline; unlike wait_readable it needs no descriptor list
+                auto wait = timeout;
+                if (poll_deadline_ != std::chrono::steady_clock::time_point::max()) {
+                    auto until = std::chrono::ceil<std::chrono::milliseconds>(poll_deadline_ -
+                                                                               std::chrono::steady_clock::now());
+                    wait = std::clamp(until, std::chrono::milliseconds::zero(), timeout);
+                }
+                wait_serial_readable(static_cast<int>(wait.count()));
+            }
+
+            // Listen: bounded, so a chatty radio cannot hold the caller indefinitely
+            auto now = std::chrono::steady_clock::now();
+            if ((!serial_connected_ || reconnect_requested_) && serial_config_.auto_reconnect) {
+                poll_reconnect(now);
+            }
+            for (int i = 0; i < 16 && receive_serial(0); ++i) {
+            }
+
+            // Heartbeat
+            if (replay_pending_) {
+                replay_configuration();
+                missed_heartbeats_ = 0;
+            }
+            if (link_ready_) {
+                maintain_link(now);
+            }
+
+            // Transmit
+            auto tx_wake = std::chrono::steady_clock::time_point::max();
+            {
+                std::unique_lock<std::mutex> lock(tx_queue_mutex_);
+                while (link_ready_ && transmit_next(lock, tx_wake)) {
+                }
+            }
+
+            // Expired last, so the deadline covers the commands sent above
+            int command_wait = expire_commands();
+            now = std::chrono::steady_clock::now();
+            poll_deadline_ = command_wait < 0 ? std::chrono::steady_clock::time_point::max()
+                                              : now + std::chrono::milliseconds(command_wait);
+            if (!serial_connected_ && serial_config_.auto_reconnect) {
+                poll_deadline_ = std::min(poll_deadline_, reconnect_at_);
+            }
+            if (link_ready_) {
+                poll_deadline_ = std::min({poll_deadline_, maintenance_due(), tx_wake});
+            }
         }
 
         // Connection management
-        inline bool is_connected() const override { return running_ && serial_connected_; }
+        inline bool is_connected() const override { return running_ && serial_connected_ && link_ready_; }
+
+        // Times the serial port was reopened after the radio went away
+        inline uint32_t get_reconnect_count() const { return reconnects_; }
 
         inline void set_command_timeout(std::chrono::milliseconds timeout) { command_timeout_ = timeout; }
 
+        // Transmit scheduling
+        inline void set_default_tx_options(const TxOptions &options) { default_tx_options_ = options; }
+
+        // Pick options per message (e.g. short expiry and coalescing for position updates) for sends that come
+        // through the generic NetworkInterface API
+        inline void
+        set_tx_classifier(std::function<TxOptions(const std::string &dest_addr, const std::string &msg)> classifier) {
+            tx_classifier_ = classifier;
+        }
+
+        inline void set_modulation(const LoRaModulation &modulation) {
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            tx_scheduler_.set_modulation(modulation);
+        }
+
+        inline void set_regional_limits(const RegionalLimits &limits) {
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            tx_scheduler_.set_limits(limits);
+        }
+
+        // Pace transmissions at `rate` seconds of airtime per second (zero = the sub-band duty cycle)
+        inline void set_tx_pacing(double rate, std::chrono::milliseconds burst = std::chrono::milliseconds(2000)) {
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            tx_scheduler_.set_pacing(rate, burst);
+            tx_queue_wake_.notify_one();
+        }
+
+        inline TxStats get_tx_stats() const {
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            return tx_scheduler_.stats();
+        }
+
+        inline size_t tx_queue_size() const {
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            return tx_scheduler_.size();
+        }
+
+        // Forward error correction. All nodes must agree on whether it is enabled: the FEC header is part of the
+        // payload. Parity redundancy follows the loss measured on frames received from each peer.
+        inline void set_fec(const FecConfig &config) {
+            {
+                std::lock_guard<std::mutex> lock(fec_mutex_);
+                if (config.enabled != fec_config_.enabled) {
+                    fec_encoder_.clear();
+                    fec_decoder_.clear();
+                }
+                fec_config_ = config;
+            }
+            std::lock_guard<std::mutex> lock(tx_queue_mutex_);
+            tx_scheduler_.set_coding_overhead(config.enabled ? fec::DATA_HEADER : 0);
+            tx_queue_wake_.notify_one();
+        }
+
+        inline FecConfig get_fec_config() const {
+            std::lock_guard<std::mutex> lock(fec_mutex_);
+            return fec_config_;
+        }
+
+        inline FecStats get_fec_stats() const {
+            std::lock_guard<std::mutex> lock(fec_mutex_);
+            return fec_encoder_.stats(fec_decoder_.stats());
+        }
+
+        // Estimated frame loss on the link to `peer` (0..1), measured while FEC is enabled
+        inline double get_link_loss(const std::string &peer) const {
+            in6_addr addr;
+            char canonical[INET6_ADDRSTRLEN];
+            if (inet_pton(AF_INET6, peer.c_str(), &addr) != 1 ||
+                inet_ntop(AF_INET6, &addr, canonical, sizeof(canonical)) == nullptr) {
+                return 0.0;
+            }
+            std::lock_guard<std::mutex> lock(fec_mutex_);
+            return fec_decoder_.loss(canonical);
+        }
+
+        // Pipelined commands: any number may be in flight. Each gets a sequence ID and completes, with or
+        // without a response, by its own deadline (zero = the configured command timeout). Polled, answers are
+        // only read in poll_once: keep polling while the future is pending.
+        inline std::future<CommandResult>
+        submit_command(SerialCommand cmd, const std::vector<uint8_t> &data = {},
+                       std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+            auto promise = std::make_shared<std::promise<CommandResult>>();
+            auto future = promise->get_future();
+            if (!running_) {
+                CommandResult result;
+                result.command = cmd;
+                promise->set_value(std::move(result));
+                return future;
+            }
+            dispatch_command(cmd, data, std::move(promise), nullptr, timeout);
+            return future;
+        }
+
+        // Callback flavour; the callback runs on the listen thread, in poll_once when polled (or on the caller's
+        // thread, if the write fails)
+        inline uint32_t submit_command(SerialCommand cmd, const std::vector<uint8_t> &data, CommandCallback callback,
+                                       std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+            if (!running_) {
+                CommandResult result;
+                result.command = cmd;
+                if (callback) {
+                    callback(result);
+                }
+                return 0;
+            }
+            uint32_t sequence = 0;
+            dispatch_command(cmd, data, nullptr, std::move(callback), timeout, &sequence);
+            return sequence;
+        }
+
         // Message retrieval (non-blocking)
         inline bool has_messages() const {
             std::lock_guard<std::mutex> lock(message_queue_mutex_);
             return !incoming_messages_.empty();
         }
 
+        // Convenience pull that allocates the result; prefer drain_messages on long-running nodes
         inline std::vector<IncomingMessage> get_pending_messages() {
             std::lock_guard<std::mutex> lock(message_queue_mutex_);
-            std::vector<IncomingMessage> messages;
+            std::vector<IncomingMessage> messages(incoming_messages_.size());
+            incoming_messages_.drain(messages);
+            return messages;
+        }
 
-            while (!incoming_messages_.empty()) {
-                messages.push_back(incoming_messages_.front());
-                incoming_messages_.pop();
-            }
+        // Batch drain without allocation: swaps up to out.size() messages into the caller's buffer. Reusing the same
+        // buffer keeps string capacity circulating between the queue and the caller.
+        inline size_t drain_messages(std::span<IncomingMessage> out) {
+            std::lock_guard<std::mutex> lock(message_queue_mutex_);
+            return incoming_messages_.drain(out);
+        }
 
-            return messages;
+        // Wait until messages are queued or the timeout expires
+        inline bool wait_for_messages(std::chrono::milliseconds timeout) {
+            std::unique_lock<std::mutex> lock(message_queue_mutex_);
+            return message_available_.wait_for(lock, timeout,
+                                               [this] { return !incoming_messages_.empty() || !running_; }) &&
+                   !incoming_messages_.empty();
+        }
+
+        inline void set_delivery_mode(DeliveryMode mode) { delivery_mode_ = mode; }
+        inline DeliveryMode get_delivery_mode() const { return delivery_mode_; }
+
+        // Replace the receive queue (queued messages are discarded)
+        inline void set_receive_queue(size_t capacity, OverflowPolicy policy = OverflowPolicy::drop_oldest) {
+            std::lock_guard<std::mutex> lock(message_queue_mutex_);
+            incoming_messages_ = RingBuffer<IncomingMessage>(capacity, policy);
+        }
+
+        inline ReceiveStats get_receive_stats() const {
+            std::lock_guard<std::mutex> lock(message_queue_mutex_);
+            auto ring = incoming_messages_.stats();
+            return {received_count_, ring.pushed, ring.dropped, ring.size, ring.capacity};
         }
     };
 
@@ -0,0 +1,785 @@
+#pragma once
+
+#include "impulse/network/lora.hpp"
+
+#include <algorithm>
+#include <array>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace impulse {
+
+    struct MeshConfig {
+        std::chrono::seconds route_lifetime = std::chrono::seconds(60);
+        std::chrono::milliseconds discovery_timeout = std::chrono::milliseconds(2000);
+        uint8_t discovery_retries = 3;
+        uint8_t max_hops = 8;
+        // Acknowledge every unicast hop; feeds the ETX link metric and detects broken links
+        bool hop_acks = true;
+        std::chrono::milliseconds hop_ack_timeout = std::chrono::milliseconds(3000);
+        uint8_t link_failures_before_break = 3;
+        // Restrict the firmware to single-hop transmission so only the host forwards
+        bool single_hop_links = true;
+        size_t max_pending_per_destination = 16;
+    };
+
+    struct MeshRoute {
+        std::string destination;
+        std::string next_hop;
+        double metric; // summed ETX along the path
+        uint8_t hops;
+        std::chrono::steady_clock::time_point expires;
+        uint16_t sequence; // destination sequence number, 0 = unknown
+    };
+
+    struct MeshStats {
+        uint64_t delivered = 0;
+        uint64_t forwarded = 0;
+        uint64_t discoveries = 0;
+        uint64_t discovery_failures = 0;
+        uint64_t broken_links = 0;
+        uint64_t dropped = 0;
+    };
+
+    // Host-side AODV-style routing on top of LoRaInterface. Unicast traffic follows cached routes hop by hop;
+    // routes are discovered on demand with flooded requests and answered along the reverse path. Only route
+    // requests and application broadcasts are flooded, with duplicate suppression.
+    //
+    // As in AODV every node numbers its own route announcements. Routes remember the destination sequence number
+    // they were learned with; a fresher number always wins and an older one never does, so a late reply from
+    // before a link break can't reinstate a dead path or form a loop. Broken routes are reported upstream with
+    // RERR, hop by hop, to every node that routed through the break.
+    //
+    // Frames are LoRa payloads starting with MESH_MAGIC and a type byte:
+    //   DATA  [ttl][seq:2][origin:16][dest:16][payload]                       unicast to the next hop
+    //   RREQ  [ttl][id:2][origin:16][oseq:2][target:16][tseq:2][metric:2]     broadcast, metric = ETX x 16
+    //   RREP  [ttl][origin:16][target:16][tseq:2][metric:2][hops]             unicast towards the requester
+    //   RERR  [dest:16][dseq:2]                                               broadcast to neighbours
+    //   ACK   [seq:2]                                                         hop acknowledgement of DATA
+    //   BCAST [ttl][id:2][origin:16][payload]                                 application broadcast flood
+    // Sequence numbers skip 0, which stands for unknown.
+    class LoRaMeshInterface : public NetworkInterface {
+      private:
+        using Address = std::array<uint8_t, 16>;
+
+        static constexpr uint8_t MESH_MAGIC = 0x4D;
+        enum FrameType : uint8_t { DATA = 1, RREQ = 2, RREP = 3, RERR = 4, ACK = 5, BCAST = 6 };
+
+        struct Route {
+            Address next_hop;
+            double metric;
+            uint8_t hops;
+            uint16_t seq; // destination sequence number, 0 = unknown
+            bool valid;   // broken routes stay until they expire to remember their sequence number
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        struct Link {
+            double delivery = 0.75; // EWMA of hop-ack outcomes; unknown links start optimistic but not perfect
+            uint8_t consecutive_failures = 0;
+        };
+
+        struct Discovery {
+            uint8_t attempts = 0;
+            std::chrono::steady_clock::time_point deadline;
+            std::deque<std::string> pending; // payloads waiting for the route
+        };
+
+        struct AwaitingAck {
+            Address next_hop;
+            Address destination;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+        LoRaInterface *lora_;
+        MeshConfig config_;
+        Address self_{};
+        bool owns_start_ = false;
+        std::optional<uint8_t> restore_hop_limit_; // firmware hop limit to put back when we did not start the radio
+
+        std::map<Address, Route> routes_;
+        std::map<Address, Link> links_;
+        std::map<Address, Discovery> discoveries_;
+        std::map<uint16_t, AwaitingAck> awaiting_acks_;
+        std::map<std::pair<Address, uint16_t>, std::chrono::steady_clock::time_point> seen_floods_;
+        uint16_t next_seq_ = 0;
+        uint16_t next_flood_id_ = 0;
+        uint16_t own_seq_ = 1;
+        MeshStats stats_;
+        mutable std::mutex mutex_;
+
+        std::thread maintenance_thread_;
+        std::condition_variable maintenance_wake_;
+        std::chrono::steady_clock::time_point maintenance_due_; // polled mode: when poll_once has timers to run
+        std::atomic<bool> running_;
+
+        inline static bool parse(const std::string &addr, Address &out) {
+            return inet_pton(AF_INET6, addr.c_str(), out.data()) == 1;
+        }
+
+        inline static std::string format(const Address &addr) {
+            char str[INET6_ADDRSTRLEN];
+            return inet_ntop(AF_INET6, addr.data(), str, sizeof(str)) ? std::string(str) : std::string();
+        }
+
+        inline static bool is_broadcast(const Address &addr) {
+            return std::all_of(addr.begin(), addr.end(), [](uint8_t b) { return b == 0xFF; });
+        }
+
+        inline static void put16(std::string &out, uint16_t value) {
+            out.push_back(static_cast<char>(value >> 8));
+            out.push_back(static_cast<char>(value & 0xFF));
+        }
+
+        inline static uint16_t get16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+
+        // Sequence number arithmetic modulo 2^16, skipping 0
+        inline static bool newer(uint16_t a, uint16_t b) { return static_cast<int16_t>(a - b) > 0; }
+        inline static uint16_t following(uint16_t seq) { return seq == 0xFFFF ? 1 : seq + 1; }
+
+        inline static void put_address(std::string &out, const Address &addr) {
+            out.append(reinterpret_cast<const char *>(addr.data()), addr.size());
+        }
+
+        inline static Address get_address(const uint8_t *p) {
+            Address addr;
+            std::memcpy(addr.data(), p, addr.size());
+            return addr;
+        }
+
+        inline std::string header(FrameType type) const {
+            std::string frame;
+            frame.push_back(static_cast<char>(MESH_MAGIC));
+            frame.push_back(static_cast<char>(type));
+            return frame;
+        }
+
+        // ETX of the link to a neighbour (1 = perfect)
+        inline double link_etx(const Address &neighbor) const {
+            auto it = links_.find(neighbor);
+            double delivery = it == links_.end() ? Link{}.delivery : it->second.delivery;
+            return 1.0 / std::max(delivery, 0.05);
+        }
+
+        inline static uint16_t encode_metric(double metric) {
+            return static_cast<uint16_t>(std::min(metric * 16.0, 65535.0));
+        }
+
+        inline void record_link(const Address &neighbor, bool delivered) {
+            auto &link = links_[neighbor];
+            link.delivery = 0.8 * link.delivery + 0.2 * (delivered ? 1.0 : 0.0);
+            link.consecutive_failures = delivered ? 0 : link.consecutive_failures + 1;
+        }
+
+        // Install or improve a route learned with destination sequence number `seq`. A fresher number always wins;
+        // the same number wins over a broken route, on the same next hop, or with a better metric. Returns true if
+        // the route changed.
+        inline bool update_route(const Address &dest, const Address &next_hop, double metric, uint8_t hops,
+                                 uint16_t seq) {
+            auto now = std::chrono::steady_clock::now();
+            auto it = routes_.find(dest);
+            if (it != routes_.end() && it->second.expires > now) {
+                const Route &route = it->second;
+                bool fresher = route.seq == 0 || newer(seq, route.seq);
+                bool better = seq == route.seq && (!route.valid || route.next_hop == next_hop || metric < route.metric);
+                if (!fresher && !better) {
+                    return false;
+                }
+            }
+            routes_[dest] = {next_hop, metric, hops, seq, true, now + config_.route_lifetime};
+            return true;
+        }
+
+        // DATA carries no sequence number: it keeps the route it arrived on alive, or fills in a missing one
+        inline void refresh_route(const Address &dest, const Address &next_hop, double metric, uint8_t hops) {
+            auto now = std::chrono::steady_clock::now();
+            auto it = routes_.find(dest);
+            if (it == routes_.end() || it->second.expires <= now) {
+                routes_[dest] = {next_hop, metric, hops, 0, true, now + config_.route_lifetime};
+            } else if (it->second.valid && it->second.next_hop == next_hop) {
+                it->second.expires = now + config_.route_lifetime;
+            }
+        }
+
+        inline const Route *find_route(const Address &dest) {
+            auto it = routes_.find(dest);
+            if (it == routes_.end() || !it->second.valid || it->second.expires <= std::chrono::steady_clock::now()) {
+                return nullptr;
+            }
+            return &it->second;
+        }
+
+        // Sequence number we last heard for a destination, 0 if none
+        inline uint16_t known_seq(const Address &dest) const {
+            auto it = routes_.find(dest);
+            return it == routes_.end() ? 0 : it->second.seq;
+        }
+
+        // Mark a route broken and tell the neighbours, which pass it on if they routed through us
+        inline void invalidate_route(const Address &dest, Route &route, uint16_t seq) {
+            route.valid = false;
+            route.seq = seq;
+            route.expires = std::chrono::steady_clock::now() + config_.route_lifetime;
+            std::string frame = header(RERR);
+            put_address(frame, dest);
+            put16(frame, seq);
+            broadcast(frame, TxPriority::control);
+        }
+
+        // Caller holds mutex_
+        inline void transmit(const Address &to, const std::string &frame, TxPriority priority = TxPriority::normal) {
+            TxOptions options;
+            options.priority = priority;
+            lora_->send_message(format(to), frame, options);
+        }
+
+        inline void broadcast(const std::string &frame, TxPriority priority = TxPriority::normal) {
+            Address all;
+            all.fill(0xFF);
+            transmit(all, frame, priority);
+        }
+
+        // A timer was added; the maintenance thread (polled: the application's loop) re-plans its wake-up. Caller
+        // holds mutex_.
+        inline void schedule(std::chrono::steady_clock::time_point at) {
+            maintenance_due_ = std::min(maintenance_due_, at);
+            maintenance_wake_.notify_one();
+        }
+
+        inline void send_data(const Address &origin, const Address &dest, uint8_t ttl, const std::string &payload,
+                              const Route &route) {
+            std::string frame = header(DATA);
+            frame.push_back(static_cast<char>(ttl));
+            uint16_t seq = next_seq_++;
+            put16(frame, seq);
+            put_address(frame, origin);
+            put_address(frame, dest);
+            frame += payload;
+
+            if (config_.hop_acks) {
+                auto deadline = std::chrono::steady_clock::now() + config_.hop_ack_timeout;
+                awaiting_acks_[seq] = {route.next_hop, dest, deadline};
+                schedule(deadline);
+            }
+            transmit(route.next_hop, frame);
+        }
+
+        inline void send_route_request(const Address &target) {
+            std::string frame = header(RREQ);
+            frame.push_back(static_cast<char>(config_.max_hops));
+            uint16_t id = next_flood_id_++;
+            put16(frame, id);
+            put_address(frame, self_);
+            own_seq_ = following(own_seq_);
+            put16(frame, own_seq_);
+            put_address(frame, target);
+            put16(frame, known_seq(target));
+            put16(frame, 0);
+            seen_floods_[{self_, id}] = std::chrono::steady_clock::now();
+            ++stats_.discoveries;
+            broadcast(frame, TxPriority::control);
+        }
+
+        inline void route_or_discover(const Address &dest, const std::string &payload) {
+            if (const Route *route = find_route(dest)) {
+                send_data(self_, dest, config_.max_hops, payload, *route);
+                return;
+            }
+
+            auto &discovery = discoveries_[dest];
+            if (discovery.pending.size() >= config_.max_pending_per_destination) {
+                discovery.pending.pop_front();
+                ++stats_.dropped;
+            }
+            discovery.pending.push_back(payload);
+            if (discovery.attempts == 0) {
+                discovery.attempts = 1;
+                discovery.deadline = std::chrono::steady_clock::now() + config_.discovery_timeout;
+                send_route_request(dest);
+                schedule(discovery.deadline);
+            }
+        }
+
+        inline void flush_pending(const Address &dest) {
+            auto it = discoveries_.find(dest);
+            const Route *route = find_route(dest);
+            if (it == discoveries_.end() || !route) {
+                return;
+            }
+            for (const auto &payload : it->second.pending) {
+                send_data(self_, dest, config_.max_hops, payload, *route);
+            }
+            discoveries_.erase(it);
+        }
+
+        // The break makes the destination's next number the freshest one around, as AODV does
+        inline void break_link(const Address &next_hop) {
+            ++stats_.broken_links;
+            for (auto &[dest, route] : routes_) {
+                if (route.valid && route.next_hop == next_hop) {
+                    invalidate_route(dest, route, route.seq == 0 ? 0 : following(route.seq));
+                }
+            }
+        }
+
+        inline bool seen_flood(const Address &origin, uint16_t id) {
+            auto key = std::make_pair(origin, id);
+            if (seen_floods_.count(key)) {
+                return true;
+            }
+            seen_floods_[key] = std::chrono::steady_clock::now();
+            return false;
+        }
+
+        inline void handle_frame(const std::string &message, const std::string &from_addr) {
+            Address from;
+            if (message.size() < 2 || static_cast<uint8_t>(message[0]) != MESH_MAGIC || !parse(from_addr, from)) {
+                // Not a mesh frame: a direct transmission from a node without routing
+                std::function<void(const std::string &, const std::string &, uint16_t)> callback;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    callback = message_callback_;
+                }
+                if (callback) {
+                    callback(message, from_addr, 0);
+                }
+                return;
+            }
+
+            const auto *p = reinterpret_cast<const uint8_t *>(message.data()) + 2;
+            size_t size = message.size() - 2;
+            std::string deliver_payload;
+            std::string deliver_from;
+            std::function<void(const std::string &, const std::string &, uint16_t)> callback;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                callback = message_callback_;
+                switch (static_cast<FrameType>(message[1])) {
+                case DATA: {
+                    if (size < 1 + 2 + 32) {
+                        return;
+                    }
+                    uint8_t ttl = p[0];
+                    uint16_t seq = get16(p + 1);
+                    Address origin = get_address(p + 3);
+                    Address dest = get_address(p + 19);
+
+                    if (config_.hop_acks) {
+                        std::string ack = header(ACK);
+                        put16(ack, seq);
+                        transmit(from, ack, TxPriority::control);
+                    }
+                    // Keep the reverse route warm; hops travelled so far stand in for the unknown path cost
+                    uint8_t travelled = config_.max_hops > ttl ? config_.max_hops - ttl + 1 : 1;
+                    refresh_route(origin, from, link_etx(from) * travelled, travelled);
+
+                    if (dest == self_) {
+                        ++stats_.delivered;
+                        deliver_payload.assign(message, 2 + 35, std::string::npos);
+                        deliver_from = format(origin);
+                    } else if (ttl > 1) {
+                        if (const Route *route = find_route(dest)) {
+                            ++stats_.forwarded;
+                            send_data(origin, dest, ttl - 1, message.substr(2 + 35), *route);
+                        } else {
+                            ++stats_.dropped;
+                            std::string frame = header(RERR);
+                            put_address(frame, dest);
+                            put16(frame, known_seq(dest));
+                            transmit(from, frame, TxPriority::control);
+                        }
+                    } else {
+                        ++stats_.dropped;
+                    }
+                    break;
+                }
+
+                case RREQ: {
+                    if (size < 1 + 2 + 16 + 2 + 16 + 2 + 2) {
+                        return;
+                    }
+                    uint8_t ttl = p[0];
+                    uint16_t id = get16(p + 1);
+                    Address origin = get_address(p + 3);
+                    uint16_t origin_seq = get16(p + 19);
+                    Address target = get_address(p + 21);
+                    uint16_t target_seq = get16(p + 37);
+                    double metric = get16(p + 39) / 16.0 + link_etx(from);
+                    if (origin == self_) {
+                        return;
+                    }
+
+                    bool duplicate = seen_flood(origin, id);
+                    bool improved = update_route(origin, from, metric, config_.max_hops - ttl + 1, origin_seq);
+
+                    if (target == self_) {
+                        // Answer the first request and any later copy that found a better path, each time with a
+                        // number fresher than any the requester may have heard for us
+                        if (!duplicate || improved) {
+                            if (target_seq != 0 && newer(target_seq, own_seq_)) {
+                                own_seq_ = target_seq;
+                            }
+                            own_seq_ = following(own_seq_);
+                            std::string frame = header(RREP);
+                            frame.push_back(static_cast<char>(config_.max_hops));
+                            put_address(frame, origin);
+                            put_address(frame, self_);
+                            put16(frame, own_seq_);
+                            put16(frame, 0);
+                            frame.push_back(0);
+                            transmit(from, frame, TxPriority::control);
+                        }
+                    } else if (!duplicate && ttl > 1) {
+                        std::string frame = header(RREQ);
+                        frame.push_back(static_cast<char>(ttl - 1));
+                        put16(frame, id);
+                        put_address(frame, origin);
+                        put16(frame, origin_seq);
+                        put_address(frame, target);
+                        uint16_t known = known_seq(target);
+                        if (known != 0 && (target_seq == 0 || newer(known, target_seq))) {
+                            target_seq = known;
+                        }
+                        put16(frame, target_seq);
+                        put16(frame, encode_metric(metric));
+                        broadcast(frame, TxPriority::control);
+                    }
+                    break;
+                }
+
+                case RREP: {
+                    if (size < 1 + 32 + 2 + 2 + 1) {
+                        return;
+                    }
+                    uint8_t ttl = p[0];
+                    Address origin = get_address(p + 1);
+                    Address target = get_address(p + 17);
+                    uint16_t target_seq = get16(p + 33);
+                    double metric = get16(p + 35) / 16.0 + link_etx(from);
+                    uint8_t hops = p[37] + 1;
+
+                    // A stale reply loses to what we know and goes no further
+                    if (!update_route(target, from, metric, hops, target_seq)) {
+                        break;
+                    }
+                    if (origin == self_) {
+                        flush_pending(target);
+                    } else if (ttl > 1) {
+                        if (const Route *back = find_route(origin)) {
+                            std::string frame = header(RREP);
+                            frame.push_back(static_cast<char>(ttl - 1));
+                            put_address(frame, origin);
+                            put_address(frame, target);
+                            put16(frame, target_seq);
+                            put16(frame, encode_metric(metric));
+                            frame.push_back(static_cast<char>(hops));
+                            transmit(back->next_hop, frame, TxPriority::control);
+                        }
+                    }
+                    break;
+                }
+
+                case RERR: {
+                    if (size < 16 + 2) {
+                        return;
+                    }
+                    // Only the node we route through can break our route; pass the news on to those routing via us
+                    Address dest = get_address(p);
+                    uint16_t seq = get16(p + 16);
+                    auto it = routes_.find(dest);
+                    if (it != routes_.end() && it->second.valid && it->second.next_hop == from) {
+                        if (seq == 0 || (it->second.seq != 0 && !newer(seq, it->second.seq))) {
+                            seq = it->second.seq;
+                        }
+                        invalidate_route(dest, it->second, seq);
+                    }
+                    break;
+                }
+
+                case ACK: {
+                    if (size < 2) {
+                        return;
+                    }
+                    auto it = awaiting_acks_.find(get16(p));
+                    if (it != awaiting_acks_.end() && it->second.next_hop == from) {
+                        record_link(from, true);
+                        awaiting_acks_.erase(it);
+                    }
+                    break;
+                }
+
+                case BCAST: {
+                    if (size < 1 + 2 + 16) {
+                        return;
+                    }
+                    uint8_t ttl = p[0];
+                    Address origin = get_address(p + 3);
+                    if (origin == self_ || seen_flood(origin, get16(p + 1))) {
+                        return;
+                    }
+                    if (ttl > 1) {
+                        std::string frame = message;
+                        frame[2] = static_cast<char>(ttl - 1);
+                        broadcast(frame);
+                    }
+                    deliver_payload.assign(message, 2 + 19, std::string::npos);
+                    deliver_from = format(origin);
+                    break;
+                }
+
+                default:
+                    return;
+                }
+            }
+
+            if (!deliver_from.empty() && callback) {
+                callback(deliver_payload, deliver_from, 0);
+            }
+        }
+
+        // Retry or abandon discoveries, time out hop acks and forget old flood IDs. Returns when to come back.
+        // Caller holds mutex_.
+        inline std::chrono::steady_clock::time_point maintain_routes(std::chrono::steady_clock::time_point now) {
+            auto next = now + std::chrono::seconds(1);
+
+            for (auto it = discoveries_.begin(); it != discoveries_.end();) {
+                if (it->second.deadline <= now) {
+                    if (it->second.attempts >= config_.discovery_retries) {
+                        ++stats_.discovery_failures;
+                        stats_.dropped += it->second.pending.size();
+                        it = discoveries_.erase(it);
+                        continue;
+                    }
+                    ++it->second.attempts;
+                    // Back off linearly with each retry
+                    it->second.deadline = now + config_.discovery_timeout * it->second.attempts;
+                    send_route_request(it->first);
+                }
+                next = std::min(next, it->second.deadline);
+                ++it;
+            }
+
+            for (auto it = awaiting_acks_.begin(); it != awaiting_acks_.end();) {
+                if (it->second.deadline <= now) {
+                    Address next_hop = it->second.next_hop;
+                    record_link(next_hop, false);
+                    it = awaiting_acks_.erase(it);
+                    if (links_[next_hop].consecutive_failures >= config_.link_failures_before_break) {
+                        break_link(next_hop);
+                    }
+                    continue;
+                }
+                next = std::min(next, it->second.deadline);
+                ++it;
+            }
+
+            for (auto it = seen_floods_.begin(); it != seen_floods_.end();) {
+                it = now - it->second > std::chrono::seconds(30) ? seen_floods_.erase(it) : std::next(it);
+            }
+            for (auto it = routes_.begin(); it != routes_.end();) {
+                it = it->second.expires <= now ? routes_.erase(it) : std::next(it);
+            }
+            return next;
+        }
+
+        inline void maintenance_thread_func() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (running_) {
+                auto next = maintain_routes(std::chrono::steady_clock::now());
+                if (maintenance_wake_.wait_until(lock, next) == std::cv_status::timeout) {
+                    wakeup_[static_cast<size_t>(ThreadRole::maintenance)].record_wakeup(next);
+                }
+            }
+        }
+
+      public:
+        inline explicit LoRaMeshInterface(LoRaInterface *lora, const MeshConfig &config = {})
+            : lora_(lora), config_(config), running_(false) {
+            interface_name_ = "LoRaMesh-" + lora_->get_interface_name();
+        }
+
+        inline ~LoRaMeshInterface() { stop(); }
+
+        inline bool start() override {
+            if (running_) {
+                return true;
+            }
+            if (!lora_->is_connected()) {
+                if (!lora_->start()) {
+                    return false;
+                }
+                owns_start_ = true;
+            }
+            if (!parse(lora_->get_address(), self_)) {
+                return false;
+            }
+            if (config_.single_hop_links) {
+                if (!owns_start_) {
+                    restore_hop_limit_ = lora_->get_hop_limit();
+                }
+                lora_->set_hop_limit(1);
+            }
+
+            lora_->set_message_callback([this](const std::string &message, const std::string &from, uint16_t) {
+                handle_frame(message, from);
+            });
+
+            running_ = true;
+            maintenance_due_ = std::chrono::steady_clock::now();
+            if (threading_ == Threading::threads) {
+                maintenance_thread_ = std::thread(&LoRaMeshInterface::maintenance_thread_func, this);
+                configure_thread(ThreadRole::maintenance, maintenance_thread_, "mesh-routes");
+            }
+            return true;
+        }
+
+        inline void stop() override {
+            if (!running_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_ = false;
+                maintenance_wake_.notify_all();
+            }
+            if (maintenance_thread_.joinable()) {
+                maintenance_thread_.join();
+            }
+            lora_->set_message_callback(nullptr);
+            if (owns_start_) {
+                lora_->stop();
+                owns_start_ = false;
+            } else if (restore_hop_limit_) {
+                lora_->set_hop_limit(*restore_hop_limit_);
+            }
+            restore_hop_limit_.reset();
+        }
+
+        inline bool is_connected() const override { return running_ && lora_->is_connected(); }
+
+        // Polled mode: no route maintenance thread; poll_once drives the radio and the route timers. The radio is
+        // switched along unless it is already running, in which case it keeps whatever mode it was started in.
+        inline bool set_threading(Threading threading) override {
+            if (running_) {
+                std::cerr << interface_name_ << ": set the threading mode before start()" << std::endl;
+                return false;
+            }
+            if (!lora_->is_connected() && !lora_->set_threading(threading)) {
+                return false;
+            }
+            threading_ = threading;
+            return true;
+        }
+
+        inline std::vector<int> get_poll_fds() const override {
+            return threading_ == Threading::polled ? lora_->get_poll_fds() : std::vector<int>{};
+        }
+
+        inline std::chrono::steady_clock::time_point next_deadline() override {
+            if (threading_ != Threading::polled || !running_) {
+                return std::chrono::steady_clock::time_point::max();
+            }
+            auto radio = lora_->next_deadline();
+            std::lock_guard<std::mutex> lock(mutex_);
+            return std::min(maintenance_due_, radio);
+        }
+
+        inline void poll_once(std::chrono::milliseconds timeout) override {
+            if (threading_ != Threading::polled || !running_) {
+                return;
+            }
+            if (timeout.count() > 0) {
+                wait_readable(get_poll_fds(), timeout, next_deadline());
+            }
+            lora_->poll_once(std::chrono::milliseconds(0)); // delivers frames into handle_frame
+            std::lock_guard<std::mutex> lock(mutex_);
+            maintenance_due_ = maintain_routes(std::chrono::steady_clock::now());
+        }
+
+        inline void send_message(const std::string &dest_addr, uint16_t /* dest_port */,
+                                 const std::string &msg) override {
+            Address dest;
+            if (!parse(dest_addr, dest)) {
+                std::cerr << "Invalid IPv6 address: " << dest_addr << std::endl;
+                return;
+            }
+            if (is_broadcast(dest)) {
+                multicast_message(msg);
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            route_or_discover(dest, msg);
+        }
+
+        // Broadcasts are the only application traffic that floods
+        inline void multicast_message(const std::string &msg) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::string frame = header(BCAST);
+            frame.push_back(static_cast<char>(config_.max_hops));
+            uint16_t id = next_flood_id_++;
+            put16(frame, id);
+            put_address(frame, self_);
+            frame += msg;
+            seen_floods_[{self_, id}] = std::chrono::steady_clock::now();
+            broadcast(frame);
+        }
+
+        inline void multicast_to_group(const std::vector<std::string> &dest_addrs, uint16_t dest_port,
+                                       const std::string &msg) override {
+            for (const auto &addr : dest_addrs) {
+                send_message(addr, dest_port, msg);
+            }
+        }
+
+        inline std::string get_address() const override { return lora_->get_address(); }
+        inline uint16_t get_port() const override { return 0; }
+        inline std::string get_interface_name() const override { return interface_name_; }
+
+        inline void set_message_callback(
+            std::function<void(const std::string &, const std::string &, uint16_t)> callback) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            message_callback_ = callback;
+        }
+
+        // Mesh-specific methods
+        inline std::vector<MeshRoute> get_routes() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<MeshRoute> routes;
+            auto now = std::chrono::steady_clock::now();
+            for (const auto &[dest, route] : routes_) {
+                if (route.valid && route.expires > now) {
+                    routes.push_back({format(dest), format(route.next_hop), route.metric, route.hops, route.expires,
+                                      route.seq});
+                }
+            }
+            return routes;
+        }
+
+        inline MeshStats get_stats() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return stats_;
+        }
+
+        // Drop all cached routes (e.g. after the fleet moved)
+        inline void flush_routes() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            routes_.clear();
+        }
+    };
+
+} // namespace impulse
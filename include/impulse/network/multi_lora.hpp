@@ -0,0 +1,400 @@
+#pragma once
+
+#include "impulse/network/lora.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace impulse {
+
+    struct RadioConfig {
+        std::string serial_port;
+        uint32_t frequency_hz;
+        SerialConfig serial = {};
+    };
+
+    enum struct BroadcastPolicy : uint8_t {
+        all_channels = 0, // every radio transmits; reaches peers on any channel
+        least_loaded = 1, // one radio, the one with the shortest transmit queue; for peers that listen everywhere
+        round_robin = 2,  // one radio, rotating
+    };
+
+    struct ChannelStats {
+        std::string serial_port;
+        uint32_t frequency_hz;
+        bool connected;
+        size_t queued;
+        TxStats tx;
+        uint64_t received;
+    };
+
+    // Several melodi radios on different frequencies behaving as one interface with one node address. Unicast goes
+    // out on the channel its peer lives on (assigned, classified or learned from received traffic); a peer not yet
+    // heard from is probed one channel per message, then reached through the default channel. Broadcasts follow
+    // the broadcast policy; everything received on any radio arrives through the one message callback.
+    // Each radio keeps its own transmit scheduler, so radios on separate sub-bands add duty-cycle budget.
+    class MultiLoRaInterface : public NetworkInterface {
+      public:
+        using ChannelClassifier = std::function<std::optional<size_t>(const std::string &dest_addr,
+                                                                      const std::string &msg)>;
+
+      private:
+        std::vector<RadioConfig> configs_;
+        std::vector<std::unique_ptr<LoRaInterface>> radios_;
+        std::vector<std::unique_ptr<std::atomic<uint64_t>>> received_;
+
+        mutable std::mutex channels_mutex_;
+        std::map<std::string, size_t, std::less<>> peer_channels_; // canonical address -> radio index
+        std::map<std::string, size_t, std::less<>> learned_channels_;
+        std::map<std::string, size_t, std::less<>> probes_; // unicasts sent to peers whose channel is unknown
+        std::shared_ptr<const ChannelClassifier> channel_classifier_;
+        size_t default_channel_ = 0;
+        std::atomic<BroadcastPolicy> broadcast_policy_;
+        std::atomic<bool> learn_channels_;
+        size_t next_broadcast_ = 0;
+
+        using MessageCallback = std::function<void(const std::string &, const std::string &, uint16_t)>;
+        mutable std::mutex callback_mutex_;
+        std::shared_ptr<const MessageCallback> callback_; // copied out under the mutex without allocating
+
+        // Canonical form of an address, written to `str`; the address itself if it does not parse
+        inline static std::string_view canonical(const std::string &addr, char (&str)[INET6_ADDRSTRLEN]) {
+            in6_addr bytes;
+            if (inet_pton(AF_INET6, addr.c_str(), &bytes) != 1 ||
+                inet_ntop(AF_INET6, &bytes, str, INET6_ADDRSTRLEN) == nullptr) {
+                return addr;
+            }
+            return str;
+        }
+
+        inline static std::string canonical(const std::string &addr) {
+            char str[INET6_ADDRSTRLEN];
+            return std::string(canonical(addr, str));
+        }
+
+        inline static bool is_broadcast(const std::string &addr) {
+            in6_addr bytes;
+            return inet_pton(AF_INET6, addr.c_str(), &bytes) == 1 &&
+                   std::all_of(bytes.s6_addr, bytes.s6_addr + 16, [](uint8_t b) { return b == 0xFF; });
+        }
+
+        inline size_t least_loaded() const {
+            size_t best = 0;
+            size_t best_queued = SIZE_MAX;
+            std::chrono::microseconds best_airtime = std::chrono::microseconds::max();
+            for (size_t i = 0; i < radios_.size(); ++i) {
+                if (!radios_[i]->is_connected()) {
+                    continue;
+                }
+                size_t queued = radios_[i]->tx_queue_size();
+                auto airtime = radios_[i]->get_tx_stats().airtime;
+                if (queued < best_queued || (queued == best_queued && airtime < best_airtime)) {
+                    best = i;
+                    best_queued = queued;
+                    best_airtime = airtime;
+                }
+            }
+            return best;
+        }
+
+        // Radio for a unicast destination
+        inline size_t channel_for(const std::string &dest_addr, const std::string &msg) {
+            char str[INET6_ADDRSTRLEN];
+            std::string_view addr = canonical(dest_addr, str);
+            std::shared_ptr<const ChannelClassifier> classifier;
+            {
+                std::lock_guard<std::mutex> lock(channels_mutex_);
+                if (auto it = peer_channels_.find(addr); it != peer_channels_.end()) {
+                    return it->second;
+                }
+                classifier = channel_classifier_;
+            }
+            // User code runs unlocked, so it may call back into the interface
+            if (classifier) {
+                auto channel = (*classifier)(std::string(addr), msg);
+                if (channel && *channel < radios_.size()) {
+                    return *channel;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(channels_mutex_);
+            if (auto it = learned_channels_.find(addr); it != learned_channels_.end()) {
+                return it->second;
+            }
+            // Unknown peer: one channel per message, each tried once, until it is heard from; then the default
+            auto probed = probes_.find(addr);
+            if (probed == probes_.end()) {
+                probed = probes_.emplace(std::string(addr), 0).first;
+            }
+            size_t &probes = probed->second;
+            if (probes < radios_.size()) {
+                return (default_channel_ + probes++) % radios_.size();
+            }
+            return default_channel_;
+        }
+
+        inline void on_receive(size_t radio, const std::string &msg, const std::string &from_addr, uint16_t port) {
+            ++*received_[radio];
+            if (learn_channels_) {
+                std::lock_guard<std::mutex> lock(channels_mutex_);
+                learned_channels_[from_addr] = radio;
+                probes_.erase(from_addr);
+            }
+
+            std::shared_ptr<const MessageCallback> callback;
+            {
+                std::lock_guard<std::mutex> lock(callback_mutex_);
+                callback = callback_;
+            }
+            if (callback && *callback) {
+                (*callback)(msg, from_addr, port);
+            }
+        }
+
+      public:
+        inline MultiLoRaInterface(const std::vector<RadioConfig> &radios, const std::string &node_ipv6,
+                                  BroadcastPolicy broadcast_policy = BroadcastPolicy::all_channels)
+            : configs_(radios), broadcast_policy_(broadcast_policy), learn_channels_(true) {
+            if (radios.empty()) {
+                throw std::invalid_argument("MultiLoRaInterface needs at least one radio");
+            }
+
+            address_ = node_ipv6;
+            port_ = 0;
+            interface_name_ = "MultiLoRa";
+            for (const auto &config : configs_) {
+                radios_.push_back(std::make_unique<LoRaInterface>(config.serial_port, node_ipv6, config.serial));
+                received_.push_back(std::make_unique<std::atomic<uint64_t>>(0));
+                interface_name_ += "-" + config.serial_port;
+            }
+        }
+
+        inline ~MultiLoRaInterface() { stop(); }
+
+        // All radios must come up; a partial start is rolled back
+        inline bool start() override {
+            if (running_) {
+                return true;
+            }
+
+            for (size_t i = 0; i < radios_.size(); ++i) {
+                radios_[i]->set_message_callback([this, i](const std::string &msg, const std::string &from,
+                                                           uint16_t port) { on_receive(i, msg, from, port); });
+                if (!radios_[i]->start() || !radios_[i]->set_frequency(configs_[i].frequency_hz)) {
+                    std::cerr << "Failed to bring up LoRa radio " << configs_[i].serial_port << std::endl;
+                    for (size_t j = 0; j <= i; ++j) {
+                        radios_[j]->stop();
+                    }
+                    return false;
+                }
+            }
+
+            running_ = true;
+            std::cout << "Multi-radio LoRa interface started with " << radios_.size() << " radios" << std::endl;
+            return true;
+        }
+
+        inline void stop() override {
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+            for (auto &radio : radios_) {
+                radio->stop();
+            }
+        }
+
+        // Connected while any radio is
+        inline bool is_connected() const override {
+            for (const auto &radio : radios_) {
+                if (radio->is_connected()) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // The radios' buffers come from `resource` from the next start(); channel lookups only allocate for a peer
+        // not seen before
+        inline bool set_memory_resource(std::pmr::memory_resource *resource) override {
+            for (auto &radio : radios_) {
+                if (!radio->set_memory_resource(resource)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Polled mode: every radio is polled; poll_once waits on all their ports at once
+        inline bool set_threading(Threading threading) override {
+            if (running_) {
+                std::cerr << interface_name_ << ": set the threading mode before start()" << std::endl;
+                return false;
+            }
+            for (auto &radio : radios_) {
+                if (!radio->set_threading(threading)) {
+                    return false;
+                }
+            }
+            threading_ = threading;
+            return true;
+        }
+
+        inline std::vector<int> get_poll_fds() const override {
+            std::vector<int> fds;
+            for (const auto &radio : radios_) {
+                auto radio_fds = radio->get_poll_fds();
+                fds.insert(fds.end(), radio_fds.begin(), radio_fds.end());
+            }
+            return fds;
+        }
+
+        inline std::chrono::steady_clock::time_point next_deadline() override {
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            for (auto &radio : radios_) {
+                deadline = std::min(deadline, radio->next_deadline());
+            }
+            return deadline;
+        }
+
+        inline void poll_once(std::chrono::milliseconds timeout) override {
+            if (threading_ != Threading::polled || !running_) {
+                return;
+            }
+            if (timeout.count() > 0) {
+                wait_readable(get_poll_fds(), timeout, next_deadline());
+            }
+            for (auto &radio : radios_) {
+                radio->poll_once(std::chrono::milliseconds(0));
+            }
+        }
+
+        inline void send_message(const std::string &dest_addr, uint16_t dest_port, const std::string &msg) override {
+            if (is_broadcast(dest_addr)) {
+                multicast_message(msg);
+                return;
+            }
+            radios_[channel_for(dest_addr, msg)]->send_message(dest_addr, dest_port, msg);
+        }
+
+        inline void multicast_message(const std::string &msg) override {
+            switch (broadcast_policy_.load()) {
+            case BroadcastPolicy::all_channels:
+                for (auto &radio : radios_) {
+                    radio->multicast_message(msg);
+                }
+                break;
+            case BroadcastPolicy::least_loaded:
+                radios_[least_loaded()]->multicast_message(msg);
+                break;
+            case BroadcastPolicy::round_robin: {
+                size_t radio;
+                {
+                    std::lock_guard<std::mutex> lock(channels_mutex_);
+                    radio = next_broadcast_++ % radios_.size();
+                }
+                radios_[radio]->multicast_message(msg);
+                break;
+            }
+            }
+        }
+
+        inline void multicast_to_group(const std::vector<std::string> &dest_addrs, uint16_t dest_port,
+                                       const std::string &msg) override {
+            for (const auto &addr : dest_addrs) {
+                send_message(addr, dest_port, msg);
+            }
+        }
+
+        inline std::string get_address() const override { return address_; }
+        inline uint16_t get_port() const override { return port_; }
+        inline std::string get_interface_name() const override { return interface_name_; }
+
+        inline void set_message_callback(
+            std::function<void(const std::string &, const std::string &, uint16_t)> callback) override {
+            auto shared = std::make_shared<const MessageCallback>(std::move(callback));
+            std::lock_guard<std::mutex> lock(callback_mutex_);
+            callback_ = std::move(shared);
+        }
+
+        // Channel assignment. Explicit assignments win over the classifier, which wins over learned channels.
+        inline bool assign_peer(const std::string &peer_addr, size_t radio) {
+            if (radio >= radios_.size()) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(channels_mutex_);
+            peer_channels_[canonical(peer_addr)] = radio;
+            return true;
+        }
+
+        inline void unassign_peer(const std::string &peer_addr) {
+            std::lock_guard<std::mutex> lock(channels_mutex_);
+            peer_channels_.erase(canonical(peer_addr));
+        }
+
+        // Map traffic classes to channels, e.g. telemetry on one radio and bulk on another. Return nullopt to fall
+        // through to learned channels.
+        inline void set_channel_classifier(ChannelClassifier classifier) {
+            auto shared = classifier ? std::make_shared<const ChannelClassifier>(std::move(classifier)) : nullptr;
+            std::lock_guard<std::mutex> lock(channels_mutex_);
+            channel_classifier_ = std::move(shared);
+        }
+
+        // Channel for peers that were probed on every channel without answering
+        inline bool set_default_channel(size_t radio) {
+            if (radio >= radios_.size()) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(channels_mutex_);
+            default_channel_ = radio;
+            return true;
+        }
+
+        // Remember which radio each peer was last heard on and use it for replies
+        inline void set_channel_learning(bool enabled) {
+            std::lock_guard<std::mutex> lock(channels_mutex_);
+            learn_channels_ = enabled;
+            if (!enabled) {
+                learned_channels_.clear();
+            }
+        }
+
+        inline void set_broadcast_policy(BroadcastPolicy policy) { broadcast_policy_ = policy; }
+
+        inline bool set_frequency(size_t radio, uint32_t frequency_hz) {
+            if (radio >= radios_.size() || !radios_[radio]->set_frequency(frequency_hz)) {
+                return false;
+            }
+            configs_[radio].frequency_hz = frequency_hz;
+            return true;
+        }
+
+        inline size_t radio_count() const { return radios_.size(); }
+
+        // Direct access for per-radio settings (tx power, scheduler limits, FEC, ...)
+        inline LoRaInterface &radio(size_t index) { return *radios_.at(index); }
+
+        inline std::vector<ChannelStats> get_channel_stats() const {
+            std::vector<ChannelStats> stats;
+            for (size_t i = 0; i < radios_.size(); ++i) {
+                stats.push_back({configs_[i].serial_port, configs_[i].frequency_hz, radios_[i]->is_connected(),
+                                 radios_[i]->tx_queue_size(), radios_[i]->get_tx_stats(), received_[i]->load()});
+            }
+            return stats;
+        }
+    };
+
+} // namespace impulse
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace impulse {
+
+    struct Neighbor {
+        std::string address;
+        uint8_t hop_count = 1;
+        std::optional<int16_t> rssi_dbm; // as reported by the firmware, when it reports it
+        std::optional<int8_t> snr_db;
+        std::chrono::steady_clock::time_point last_heard;
+        uint32_t frames_heard = 0; // frames received from this node by the host
+    };
+
+    // Immutable snapshot handed to readers
+    struct NeighborTable {
+        std::vector<Neighbor> entries; // sorted by address
+        std::chrono::steady_clock::time_point updated;
+
+        inline const Neighbor *find(const std::string &address) const {
+            auto it = std::lower_bound(entries.begin(), entries.end(), address,
+                                       [](const Neighbor &n, const std::string &a) { return n.address < a; });
+            return it != entries.end() && it->address == address ? &*it : nullptr;
+        }
+    };
+
+    // Neighbour state merged from firmware reports and frames the host sees. Writers update a private map under a
+    // mutex and publish copies; readers only load the published snapshot and never wait for a table to be rebuilt.
+    // The load itself is not lock-free: libstdc++ implements std::atomic<std::shared_ptr> with a lock bit in the
+    // pointer, held for the reference count update, so a reader may spin briefly against publish() or another
+    // reader. That bounds the wait to a few instructions, but it is not wait-free.
+    class NeighborCache {
+      private:
+        std::map<std::string, Neighbor, std::less<>> working_;
+        std::mutex mutex_;
+        bool dirty_ = false;
+        std::atomic<std::shared_ptr<const NeighborTable>> snapshot_;
+        std::chrono::seconds expiry_;
+
+      public:
+        inline explicit NeighborCache(std::chrono::seconds expiry = std::chrono::minutes(5))
+            : snapshot_(std::make_shared<const NeighborTable>()), expiry_(expiry) {}
+
+        inline void set_expiry(std::chrono::seconds expiry) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            expiry_ = expiry;
+        }
+
+        // Entry reported by the firmware. `heard_ago` is how long ago the radio last heard the node.
+        inline void report(const std::string &address, uint8_t hop_count, std::optional<int16_t> rssi_dbm,
+                           std::optional<int8_t> snr_db, std::chrono::seconds heard_ago) {
+            auto heard = std::chrono::steady_clock::now() - heard_ago;
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto &neighbor = working_[address];
+            neighbor.address = address;
+            neighbor.hop_count = hop_count;
+            if (rssi_dbm) {
+                neighbor.rssi_dbm = rssi_dbm;
+            }
+            if (snr_db) {
+                neighbor.snr_db = snr_db;
+            }
+            neighbor.last_heard = std::max(neighbor.last_heard, heard);
+            dirty_ = true;
+        }
+
+        // A frame from `address` reached the host. Cheap: only touches the working map, and only allocates for a
+        // node it has not heard yet.
+        inline void observe(std::string_view address) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = working_.find(address);
+            if (it == working_.end()) {
+                it = working_.emplace(std::string(address), Neighbor{}).first;
+                it->second.address = it->first;
+                it->second.hop_count = 0; // unknown until the firmware reports it
+            }
+            auto &neighbor = it->second;
+            neighbor.last_heard = std::chrono::steady_clock::now();
+            ++neighbor.frames_heard;
+            dirty_ = true;
+        }
+
+        // Drop stale entries and publish a new snapshot if anything changed
+        inline void publish() {
+            auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = working_.begin(); it != working_.end();) {
+                if (now - it->second.last_heard > expiry_) {
+                    it = working_.erase(it);
+                    dirty_ = true;
+                } else {
+                    ++it;
+                }
+            }
+            if (!dirty_) {
+                return;
+            }
+
+            auto table = std::make_shared<NeighborTable>();
+            table->entries.reserve(working_.size());
+            for (const auto &[address, neighbor] : working_) {
+                table->entries.push_back(neighbor);
+            }
+            table->updated = now;
+            snapshot_.store(std::move(table));
+            dirty_ = false;
+        }
+
+        inline std::shared_ptr<const NeighborTable> snapshot() const { return snapshot_.load(); }
+    };
+
+} // namespace impulse
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <poll.h>
+#include <vector>
+
+namespace impulse {
+
+    // How a component does its work: on threads of its own, or only when the application calls poll_once
+    enum class Threading { threads, polled };
+
+    // A component an application event loop can drive instead of its own threads: wait until one of the
+    // descriptors is readable or the deadline passes, then call poll_once with a zero timeout
+    class Pollable {
+      public:
+        virtual ~Pollable() = default;
+
+        // Descriptors to watch for POLLIN
+        virtual std::vector<int> get_poll_fds() const { return {}; }
+
+        // When timers are next due; time_point::max() when nothing is scheduled
+        virtual std::chrono::steady_clock::time_point next_deadline() {
+            return std::chrono::steady_clock::time_point::max();
+        }
+
+        // Wait up to `timeout` for input or the deadline, then do everything that is due without blocking further
+        virtual void poll_once(std::chrono::milliseconds timeout) = 0;
+    };
+
+    // Block until one of `fds` is readable, `deadline` passes or `timeout` runs out; poll() result
+    inline int wait_readable(const std::vector<int> &fds, std::chrono::milliseconds timeout,
+                             std::chrono::steady_clock::time_point deadline) {
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            auto until_deadline = std::chrono::ceil<std::chrono::milliseconds>(deadline -
+                                                                               std::chrono::steady_clock::now());
+            timeout = std::clamp(until_deadline, std::chrono::milliseconds(0), timeout);
+        }
+        std::vector<struct pollfd> pfds;
+        pfds.reserve(fds.size());
+        for (int fd : fds) {
+            pfds.push_back({fd, POLLIN, 0});
+        }
+        return poll(pfds.data(), pfds.size(), static_cast<int>(timeout.count()));
+    }
+
+    // Drives a set of polled interfaces and transports from the calling thread. It is pollable itself, so an
+    // application with its own loop can register get_poll_fds() there and call poll_once(0) when they fire.
+    class Poller : public Pollable {
+      private:
+        std::vector<Pollable *> items_;
+
+      public:
+        inline void add(Pollable *item) {
+            if (std::find(items_.begin(), items_.end(), item) == items_.end()) {
+                items_.push_back(item);
+            }
+        }
+
+        inline void remove(Pollable *item) {
+            items_.erase(std::remove(items_.begin(), items_.end(), item), items_.end());
+        }
+
+        inline std::vector<int> get_poll_fds() const override {
+            std::vector<int> fds;
+            for (const auto *item : items_) {
+                auto item_fds = item->get_poll_fds();
+                fds.insert(fds.end(), item_fds.begin(), item_fds.end());
+            }
+            return fds;
+        }
+
+        inline std::chrono::steady_clock::time_point next_deadline() override {
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            for (auto *item : items_) {
+                deadline = std::min(deadline, item->next_deadline());
+            }
+            return deadline;
+        }
+
+        // One pass of the loop: a single wait over every descriptor, then each component does its due work
+        inline void poll_once(std::chrono::milliseconds timeout) override {
+            wait_readable(get_poll_fds(), timeout, next_deadline());
+            for (auto *item : items_) {
+                item->poll_once(std::chrono::milliseconds(0));
+            }
+        }
+    };
+
+} // namespace impulse
@@ -0,0 +1,601 @@
+#pragma once
+
+#include "impulse/network/interface.hpp"
+
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace impulse {
+
+    using MacAddress = std::array<uint8_t, 6>;
+
+    struct RawConfig {
+        uint16_t ethertype = 0x88B5;  // IEEE 802 local experimental EtherType 1
+        uint32_t block_size = 1 << 16; // RX ring block, a multiple of the page size
+        uint32_t block_count = 32;
+        std::chrono::milliseconds block_timeout = std::chrono::milliseconds(2); // hand over partly filled blocks
+        uint32_t tx_frame_size = 2048;
+        uint32_t tx_frame_count = 256;
+        bool qdisc_bypass = true; // frames go straight to the driver; no traffic shaping on this interface
+    };
+
+    struct RawStats {
+        uint64_t frames_sent = 0;
+        uint64_t frames_received = 0;
+        uint64_t blocks_received = 0; // RX wake-ups; frames_received / blocks_received is the batching factor
+        uint64_t tx_kicks = 0;        // send() calls that flushed the TX ring
+        uint64_t tx_ring_full = 0;    // frames dropped because the TX ring stayed full
+        uint64_t rx_dropped = 0;      // frames the kernel dropped because the RX ring was full
+        uint64_t oversized = 0;       // messages larger than the interface MTU allows
+    };
+
+    // Impulse messages directly in Ethernet frames on one segment, without IP or UDP, through AF_PACKET with
+    // TPACKET_V3 memory-mapped rings. Nodes keep their IPv6 identities: every frame carries the sender's address,
+    // receivers learn which MAC each address lives at, and unicast to a peer not learned yet is broadcast with the
+    // destination address in the header. Needs CAP_NET_RAW; works on any Ethernet-like link, veth included.
+    //
+    //   [Ethernet: dst MAC][src MAC][ethertype] [version:1][flags:1][port:2][length:2][src IPv6:16][dst IPv6:16]?
+    class RawEthernetInterface : public NetworkInterface {
+      public:
+        static constexpr uint8_t VERSION = 1;
+        static constexpr uint8_t FLAG_DEST = 0x01; // destination IPv6 present: unicast sent to the broadcast MAC
+        static constexpr size_t HEADER_SIZE = 22;
+        static constexpr size_t DEST_SIZE = 16;
+
+      private:
+        RawConfig config_;
+        int fd_ = -1;
+        int ifindex_ = 0;
+        size_t mtu_ = 1500;
+        MacAddress mac_{};
+        in6_addr ipv6_{};
+
+        uint8_t *ring_ = nullptr;
+        size_t ring_size_ = 0;
+        uint8_t *tx_ring_ = nullptr;
+        uint32_t rx_block_ = 0;
+        uint32_t tx_frame_ = 0;
+
+        std::thread receive_thread_;
+        std::atomic<bool> receiving_{false}; // read by the receive thread; running_ belongs to the caller
+        std::mutex callback_mutex_;
+        // Snapshots the receive thread copies per frame; copying a shared_ptr never allocates, a std::function may
+        using MessageCallback = std::function<void(const std::string &, const std::string &, uint16_t)>;
+        std::shared_ptr<const MessageCallback> callback_;
+        std::shared_ptr<const std::function<void()>> batch_end_;
+        std::string recv_message_; // keep their capacity from frame to frame
+        std::string recv_addr_;
+
+        std::mutex tx_mutex_;
+        std::atomic<int> tx_held_{0};
+        bool tx_pending_ = false;
+
+        mutable std::mutex neighbors_mutex_;
+        std::map<std::string, MacAddress, std::less<>> neighbors_; // canonical IPv6 -> MAC, learned from traffic
+        std::map<std::string, MacAddress, std::less<>> pinned_;    // add_neighbor(); never overwritten by learning
+
+        std::mutex stats_mutex_;
+        RawStats stats_;
+
+        inline static constexpr MacAddress BROADCAST_MAC = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+        inline static std::string to_string(const in6_addr &addr) {
+            char str[INET6_ADDRSTRLEN];
+            inet_ntop(AF_INET6, &addr, str, sizeof(str));
+            return str;
+        }
+
+        inline bool open_socket() {
+            fd_ = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(config_.ethertype));
+            if (fd_ < 0) {
+                std::cerr << "Failed to open packet socket on " << interface_name_ << ": " << strerror(errno)
+                          << " (needs CAP_NET_RAW)" << std::endl;
+                return false;
+            }
+
+            struct ifreq ifr = {};
+            strncpy(ifr.ifr_name, interface_name_.c_str(), IFNAMSIZ - 1);
+            if (ioctl(fd_, SIOCGIFINDEX, &ifr) < 0) {
+                std::cerr << "No such interface " << interface_name_ << std::endl;
+                return false;
+            }
+            ifindex_ = ifr.ifr_ifindex;
+            if (ioctl(fd_, SIOCGIFHWADDR, &ifr) < 0) {
+                std::cerr << "Failed to read MAC of " << interface_name_ << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            memcpy(mac_.data(), ifr.ifr_hwaddr.sa_data, mac_.size());
+            if (ioctl(fd_, SIOCGIFMTU, &ifr) == 0) {
+                mtu_ = static_cast<size_t>(ifr.ifr_mtu);
+            }
+
+            int version = TPACKET_V3;
+            if (setsockopt(fd_, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+                std::cerr << "TPACKET_V3 not supported: " << strerror(errno) << std::endl;
+                return false;
+            }
+            // Our own transmissions are not looped back into the RX ring
+            int ignore = 1;
+            setsockopt(fd_, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore, sizeof(ignore));
+            if (config_.qdisc_bypass) {
+                int bypass = 1;
+                setsockopt(fd_, SOL_PACKET, PACKET_QDISC_BYPASS, &bypass, sizeof(bypass));
+            }
+
+            struct tpacket_req3 rx = {};
+            rx.tp_block_size = config_.block_size;
+            rx.tp_block_nr = config_.block_count;
+            rx.tp_frame_size = 2048;
+            rx.tp_frame_nr = (config_.block_size / rx.tp_frame_size) * config_.block_count;
+            rx.tp_retire_blk_tov = static_cast<unsigned int>(config_.block_timeout.count());
+            if (setsockopt(fd_, SOL_PACKET, PACKET_RX_RING, &rx, sizeof(rx)) < 0) {
+                std::cerr << "Failed to set up RX ring: " << strerror(errno) << std::endl;
+                return false;
+            }
+
+            struct tpacket_req3 tx = {};
+            tx.tp_frame_size = config_.tx_frame_size;
+            tx.tp_frame_nr = config_.tx_frame_count;
+            tx.tp_block_size = config_.block_size;
+            tx.tp_block_nr = (config_.tx_frame_size * config_.tx_frame_count + config_.block_size - 1) /
+                             config_.block_size;
+            tx.tp_frame_nr = tx.tp_block_nr * (config_.block_size / config_.tx_frame_size);
+            if (setsockopt(fd_, SOL_PACKET, PACKET_TX_RING, &tx, sizeof(tx)) < 0) {
+                std::cerr << "Failed to set up TX ring: " << strerror(errno) << std::endl;
+                return false;
+            }
+            config_.tx_frame_count = tx.tp_frame_nr;
+
+            // One mapping: the RX ring followed by the TX ring
+            size_t rx_size = static_cast<size_t>(rx.tp_block_size) * rx.tp_block_nr;
+            ring_size_ = rx_size + static_cast<size_t>(tx.tp_block_size) * tx.tp_block_nr;
+            void *ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd_, 0);
+            if (ring == MAP_FAILED) {
+                ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            }
+            if (ring == MAP_FAILED) {
+                std::cerr << "Failed to map packet rings: " << strerror(errno) << std::endl;
+                return false;
+            }
+            ring_ = static_cast<uint8_t *>(ring);
+            tx_ring_ = ring_ + rx_size;
+
+            struct sockaddr_ll addr = {};
+            addr.sll_family = AF_PACKET;
+            addr.sll_protocol = htons(config_.ethertype);
+            addr.sll_ifindex = ifindex_;
+            if (bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+                std::cerr << "Failed to bind packet socket to " << interface_name_ << ": " << strerror(errno)
+                          << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        inline void close_socket() {
+            if (ring_) {
+                munmap(ring_, ring_size_);
+                ring_ = tx_ring_ = nullptr;
+            }
+            if (fd_ >= 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+
+        inline void handle_frame(const uint8_t *frame, size_t size) {
+            if (size < ETH_HLEN + HEADER_SIZE) {
+                return;
+            }
+            const uint8_t *header = frame + ETH_HLEN;
+            uint8_t flags = header[1];
+            uint16_t port = (header[2] << 8) | header[3];
+            size_t length = (header[4] << 8) | header[5];
+            size_t offset = ETH_HLEN + HEADER_SIZE + ((flags & FLAG_DEST) ? DEST_SIZE : 0);
+            if (header[0] != VERSION || offset + length > size || port != port_) {
+                return;
+            }
+            if ((flags & FLAG_DEST) && memcmp(header + HEADER_SIZE, &ipv6_, DEST_SIZE) != 0) {
+                return; // unicast for another node, flooded because its MAC was not known yet
+            }
+
+            char from[INET6_ADDRSTRLEN];
+            inet_ntop(AF_INET6, header + 6, from, sizeof(from));
+            {
+                MacAddress mac;
+                memcpy(mac.data(), frame + ETH_ALEN, mac.size());
+                std::lock_guard<std::mutex> lock(neighbors_mutex_);
+                if (pinned_.find(std::string_view(from)) == pinned_.end()) {
+                    auto it = neighbors_.find(std::string_view(from));
+                    if (it == neighbors_.end()) {
+                        neighbors_.emplace(from, mac);
+                    } else {
+                        it->second = mac;
+                    }
+                }
+            }
+
+            std::shared_ptr<const MessageCallback> callback;
+            {
+                std::lock_guard<std::mutex> lock(callback_mutex_);
+                callback = callback_;
+            }
+            if (callback && *callback) {
+                recv_message_.assign(reinterpret_cast<const char *>(frame + offset), length);
+                recv_addr_.assign(from);
+                (*callback)(recv_message_, recv_addr_, port);
+            }
+        }
+
+        // Hand the next filled block of the RX ring to handle_frame, then back to the kernel; false if none is ready
+        inline bool receive_block() {
+            auto *block = reinterpret_cast<tpacket_block_desc *>(ring_ + size_t(rx_block_) * config_.block_size);
+            if (!(block->hdr.bh1.block_status & TP_STATUS_USER)) {
+                return false;
+            }
+
+            uint32_t count = block->hdr.bh1.num_pkts;
+            auto *packet = reinterpret_cast<tpacket3_hdr *>(reinterpret_cast<uint8_t *>(block) +
+                                                             block->hdr.bh1.offset_to_first_pkt);
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            for (uint32_t i = 0; i < count; ++i) {
+                // Time from the kernel receiving the frame to us handling it, block retirement included
+                wakeup_[static_cast<size_t>(ThreadRole::receive)].record(std::chrono::nanoseconds(
+                    (now.tv_sec - int64_t(packet->tp_sec)) * 1000000000LL + (now.tv_nsec - int64_t(packet->tp_nsec))));
+                handle_frame(reinterpret_cast<const uint8_t *>(packet) + packet->tp_mac, packet->tp_snaplen);
+                packet = reinterpret_cast<tpacket3_hdr *>(reinterpret_cast<uint8_t *>(packet) +
+                                                         packet->tp_next_offset);
+            }
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.frames_received += count;
+                ++stats_.blocks_received;
+            }
+            __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            rx_block_ = (rx_block_ + 1) % config_.block_count;
+
+            std::shared_ptr<const std::function<void()>> batch_end;
+            {
+                std::lock_guard<std::mutex> lock(callback_mutex_);
+                batch_end = batch_end_;
+            }
+            if (batch_end && *batch_end) {
+                (*batch_end)();
+            }
+            return true;
+        }
+
+        // One poll per block
+        inline void receive_loop() {
+            while (receiving_) {
+                if (!receive_block()) {
+                    struct pollfd pfd = {fd_, POLLIN | POLLERR, 0};
+                    poll(&pfd, 1, 100);
+                }
+            }
+        }
+
+        // Ask the kernel to transmit everything marked in the TX ring; tx_mutex_ held
+        inline void kick() {
+            if (!tx_pending_) {
+                return;
+            }
+            tx_pending_ = false;
+            if (send(fd_, nullptr, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != ENOBUFS) {
+                std::cerr << "Raw Ethernet send on " << interface_name_ << " failed: " << strerror(errno)
+                          << std::endl;
+            }
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            ++stats_.tx_kicks;
+        }
+
+        inline tpacket3_hdr *tx_slot(uint32_t index) {
+            return reinterpret_cast<tpacket3_hdr *>(tx_ring_ + size_t(index) * config_.tx_frame_size);
+        }
+
+        // Place one frame in the TX ring; transmitted on the next kick
+        inline void queue_frame(const MacAddress &dest_mac, const in6_addr *dest_ip, uint16_t port,
+                                const std::string &msg) {
+            size_t header = HEADER_SIZE + (dest_ip ? DEST_SIZE : 0);
+            size_t room = config_.tx_frame_size - TPACKET3_HDRLEN + sizeof(sockaddr_ll) - ETH_HLEN;
+            if (msg.size() + header > std::min(mtu_, room)) {
+                std::cerr << "Raw Ethernet message of " << msg.size() << " bytes exceeds the MTU of "
+                          << interface_name_ << std::endl;
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                ++stats_.oversized;
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(tx_mutex_);
+            if (fd_ < 0) {
+                return;
+            }
+            tpacket3_hdr *slot = tx_slot(tx_frame_);
+            if (__atomic_load_n(&slot->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+                // Ring full: flush what is queued and give the kernel a moment to drain it
+                tx_pending_ = true;
+                kick();
+                struct pollfd pfd = {fd_, POLLOUT, 0};
+                poll(&pfd, 1, 10);
+                if (__atomic_load_n(&slot->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+                    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+                    ++stats_.tx_ring_full;
+                    return;
+                }
+            }
+
+            uint8_t *frame = reinterpret_cast<uint8_t *>(slot) + TPACKET3_HDRLEN - sizeof(sockaddr_ll);
+            memcpy(frame, dest_mac.data(), ETH_ALEN);
+            memcpy(frame + ETH_ALEN, mac_.data(), ETH_ALEN);
+            frame[12] = static_cast<uint8_t>(config_.ethertype >> 8);
+            frame[13] = static_cast<uint8_t>(config_.ethertype & 0xFF);
+            uint8_t *out = frame + ETH_HLEN;
+            out[0] = VERSION;
+            out[1] = dest_ip ? FLAG_DEST : 0;
+            out[2] = static_cast<uint8_t>(port >> 8);
+            out[3] = static_cast<uint8_t>(port & 0xFF);
+            out[4] = static_cast<uint8_t>(msg.size() >> 8);
+            out[5] = static_cast<uint8_t>(msg.size() & 0xFF);
+            memcpy(out + 6, &ipv6_, sizeof(ipv6_));
+            if (dest_ip) {
+                memcpy(out + HEADER_SIZE, dest_ip, DEST_SIZE);
+            }
+            memcpy(out + header, msg.data(), msg.size());
+
+            slot->tp_len = static_cast<uint32_t>(ETH_HLEN + header + msg.size());
+            slot->tp_next_offset = 0;
+            __atomic_store_n(&slot->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+            tx_frame_ = (tx_frame_ + 1) % config_.tx_frame_count;
+            tx_pending_ = true;
+            {
+                std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+                ++stats_.frames_sent;
+            }
+            if (tx_held_ == 0) {
+                kick();
+            }
+        }
+
+        inline void send_to(const std::string &dest_addr, uint16_t dest_port, const std::string &msg) {
+            in6_addr dest;
+            if (inet_pton(AF_INET6, dest_addr.c_str(), &dest) != 1) {
+                std::cerr << address_ << ": Invalid destination address " << dest_addr << std::endl;
+                return;
+            }
+            MacAddress mac;
+            bool known;
+            {
+                char canonical[INET6_ADDRSTRLEN];
+                inet_ntop(AF_INET6, &dest, canonical, sizeof(canonical));
+                std::lock_guard<std::mutex> lock(neighbors_mutex_);
+                auto pinned = pinned_.find(std::string_view(canonical));
+                auto learned = neighbors_.find(std::string_view(canonical));
+                known = pinned != pinned_.end() || learned != neighbors_.end();
+                if (known) {
+                    mac = pinned != pinned_.end() ? pinned->second : learned->second;
+                }
+            }
+            if (known) {
+                queue_frame(mac, nullptr, dest_port, msg);
+            } else {
+                queue_frame(BROADCAST_MAC, &dest, dest_port, msg);
+            }
+        }
+
+      public:
+        // Holds transmissions while alive and sends everything queued meanwhile with one system call
+        class Batch {
+          private:
+            RawEthernetInterface *interface_;
+
+          public:
+            inline explicit Batch(RawEthernetInterface *interface) : interface_(interface) { ++interface_->tx_held_; }
+            inline ~Batch() {
+                if (--interface_->tx_held_ == 0) {
+                    interface_->flush();
+                }
+            }
+            Batch(const Batch &) = delete;
+            Batch &operator=(const Batch &) = delete;
+        };
+
+        inline RawEthernetInterface(const std::string &interface, const std::string &node_ipv6, uint16_t port = 7447,
+                                    const RawConfig &config = {})
+            : config_(config) {
+            interface_name_ = interface;
+            port_ = port;
+            if (inet_pton(AF_INET6, node_ipv6.c_str(), &ipv6_) != 1) {
+                throw std::invalid_argument("Invalid IPv6 address: " + node_ipv6);
+            }
+            address_ = to_string(ipv6_);
+        }
+
+        inline ~RawEthernetInterface() { stop(); }
+
+        inline bool start() override {
+            if (running_) {
+                return true;
+            }
+            if (!open_socket()) {
+                close_socket();
+                return false;
+            }
+            rx_block_ = 0;
+            tx_frame_ = 0;
+            recv_message_.reserve(mtu_);
+            recv_addr_.reserve(INET6_ADDRSTRLEN);
+            running_ = true;
+            if (threading_ == Threading::threads) {
+                receiving_ = true;
+                receive_thread_ = std::thread(&RawEthernetInterface::receive_loop, this);
+                configure_thread(ThreadRole::receive, receive_thread_, "raw-rx");
+            }
+
+            char mac[18];
+            snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x", mac_[0], mac_[1], mac_[2], mac_[3], mac_[4],
+                     mac_[5]);
+            std::cout << "Raw Ethernet interface started on " << interface_name_ << " (" << mac << ", EtherType 0x"
+                      << std::hex << config_.ethertype << std::dec << ") with IPv6: " << address_ << std::endl;
+            return true;
+        }
+
+        inline void stop() override {
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+            receiving_ = false;
+            if (receive_thread_.joinable()) {
+                receive_thread_.join();
+            }
+            std::lock_guard<std::mutex> lock(tx_mutex_);
+            close_socket();
+        }
+
+        inline bool is_connected() const override { return running_ && fd_ >= 0; }
+
+        // Frames live in the mapped rings and the buffers handed to the callback keep their capacity, so there is
+        // nothing to take from a resource
+        inline bool set_memory_resource(std::pmr::memory_resource *) override { return true; }
+
+        // Polled mode: no receive thread; ring blocks are handed over from poll_once on the caller's thread. A
+        // block that is not full becomes readable after config.block_timeout.
+        inline bool set_threading(Threading threading) override {
+            if (running_) {
+                std::cerr << interface_name_ << ": set the threading mode before start()" << std::endl;
+                return false;
+            }
+            threading_ = threading;
+            return true;
+        }
+
+        inline std::vector<int> get_poll_fds() const override {
+            if (threading_ != Threading::polled || fd_ < 0) {
+                return {};
+            }
+            return {fd_};
+        }
+
+        inline void poll_once(std::chrono::milliseconds timeout) override {
+            if (threading_ != Threading::polled || !running_) {
+                return;
+            }
+            if (timeout.count() > 0 && wait_readable(get_poll_fds(), timeout, next_deadline()) <= 0) {
+                return;
+            }
+            // Bounded by the ring, so a busy link cannot hold the caller indefinitely
+            for (uint32_t i = 0; i < config_.block_count && receive_block(); ++i) {
+            }
+        }
+
+        inline void send_message(const std::string &dest_addr, uint16_t dest_port, const std::string &msg) override {
+            send_to(dest_addr, dest_port, msg);
+        }
+
+        inline void multicast_message(const std::string &msg) override {
+            queue_frame(BROADCAST_MAC, nullptr, port_, msg);
+        }
+
+        inline void multicast_to_group(const std::vector<std::string> &dest_addrs, uint16_t dest_port,
+                                       const std::string &msg) override {
+            Batch batch(this);
+            for (const auto &addr : dest_addrs) {
+                send_to(addr, dest_port, msg);
+            }
+        }
+
+        inline std::string get_address() const override { return address_; }
+        inline uint16_t get_port() const override { return port_; }
+        inline std::string get_interface_name() const override { return interface_name_; }
+
+        inline void set_message_callback(
+            std::function<void(const std::string &, const std::string &, uint16_t)> callback) override {
+            auto snapshot = std::make_shared<const MessageCallback>(callback);
+            std::lock_guard<std::mutex> lock(callback_mutex_);
+            message_callback_ = callback;
+            callback_ = std::move(snapshot);
+        }
+
+        inline void set_batch_end_callback(std::function<void()> callback) override {
+            auto snapshot = std::make_shared<const std::function<void()>>(callback);
+            std::lock_guard<std::mutex> lock(callback_mutex_);
+            batch_end_callback_ = callback;
+            batch_end_ = std::move(snapshot);
+        }
+
+        // Queue frames without sending until the returned batch goes out of scope
+        inline Batch batch() { return Batch(this); }
+
+        inline void flush() {
+            std::lock_guard<std::mutex> lock(tx_mutex_);
+            if (fd_ >= 0) {
+                kick();
+            }
+        }
+
+        // Pin a peer to a MAC instead of learning it from traffic; frames from the address seen at another MAC do
+        // not move it
+        inline bool add_neighbor(const std::string &ipv6, const MacAddress &mac) {
+            in6_addr addr;
+            if (inet_pton(AF_INET6, ipv6.c_str(), &addr) != 1) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(neighbors_mutex_);
+            pinned_[to_string(addr)] = mac;
+            return true;
+        }
+
+        // Learned and pinned peers; a pinned MAC wins over a learned one
+        inline std::map<std::string, MacAddress> get_neighbors() const {
+            std::lock_guard<std::mutex> lock(neighbors_mutex_);
+            std::map<std::string, MacAddress> neighbors(neighbors_.begin(), neighbors_.end());
+            for (const auto &[address, mac] : pinned_) {
+                neighbors[address] = mac;
+            }
+            return neighbors;
+        }
+
+        inline MacAddress get_mac() const { return mac_; }
+
+        inline RawStats get_stats() {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            if (fd_ >= 0) {
+                // Reading the kernel counters resets them, so they are accumulated here
+                struct tpacket_stats_v3 kernel = {};
+                socklen_t len = sizeof(kernel);
+                if (getsockopt(fd_, SOL_PACKET, PACKET_STATISTICS, &kernel, &len) == 0) {
+                    stats_.rx_dropped += kernel.tp_drops;
+                }
+            }
+            return stats_;
+        }
+    };
+
+} // namespace impulse
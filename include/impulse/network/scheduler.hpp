@@ -0,0 +1,474 @@
+#pragma once
+
+#include "impulse/util/memory.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace impulse {
+
+    // LoRa modulation parameters, used to compute time on air
+    struct LoRaModulation {
+        uint8_t spreading_factor = 7;   // 7..12
+        uint32_t bandwidth_hz = 125000; // 125000, 250000, 500000
+        uint8_t coding_rate = 1;        // 1..4 => 4/5..4/8
+        uint16_t preamble_symbols = 8;
+        bool explicit_header = true;
+        bool crc = true;
+        uint16_t frame_overhead = 4; // bytes the firmware adds on air besides addresses (length, flags, ...)
+
+        inline bool low_data_rate_optimize() const {
+            // Mandated when a symbol lasts 16 ms or more (SF11/SF12 at 125 kHz)
+            return (double(1u << spreading_factor) / bandwidth_hz) >= 0.016;
+        }
+
+        // Semtech SX127x time-on-air formula (AN1200.13)
+        inline std::chrono::microseconds time_on_air(size_t payload_bytes) const {
+            double symbol_time = double(1u << spreading_factor) / bandwidth_hz;
+            double preamble_time = (preamble_symbols + 4.25) * symbol_time;
+
+            double bits = 8.0 * (payload_bytes + frame_overhead) - 4.0 * spreading_factor + 28 + (crc ? 16 : 0) -
+                          (explicit_header ? 0 : 20);
+            double divisor = 4.0 * (spreading_factor - (low_data_rate_optimize() ? 2 : 0));
+            double payload_symbols = 8 + std::max(std::ceil(bits / divisor) * (coding_rate + 4), 0.0);
+
+            return std::chrono::microseconds(
+                static_cast<int64_t>(std::ceil((preamble_time + payload_symbols * symbol_time) * 1e6)));
+        }
+    };
+
+    // Regulatory sub-band with its duty-cycle limit
+    struct SubBand {
+        uint32_t low_hz;
+        uint32_t high_hz;
+        double duty_cycle; // fraction of time the transmitter may be on, e.g. 0.01 for 1 %
+    };
+
+    struct RegionalLimits {
+        std::vector<SubBand> sub_bands;
+        double default_duty_cycle = 1.0;                     // frequencies outside every listed sub-band
+        std::chrono::seconds window = std::chrono::hours(1); // duty cycle observation window
+
+        // ETSI EN 300 220 sub-bands for the 863-870 MHz SRD band
+        inline static RegionalLimits eu868() {
+            return {{{863000000, 865000000, 0.001},
+                     {865000000, 868000000, 0.01},
+                     {868000000, 868600000, 0.01},
+                     {868700000, 869200000, 0.001},
+                     {869400000, 869650000, 0.1},
+                     {869700000, 870000000, 0.01}},
+                    0.01,
+                    std::chrono::hours(1)};
+        }
+
+        // No duty cycle limits (e.g. US915, or a lab setup); pacing still applies
+        inline static RegionalLimits unrestricted() { return {{}, 1.0, std::chrono::hours(1)}; }
+
+        // Index into sub_bands, or -1 for the default band
+        inline int sub_band_of(uint32_t frequency_hz) const {
+            for (size_t i = 0; i < sub_bands.size(); ++i) {
+                if (frequency_hz >= sub_bands[i].low_hz && frequency_hz < sub_bands[i].high_hz) {
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        }
+
+        inline double duty_cycle_of(int sub_band) const {
+            return sub_band < 0 ? default_duty_cycle : sub_bands[sub_band].duty_cycle;
+        }
+    };
+
+    // Token bucket measured in airtime: refills at `rate` seconds of airtime per second, up to `burst`
+    class TokenBucket {
+      private:
+        double rate_;
+        double capacity_us_;
+        double tokens_us_;
+        std::chrono::steady_clock::time_point last_refill_;
+
+      public:
+        inline TokenBucket(double rate = 1.0, std::chrono::microseconds burst = std::chrono::seconds(2))
+            : rate_(rate), capacity_us_(double(burst.count())), tokens_us_(double(burst.count())),
+              last_refill_(std::chrono::steady_clock::now()) {}
+
+        inline void configure(double rate, std::chrono::microseconds burst) {
+            rate_ = rate;
+            capacity_us_ = double(burst.count());
+            tokens_us_ = std::min(tokens_us_, capacity_us_);
+        }
+
+        inline void refill(std::chrono::steady_clock::time_point now) {
+            if (now > last_refill_) {
+                double elapsed_us = std::chrono::duration<double, std::micro>(now - last_refill_).count();
+                tokens_us_ = std::min(capacity_us_, tokens_us_ + elapsed_us * rate_);
+            }
+            last_refill_ = now;
+        }
+
+        // Time until `cost` tokens are available (zero if they are available now)
+        inline std::chrono::microseconds wait_time(std::chrono::microseconds cost,
+                                                   std::chrono::steady_clock::time_point now) {
+            refill(now);
+            double needed = std::min(double(cost.count()), capacity_us_) - tokens_us_;
+            if (needed <= 0 || rate_ <= 0) {
+                return std::chrono::microseconds::zero();
+            }
+            return std::chrono::microseconds(static_cast<int64_t>(std::ceil(needed / rate_)));
+        }
+
+        inline void consume(std::chrono::microseconds cost) { tokens_us_ -= double(cost.count()); }
+
+        // Give back tokens consumed for a transmission that did not happen
+        inline void refund(std::chrono::microseconds cost) {
+            tokens_us_ = std::min(capacity_us_, tokens_us_ + double(cost.count()));
+        }
+    };
+
+    // Sliding-window airtime accounting for one sub-band
+    class DutyCycleTracker {
+      private:
+        std::pmr::deque<std::pair<std::chrono::steady_clock::time_point, std::chrono::microseconds>> history_;
+        std::chrono::microseconds used_{0};
+
+        inline void expire(std::chrono::steady_clock::time_point now, std::chrono::seconds window) {
+            while (!history_.empty() && history_.front().first + window <= now) {
+                used_ -= history_.front().second;
+                history_.pop_front();
+            }
+        }
+
+      public:
+        inline explicit DutyCycleTracker(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : history_(resource) {}
+
+        inline void set_memory_resource(std::pmr::memory_resource *resource) { move_to_resource(history_, resource); }
+
+        // Time until `airtime` fits in the budget (zero if it fits now)
+        inline std::chrono::microseconds wait_time(std::chrono::microseconds airtime, double duty_cycle,
+                                                   std::chrono::seconds window,
+                                                   std::chrono::steady_clock::time_point now) {
+            if (duty_cycle >= 1.0) {
+                return std::chrono::microseconds::zero();
+            }
+            expire(now, window);
+
+            auto budget = std::chrono::duration_cast<std::chrono::microseconds>(window * duty_cycle);
+            auto used = used_;
+            for (const auto &[sent_at, spent] : history_) {
+                if (used + airtime <= budget) {
+                    break;
+                }
+                used -= spent;
+                if (used + airtime <= budget) {
+                    return std::chrono::duration_cast<std::chrono::microseconds>(sent_at + window - now);
+                }
+            }
+            return used_ + airtime <= budget ? std::chrono::microseconds::zero()
+                                             : std::chrono::duration_cast<std::chrono::microseconds>(window);
+        }
+
+        inline void record(std::chrono::microseconds airtime, std::chrono::steady_clock::time_point now) {
+            history_.emplace_back(now, airtime);
+            used_ += airtime;
+        }
+
+        // Take back the most recent record of `airtime`, for a transmission that did not happen
+        inline void refund(std::chrono::microseconds airtime) {
+            for (auto it = history_.rbegin(); it != history_.rend(); ++it) {
+                if (it->second == airtime) {
+                    used_ -= airtime;
+                    history_.erase(std::next(it).base());
+                    return;
+                }
+            }
+        }
+
+        inline std::chrono::microseconds used() const { return used_; }
+    };
+
+    enum struct TxPriority : uint8_t {
+        control = 0, // stop commands, configuration
+        high = 1,    // close-range position, safety
+        normal = 2,
+        bulk = 3, // telemetry that may wait
+    };
+
+    struct TxOptions {
+        TxPriority priority = TxPriority::normal;
+        // Drop the frame if it could not be sent within this time (zero = never expires)
+        std::chrono::milliseconds max_age = std::chrono::milliseconds::zero();
+        // Non-zero: a newer frame with the same key and destination replaces a queued older one
+        uint32_t coalesce_key = 0;
+    };
+
+    // A frame waiting for airtime. `command`/`command_data` is the serial command; `payload_size` is what goes on
+    // air, including the addresses.
+    struct TxFrame {
+        uint8_t command = 0;
+        std::vector<uint8_t> command_data;
+        std::string dest_addr;
+        size_t payload_size = 0;
+        TxOptions options;
+        std::chrono::steady_clock::time_point enqueued;
+        std::chrono::steady_clock::time_point expires = std::chrono::steady_clock::time_point::max();
+        bool encoded = false; // payload already carries its link-layer coding (e.g. an FEC parity frame)
+        std::chrono::microseconds charged{0}; // airtime pop_ready charged for it
+    };
+
+    struct TxSchedulerConfig {
+        LoRaModulation modulation;
+        RegionalLimits limits = RegionalLimits::eu868();
+        uint32_t frequency_hz = 868100000;
+        // Pacing rate as a fraction of the channel (zero = the sub-band duty cycle) and burst allowance
+        double pacing_rate = 0.0;
+        std::chrono::milliseconds pacing_burst = std::chrono::milliseconds(2000);
+        size_t max_queued_frames = 256;
+    };
+
+    struct TxStats {
+        uint64_t sent = 0;
+        uint64_t expired = 0;
+        uint64_t coalesced = 0;
+        uint64_t dropped = 0;
+        uint64_t oversized = 0; // frames whose airtime alone exceeds the sub-band's duty-cycle budget
+        std::chrono::microseconds airtime{0};
+    };
+
+    // Priority queue in front of the radio that only releases frames when both the regional duty-cycle budget of
+    // the current sub-band and the pacing bucket allow it. Not thread-safe; the owner serializes access.
+    class TxScheduler {
+      private:
+        static constexpr size_t PRIORITY_COUNT = 4;
+
+        TxSchedulerConfig config_;
+        // Queue and history nodes come from pool_, once set_memory_resource made one, and are recycled there
+        std::unique_ptr<std::pmr::unsynchronized_pool_resource> pool_;
+        std::array<std::pmr::deque<TxFrame>, PRIORITY_COUNT> queues_;
+        std::vector<DutyCycleTracker> trackers_; // one per sub-band, plus the default band at the end
+        TokenBucket bucket_;
+        TxStats stats_;
+        size_t coding_overhead_ = 0;
+
+        inline std::pmr::memory_resource *resource() const {
+            return pool_ ? pool_.get() : std::pmr::get_default_resource();
+        }
+
+        inline DutyCycleTracker &tracker() {
+            int band = config_.limits.sub_band_of(config_.frequency_hz);
+            return trackers_[band < 0 ? trackers_.size() - 1 : band];
+        }
+
+        inline double duty_cycle() const {
+            return config_.limits.duty_cycle_of(config_.limits.sub_band_of(config_.frequency_hz));
+        }
+
+        inline void configure_bucket() {
+            double rate = config_.pacing_rate > 0 ? config_.pacing_rate : duty_cycle();
+            bucket_.configure(rate, config_.pacing_burst);
+        }
+
+        // Airtime of the frame as it will go on air, link-layer coding included
+        inline std::chrono::microseconds airtime_of(const TxFrame &frame) const {
+            return config_.modulation.time_on_air(frame.payload_size + (frame.encoded ? 0 : coding_overhead_));
+        }
+
+        // Whole duty-cycle budget of the current sub-band; a frame longer than this could never be sent
+        inline std::chrono::microseconds budget() const {
+            if (duty_cycle() >= 1.0) {
+                return std::chrono::microseconds::max();
+            }
+            return std::chrono::duration_cast<std::chrono::microseconds>(config_.limits.window * duty_cycle());
+        }
+
+        inline void drop_expired(std::chrono::steady_clock::time_point now) {
+            for (auto &queue : queues_) {
+                auto kept = std::remove_if(queue.begin(), queue.end(),
+                                           [now](const TxFrame &frame) { return frame.expires <= now; });
+                stats_.expired += std::distance(kept, queue.end());
+                queue.erase(kept, queue.end());
+            }
+        }
+
+        inline size_t queued() const {
+            size_t total = 0;
+            for (const auto &queue : queues_) {
+                total += queue.size();
+            }
+            return total;
+        }
+
+      public:
+        inline explicit TxScheduler(TxSchedulerConfig config = {})
+            : config_(std::move(config)), trackers_(config_.limits.sub_bands.size() + 1) {
+            configure_bucket();
+        }
+
+        // Take queue and airtime-history nodes from a pool over `resource`, so that frames coming and going stop
+        // allocating once it has grown to the working set. Queued frames and the history move over.
+        inline void set_memory_resource(std::pmr::memory_resource *resource) {
+            auto pool = std::make_unique<std::pmr::unsynchronized_pool_resource>(resource);
+            for (auto &queue : queues_) {
+                move_to_resource(queue, pool.get());
+            }
+            for (auto &tracker : trackers_) {
+                tracker.set_memory_resource(pool.get());
+            }
+            pool_ = std::move(pool);
+        }
+
+        inline void set_modulation(const LoRaModulation &modulation) { config_.modulation = modulation; }
+        inline const LoRaModulation &modulation() const { return config_.modulation; }
+
+        inline void set_frequency(uint32_t frequency_hz) {
+            config_.frequency_hz = frequency_hz;
+            configure_bucket();
+        }
+
+        inline void set_limits(const RegionalLimits &limits) {
+            config_.limits = limits;
+            trackers_.clear();
+            for (size_t i = 0; i < limits.sub_bands.size() + 1; ++i) {
+                trackers_.emplace_back(resource());
+            }
+            configure_bucket();
+        }
+
+        // Bytes the link layer adds to frames that are not `encoded` yet when they go on air (e.g. the FEC header).
+        // Airtime is charged on the coded size.
+        inline void set_coding_overhead(size_t bytes) { coding_overhead_ = bytes; }
+
+        inline void set_pacing(double rate, std::chrono::milliseconds burst) {
+            config_.pacing_rate = rate;
+            config_.pacing_burst = burst;
+            configure_bucket();
+        }
+
+        // Whether the frame can never fit in the duty-cycle budget, however long it waits
+        inline bool exceeds_budget(const TxFrame &frame) const { return airtime_of(frame) > budget(); }
+
+        // Queue a frame. Returns false if it was rejected because the queue is full of higher-priority traffic or
+        // because the frame is too long for the duty-cycle budget (it would wait forever and, with strict
+        // priority, hold back everything queued behind it).
+        inline bool enqueue(TxFrame &&frame, std::chrono::steady_clock::time_point now) {
+            if (exceeds_budget(frame)) {
+                ++stats_.oversized;
+                return false;
+            }
+            frame.enqueued = now;
+            if (frame.options.max_age > std::chrono::milliseconds::zero()) {
+                frame.expires = now + frame.options.max_age;
+            }
+
+            auto &queue = queues_[static_cast<size_t>(frame.options.priority)];
+            if (frame.options.coalesce_key != 0) {
+                for (auto &queued_frame : queue) {
+                    if (queued_frame.options.coalesce_key == frame.options.coalesce_key &&
+                        queued_frame.dest_addr == frame.dest_addr) {
+                        queued_frame = std::move(frame);
+                        ++stats_.coalesced;
+                        return true;
+                    }
+                }
+            }
+
+            if (queued() >= config_.max_queued_frames) {
+                drop_expired(now);
+            }
+            if (queued() >= config_.max_queued_frames) {
+                // Make room by dropping the oldest frame of the lowest priority class below this one
+                bool made_room = false;
+                for (size_t p = PRIORITY_COUNT; p-- > static_cast<size_t>(frame.options.priority) + 1;) {
+                    if (!queues_[p].empty()) {
+                        queues_[p].pop_front();
+                        made_room = true;
+                        break;
+                    }
+                }
+                ++stats_.dropped;
+                if (!made_room) {
+                    return false;
+                }
+            }
+
+            queue.push_back(std::move(frame));
+            return true;
+        }
+
+        // Pop the next frame that may go on air now and charge its airtime. Otherwise returns nothing and sets
+        // `wake_at` to when the scheduler should be asked again (time_point::max() when the queue is empty).
+        inline std::optional<TxFrame> pop_ready(std::chrono::steady_clock::time_point now,
+                                                std::chrono::steady_clock::time_point &wake_at) {
+            drop_expired(now);
+            wake_at = std::chrono::steady_clock::time_point::max();
+
+            for (auto &queue : queues_) {
+                // A modulation or frequency change since enqueue can leave a frame too long for the budget
+                while (!queue.empty() && exceeds_budget(queue.front())) {
+                    queue.pop_front();
+                    ++stats_.oversized;
+                }
+                if (queue.empty()) {
+                    continue;
+                }
+
+                auto airtime = airtime_of(queue.front());
+                auto wait = std::max(tracker().wait_time(airtime, duty_cycle(), config_.limits.window, now),
+                                     bucket_.wait_time(airtime, now));
+                if (wait > std::chrono::microseconds::zero()) {
+                    // Strict priority: lower classes do not overtake a waiting higher class
+                    wake_at = std::min(now + wait, queue.front().expires);
+                    return std::nullopt;
+                }
+
+                TxFrame frame = std::move(queue.front());
+                queue.pop_front();
+                if (duty_cycle() < 1.0) {
+                    tracker().record(airtime, now); // nothing expires a history no budget is checked against
+                }
+                bucket_.consume(airtime);
+                ++stats_.sent;
+                stats_.airtime += airtime;
+                frame.charged = airtime;
+                return frame;
+            }
+
+            return std::nullopt;
+        }
+
+        // Put back a frame pop_ready released but that never went on air (e.g. the link was lost). Its airtime is
+        // returned to the budget and it goes back to the front of its class, keeping its expiry.
+        inline void requeue(TxFrame &&frame) {
+            if (frame.charged > std::chrono::microseconds::zero()) {
+                tracker().refund(frame.charged);
+                bucket_.refund(frame.charged);
+                --stats_.sent;
+                stats_.airtime -= frame.charged;
+                frame.charged = std::chrono::microseconds::zero();
+            }
+            queues_[static_cast<size_t>(frame.options.priority)].push_front(std::move(frame));
+        }
+
+        inline bool empty() const { return queued() == 0; }
+        inline size_t size() const { return queued(); }
+        inline const TxStats &stats() const { return stats_; }
+
+        // Airtime used in the current sub-band over the regulatory window
+        inline std::chrono::microseconds airtime_used() { return tracker().used(); }
+
+        inline void clear() {
+            for (auto &queue : queues_) {
+                queue.clear();
+            }
+        }
+    };
+
+} // namespace impulse
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace impulse {
+
+    enum struct FramingVersion : uint8_t {
+        v1 = 1, // responses: [AA BB CC DD][type][data], length inferred from the type; commands unframed
+        // both directions: [AA 55][length:2][sequence:2][crc8 of length + sequence][type][data][crc16 of type + data]
+        v2 = 2,
+    };
+
+    struct FramingStats {
+        uint64_t frames = 0;
+        uint64_t crc_errors = 0;    // v2 frames dropped whole because the body CRC failed
+        uint64_t header_errors = 0; // v2 sync words whose header CRC or length did not check out
+        uint64_t discarded_bytes = 0;
+    };
+
+    namespace crc {
+        // CRC-8/SMBUS (poly 0x07) and CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), byte-table driven
+        inline constexpr std::array<uint8_t, 256> CRC8_TABLE = [] {
+            std::array<uint8_t, 256> table{};
+            for (int i = 0; i < 256; ++i) {
+                uint8_t crc = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+                }
+                table[i] = crc;
+            }
+            return table;
+        }();
+
+        inline constexpr std::array<uint16_t, 256> CRC16_TABLE = [] {
+            std::array<uint16_t, 256> table{};
+            for (int i = 0; i < 256; ++i) {
+                uint16_t crc = i << 8;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+                }
+                table[i] = crc;
+            }
+            return table;
+        }();
+
+        inline uint8_t crc8(const uint8_t *data, size_t size) {
+            uint8_t crc = 0;
+            for (size_t i = 0; i < size; ++i) {
+                crc = CRC8_TABLE[crc ^ data[i]];
+            }
+            return crc;
+        }
+
+        inline uint16_t crc16(const uint8_t *data, size_t size, uint16_t crc = 0xFFFF) {
+            for (size_t i = 0; i < size; ++i) {
+                crc = (crc << 8) ^ CRC16_TABLE[(crc >> 8) ^ data[i]];
+            }
+            return crc;
+        }
+    } // namespace crc
+
+    // Splits the byte stream from the radio into frames. v2 frames carry their own length, protected by a header
+    // CRC, so a frame whose body is corrupt is dropped in one step instead of rescanning its bytes for the next
+    // sync word. v2 frames also carry a sequence number: the host numbers its commands and the firmware echoes the
+    // number in the response, 0 in frames that answer no command. Not thread-safe; owned by the listen thread.
+    class SerialFramer {
+      public:
+        // v1 only: total frame length (header included) for a frame starting at `frame`, or SIZE_MAX when more
+        // bytes are needed to tell
+        using LengthFn = size_t (*)(const uint8_t *frame, size_t available);
+
+        static constexpr uint8_t V1_SYNC[4] = {0xAA, 0xBB, 0xCC, 0xDD};
+        static constexpr uint8_t V2_SYNC[2] = {0xAA, 0x55};
+        static constexpr size_t V2_HEADER = 7;
+        static constexpr size_t V2_TRAILER = 2;
+        static constexpr size_t V2_MAX_BODY = 4096;
+
+      private:
+        LengthFn v1_length_;
+        FramingVersion version_ = FramingVersion::v1;
+        std::vector<uint8_t> buffer_;
+        size_t start_ = 0; // consumed bytes at the front of buffer_, compacted lazily
+        FramingStats stats_;
+
+        inline void discard(size_t count) {
+            start_ += count;
+            stats_.discarded_bytes += count;
+        }
+
+        // Drop bytes up to the next possible sync word; keeps a partial sync at the end
+        inline void seek(const uint8_t *sync, size_t sync_size) {
+            const uint8_t *begin = buffer_.data() + start_;
+            const uint8_t *end = buffer_.data() + buffer_.size();
+            const uint8_t *p = begin;
+            if (begin == end) {
+                return;
+            }
+            while ((p = static_cast<const uint8_t *>(memchr(p, sync[0], end - p))) != nullptr) {
+                size_t available = std::min<size_t>(end - p, sync_size);
+                if (memcmp(p, sync, available) == 0) {
+                    break;
+                }
+                ++p;
+            }
+            discard((p ? p : end) - begin);
+        }
+
+        inline bool next_v1(uint8_t &type, std::vector<uint8_t> &data, uint16_t &sequence) {
+            seek(V1_SYNC, sizeof(V1_SYNC));
+            size_t available = buffer_.size() - start_;
+            if (available < sizeof(V1_SYNC) + 1) {
+                return false;
+            }
+            const uint8_t *frame = buffer_.data() + start_;
+            size_t length = v1_length_(frame, available);
+            if (length == SIZE_MAX || available < length) {
+                return false;
+            }
+            type = frame[4];
+            data.assign(frame + 5, frame + length);
+            sequence = 0;
+            start_ += length;
+            ++stats_.frames;
+            return true;
+        }
+
+        inline bool next_v2(uint8_t &type, std::vector<uint8_t> &data, uint16_t &sequence) {
+            while (true) {
+                seek(V2_SYNC, sizeof(V2_SYNC));
+                size_t available = buffer_.size() - start_;
+                if (available < V2_HEADER) {
+                    return false;
+                }
+                const uint8_t *frame = buffer_.data() + start_;
+                size_t body = (frame[2] << 8) | frame[3];
+                if (crc::crc8(frame + 2, 4) != frame[6] || body == 0 || body > V2_MAX_BODY) {
+                    // Not a real header (or a damaged one): resume the search one byte later
+                    ++stats_.header_errors;
+                    discard(1);
+                    continue;
+                }
+                if (available < V2_HEADER + body + V2_TRAILER) {
+                    return false;
+                }
+                const uint8_t *payload = frame + V2_HEADER;
+                uint16_t expected = (payload[body] << 8) | payload[body + 1];
+                if (crc::crc16(payload, body) != expected) {
+                    // The header CRC vouches for the length, so the whole frame can be skipped at once
+                    ++stats_.crc_errors;
+                    discard(V2_HEADER + body + V2_TRAILER);
+                    continue;
+                }
+                type = payload[0];
+                data.assign(payload + 1, payload + body);
+                sequence = (frame[4] << 8) | frame[5];
+                start_ += V2_HEADER + body + V2_TRAILER;
+                ++stats_.frames;
+                return true;
+            }
+        }
+
+      public:
+        inline explicit SerialFramer(LengthFn v1_length) : v1_length_(v1_length) {}
+
+        inline void set_version(FramingVersion version) { version_ = version; }
+        inline FramingVersion version() const { return version_; }
+        inline const FramingStats &stats() const { return stats_; }
+
+        inline void reset() {
+            buffer_.clear();
+            start_ = 0;
+        }
+
+        inline void feed(const uint8_t *bytes, size_t size) {
+            if (start_ > 0 && (start_ == buffer_.size() || start_ >= 4096)) {
+                buffer_.erase(buffer_.begin(), buffer_.begin() + start_);
+                start_ = 0;
+            }
+            buffer_.insert(buffer_.end(), bytes, bytes + size);
+        }
+
+        // Next complete frame, split into response type, data and sequence (always 0 in v1). False when more bytes
+        // are needed.
+        inline bool next(uint8_t &type, std::vector<uint8_t> &data, uint16_t &sequence) {
+            return version_ == FramingVersion::v2 ? next_v2(type, data, sequence) : next_v1(type, data, sequence);
+        }
+
+        inline bool next(uint8_t &type, std::vector<uint8_t> &data) {
+            uint16_t sequence;
+            return next(type, data, sequence);
+        }
+
+        // Host-to-radio command bytes; `sequence` only travels in v2
+        inline static void encode_command(FramingVersion version, uint8_t command, const std::vector<uint8_t> &data,
+                                          std::vector<uint8_t> &out, uint16_t sequence = 0) {
+            out.clear();
+            if (version == FramingVersion::v1) {
+                out.reserve(1 + data.size());
+                out.push_back(command);
+                out.insert(out.end(), data.begin(), data.end());
+                return;
+            }
+
+            size_t body = 1 + data.size();
+            out.reserve(V2_HEADER + body + V2_TRAILER);
+            out.insert(out.end(), V2_SYNC, V2_SYNC + sizeof(V2_SYNC));
+            out.push_back(static_cast<uint8_t>(body >> 8));
+            out.push_back(static_cast<uint8_t>(body & 0xFF));
+            out.push_back(static_cast<uint8_t>(sequence >> 8));
+            out.push_back(static_cast<uint8_t>(sequence & 0xFF));
+            out.push_back(crc::crc8(out.data() + 2, 4));
+            out.push_back(command);
+            out.insert(out.end(), data.begin(), data.end());
+            uint16_t check = crc::crc16(out.data() + V2_HEADER, body);
+            out.push_back(static_cast<uint8_t>(check >> 8));
+            out.push_back(static_cast<uint8_t>(check & 0xFF));
+        }
+    };
+
+} // namespace impulse
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace impulse {
+
+    // 16-bit node IDs standing in for full IPv6 addresses on the air.
+    //
+    // Nodes inside the fleet prefix with an interface ID of the form ::XXXX (what LanInterface generates) map to
+    // XXXX without any coordination, so every node derives the same table. Addresses outside that pattern need an
+    // explicit assignment, which must be made identically on every node; fingerprint() lets nodes compare tables.
+    class ShortAddressTable {
+      public:
+        using Bytes = std::array<uint8_t, 16>;
+
+        static constexpr uint16_t UNASSIGNED = 0x0000;
+        static constexpr uint16_t BROADCAST = 0xFFFF;
+
+      private:
+        Bytes prefix_{}; // only the first 8 bytes are used
+        std::map<Bytes, uint16_t> by_address_;
+        std::map<uint16_t, Bytes> by_id_;
+        mutable std::mutex mutex_;
+
+        inline static bool parse(const std::string &addr, Bytes &bytes) {
+            return inet_pton(AF_INET6, addr.c_str(), bytes.data()) == 1;
+        }
+
+        inline static bool is_broadcast(const Bytes &bytes) {
+            for (uint8_t b : bytes) {
+                if (b != 0xFF) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        inline std::optional<uint16_t> derive(const Bytes &bytes) const {
+            if (memcmp(bytes.data(), prefix_.data(), 8) != 0) {
+                return std::nullopt;
+            }
+            for (size_t i = 8; i < 14; ++i) {
+                if (bytes[i] != 0) {
+                    return std::nullopt;
+                }
+            }
+            uint16_t id = (bytes[14] << 8) | bytes[15];
+            if (id == UNASSIGNED || id == BROADCAST) {
+                return std::nullopt;
+            }
+            return id;
+        }
+
+      public:
+        inline explicit ShortAddressTable(const std::string &prefix = "fd00:dead:beef::") { parse(prefix, prefix_); }
+
+        // Assign an explicit ID to an address outside the derivable range, replacing one it had. Fails on
+        // collisions.
+        inline bool assign(const std::string &addr, uint16_t id) {
+            Bytes bytes;
+            if (!parse(addr, bytes) || id == UNASSIGNED || id == BROADCAST) {
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto existing = by_id_.find(id);
+            if (existing != by_id_.end() && existing->second != bytes) {
+                return false;
+            }
+            auto derived_owner = derive(bytes);
+            if (derived_owner && *derived_owner != id) {
+                return false; // derivable addresses keep their derived ID
+            }
+            auto previous = by_address_.find(bytes);
+            if (previous != by_address_.end() && previous->second != id) {
+                by_id_.erase(previous->second);
+            }
+            by_address_[bytes] = id;
+            by_id_[id] = bytes;
+            return true;
+        }
+
+        inline std::optional<uint16_t> lookup(const Bytes &bytes) const {
+            if (is_broadcast(bytes)) {
+                return BROADCAST;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = by_address_.find(bytes);
+            if (it != by_address_.end()) {
+                return it->second;
+            }
+            auto id = derive(bytes);
+            // A derived ID is unusable if it was explicitly given to another address
+            if (id && by_id_.count(*id)) {
+                return std::nullopt;
+            }
+            return id;
+        }
+
+        inline std::optional<uint16_t> lookup(const std::string &addr) const {
+            Bytes bytes;
+            if (!parse(addr, bytes)) {
+                return std::nullopt;
+            }
+            return lookup(bytes);
+        }
+
+        // Expand an on-air ID back to the full IPv6 address
+        inline std::optional<Bytes> expand(uint16_t id) const {
+            if (id == UNASSIGNED) {
+                return std::nullopt;
+            }
+            Bytes bytes;
+            if (id == BROADCAST) {
+                bytes.fill(0xFF);
+                return bytes;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = by_id_.find(id);
+            if (it != by_id_.end()) {
+                return it->second;
+            }
+            bytes = prefix_;
+            std::memset(bytes.data() + 8, 0, 6);
+            bytes[14] = id >> 8;
+            bytes[15] = id & 0xFF;
+            return bytes;
+        }
+
+        inline std::string expand_to_string(uint16_t id) const {
+            auto bytes = expand(id);
+            char str[INET6_ADDRSTRLEN];
+            if (!bytes || inet_ntop(AF_INET6, bytes->data(), str, sizeof(str)) == nullptr) {
+                return "";
+            }
+            return str;
+        }
+
+        // FNV-1a over the prefix and explicit assignments; equal on nodes that share the same table
+        inline uint32_t fingerprint() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            uint32_t hash = 2166136261u;
+            auto mix = [&hash](uint8_t byte) { hash = (hash ^ byte) * 16777619u; };
+            for (size_t i = 0; i < 8; ++i) {
+                mix(prefix_[i]);
+            }
+            for (const auto &[id, bytes] : by_id_) {
+                mix(id >> 8);
+                mix(id & 0xFF);
+                for (uint8_t b : bytes) {
+                    mix(b);
+                }
+            }
+            return hash;
+        }
+    };
+
+} // namespace impulse
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "impulse/protocol/message.hpp"
+#include "impulse/protocol/wire.hpp"
+
+#include <capnp/message.h>
+#include <capnp/serialize.h>
+#include <kj/string.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace impulse {
+
+    // A Cap'n Proto message as Transport payload (build with IMPULSE_WITH_CAPNP). On the wire:
+    //   [type ID:8][segment table][segments]
+    // i.e. capnp's flat serialization behind the 64-bit ID capnp assigns the root struct, so topics of different
+    // schemas can share an interface. Received messages are read in place: deserialize checks nothing beyond the
+    // segment table and points a reader at the receive buffer, and fields are decoded only when the handler reads
+    // them. That buffer is reused after the handler returns, so copying a message (batch delivery, storing it)
+    // copies its bytes. Accessors throw kj::Exception on a message whose pointers are corrupt.
+    template <typename Schema> class CapnpMessage : public Message {
+      public:
+        static constexpr uint64_t TYPE_ID = capnp::typeId<Schema>();
+        static constexpr SerializationType SERIALIZATION = SerializationType::capnproto;
+        static constexpr size_t MAX_SEGMENTS = 512; // capnp's own limit for a flat message
+
+      private:
+        std::unique_ptr<capnp::MallocMessageBuilder> builder_; // set while building (send side)
+        mutable std::optional<capnp::FlatArrayMessageReader> reader_; // set while reading received or copied bytes
+        const capnp::word *words_ = nullptr; // what reader_ reads: receive buffer, scratch, or owned_
+        size_t word_count_ = 0;
+        std::vector<uint64_t> owned_;
+
+        // Bytes of the flat message at `flat` according to its segment table, 0 if the table does not fit `size`
+        inline static size_t flat_size(const char *flat, size_t size) {
+            if (size < 8) {
+                return 0;
+            }
+            size_t segments = wire::get<uint32_t>(flat) + size_t(1);
+            size_t table = (segments / 2 + 1) * 8; // count and sizes, padded to a whole word
+            if (segments > MAX_SEGMENTS || table > size) {
+                return 0;
+            }
+            size_t total = table;
+            for (size_t i = 0; i < segments; ++i) {
+                total += size_t(wire::get<uint32_t>(flat + 4 + 4 * i)) * 8;
+            }
+            return total;
+        }
+
+        inline void open(const capnp::word *words, size_t count) {
+            words_ = words;
+            word_count_ = count;
+            reader_.emplace(kj::ArrayPtr<const capnp::word>(words, count));
+        }
+
+        inline void reset() {
+            reader_.reset();
+            builder_.reset();
+            words_ = nullptr;
+            word_count_ = 0;
+        }
+
+        inline void write_flat(char *out) const {
+            if (!builder_) {
+                if (words_) {
+                    memcpy(out, words_, word_count_ * 8);
+                } else {
+                    wire::put<uint64_t>(out, 0); // one empty segment: reads as a default-valued root
+                }
+                return;
+            }
+            auto segments = builder_->getSegmentsForOutput();
+            wire::put<uint32_t>(out, static_cast<uint32_t>(segments.size() - 1));
+            for (size_t i = 0; i < segments.size(); ++i) {
+                wire::put<uint32_t>(out + 4 + 4 * i, static_cast<uint32_t>(segments[i].size()));
+            }
+            if (segments.size() % 2 == 0) {
+                wire::put<uint32_t>(out + 4 + 4 * segments.size(), 0);
+            }
+            size_t offset = (segments.size() / 2 + 1) * 8;
+            for (auto segment : segments) {
+                memcpy(out + offset, segment.begin(), segment.size() * 8);
+                offset += segment.size() * 8;
+            }
+        }
+
+        inline void copy_from(const CapnpMessage &other) {
+            if (!other.builder_ && !other.words_) {
+                return;
+            }
+            owned_.resize((other.get_size() - 8) / 8);
+            other.write_flat(reinterpret_cast<char *>(owned_.data()));
+            open(reinterpret_cast<const capnp::word *>(owned_.data()), owned_.size());
+        }
+
+        inline void take(CapnpMessage &other) {
+            builder_ = std::move(other.builder_);
+            if (other.words_ == reinterpret_cast<const capnp::word *>(other.owned_.data())) {
+                owned_ = std::move(other.owned_);
+                open(reinterpret_cast<const capnp::word *>(owned_.data()), owned_.size());
+            } else if (other.words_) {
+                open(other.words_, other.word_count_);
+            }
+            other.reset();
+        }
+
+      public:
+        inline CapnpMessage() = default;
+        inline CapnpMessage(const CapnpMessage &other) : Message(other) { copy_from(other); }
+        inline CapnpMessage(CapnpMessage &&other) noexcept { take(other); }
+        inline CapnpMessage &operator=(const CapnpMessage &other) {
+            if (this != &other) {
+                reset();
+                copy_from(other);
+            }
+            return *this;
+        }
+        inline CapnpMessage &operator=(CapnpMessage &&other) noexcept {
+            if (this != &other) {
+                reset();
+                take(other);
+            }
+            return *this;
+        }
+
+        // Start a new message; what was held before is dropped
+        inline typename Schema::Builder init() {
+            reset();
+            builder_ = std::make_unique<capnp::MallocMessageBuilder>();
+            return builder_->initRoot<Schema>();
+        }
+
+        // Modify the current content, received or built. Received content is copied into a builder first.
+        inline typename Schema::Builder edit() {
+            if (!builder_) {
+                auto builder = std::make_unique<capnp::MallocMessageBuilder>();
+                builder->setRoot(get());
+                reset();
+                builder_ = std::move(builder);
+            }
+            return builder_->getRoot<Schema>();
+        }
+
+        // The content, read in place; default values for an empty message
+        inline typename Schema::Reader get() const {
+            if (builder_) {
+                return builder_->getRoot<Schema>().asReader();
+            }
+            if (reader_) {
+                return reader_->getRoot<Schema>();
+            }
+            return typename Schema::Reader();
+        }
+
+        // Whether the bytes are a message of this schema with a consistent segment table
+        inline static bool matches(const char *data, size_t size) {
+            return size >= 16 && size % 8 == 0 && wire::get<uint64_t>(data) == TYPE_ID &&
+                   flat_size(data + 8, size - 8) == size - 8;
+        }
+
+        // Expects bytes accepted by matches()
+        inline void deserialize(const char *buffer) override {
+            reset();
+            const char *flat = buffer + 8;
+            size_t words = flat_size(flat, SIZE_MAX) / 8;
+            if (reinterpret_cast<uintptr_t>(flat) % alignof(capnp::word) == 0) {
+                open(reinterpret_cast<const capnp::word *>(flat), words);
+            } else {
+                // capnp needs aligned words; redundancy and relay headers shift the payload off alignment
+                thread_local std::vector<uint64_t> scratch;
+                scratch.resize(words);
+                memcpy(scratch.data(), flat, words * 8);
+                open(reinterpret_cast<const capnp::word *>(scratch.data()), words);
+            }
+        }
+
+        inline void serialize(char *buffer) const override {
+            wire::put<uint64_t>(buffer, TYPE_ID);
+            write_flat(buffer + 8);
+        }
+
+        inline uint32_t get_size() const override {
+            if (!builder_) {
+                return static_cast<uint32_t>(8 + (words_ ? word_count_ * 8 : 8));
+            }
+            auto segments = builder_->getSegmentsForOutput();
+            size_t size = 8 + (segments.size() / 2 + 1) * 8;
+            for (auto segment : segments) {
+                size += segment.size() * 8;
+            }
+            return static_cast<uint32_t>(size);
+        }
+
+        // Schemas with a `timestamp` field get it set by continuous broadcasts
+        inline void set_timestamp(uint64_t timestamp) override {
+            if constexpr (requires(typename Schema::Builder root) { root.setTimestamp(timestamp); }) {
+                edit().setTimestamp(timestamp);
+            }
+        }
+
+        inline std::string to_string() const override { return get().toString().flatten().cStr(); }
+    };
+
+} // namespace impulse
@@ -0,0 +1,384 @@
+#pragma once
+
+#include "impulse/network/interface.hpp"
+#include "impulse/network/poller.hpp"
+#include "impulse/network/scheduler.hpp"
+#include "impulse/protocol/message.hpp"
+#include "impulse/protocol/redundancy.hpp"
+#include "impulse/protocol/relay.hpp"
+#include "impulse/util/realtime.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace impulse {
+
+    // A class of messages the gateway bridges, and how
+    struct GatewayTopic {
+        std::string name;
+        std::function<bool(const std::string &msg)> match;
+        bool to_lora = true; // forward LAN traffic onto LoRa
+        bool to_lan = true;  // relay LoRa traffic onto LAN multicast
+        // LAN -> LoRa: at most one message per source this often; newer messages replace a waiting one. 0 forwards
+        // everything the airtime budget allows, still keeping only the latest per source when it does not.
+        std::chrono::milliseconds lora_interval = std::chrono::milliseconds(0);
+        std::function<std::string(const std::string &)> encode; // LAN form -> compact LoRa form
+        std::function<std::string(const std::string &)> decode; // compact LoRa form -> LAN form
+        // Recognises the compact form when decode is set; LoRa traffic in the full form still matches `match`
+        std::function<bool(const std::string &msg)> match_compact;
+    };
+
+    // Topic of the messages a Transport<MessageT> carries (plain or with a redundancy envelope)
+    template <typename MessageT>
+    inline GatewayTopic gateway_topic(const std::string &name,
+                                      std::chrono::milliseconds lora_interval = std::chrono::milliseconds(0)) {
+        GatewayTopic topic;
+        topic.name = name;
+        topic.match = [](const std::string &msg) {
+            constexpr size_t envelope = redundancy::ENVELOPE_SIZE;
+            return message_matches<MessageT>(msg.data(), msg.size()) ||
+                   (msg.size() > envelope && message_matches<MessageT>(msg.data() + envelope, msg.size() - envelope));
+        };
+        topic.lora_interval = lora_interval;
+        return topic;
+    }
+
+    struct GatewayConfig {
+        double lora_bytes_per_second = 50.0; // airtime budget for forwarded traffic, in payload bytes
+        double lora_burst_bytes = 512.0;
+        double lan_bytes_per_second = 1e6;
+        double lan_burst_bytes = 64.0 * 1024;
+        bool preserve_source = true; // prefix forwarded messages with a relay header naming the original sender
+        std::chrono::milliseconds loop_window = std::chrono::milliseconds(2000); // forget forwarded payloads after
+    };
+
+    struct GatewayDirectionStats {
+        uint64_t forwarded = 0;
+        uint64_t bytes = 0;
+        uint64_t filtered = 0;   // no matching topic, or the topic is not bridged this way
+        uint64_t superseded = 0; // replaced by a newer message from the same source before it went out
+        uint64_t throttled = 0;  // dropped for lack of budget (LoRa -> LAN only; LAN -> LoRa keeps the latest)
+        uint64_t loops = 0;      // already relayed once, or the gateway's own output heard back
+    };
+
+    struct GatewayStats {
+        GatewayDirectionStats to_lora;
+        GatewayDirectionStats to_lan;
+        size_t waiting = 0; // LAN messages held for LoRa
+    };
+
+    // Bridges selected topics between a LAN and a LoRa interface. LAN traffic is thinned to what LoRa airtime
+    // allows by keeping only the latest message per topic and source, optionally re-encoded in a compact form;
+    // LoRa traffic is relayed onto LAN multicast as is. Messages are forwarded at most once: a bridged message
+    // behind a relay header, or one matching a payload the gateway forwarded within the loop window, is dropped.
+    // LAN messages waiting for airtime are retried by a pump thread, or by poll_once with Threading::polled.
+    class Gateway : public Pollable {
+      private:
+        static constexpr std::chrono::milliseconds PUMP_INTERVAL{20}; // how often waiting LAN messages are retried
+
+        struct Slot {
+            std::string payload;
+            bool waiting = false;
+            std::chrono::steady_clock::time_point last_sent;
+        };
+
+        NetworkInterface *lan_;
+        NetworkInterface *lora_;
+        GatewayConfig config_;
+
+        std::mutex mutex_;
+        std::vector<GatewayTopic> topics_;
+        std::map<std::pair<size_t, std::string>, Slot> slots_; // (topic, source) -> latest LAN message
+        std::pair<size_t, std::string> last_served_;          // the pump resumes after it, so sources take turns
+        std::unordered_map<size_t, std::chrono::steady_clock::time_point> forwarded_;
+        // Byte budgets on the airtime bucket: a byte costs its share of a second at the configured rate
+        TokenBucket lora_budget_;
+        TokenBucket lan_budget_;
+        GatewayStats stats_;
+
+        std::thread pump_thread_;
+        std::atomic<bool> running_;
+        Threading threading_;
+        std::chrono::steady_clock::time_point last_pump_;
+        bool attached_ = false;
+        WakeupMonitor wakeup_;
+
+        inline static std::chrono::microseconds byte_cost(double bytes, double bytes_per_second) {
+            return std::chrono::microseconds(static_cast<int64_t>(bytes * 1e6 / bytes_per_second));
+        }
+
+        // Charge `bytes` to a budget if it has them; frames larger than the burst pass when the bucket is full
+        inline static bool spend(TokenBucket &budget, size_t bytes, double bytes_per_second,
+                                 std::chrono::steady_clock::time_point now) {
+            auto cost = byte_cost(static_cast<double>(bytes), bytes_per_second);
+            if (budget.wait_time(cost, now) > std::chrono::microseconds::zero()) {
+                return false;
+            }
+            budget.consume(cost);
+            return true;
+        }
+
+        inline static size_t key(std::string_view payload) { return std::hash<std::string_view>{}(payload); }
+
+        inline void remember(std::string_view payload, std::chrono::steady_clock::time_point now) {
+            forwarded_[key(payload)] = now;
+        }
+
+        inline bool seen(std::string_view payload, std::chrono::steady_clock::time_point now) {
+            auto it = forwarded_.find(key(payload));
+            return it != forwarded_.end() && now - it->second < config_.loop_window;
+        }
+
+        // From LoRa a topic with a compact form may arrive in either form; `compact` tells which one matched
+        inline const GatewayTopic *topic_for(const std::string &msg, bool from_lora, size_t &index,
+                                             bool &compact) const {
+            for (size_t i = 0; i < topics_.size(); ++i) {
+                const auto &topic = topics_[i];
+                compact = from_lora && topic.decode && topic.match_compact && topic.match_compact(msg);
+                if (compact || (topic.match && topic.match(msg))) {
+                    index = i;
+                    return &topic;
+                }
+            }
+            return nullptr;
+        }
+
+        // Relayed already: a relay header followed by a message of a bridged topic. A message of the topic itself
+        // may start with the relay magic, so the header alone does not tell.
+        inline bool relayed(const std::string &msg, bool from_lora) const {
+            std::string origin;
+            size_t index;
+            bool compact;
+            return relay::read_header(msg.data(), msg.size(), origin) &&
+                   topic_for(msg.substr(relay::HEADER_SIZE), from_lora, index, compact) != nullptr;
+        }
+
+        inline std::string wrap(const std::string &source, const std::string &payload) const {
+            if (!config_.preserve_source) {
+                return payload;
+            }
+            std::string out(relay::HEADER_SIZE, '\0');
+            if (!relay::write_header(out.data(), source)) {
+                return payload;
+            }
+            return out + payload;
+        }
+
+        // Send the slot's message to LoRa if its interval has passed and the budget allows; lock held
+        inline bool try_send(const std::pair<size_t, std::string> &id, Slot &slot,
+                             std::chrono::steady_clock::time_point now, std::vector<std::string> &out) {
+            const auto &topic = topics_[id.first];
+            if (!slot.waiting || now - slot.last_sent < topic.lora_interval) {
+                return false;
+            }
+            std::string payload = topic.encode ? topic.encode(slot.payload) : slot.payload;
+            std::string frame = wrap(id.second, payload);
+            if (!spend(lora_budget_, frame.size(), config_.lora_bytes_per_second, now)) {
+                return false;
+            }
+            remember(slot.payload, now);
+            remember(payload, now);
+            slot.waiting = false;
+            slot.last_sent = now;
+            ++stats_.to_lora.forwarded;
+            stats_.to_lora.bytes += frame.size();
+            out.push_back(std::move(frame));
+            return true;
+        }
+
+        // Offer every waiting LAN message to LoRa, sources in turn, and forget old forwarded payloads
+        inline void pump(std::vector<std::string> &out) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto now = std::chrono::steady_clock::now();
+                last_pump_ = now;
+                auto it = slots_.upper_bound(last_served_);
+                for (size_t i = 0; i < slots_.size(); ++i, ++it) {
+                    if (it == slots_.end()) {
+                        it = slots_.begin();
+                    }
+                    if (try_send(it->first, it->second, now, out)) {
+                        last_served_ = it->first;
+                    }
+                }
+                for (auto it = forwarded_.begin(); it != forwarded_.end();) {
+                    it = now - it->second >= config_.loop_window ? forwarded_.erase(it) : std::next(it);
+                }
+            }
+            for (const auto &frame : out) {
+                lora_->multicast_message(frame);
+            }
+            out.clear();
+        }
+
+        inline void pump_loop() {
+            std::vector<std::string> out;
+            while (running_) {
+                pump(out);
+                auto deadline = std::chrono::steady_clock::now() + PUMP_INTERVAL;
+                std::this_thread::sleep_until(deadline);
+                wakeup_.record_wakeup(deadline);
+            }
+        }
+
+      public:
+        // With Threading::polled no pump thread is started; the application calls poll_once (see Pollable)
+        inline Gateway(NetworkInterface *lan, NetworkInterface *lora, const GatewayConfig &config = {},
+                       Threading threading = Threading::threads)
+            : lan_(lan), lora_(lora), config_(config),
+              lora_budget_(1.0, byte_cost(config.lora_burst_bytes, config.lora_bytes_per_second)),
+              lan_budget_(1.0, byte_cost(config.lan_burst_bytes, config.lan_bytes_per_second)), running_(true),
+              threading_(threading), last_pump_(std::chrono::steady_clock::now()) {
+            if (threading_ == Threading::threads) {
+                pump_thread_ = std::thread(&Gateway::pump_loop, this);
+            }
+        }
+
+        inline ~Gateway() {
+            if (attached_) {
+                lan_->set_message_callback(nullptr);
+                lora_->set_message_callback(nullptr);
+            }
+            running_ = false;
+            if (pump_thread_.joinable()) {
+                pump_thread_.join();
+            }
+        }
+
+        Gateway(const Gateway &) = delete;
+        Gateway &operator=(const Gateway &) = delete;
+
+        // Topics are matched in the order they were added; messages matching none are not bridged
+        inline void add_topic(const GatewayTopic &topic) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            topics_.push_back(topic);
+        }
+
+        // Install the gateway as the message callback of both interfaces. Applications that also consume traffic
+        // on the gateway node call handle_lan_message / handle_lora_message from their own callbacks instead.
+        inline void attach() {
+            lan_->set_message_callback([this](const std::string &msg, const std::string &from, uint16_t port) {
+                handle_lan_message(msg, from, port);
+            });
+            lora_->set_message_callback([this](const std::string &msg, const std::string &from, uint16_t port) {
+                handle_lora_message(msg, from, port);
+            });
+            attached_ = true;
+        }
+
+        inline void handle_lan_message(const std::string &msg, const std::string &from_addr, uint16_t) {
+            std::vector<std::string> out;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto now = std::chrono::steady_clock::now();
+                if (relayed(msg, false) || seen(msg, now)) {
+                    ++stats_.to_lora.loops;
+                    return;
+                }
+                size_t index;
+                bool compact;
+                const auto *topic = topic_for(msg, false, index, compact);
+                if (!topic || !topic->to_lora) {
+                    ++stats_.to_lora.filtered;
+                    return;
+                }
+
+                auto id = std::make_pair(index, from_addr);
+                auto &slot = slots_[id];
+                if (slot.waiting) {
+                    ++stats_.to_lora.superseded;
+                }
+                slot.payload = msg;
+                slot.waiting = true;
+                try_send(id, slot, now, out);
+            }
+            for (const auto &frame : out) {
+                lora_->multicast_message(frame);
+            }
+        }
+
+        inline void handle_lora_message(const std::string &msg, const std::string &from_addr, uint16_t) {
+            std::string frame;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto now = std::chrono::steady_clock::now();
+                if (relayed(msg, true) || seen(msg, now)) {
+                    ++stats_.to_lan.loops;
+                    return;
+                }
+                size_t index;
+                bool compact;
+                const auto *topic = topic_for(msg, true, index, compact);
+                if (!topic || !topic->to_lan) {
+                    ++stats_.to_lan.filtered;
+                    return;
+                }
+
+                std::string payload = compact ? topic->decode(msg) : msg;
+                frame = wrap(from_addr, payload);
+                if (!spend(lan_budget_, frame.size(), config_.lan_bytes_per_second, now)) {
+                    ++stats_.to_lan.throttled;
+                    return;
+                }
+                remember(msg, now);
+                remember(payload, now);
+                ++stats_.to_lan.forwarded;
+                stats_.to_lan.bytes += frame.size();
+            }
+            lan_->multicast_message(frame);
+        }
+
+        // Affinity, real-time priority and name of the pump thread that feeds LoRa
+        inline bool set_thread_config(const ThreadConfig &config) {
+            return apply_thread_config(pump_thread_, config, "gateway");
+        }
+
+        inline WakeupStats get_wakeup_stats() const { return wakeup_.stats(); }
+
+        inline Threading get_threading() const { return threading_; }
+
+        // Due while LAN messages wait for LoRa or forwarded payloads wait to be forgotten
+        inline std::chrono::steady_clock::time_point next_deadline() override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            bool waiting = !forwarded_.empty();
+            for (auto it = slots_.begin(); !waiting && it != slots_.end(); ++it) {
+                waiting = it->second.waiting;
+            }
+            return waiting ? last_pump_ + PUMP_INTERVAL : std::chrono::steady_clock::time_point::max();
+        }
+
+        // The gateway has no descriptors of its own; traffic arrives through the interfaces' poll_once
+        inline void poll_once(std::chrono::milliseconds timeout) override {
+            if (threading_ != Threading::polled) {
+                return;
+            }
+            if (timeout.count() > 0) {
+                wait_readable({}, timeout, next_deadline());
+            }
+            if (std::chrono::steady_clock::now() >= next_deadline()) {
+                std::vector<std::string> out;
+                pump(out);
+            }
+        }
+
+        inline GatewayStats get_stats() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            GatewayStats stats = stats_;
+            for (const auto &[id, slot] : slots_) {
+                stats.waiting += slot.waiting;
+            }
+            return stats;
+        }
+    };
+
+} // namespace impulse
@@ -3,9 +3,12 @@
 #include <concord/core/types.hpp>
 #include <concord/geographic/crs/datum.hpp>
 
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <ctime>
+#include <memory_resource>
 #include <string>
 
 namespace impulse {
@@ -20,6 +23,30 @@ namespace impulse {
         virtual void set_timestamp(uint64_t timestamp) = 0;
     };
 
+    // Variable-length messages (strings, repeated fields) decode with the received size and put their variable
+    // parts in `arena`, which the receiver releases once the handler returns; copies of the message allocate
+    // normally. False rejects a malformed message.
+    template <typename MessageT>
+    concept VariableLength = requires(MessageT &msg, const char *data, size_t size, std::pmr::memory_resource *arena) {
+        { msg.deserialize(data, size, arena) } -> std::convertible_to<bool>;
+    };
+
+    // Whether `size` received bytes can be a MessageT. Types with a static matches() decide for themselves
+    // (generated ones check their type ID), variable-length ones without it leave it to their deserialize, and
+    // the others are recognised by their fixed size.
+    template <typename MessageT> inline bool message_matches(const char *data, size_t size) {
+        if constexpr (requires {
+                          { MessageT::matches(data, size) } -> std::convertible_to<bool>;
+                      }) {
+            return MessageT::matches(data, size);
+        } else if constexpr (VariableLength<MessageT>) {
+            return true;
+        } else {
+            static const uint32_t fixed_size = MessageT{}.get_size();
+            return size == fixed_size;
+        }
+    }
+
     struct __attribute__((packed)) Discovery : public Message {
         uint64_t timestamp;
         uint64_t join_time;
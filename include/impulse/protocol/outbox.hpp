@@ -0,0 +1,412 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+
+namespace impulse {
+
+    struct OutboxConfig {
+        std::string directory = "."; // one file per topic: <directory>/<topic>.outbox
+        size_t capacity = 1 << 20;   // file size in bytes, header included
+        std::chrono::milliseconds default_ttl = std::chrono::minutes(10); // 0 keeps messages until delivered
+        double drain_rate = 10.0;   // messages per second once the link is back; set to what the link sustains
+        double drain_burst = 5.0;   // messages that may go out back to back
+        bool sync_writes = false;   // msync every append; survives power loss, not just a process crash
+    };
+
+    struct OutboxStats {
+        uint64_t queued = 0;
+        uint64_t delivered = 0;
+        uint64_t expired = 0;
+        uint64_t superseded = 0; // replaced by a newer message with the same dedup key
+        uint64_t evicted = 0;    // pushed out by higher-priority messages when the file was full
+        uint64_t rejected = 0;   // did not fit
+        size_t pending = 0;
+        size_t bytes_used = 0;
+    };
+
+    // Durable store-and-forward queue in a memory-mapped file. Records are appended behind a committed tail and
+    // retired in place by flipping their state byte, so a crash loses at most the append in progress. The file is
+    // compacted by rewriting the live records to a temporary file and renaming it over the original. Delivery order is
+    // highest priority first, oldest first within a priority. Not thread-safe; the owner serializes access.
+    class Outbox {
+      private:
+        static constexpr uint64_t MAGIC = 0x31584F424F504D49ULL; // "IMPOBOX1"
+        static constexpr uint8_t PENDING = 0;
+        static constexpr uint8_t DONE = 1;
+
+        struct FileHeader {
+            uint64_t magic;
+            uint64_t capacity;
+            uint64_t tail; // end of the committed records
+            uint64_t next_sequence;
+        };
+
+        struct RecordHeader {
+            uint32_t length;
+            uint8_t priority;
+            uint8_t state;
+            uint16_t reserved;
+            uint64_t sequence;
+            uint64_t dedup_key;  // 0: none
+            uint64_t expires_ms; // system clock, so deadlines hold across restarts; 0: never
+        };
+
+        static constexpr size_t HEADER_SIZE = 64;
+        static_assert(sizeof(FileHeader) <= HEADER_SIZE);
+
+        using Order = std::pair<uint8_t, uint64_t>; // (255 - priority, sequence)
+
+        std::string path_;
+        int fd_ = -1;
+        uint8_t *map_ = nullptr;
+        size_t capacity_ = 0;
+        bool sync_writes_ = false;
+
+        std::map<Order, size_t> pending_;                  // delivery order -> record offset
+        std::unordered_map<uint64_t, Order> dedup_;        // dedup key -> pending record
+        size_t live_bytes_ = 0;
+        OutboxStats stats_;
+
+        inline static size_t record_size(size_t length) { return (sizeof(RecordHeader) + length + 7) & ~size_t(7); }
+
+        inline static uint64_t now_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        }
+
+        inline FileHeader &header() { return *reinterpret_cast<FileHeader *>(map_); }
+        inline RecordHeader &record(size_t offset) { return *reinterpret_cast<RecordHeader *>(map_ + offset); }
+
+        inline bool map_file(const std::string &path, size_t capacity) {
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd_ < 0) {
+                std::cerr << "Failed to open outbox " << path << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            // An existing file keeps its size so its records stay readable
+            struct stat st;
+            if (fstat(fd_, &st) == 0 && st.st_size >= static_cast<off_t>(HEADER_SIZE + 4096)) {
+                capacity = static_cast<size_t>(st.st_size) & ~size_t(7);
+            }
+            if (fstat(fd_, &st) < 0 || (static_cast<size_t>(st.st_size) != capacity && ftruncate(fd_, capacity) < 0)) {
+                std::cerr << "Failed to size outbox " << path << ": " << strerror(errno) << std::endl;
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+            void *map = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (map == MAP_FAILED) {
+                std::cerr << "Failed to map outbox " << path << ": " << strerror(errno) << std::endl;
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+            map_ = static_cast<uint8_t *>(map);
+            capacity_ = capacity;
+            return true;
+        }
+
+        inline void unmap_file() {
+            if (map_) {
+                munmap(map_, capacity_);
+                map_ = nullptr;
+            }
+            if (fd_ >= 0) {
+                ::close(fd_);
+                fd_ = -1;
+            }
+        }
+
+        inline void flush(size_t offset, size_t size) {
+            if (!sync_writes_) {
+                return;
+            }
+            size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size_t start = offset & ~(page - 1);
+            msync(map_ + start, offset + size - start, MS_SYNC);
+        }
+
+        // Rebuild the index from the file, stopping at the first record that does not check out
+        inline void load() {
+            auto &head = header();
+            if (head.magic != MAGIC || head.capacity != capacity_ || head.tail < HEADER_SIZE ||
+                head.tail > capacity_) {
+                memset(map_, 0, HEADER_SIZE);
+                head.magic = MAGIC;
+                head.capacity = capacity_;
+                head.tail = HEADER_SIZE;
+                head.next_sequence = 0;
+                return;
+            }
+
+            size_t offset = HEADER_SIZE;
+            while (offset + sizeof(RecordHeader) <= head.tail) {
+                auto &rec = record(offset);
+                size_t size = record_size(rec.length);
+                if (rec.state > DONE || offset + size > head.tail) {
+                    break;
+                }
+                if (rec.state == PENDING) {
+                    index(rec, offset);
+                }
+                offset += size;
+            }
+            head.tail = offset;
+        }
+
+        inline void index(const RecordHeader &rec, size_t offset) {
+            Order order{static_cast<uint8_t>(255 - rec.priority), rec.sequence};
+            if (rec.dedup_key != 0) {
+                if (auto it = dedup_.find(rec.dedup_key); it != dedup_.end()) {
+                    retire(it->second);
+                    ++stats_.superseded;
+                }
+                dedup_[rec.dedup_key] = order;
+            }
+            pending_[order] = offset;
+            live_bytes_ += record_size(rec.length);
+        }
+
+        inline void retire(const Order &order) {
+            auto it = pending_.find(order);
+            if (it == pending_.end()) {
+                return;
+            }
+            auto &rec = record(it->second);
+            rec.state = DONE;
+            flush(it->second, sizeof(RecordHeader));
+            if (rec.dedup_key != 0) {
+                auto key = dedup_.find(rec.dedup_key);
+                if (key != dedup_.end() && key->second == order) {
+                    dedup_.erase(key);
+                }
+            }
+            live_bytes_ -= record_size(rec.length);
+            pending_.erase(it);
+        }
+
+        inline void drop_expired(uint64_t now) {
+            for (auto it = pending_.begin(); it != pending_.end();) {
+                auto order = it->first;
+                auto expires = record(it->second).expires_ms;
+                ++it;
+                if (expires != 0 && expires <= now) {
+                    retire(order);
+                    ++stats_.expired;
+                }
+            }
+        }
+
+        // Copy the live records into a fresh file and swap it in. The rename is the commit point.
+        inline bool compact() {
+            if (pending_.empty()) {
+                header().tail = HEADER_SIZE; // nothing to keep: a single header write
+                flush(0, HEADER_SIZE);
+                return true;
+            }
+
+            std::string temp = path_ + ".compact";
+            int fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0 || ftruncate(fd, capacity_) < 0) {
+                std::cerr << "Failed to compact outbox " << path_ << ": " << strerror(errno) << std::endl;
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+                return false;
+            }
+            void *map = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                std::cerr << "Failed to compact outbox " << path_ << ": " << strerror(errno) << std::endl;
+                ::close(fd);
+                return false;
+            }
+            auto *dest = static_cast<uint8_t *>(map);
+
+            // Live records keep their file order so a reload sees dedup keys in the order they were written
+            std::map<size_t, Order> by_offset;
+            for (const auto &[order, offset] : pending_) {
+                by_offset[offset] = order;
+            }
+            memcpy(dest, map_, HEADER_SIZE);
+            size_t tail = HEADER_SIZE;
+            for (auto &[offset, order] : by_offset) {
+                size_t size = record_size(record(offset).length);
+                memcpy(dest + tail, map_ + offset, size);
+                pending_[order] = tail;
+                tail += size;
+            }
+            reinterpret_cast<FileHeader *>(dest)->tail = tail;
+            msync(dest, tail, MS_SYNC);
+
+            if (rename(temp.c_str(), path_.c_str()) < 0) {
+                std::cerr << "Failed to replace outbox " << path_ << ": " << strerror(errno) << std::endl;
+                for (auto &[offset, order] : by_offset) {
+                    pending_[order] = offset;
+                }
+                munmap(map, capacity_);
+                ::close(fd);
+                unlink(temp.c_str());
+                return false;
+            }
+            unmap_file();
+            fd_ = fd;
+            map_ = dest;
+            return true;
+        }
+
+        // Make room for `needed` bytes, evicting the oldest records of the lowest priority not above `priority`.
+        // Eviction frees a sixteenth of the file beyond what is needed so a full outbox does not compact per push.
+        inline bool reserve(size_t needed, uint8_t priority) {
+            if (header().tail + needed <= capacity_) {
+                return true;
+            }
+            size_t space = capacity_ - HEADER_SIZE;
+            if (needed > space) {
+                return false;
+            }
+            if (live_bytes_ + needed > space) {
+                size_t target = space - std::min(space - needed, space / 16);
+                while (!pending_.empty() && live_bytes_ + needed > target) {
+                    uint8_t lowest = std::prev(pending_.end())->first.first;
+                    if (255 - lowest > priority) {
+                        break;
+                    }
+                    retire(pending_.lower_bound({lowest, 0})->first);
+                    ++stats_.evicted;
+                }
+                if (live_bytes_ + needed > space) {
+                    return false;
+                }
+            }
+            return compact() && header().tail + needed <= capacity_;
+        }
+
+      public:
+        inline Outbox() = default;
+        inline ~Outbox() { close(); }
+
+        Outbox(const Outbox &) = delete;
+        Outbox &operator=(const Outbox &) = delete;
+
+        // Open or create the file; pending records from a previous run are picked up again
+        inline bool open(const std::string &path, const OutboxConfig &config) {
+            close();
+            size_t capacity = std::max<size_t>(config.capacity, HEADER_SIZE + 4096) & ~size_t(7);
+            if (!map_file(path, capacity)) {
+                return false;
+            }
+            path_ = path;
+            sync_writes_ = config.sync_writes;
+            load();
+            flush(0, HEADER_SIZE);
+            return true;
+        }
+
+        inline void close() {
+            if (map_) {
+                msync(map_, header().tail, MS_SYNC);
+            }
+            unmap_file();
+            pending_.clear();
+            dedup_.clear();
+            live_bytes_ = 0;
+        }
+
+        inline bool is_open() const { return map_ != nullptr; }
+
+        // Queue a payload. A non-zero dedup key replaces any pending message with the same key, so only the latest
+        // state of, say, a position report is sent after an outage. Returns false if it does not fit.
+        inline bool push(const char *data, size_t size, uint8_t priority = 0, uint64_t dedup_key = 0,
+                         std::chrono::milliseconds ttl = std::chrono::milliseconds(0)) {
+            if (!map_ || size > UINT32_MAX) {
+                ++stats_.rejected;
+                return false;
+            }
+            uint64_t now = now_ms();
+            drop_expired(now);
+            size_t size_needed = record_size(size);
+            if (!reserve(size_needed, priority)) {
+                ++stats_.rejected;
+                return false;
+            }
+
+            auto &head = header();
+            size_t offset = head.tail;
+            auto &rec = record(offset);
+            rec.length = static_cast<uint32_t>(size);
+            rec.priority = priority;
+            rec.state = PENDING;
+            rec.reserved = 0;
+            rec.sequence = head.next_sequence++;
+            rec.dedup_key = dedup_key;
+            rec.expires_ms = ttl.count() > 0 ? now + ttl.count() : 0;
+            memcpy(map_ + offset + sizeof(RecordHeader), data, size);
+            flush(offset, size_needed);
+
+            head.tail = offset + size_needed; // commit
+            flush(0, HEADER_SIZE);
+            index(rec, offset);
+            ++stats_.queued;
+            return true;
+        }
+
+        // Copy out the next message in delivery order, skipping expired ones, without retiring it. False when
+        // nothing is pending.
+        inline bool front(std::string &payload) {
+            drop_expired(now_ms());
+            if (pending_.empty()) {
+                return false;
+            }
+            auto it = pending_.begin();
+            const auto &rec = record(it->second);
+            payload.assign(reinterpret_cast<const char *>(map_ + it->second + sizeof(RecordHeader)), rec.length);
+            return true;
+        }
+
+        // Retire the message front() returned, once it has been sent
+        inline void pop() {
+            if (pending_.empty()) {
+                return;
+            }
+            retire(pending_.begin()->first);
+            ++stats_.delivered;
+            if (pending_.empty()) {
+                compact(); // drained: rewind to the start of the file
+            }
+        }
+
+        inline bool empty() const { return pending_.empty(); }
+        inline size_t size() const { return pending_.size(); }
+
+        inline void clear() {
+            while (!pending_.empty()) {
+                retire(pending_.begin()->first);
+            }
+            if (map_) {
+                compact();
+            }
+        }
+
+        inline OutboxStats stats() const {
+            OutboxStats stats = stats_;
+            stats.pending = pending_.size();
+            stats.bytes_used = map_ ? reinterpret_cast<const FileHeader *>(map_)->tail : 0;
+            return stats;
+        }
+    };
+
+} // namespace impulse
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace impulse {
+
+    // Messages sent on several paths at once carry a small envelope so the receiver can deliver the first copy and
+    // drop the rest:
+    //
+    //   [MAGIC:2][origin:4][sequence:4][message]
+    //
+    // The origin is random per sending Transport, so a restarted sender never collides with its old sequence numbers.
+    namespace redundancy {
+        static constexpr uint8_t MAGIC[2] = {0xD7, 0x5E};
+        static constexpr size_t ENVELOPE_SIZE = 10;
+
+        inline void write_envelope(char *out, uint32_t origin, uint32_t sequence) {
+            memcpy(out, MAGIC, sizeof(MAGIC));
+            memcpy(out + 2, &origin, sizeof(origin));
+            memcpy(out + 6, &sequence, sizeof(sequence));
+        }
+
+        inline bool read_envelope(const char *data, size_t size, uint32_t &origin, uint32_t &sequence) {
+            if (size < ENVELOPE_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+                return false;
+            }
+            memcpy(&origin, data + 2, sizeof(origin));
+            memcpy(&sequence, data + 6, sizeof(sequence));
+            return true;
+        }
+    } // namespace redundancy
+
+    struct PathStats {
+        std::string name;
+        uint64_t sent = 0;
+        uint64_t received = 0;   // envelopes that arrived on this path
+        uint64_t first = 0;      // copies that arrived here before any other path: the path that "won"
+        uint64_t duplicates = 0; // copies that lost the race
+        std::chrono::microseconds mean_lag{0}; // how far behind the winner this path's duplicates arrived
+        std::chrono::microseconds max_lag{0};
+    };
+
+    // Per-origin record of delivered sequence numbers, in blocks of 64 as bitmaps. A copy is new unless its bit is
+    // set, however far behind the newest sequence it is: the outbox drains queued messages long after later ones
+    // went out directly. Blocks untouched for `retention` are forgotten, so keep it at least as long as the senders'
+    // outbox TTL; past `max_sequences` per origin the oldest block goes first, bounding memory against a sender
+    // that jumps around. Not thread-safe; the owner serializes access.
+    class DedupWindow {
+      public:
+        static constexpr uint32_t WINDOW = 64;                       // sequences per block
+        static constexpr std::chrono::minutes DEFAULT_RETENTION{10}; // OutboxConfig::default_ttl
+        static constexpr size_t DEFAULT_MAX_SEQUENCES = 65536;        // ten minutes at 100 messages a second
+
+      private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Block {
+            uint64_t seen = 0; // bit i: sequence block * WINDOW + i was delivered
+            Clock::time_point touched;
+        };
+
+        struct Origin {
+            std::map<uint32_t, Block> blocks; // sequence / WINDOW -> block
+            // First copy of the last WINDOW sequences, for the lag of their duplicates
+            std::array<uint32_t, WINDOW> sequence{};
+            std::array<Clock::time_point, WINDOW> arrival{};
+            Clock::time_point last_heard;
+            Clock::time_point next_expiry;
+        };
+
+        std::map<uint32_t, Origin> origins_;
+        size_t max_origins_;
+        Clock::duration retention_;
+        size_t max_blocks_;
+        // Expired blocks are reused for new ones, as is an origin's oldest once it holds max_blocks_, so the window
+        // stops allocating when it is full. Capacity is reserved up front; expired blocks beyond it are freed.
+        std::vector<std::map<uint32_t, Block>::node_type> spare_;
+
+        inline void prune() {
+            while (origins_.size() > max_origins_) {
+                auto oldest = origins_.begin();
+                for (auto it = origins_.begin(); it != origins_.end(); ++it) {
+                    if (it->second.last_heard < oldest->second.last_heard) {
+                        oldest = it;
+                    }
+                }
+                origins_.erase(oldest);
+            }
+        }
+
+        // Forget blocks past retention; a scan per origin per second at most
+        inline void expire(Origin &state, Clock::time_point now) {
+            if (now < state.next_expiry) {
+                return;
+            }
+            state.next_expiry = now + std::min<Clock::duration>(std::chrono::seconds(1), retention_);
+            for (auto it = state.blocks.begin(); it != state.blocks.end();) {
+                if (now - it->second.touched > retention_) {
+                    auto node = state.blocks.extract(it++);
+                    if (spare_.size() < spare_.capacity()) {
+                        spare_.push_back(std::move(node));
+                    }
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        inline Block &block_of(Origin &state, uint32_t index) {
+            auto it = state.blocks.find(index);
+            if (it != state.blocks.end()) {
+                return it->second;
+            }
+            std::map<uint32_t, Block>::node_type node;
+            if (state.blocks.size() >= max_blocks_) {
+                node = state.blocks.extract(state.blocks.begin());
+            } else if (!spare_.empty()) {
+                node = std::move(spare_.back());
+                spare_.pop_back();
+            } else {
+                return state.blocks[index];
+            }
+            node.key() = index;
+            node.mapped() = Block{};
+            return state.blocks.insert(std::move(node)).position->second;
+        }
+
+      public:
+        inline explicit DedupWindow(size_t max_origins = 256, Clock::duration retention = DEFAULT_RETENTION,
+                                    size_t max_sequences = DEFAULT_MAX_SEQUENCES)
+            : max_origins_(max_origins) {
+            set_retention(retention, max_sequences);
+        }
+
+        // True if (origin, sequence) has not been seen. For a duplicate, `lag` is how long after the first copy
+        // (zero when that was more than WINDOW sequences ago).
+        inline bool accept(uint32_t origin, uint32_t sequence, Clock::time_point now, Clock::duration &lag) {
+            auto [it, inserted] = origins_.try_emplace(origin);
+            Origin &state = it->second;
+            state.last_heard = now;
+            expire(state, now);
+
+            Block &block = block_of(state, sequence / WINDOW);
+            uint64_t bit = uint64_t(1) << (sequence % WINDOW);
+            size_t slot = sequence % WINDOW;
+            if (block.seen & bit) {
+                lag = state.sequence[slot] == sequence ? now - state.arrival[slot] : Clock::duration::zero();
+                return false;
+            }
+            block.seen |= bit;
+            block.touched = now;
+            state.sequence[slot] = sequence;
+            state.arrival[slot] = now;
+            if (inserted) {
+                prune();
+            }
+            return true;
+        }
+
+        inline void set_retention(Clock::duration retention, size_t max_sequences = DEFAULT_MAX_SEQUENCES) {
+            retention_ = retention;
+            max_blocks_ = std::max<size_t>(1, max_sequences / WINDOW);
+            spare_.reserve(max_blocks_);
+        }
+
+        inline void clear() { origins_.clear(); }
+    };
+
+} // namespace impulse
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace impulse {
+
+    // Messages a gateway forwards between networks keep the address of the node that sent them:
+    //
+    //   [MAGIC:2][origin IPv6:16][message]
+    //
+    // Transport strips the header and reports the origin as the sender, so a relayed Position is filed under the
+    // robot that sent it rather than under the gateway.
+    namespace relay {
+        static constexpr uint8_t MAGIC[2] = {0xD7, 0x6A};
+        static constexpr size_t HEADER_SIZE = 18;
+
+        // False if `origin` is not an IPv6 address
+        inline bool write_header(char *out, const std::string &origin) {
+            in6_addr addr;
+            if (inet_pton(AF_INET6, origin.c_str(), &addr) != 1) {
+                return false;
+            }
+            memcpy(out, MAGIC, sizeof(MAGIC));
+            memcpy(out + 2, &addr, sizeof(addr));
+            return true;
+        }
+
+        inline bool read_header(const char *data, size_t size, std::string &origin) {
+            if (size <= HEADER_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+                return false;
+            }
+            char str[INET6_ADDRSTRLEN];
+            if (inet_ntop(AF_INET6, data + 2, str, sizeof(str)) == nullptr) {
+                return false;
+            }
+            origin = str;
+            return true;
+        }
+    } // namespace relay
+
+} // namespace impulse
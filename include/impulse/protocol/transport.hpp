@@ -2,21 +2,45 @@
 
 #include "impulse/network/interface.hpp"
 #include "impulse/protocol/message.hpp"
+#include "impulse/protocol/outbox.hpp"
+#include "impulse/protocol/redundancy.hpp"
+#include "impulse/protocol/relay.hpp"
+#include "impulse/protocol/view.hpp"
+#include "impulse/util/memory.hpp"
+#include "impulse/util/realtime.hpp"
 
 #include <atomic>
 #include <chrono>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
 #include <random>
+#include <span>
 #include <thread>
 #include <vector>
 
 namespace impulse {
 
-    template <typename MessageT = Message> class Transport {
+    // Per-message delivery options; they only take effect with an outbox enabled
+    struct SendOptions {
+        uint8_t priority = 0;   // higher drains first after an outage
+        uint64_t dedup_key = 0; // non-zero: a newer message with the same key replaces a queued one
+        std::chrono::milliseconds ttl = std::chrono::milliseconds(0); // 0: the outbox default
+    };
+
+    // One message of a batch handed to a batch handler
+    template <typename MessageT> struct Received {
+        MessageT message;
+        std::string from_addr;
+        uint16_t from_port = 0;
+        std::chrono::steady_clock::time_point received_at;
+    };
+
+    template <typename MessageT = Message> class Transport : public Pollable {
       private:
         std::string name_;
         uint64_t join_time_;
@@ -24,37 +48,270 @@ namespace impulse {
 
         std::thread message_thread_;
         std::atomic<bool> running_;
+        Threading threading_;
         MessageT message_;
 
         bool continuous_;
         std::chrono::milliseconds interval_;
+        std::chrono::steady_clock::time_point last_broadcast_;
+        WakeupMonitor wakeup_;
 
         // Generic message handler function
         std::function<void(const MessageT &, const std::string &, uint16_t)> message_handler_;
+        std::function<void(const View<MessageT> &, const std::string &, uint16_t)> view_handler_;
+
+        // Bulk delivery (opt-in): messages collect until the interface ends a receive batch, the window runs out or
+        // max_batch is reached. Slots are reused, so steady-state batching does not allocate.
+        std::mutex batch_mutex_;
+        std::mutex deliver_mutex_; // serializes batch handler calls; guards batch_handler_ and delivering_
+        std::function<void(std::span<const Received<MessageT>>)> batch_handler_;
+        std::atomic<bool> batching_{false};
+        std::pmr::vector<Received<MessageT>> batch_;
+        std::pmr::vector<Received<MessageT>> delivering_;
+        size_t batch_size_ = 0;
+        std::chrono::microseconds batch_window_{0};
+        size_t max_batch_ = 0;
+
+        inline void flush_batch() {
+            std::lock_guard<std::mutex> deliver(deliver_mutex_);
+            size_t count;
+            {
+                std::lock_guard<std::mutex> lock(batch_mutex_);
+                if (batch_size_ == 0) {
+                    return;
+                }
+                std::swap(batch_, delivering_);
+                count = batch_size_;
+                batch_size_ = 0;
+            }
+            if (batch_handler_) {
+                batch_handler_(std::span<const Received<MessageT>>(delivering_.data(), count));
+            }
+        }
+
+        inline void deliver(const MessageT &msg, const std::string &from_addr, uint16_t from_port) {
+            if (batching_) {
+                bool queued = false, full = false;
+                {
+                    std::lock_guard<std::mutex> lock(batch_mutex_);
+                    if (batching_) { // may have been turned off while we waited for the lock
+                        if (batch_size_ == batch_.size()) {
+                            batch_.emplace_back();
+                        }
+                        auto &slot = batch_[batch_size_++];
+                        slot.message = msg;
+                        slot.from_addr = from_addr;
+                        slot.from_port = from_port;
+                        slot.received_at = std::chrono::steady_clock::now();
+                        queued = true;
+                        full = batch_size_ >= max_batch_;
+                    }
+                }
+                if (full) {
+                    flush_batch();
+                }
+                if (queued) {
+                    return;
+                }
+            }
+            // Call custom handler if set
+            if (message_handler_) {
+                message_handler_(msg, from_addr, from_port);
+            }
+        }
+
+        // Decode arenas for variable-length messages: one per thread receiving at the same time, kept for reuse
+        static constexpr size_t ARENA_SIZE = 4096;
+        std::mutex arenas_mutex_;
+        std::pmr::memory_resource *memory_resource_ = std::pmr::get_default_resource();
+        std::vector<std::unique_ptr<Arena>> arenas_;
+
+        inline std::unique_ptr<Arena> acquire_arena() {
+            std::lock_guard<std::mutex> lock(arenas_mutex_);
+            if (arenas_.empty()) {
+                return std::make_unique<Arena>(ARENA_SIZE, memory_resource_);
+            }
+            auto arena = std::move(arenas_.back());
+            arenas_.pop_back();
+            return arena;
+        }
+
+        inline void release_arena(std::unique_ptr<Arena> arena) {
+            arena->release();
+            std::lock_guard<std::mutex> lock(arenas_mutex_);
+            if (arena->upstream() == memory_resource_) { // else set_memory_resource ran meanwhile; let it go
+                arenas_.push_back(std::move(arena));
+            }
+        }
+
+        // Store-and-forward while the interface is down (opt-in)
+        std::mutex outbox_mutex_;
+        std::unique_ptr<Outbox> outbox_;
+        OutboxConfig outbox_config_;
+        double drain_tokens_ = 0.0;
+        std::chrono::steady_clock::time_point last_drain_;
+        std::string drain_payload_;
+
+        // One send at a time through reused buffers, so sending does not allocate once they have grown
+        std::mutex send_mutex_;
+        std::string send_payload_;
+        std::pmr::vector<NetworkInterface *> send_paths_;
+
+        // Redundant delivery: with extra paths every message is enveloped and sent on all of them, and the receiver
+        // delivers the first copy. Path 0 is the primary interface.
+        std::mutex paths_mutex_;
+        std::vector<NetworkInterface *> paths_;
+        std::vector<PathStats> path_stats_;
+        std::vector<std::chrono::microseconds> path_lag_total_;
+        DedupWindow dedup_;
+        uint32_t origin_;
+        std::atomic<uint32_t> sequence_{0};
+
+        inline size_t path_index(NetworkInterface *via) const {
+            for (size_t i = 1; i < paths_.size(); ++i) {
+                if (paths_[i] == via) {
+                    return i;
+                }
+            }
+            return 0;
+        }
+
+        // Send queued messages at the configured rate while the interface is up
+        inline void drain_outbox() {
+            std::lock_guard<std::mutex> lock(outbox_mutex_);
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - last_drain_).count();
+            last_drain_ = now;
+            if (!outbox_ || outbox_->empty() || !network_interface_->is_connected()) {
+                drain_tokens_ = 0.0;
+                return;
+            }
+            // The loop wakes every 100 ms, so the burst must cover at least one period at the drain rate
+            double burst = std::max(outbox_config_.drain_burst, outbox_config_.drain_rate * 0.1);
+            drain_tokens_ = std::min(burst, drain_tokens_ + elapsed * outbox_config_.drain_rate);
+            while (drain_tokens_ >= 1.0 && outbox_->front(drain_payload_)) {
+                network_interface_->multicast_message(drain_payload_);
+                if (!network_interface_->is_connected()) {
+                    break; // the link went down again with this send; the message stays queued
+                }
+                outbox_->pop();
+                drain_tokens_ -= 1.0;
+            }
+        }
+
+        // Whether the bytes are a MessageT, plain or enveloped. A relay header counts only when what follows it
+        // is: a MessageT of our own may well start with the relay magic.
+        inline static bool carries_message(const char *data, size_t size) {
+            constexpr size_t envelope = redundancy::ENVELOPE_SIZE;
+            return message_matches<MessageT>(data, size) ||
+                   (size > envelope && memcmp(data, redundancy::MAGIC, sizeof(redundancy::MAGIC)) == 0 &&
+                    message_matches<MessageT>(data + envelope, size - envelope));
+        }
+
+        // A message without relay header: plain, or enveloped when it was sent on several paths
+        inline void receive(const char *data, size_t size, const std::string &from_addr, uint16_t from_port,
+                            NetworkInterface *via) {
+            uint32_t origin, sequence;
+            if (size > redundancy::ENVELOPE_SIZE &&
+                message_matches<MessageT>(data + redundancy::ENVELOPE_SIZE, size - redundancy::ENVELOPE_SIZE) &&
+                redundancy::read_envelope(data, size, origin, sequence)) {
+                auto now = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> lock(paths_mutex_);
+                size_t path = path_index(via);
+                std::chrono::steady_clock::duration lag;
+                auto &stats = path_stats_[path];
+                ++stats.received;
+                if (!dedup_.accept(origin, sequence, now, lag)) {
+                    auto lag_us = std::chrono::duration_cast<std::chrono::microseconds>(lag);
+                    ++stats.duplicates;
+                    path_lag_total_[path] += lag_us;
+                    stats.max_lag = std::max(stats.max_lag, lag_us);
+                    return;
+                }
+                ++stats.first;
+                data += redundancy::ENVELOPE_SIZE;
+                size -= redundancy::ENVELOPE_SIZE;
+            } else if (!message_matches<MessageT>(data, size)) {
+                return;
+            }
+            decode(data, size, from_addr, from_port);
+        }
+
+        inline void decode(const char *data, size_t size, const std::string &from_addr, uint16_t from_port) {
+            if constexpr (VariableLength<MessageT>) {
+                auto arena = acquire_arena();
+                {
+                    MessageT msg;
+                    if (msg.deserialize(data, size, arena.get())) {
+                        deliver(msg, from_addr, from_port);
+                    }
+                } // the message goes before its arena is released
+                release_arena(std::move(arena));
+            } else {
+                if (view_handler_) {
+                    view_handler_(View<MessageT>(data, size), from_addr, from_port);
+                }
+                if (message_handler_ || batching_) { // decode only for consumers of a copy
+                    MessageT msg;
+                    msg.deserialize(data);
+                    deliver(msg, from_addr, from_port);
+                }
+            }
+        }
+
+        // Periodic work, from the loop thread or poll_once: outbox drain, continuous broadcast, batch window
+        inline void run_timers() {
+            drain_outbox();
+            auto now = std::chrono::steady_clock::now();
+            if (continuous_) {
+                message_.set_timestamp(now.time_since_epoch().count());
+                if (now - last_broadcast_ >= interval_) {
+                    // Only the latest periodic broadcast is worth keeping across an outage
+                    send_message(message_, {0, UINT64_MAX});
+                    last_broadcast_ = now;
+                }
+            }
+            if (batching_) {
+                bool due;
+                {
+                    std::lock_guard<std::mutex> lock(batch_mutex_);
+                    due = batch_size_ > 0 && now - batch_[0].received_at >= batch_window_;
+                }
+                if (due) {
+                    flush_batch();
+                }
+            }
+        }
 
         inline void message_loop() {
-            auto last_broadcast = std::chrono::steady_clock::now();
             while (running_) {
-                if (continuous_) {
-                    auto now = std::chrono::steady_clock::now();
-                    message_.set_timestamp(now.time_since_epoch().count());
-                    if (now - last_broadcast >= interval_) {
-                        send_message(message_);
-                        last_broadcast = now;
-                    }
+                run_timers();
+                auto period = std::chrono::microseconds(std::chrono::milliseconds(100));
+                if (batching_) {
+                    std::lock_guard<std::mutex> lock(batch_mutex_);
+                    period = std::min(period, std::max(batch_window_, std::chrono::microseconds(500)));
                 }
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                auto deadline = std::chrono::steady_clock::now() + period;
+                std::this_thread::sleep_until(deadline);
+                wakeup_.record_wakeup(deadline);
             }
         }
 
       public:
-        inline Transport(const std::string &name, NetworkInterface *network_interface)
-            : name_(name), network_interface_(network_interface), running_(false), continuous_(false) {
+        // With Threading::polled no loop thread is started; the application calls poll_once (see Pollable)
+        inline Transport(const std::string &name, NetworkInterface *network_interface,
+                         Threading threading = Threading::threads)
+            : name_(name), network_interface_(network_interface), running_(false), threading_(threading),
+              continuous_(false), last_broadcast_(std::chrono::steady_clock::now()), paths_{network_interface},
+              path_stats_(1), path_lag_total_(1), origin_(std::random_device{}()) {
+            path_stats_[0].name = network_interface->get_interface_name();
             join_time_ = std::chrono::duration_cast<std::chrono::milliseconds>(
                              std::chrono::system_clock::now().time_since_epoch())
                              .count();
             running_ = true;
-            message_thread_ = std::thread(&Transport<MessageT>::message_loop, this);
+            if (threading_ == Threading::threads) {
+                message_thread_ = std::thread(&Transport<MessageT>::message_loop, this);
+            }
         }
 
         inline ~Transport() {
@@ -64,14 +321,124 @@ namespace impulse {
             }
         }
 
-        inline void send_message(const MessageT &msg) {
+        inline void send_message(const MessageT &msg, const SendOptions &options = {}) {
             // Serialize and send via LAN interface
+            std::lock_guard<std::mutex> send_lock(send_mutex_);
             auto size = msg.get_size();
-            std::vector<char> buffer(size);
-            msg.serialize(buffer.data());
-            std::string message(buffer.data(), size);
+            {
+                std::lock_guard<std::mutex> lock(paths_mutex_);
+                send_paths_.assign(paths_.begin() + 1, paths_.end());
+                for (size_t i = 0; i < path_stats_.size(); ++i) {
+                    path_stats_[i].sent += i == 0 || paths_[i]->is_connected();
+                }
+            }
+            size_t header = send_paths_.empty() ? 0 : redundancy::ENVELOPE_SIZE;
+            send_payload_.resize(header + size);
+            if (header) {
+                redundancy::write_envelope(send_payload_.data(), origin_, sequence_++);
+            }
+            msg.serialize(send_payload_.data() + header);
+            size += header;
+
+            for (auto *path : send_paths_) {
+                if (path->is_connected()) {
+                    path->multicast_message(send_payload_);
+                }
+            }
+
+            {
+                // Queue behind anything already waiting so delivery order is kept
+                std::lock_guard<std::mutex> lock(outbox_mutex_);
+                if (outbox_ && (!network_interface_->is_connected() || !outbox_->empty())) {
+                    auto ttl = options.ttl.count() > 0 ? options.ttl : outbox_config_.default_ttl;
+                    if (!outbox_->push(send_payload_.data(), size, options.priority, options.dedup_key, ttl)) {
+                        std::cerr << "Outbox for " << name_ << " is full, message dropped" << std::endl;
+                    }
+                    return;
+                }
+            }
+
+            network_interface_->multicast_message(send_payload_);
+        }
 
-            network_interface_->multicast_message(message);
+        // Where the transport's internal buffers come from; set before traffic starts. Once they have grown to the
+        // largest message and batch, sending and receiving no longer allocate.
+        inline void set_memory_resource(std::pmr::memory_resource *resource) {
+            {
+                std::lock_guard<std::mutex> lock(send_mutex_);
+                reset_resource(send_paths_, resource);
+            }
+            {
+                std::lock_guard<std::mutex> lock(arenas_mutex_);
+                memory_resource_ = resource;
+                arenas_.clear();
+            }
+            std::lock_guard<std::mutex> deliver(deliver_mutex_);
+            std::lock_guard<std::mutex> lock(batch_mutex_);
+            reset_resource(batch_, resource);
+            reset_resource(delivering_, resource);
+            batch_size_ = 0;
+        }
+
+        // Keep messages sent while the interface is down in <directory>/<name>.outbox and deliver them, at
+        // config.drain_rate, once it is back. Messages left from a previous run are delivered too.
+        inline bool enable_outbox(const OutboxConfig &config = {}) {
+            auto outbox = std::make_unique<Outbox>();
+            if (!outbox->open(config.directory + "/" + name_ + ".outbox", config)) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(outbox_mutex_);
+            outbox_ = std::move(outbox);
+            outbox_config_ = config;
+            drain_tokens_ = 0.0;
+            last_drain_ = std::chrono::steady_clock::now();
+            return true;
+        }
+
+        // Undelivered messages stay in the file for the next enable_outbox
+        inline void disable_outbox() {
+            std::lock_guard<std::mutex> lock(outbox_mutex_);
+            outbox_.reset();
+        }
+
+        // Also send every message on `path`, e.g. LoRa next to the LAN, for messages that must get through. Receivers
+        // pass the interface a message arrived on to handle_incoming_message and get each message once, from
+        // whichever path delivered it first. Paths other than the primary are not covered by the outbox.
+        inline void add_path(NetworkInterface *path) {
+            std::lock_guard<std::mutex> lock(paths_mutex_);
+            if (path_index(path) != 0 || path == network_interface_) {
+                return;
+            }
+            paths_.push_back(path);
+            path_stats_.push_back({});
+            path_stats_.back().name = path->get_interface_name();
+            path_lag_total_.push_back(std::chrono::microseconds(0));
+        }
+
+        // Arrival statistics per path: how often each one delivered first and how far behind the others were
+        inline std::vector<PathStats> get_path_stats() {
+            std::lock_guard<std::mutex> lock(paths_mutex_);
+            auto stats = path_stats_;
+            for (size_t i = 0; i < stats.size(); ++i) {
+                if (stats[i].duplicates) {
+                    stats[i].mean_lag = path_lag_total_[i] / stats[i].duplicates;
+                }
+            }
+            return stats;
+        }
+
+        // How long a received sequence number is remembered for recognising later copies, and how many are kept per
+        // sender at most. Messages a sender's outbox drains late are told apart from duplicates for this long; keep
+        // it at least the senders' outbox TTL.
+        inline void set_dedup_retention(std::chrono::steady_clock::duration retention,
+                                        size_t max_sequences = DedupWindow::DEFAULT_MAX_SEQUENCES) {
+            std::lock_guard<std::mutex> lock(paths_mutex_);
+            dedup_.set_retention(retention, max_sequences);
+        }
+
+        inline OutboxStats get_outbox_stats() {
+            std::lock_guard<std::mutex> lock(outbox_mutex_);
+            return outbox_ ? outbox_->stats() : OutboxStats{};
         }
 
         inline std::string get_address() const { return network_interface_->get_address(); }
@@ -81,6 +448,14 @@ namespace impulse {
             message_handler_ = handler;
         }
 
+        // Handler reading received messages in place instead of from a decoded copy, for fixed-layout types (see
+        // view.hpp). Runs before the message handler; when it is the only consumer, nothing is decoded at all.
+        inline void
+        set_view_handler(std::function<void(const View<MessageT> &, const std::string &, uint16_t)> handler) {
+            static_assert(!VariableLength<MessageT>, "variable-length messages have no fixed layout to view");
+            view_handler_ = handler;
+        }
+
         // Set message for continuous broadcasting
         inline void set_broadcast(const MessageT &message,
                                   std::chrono::milliseconds interval = std::chrono::milliseconds(1000)) {
@@ -92,16 +467,96 @@ namespace impulse {
         inline void unset_broadcast() { continuous_ = false; }
 
         // Handle incoming message (for external routing)
+        // `via` is the interface the message arrived on; it tells redundant copies apart (nullptr: the primary).
+        // Messages relayed by a gateway are reported as coming from their original sender.
         inline void handle_incoming_message(const std::string &message, const std::string &from_addr,
-                                            uint16_t from_port) {
-            MessageT msg;
-            if (message.size() == msg.get_size()) {
-                msg.deserialize(message.c_str());
-                // Call custom handler if set
-                if (message_handler_) {
-                    message_handler_(msg, from_addr, from_port);
+                                            uint16_t from_port, NetworkInterface *via = nullptr) {
+            // Kept per receiving thread so the origin string is not reallocated for every relayed message
+            thread_local std::string relayed_from;
+            if (message.size() > relay::HEADER_SIZE &&
+                carries_message(message.data() + relay::HEADER_SIZE, message.size() - relay::HEADER_SIZE) &&
+                relay::read_header(message.data(), message.size(), relayed_from)) {
+                receive(message.data() + relay::HEADER_SIZE, message.size() - relay::HEADER_SIZE, relayed_from,
+                        from_port, via);
+                return;
+            }
+            receive(message.data(), message.size(), from_addr, from_port, via);
+        }
+
+        // Receive messages in bulk instead of one handler call each. A batch is handed over when the interface
+        // signals the end of a receive batch (wire its batch end callback to end_of_batch), when its oldest message
+        // has waited `window`, or when it holds `max_batch` messages. Replaces the per-message handler while set;
+        // pass nullptr to go back to it.
+        inline void set_batch_handler(std::function<void(std::span<const Received<MessageT>>)> handler,
+                                      std::chrono::microseconds window = std::chrono::milliseconds(2),
+                                      size_t max_batch = 256) {
+            std::lock_guard<std::mutex> deliver(deliver_mutex_);
+            size_t count;
+            {
+                // Messages still collecting go to the previous handler; with batching turned off, new ones go
+                // straight to the per-message handler from here on
+                std::lock_guard<std::mutex> lock(batch_mutex_);
+                if (!handler) {
+                    batching_ = false;
                 }
+                std::swap(batch_, delivering_);
+                count = batch_size_;
+                batch_size_ = 0;
+            }
+            if (count > 0 && batch_handler_) {
+                batch_handler_(std::span<const Received<MessageT>>(delivering_.data(), count));
+            }
+
+            std::lock_guard<std::mutex> lock(batch_mutex_);
+            batch_handler_ = std::move(handler);
+            batch_window_ = window;
+            max_batch_ = std::max<size_t>(max_batch, 1);
+            batching_ = static_cast<bool>(batch_handler_);
+        }
+
+        // Hand the messages collected so far to the batch handler
+        inline void end_of_batch() { flush_batch(); }
+
+        inline Threading get_threading() const { return threading_; }
+
+        // Affinity, real-time priority and name of the loop thread (broadcasts, outbox drain, batch window)
+        inline bool set_thread_config(const ThreadConfig &config) {
+            return apply_thread_config(message_thread_, config, name_.substr(0, 15));
+        }
+
+        // How late the loop thread wakes up for its periodic work
+        inline WakeupStats get_wakeup_stats() const { return wakeup_.stats(); }
+
+        inline std::chrono::steady_clock::time_point next_deadline() override {
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            if (continuous_) {
+                deadline = last_broadcast_ + interval_;
+            }
+            {
+                // Same cadence as the loop thread while messages wait for the interface
+                std::lock_guard<std::mutex> lock(outbox_mutex_);
+                if (outbox_ && !outbox_->empty()) {
+                    deadline = std::min(deadline, last_drain_ + std::chrono::milliseconds(100));
+                }
+            }
+            if (batching_) {
+                std::lock_guard<std::mutex> lock(batch_mutex_);
+                if (batch_size_ > 0) {
+                    deadline = std::min(deadline, batch_[0].received_at + batch_window_);
+                }
+            }
+            return deadline;
+        }
+
+        // Transports have no descriptors of their own; incoming messages arrive through the interface's poll_once
+        inline void poll_once(std::chrono::milliseconds timeout) override {
+            if (threading_ != Threading::polled) {
+                return;
+            }
+            if (timeout.count() > 0) {
+                wait_readable({}, timeout, next_deadline());
             }
+            run_timers();
         }
     };
 
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "impulse/protocol/message.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace impulse {
+
+    // Read-only access to a received message where it lies, for handlers that look at a field or two and only
+    // sometimes keep the message. A view is valid while the handler runs; materialize() makes the copy to keep.
+    // Views are made over bytes that message_matches accepted, so fields are read unchecked; the constructor
+    // asserts it, and ok() tells in release builds.
+    //
+    // This is the view of memcpy'd structs (Position and friends): fields are found by member pointer, nested
+    // ones by a path of them, and read in host byte order as deserialize would.
+    //   view.get<&Position::timestamp>()
+    //   view.get<&Position::pose, &concord::Pose::point, &concord::Point::x>()
+    template <typename MessageT> class StructView {
+      private:
+        const char *data_;
+        size_t size_;
+        bool ok_;
+
+        template <typename Class, auto Member> inline static size_t offset_of() {
+            // Layout is the compiler's, as for the memcpy that wrote the bytes; measured once on a sample object
+            static const size_t offset = [] {
+                Class sample{};
+                return static_cast<size_t>(reinterpret_cast<const char *>(std::addressof(sample.*Member)) -
+                                           reinterpret_cast<const char *>(std::addressof(sample)));
+            }();
+            return offset;
+        }
+
+        template <typename Class, auto Member, auto... Rest> inline static auto field_at(const char *at) {
+            using Field = std::remove_cvref_t<decltype(std::declval<Class &>().*Member)>;
+            at += offset_of<Class, Member>();
+            if constexpr (sizeof...(Rest) == 0) {
+                static_assert(std::is_trivially_copyable_v<Field>, "only plain fields can be read in place");
+                Field value;
+                memcpy(static_cast<void *>(&value), at, sizeof(Field));
+                return value;
+            } else {
+                return field_at<Field, Rest...>(at);
+            }
+        }
+
+      public:
+        inline StructView(const char *data, size_t size)
+            : data_(data), size_(size), ok_(message_matches<MessageT>(data, size)) {
+            assert(ok_ && "view over bytes that are not a whole message");
+        }
+
+        // Whether the bytes are a whole MessageT; reading fields of a view that is not is undefined
+        inline bool ok() const { return ok_; }
+
+        template <auto Member, auto... Rest> inline auto get() const {
+            return field_at<MessageT, Member, Rest...>(data_);
+        }
+
+        inline MessageT materialize() const {
+            MessageT msg;
+            msg.deserialize(data_);
+            return msg;
+        }
+
+        inline const char *data() const { return data_; }
+        inline size_t size() const { return size_; }
+    };
+
+    template <typename MessageT> struct view_type {
+        using type = StructView<MessageT>;
+    };
+
+    // Types with a View of their own (impulse_gen generates one with an accessor per field) use it
+    template <typename MessageT>
+        requires requires { typename MessageT::View; }
+    struct view_type<MessageT> {
+        using type = typename MessageT::View;
+    };
+
+    template <typename MessageT> using View = typename view_type<MessageT>::type;
+
+} // namespace impulse
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace impulse {
+
+    // Building blocks for explicit wire formats: fields are little-endian whatever the host, written at byte
+    // offsets with no padding, and may be quantized to a smaller integer. Generated message types
+    // (tools/impulse_gen) are built on these; hand-written ones can use them too.
+    namespace wire {
+
+        template <typename T> inline T byteswap(T value) {
+            static_assert(std::is_integral_v<T>);
+            if constexpr (sizeof(T) == 1) {
+                return value;
+            } else if constexpr (sizeof(T) == 2) {
+                return static_cast<T>(__builtin_bswap16(static_cast<uint16_t>(value)));
+            } else if constexpr (sizeof(T) == 4) {
+                return static_cast<T>(__builtin_bswap32(static_cast<uint32_t>(value)));
+            } else {
+                return static_cast<T>(__builtin_bswap64(static_cast<uint64_t>(value)));
+            }
+        }
+
+        // Unsigned integer of the same size, which floats travel as
+        template <typename T> using bits_t = std::conditional_t<
+            sizeof(T) == 1, uint8_t,
+            std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+
+        template <typename T> inline void put(char *out, T value) {
+            static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+            auto bits = std::bit_cast<bits_t<T>>(value);
+            if constexpr (std::endian::native == std::endian::big) {
+                bits = byteswap(bits);
+            }
+            memcpy(out, &bits, sizeof(bits));
+        }
+
+        template <typename T> inline T get(const char *in) {
+            static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+            bits_t<T> bits;
+            memcpy(&bits, in, sizeof(bits));
+            if constexpr (std::is_same_v<T, bool>) {
+                return bits != 0; // any other byte than 0 or 1 would make an invalid bool
+            } else {
+                if constexpr (std::endian::native == std::endian::big) {
+                    bits = byteswap(bits);
+                }
+                return std::bit_cast<T>(bits);
+            }
+        }
+
+        // value -> round((value - offset) / scale), saturated to Q's range
+        template <typename Q> inline Q quantize(double value, double scale, double offset = 0.0) {
+            static_assert(std::is_integral_v<Q>);
+            double steps = std::nearbyint((value - offset) / scale);
+            if (!(steps > static_cast<double>(std::numeric_limits<Q>::min()))) { // also catches NaN
+                return std::numeric_limits<Q>::min();
+            }
+            if (steps >= static_cast<double>(std::numeric_limits<Q>::max())) {
+                return std::numeric_limits<Q>::max();
+            }
+            return static_cast<Q>(steps);
+        }
+
+        template <typename Q> inline double dequantize(Q steps, double scale, double offset = 0.0) {
+            return static_cast<double>(steps) * scale + offset;
+        }
+
+        // Formatting without streams or locale, for to_string of generated types
+        template <typename T> inline void append(std::string &out, T value) {
+            char buffer[32];
+            std::to_chars_result result;
+            if constexpr (std::is_same_v<T, bool>) {
+                out += value ? "true" : "false";
+                return;
+            } else if constexpr (std::is_floating_point_v<T>) {
+                result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, 7);
+            } else if constexpr (sizeof(T) == 1) {
+                result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<int>(value));
+            } else {
+                result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            }
+            out.append(buffer, result.ptr);
+        }
+
+        // Sequential writer for variable-length layouts. Without a buffer it only counts, which is how get_size
+        // measures a message that serialize then writes. Lengths and counts are 16 bits: more does not fit a
+        // datagram anyway.
+        class Writer {
+          private:
+            char *out_;
+            size_t size_ = 0;
+
+          public:
+            inline explicit Writer(char *out = nullptr) : out_(out) {}
+
+            template <typename T> inline void put(T value) {
+                if (out_) {
+                    wire::put<T>(out_ + size_, value);
+                }
+                size_ += sizeof(T);
+            }
+
+            inline void bytes(const void *data, size_t size) {
+                if (out_ && size > 0) {
+                    memcpy(out_ + size_, data, size);
+                }
+                size_ += size;
+            }
+
+            // u16 length, then the characters
+            inline void string(std::string_view text) {
+                size_t length = std::min<size_t>(text.size(), UINT16_MAX);
+                put<uint16_t>(static_cast<uint16_t>(length));
+                bytes(text.data(), length);
+            }
+
+            // u16 count, then each element through write(writer, element)
+            template <typename Range, typename F> inline void repeated(const Range &elements, F &&write) {
+                size_t count = std::min<size_t>(std::size(elements), UINT16_MAX);
+                put<uint16_t>(static_cast<uint16_t>(count));
+                for (const auto &element : elements) {
+                    if (count-- == 0) {
+                        break;
+                    }
+                    write(*this, element);
+                }
+            }
+
+            // u16 byte length of everything written until end_section(), so older readers can skip fields that
+            // were appended to the section later
+            inline size_t begin_section() {
+                size_t at = size_;
+                put<uint16_t>(0);
+                return at;
+            }
+
+            inline void end_section(size_t at) {
+                if (out_) {
+                    wire::put<uint16_t>(out_ + at, static_cast<uint16_t>(size_ - at - 2));
+                }
+            }
+
+            inline size_t size() const { return size_; }
+        };
+
+        // Bounds-checked sequential reader over received bytes. Reading past the end fails the reader for good and
+        // yields zeros and empty strings, so a decoder reads straight through and checks ok() once at the end.
+        class Reader {
+          private:
+            const char *data_;
+            size_t size_;
+            size_t pos_ = 0;
+            bool ok_ = true;
+
+            inline bool take(size_t size) {
+                if (!ok_ || size > size_ - pos_) {
+                    ok_ = false;
+                }
+                return ok_;
+            }
+
+          public:
+            inline Reader(const char *data, size_t size) : data_(data), size_(size) {}
+
+            template <typename T> inline T get() {
+                if (!take(sizeof(T))) {
+                    return T{};
+                }
+                T value = wire::get<T>(data_ + pos_);
+                pos_ += sizeof(T);
+                return value;
+            }
+
+            // Points into the received bytes
+            inline std::string_view string() {
+                size_t length = get<uint16_t>();
+                if (!take(length)) {
+                    return {};
+                }
+                std::string_view text(data_ + pos_, length);
+                pos_ += length;
+                return text;
+            }
+
+            // u16 element count, checked against the bytes left so that a corrupt count cannot make the decoder
+            // reserve much
+            inline size_t count(size_t min_element_size) {
+                size_t count = get<uint16_t>();
+                if (!take(count * min_element_size)) {
+                    return 0;
+                }
+                return count;
+            }
+
+            // The next section as a reader of its own; this one continues after it, whatever the section holds
+            inline Reader section() {
+                size_t length = get<uint16_t>();
+                bool ok = take(length);
+                Reader section(data_ + pos_, ok ? length : 0);
+                section.ok_ = ok;
+                pos_ += section.size_;
+                return section;
+            }
+
+            inline void skip(size_t size) {
+                if (take(size)) {
+                    pos_ += size;
+                }
+            }
+
+            inline size_t remaining() const { return size_ - pos_; }
+            inline bool ok() const { return ok_; }
+        };
+
+    } // namespace wire
+
+} // namespace impulse
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+
+namespace impulse {
+
+    // Counts what goes through a memory resource, for checking that a hot path stopped allocating after warm-up
+    class CountingResource : public std::pmr::memory_resource {
+      private:
+        std::pmr::memory_resource *upstream_;
+        std::atomic<uint64_t> allocations_{0};
+        std::atomic<uint64_t> deallocations_{0};
+        std::atomic<size_t> bytes_in_use_{0};
+        std::atomic<size_t> peak_bytes_{0};
+
+        inline void *do_allocate(size_t bytes, size_t alignment) override {
+            void *p = upstream_->allocate(bytes, alignment);
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            size_t in_use = bytes_in_use_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            size_t peak = peak_bytes_.load(std::memory_order_relaxed);
+            while (in_use > peak && !peak_bytes_.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {
+            }
+            return p;
+        }
+
+        inline void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+            upstream_->deallocate(p, bytes, alignment);
+            deallocations_.fetch_add(1, std::memory_order_relaxed);
+            bytes_in_use_.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+        inline bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+
+      public:
+        inline explicit CountingResource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+            : upstream_(upstream) {}
+
+        inline uint64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+        inline uint64_t deallocations() const { return deallocations_.load(std::memory_order_relaxed); }
+        inline size_t bytes_in_use() const { return bytes_in_use_.load(std::memory_order_relaxed); }
+        inline size_t peak_bytes() const { return peak_bytes_.load(std::memory_order_relaxed); }
+    };
+
+    // Bump allocator released in one step, for the variable-length parts of a decoded message. Deallocation is a
+    // no-op; release() drops everything at once. What does not fit goes to overflow blocks from upstream, and the
+    // next release() grows the main block to cover it, so a steady message mix stops allocating after warm-up.
+    class Arena : public std::pmr::memory_resource {
+      private:
+        struct Overflow {
+            Overflow *next;
+            size_t size;
+        };
+
+        std::pmr::memory_resource *upstream_;
+        std::byte *block_ = nullptr;
+        size_t capacity_ = 0;
+        size_t used_ = 0;
+        size_t demand_ = 0; // bytes asked for since the last release, with alignment slack
+        Overflow *overflow_ = nullptr;
+
+        inline void *do_allocate(size_t bytes, size_t alignment) override {
+            demand_ += bytes + alignment - 1;
+            auto base = reinterpret_cast<uintptr_t>(block_);
+            size_t start = ((base + used_ + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+            if (block_ && start + bytes <= capacity_) {
+                used_ = start + bytes;
+                return block_ + start;
+            }
+            size_t size = sizeof(Overflow) + bytes + alignment;
+            auto *chunk = static_cast<Overflow *>(upstream_->allocate(size, alignof(std::max_align_t)));
+            chunk->next = overflow_;
+            chunk->size = size;
+            overflow_ = chunk;
+            void *p = chunk + 1;
+            size_t space = size - sizeof(Overflow);
+            return std::align(alignment, bytes, p, space);
+        }
+
+        inline void do_deallocate(void *, size_t, size_t) override {}
+
+        inline bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+
+        inline void free_overflow() {
+            while (overflow_) {
+                Overflow *next = overflow_->next;
+                upstream_->deallocate(overflow_, overflow_->size, alignof(std::max_align_t));
+                overflow_ = next;
+            }
+        }
+
+      public:
+        inline explicit Arena(size_t capacity = 4096,
+                              std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+            : upstream_(upstream), capacity_(capacity) {
+            if (capacity_ > 0) {
+                block_ = static_cast<std::byte *>(upstream_->allocate(capacity_, alignof(std::max_align_t)));
+            }
+        }
+
+        inline ~Arena() {
+            free_overflow();
+            if (block_) {
+                upstream_->deallocate(block_, capacity_, alignof(std::max_align_t));
+            }
+        }
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        // Everything allocated so far is gone; nothing may still point into the arena
+        inline void release() {
+            free_overflow();
+            if (demand_ > capacity_) {
+                if (block_) {
+                    upstream_->deallocate(block_, capacity_, alignof(std::max_align_t));
+                }
+                capacity_ = std::max(demand_, capacity_ * 2);
+                block_ = static_cast<std::byte *>(upstream_->allocate(capacity_, alignof(std::max_align_t)));
+            }
+            used_ = 0;
+            demand_ = 0;
+        }
+
+        inline size_t capacity() const { return capacity_; }
+        inline size_t used() const { return used_; }
+        inline std::pmr::memory_resource *upstream() const { return upstream_; }
+    };
+
+    // Recreate a pmr container, empty, on another resource. Assigning or swapping containers whose resources
+    // differ copies element by element or is undefined, so buffers are rebuilt in place instead.
+    template <typename Container>
+    inline void reset_resource(Container &container, std::pmr::memory_resource *resource) {
+        std::destroy_at(&container);
+        std::construct_at(&container, resource);
+    }
+
+    // The same, keeping the elements: they are moved one by one onto the new resource
+    template <typename Container>
+    inline void move_to_resource(Container &container, std::pmr::memory_resource *resource) {
+        Container moved(std::make_move_iterator(container.begin()), std::make_move_iterator(container.end()),
+                        resource);
+        std::destroy_at(&container);
+        std::construct_at(&container, std::move(moved));
+    }
+
+    namespace detail {
+        inline std::atomic<uint64_t> heap_allocations{0};
+        inline thread_local uint64_t thread_heap_allocations = 0;
+    } // namespace detail
+
+    // Global operator new calls so far. Counting is a test hook: define IMPULSE_COUNT_ALLOCATIONS in exactly one
+    // translation unit of a test or benchmark before including this header; elsewhere this stays 0.
+    inline uint64_t heap_allocations() { return detail::heap_allocations.load(std::memory_order_relaxed); }
+
+    // The same for the calling thread only, for measuring a path while other threads (a device emulator) allocate
+    inline uint64_t thread_heap_allocations() { return detail::thread_heap_allocations; }
+
+} // namespace impulse
+
+#ifdef IMPULSE_COUNT_ALLOCATIONS
+// GCC sees malloc-backed new meet free-backed delete after inlining and warns about a mismatch that is not one
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void *operator new(std::size_t size) {
+    impulse::detail::heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    ++impulse::detail::thread_heap_allocations;
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    impulse::detail::heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    ++impulse::detail::thread_heap_allocations;
+    return std::malloc(size ? size : 1);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+#endif
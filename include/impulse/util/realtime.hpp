@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <alloca.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <vector>
+
+namespace impulse {
+
+    enum struct SchedPolicy : uint8_t {
+        other = 0, // leave the thread's scheduling as inherited
+        fifo = 1,  // SCHED_FIFO: runs until it blocks or a higher priority thread is ready
+        rr = 2,    // SCHED_RR: like fifo, with round robin between threads of equal priority
+    };
+
+    // Scheduling of one library thread
+    struct ThreadConfig {
+        std::vector<int> cpus; // CPUs the thread may run on; empty: any
+        SchedPolicy policy = SchedPolicy::other;
+        int priority = 0;  // 1..99 for fifo and rr; above the planner, below IRQ threads
+        std::string name;  // shown by top -H and in traces; at most 15 characters
+    };
+
+    // Which of an interface's threads a ThreadConfig applies to
+    enum struct ThreadRole : uint8_t {
+        receive = 0,     // socket or serial reader
+        transmit = 1,    // paced TX queue
+        maintenance = 2, // heartbeat, neighbour polling, route upkeep
+    };
+    constexpr size_t THREAD_ROLE_COUNT = 3;
+
+    // Apply affinity, policy and name to a running thread. Failures (typically EPERM without CAP_SYS_NICE or an
+    // rtprio limit) are reported and leave the thread running as it was.
+    inline bool apply_thread_config(std::thread &thread, const ThreadConfig &config,
+                                    const std::string &default_name = "") {
+        if (!thread.joinable()) {
+            return false;
+        }
+        auto handle = thread.native_handle();
+        bool ok = true;
+
+        const std::string &name = config.name.empty() ? default_name : config.name;
+        if (!name.empty()) {
+            pthread_setname_np(handle, name.substr(0, 15).c_str());
+        }
+
+        if (!config.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : config.cpus) {
+                CPU_SET(cpu, &set);
+            }
+            int err = pthread_setaffinity_np(handle, sizeof(set), &set);
+            if (err != 0) {
+                std::cerr << "Failed to pin thread " << name << ": " << strerror(err) << std::endl;
+                ok = false;
+            }
+        }
+
+        if (config.policy != SchedPolicy::other) {
+            struct sched_param param = {};
+            param.sched_priority = config.priority;
+            int err = pthread_setschedparam(handle, config.policy == SchedPolicy::fifo ? SCHED_FIFO : SCHED_RR,
+                                            &param);
+            if (err != 0) {
+                std::cerr << "Failed to set real-time priority " << config.priority << " for thread " << name << ": "
+                          << strerror(err) << std::endl;
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    struct MemoryLockConfig {
+        size_t prefault_heap = 16 * 1024 * 1024; // bytes allocated, touched and kept by malloc for later use
+        size_t prefault_stack = 256 * 1024;      // stack of the calling thread to touch
+    };
+
+    // Lock all current and future pages in RAM so real-time paths never take a page fault. Freed heap stays with
+    // the process instead of going back to the kernel, and new threads get their stacks mapped up front.
+    inline bool lock_memory(const MemoryLockConfig &config = {}) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            std::cerr << "mlockall failed: " << strerror(errno) << " (needs CAP_IPC_LOCK or a memlock limit)"
+                      << std::endl;
+            return false;
+        }
+        mallopt(M_TRIM_THRESHOLD, -1); // never return freed memory
+        mallopt(M_MMAP_MAX, 0);        // serve large allocations from the (locked, prefaulted) heap
+
+        if (config.prefault_heap > 0) {
+            auto *heap = static_cast<volatile char *>(malloc(config.prefault_heap));
+            if (heap) {
+                for (size_t i = 0; i < config.prefault_heap; i += 4096) {
+                    heap[i] = 0;
+                }
+                free(const_cast<char *>(heap));
+            }
+        }
+        if (config.prefault_stack > 0) {
+            auto *stack = static_cast<volatile char *>(alloca(config.prefault_stack));
+            for (size_t i = 0; i < config.prefault_stack; i += 4096) {
+                stack[i] = 0;
+            }
+        }
+        return true;
+    }
+
+    // How late a thread ran compared to when it should have: a timed wait overshooting its deadline, or a
+    // message picked up after the kernel received it
+    struct WakeupStats {
+        uint64_t samples = 0;
+        std::chrono::microseconds mean{0};
+        std::chrono::microseconds p99{0}; // upper bound of the bucket holding the 99th percentile
+        std::chrono::microseconds max{0};
+    };
+
+    // Lock-free latency histogram, cheap enough to record on every wake-up. Buckets are powers of two in
+    // microseconds.
+    class WakeupMonitor {
+      private:
+        static constexpr size_t BUCKETS = 24;
+        std::atomic<uint64_t> samples_{0};
+        std::atomic<uint64_t> total_us_{0};
+        std::atomic<uint64_t> max_us_{0};
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+
+      public:
+        inline void record(std::chrono::nanoseconds lateness) {
+            uint64_t us = lateness.count() > 0 ? static_cast<uint64_t>(lateness.count() / 1000) : 0;
+            size_t bucket = std::min<size_t>(BUCKETS - 1, us == 0 ? 0 : 64 - __builtin_clzll(us));
+            buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+            samples_.fetch_add(1, std::memory_order_relaxed);
+            total_us_.fetch_add(us, std::memory_order_relaxed);
+            uint64_t max = max_us_.load(std::memory_order_relaxed);
+            while (us > max && !max_us_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+            }
+        }
+
+        // A thread that should have woken at `deadline` is running now
+        inline void record_wakeup(std::chrono::steady_clock::time_point deadline) {
+            record(std::chrono::steady_clock::now() - deadline);
+        }
+
+        inline WakeupStats stats() const {
+            WakeupStats stats;
+            stats.samples = samples_.load(std::memory_order_relaxed);
+            if (stats.samples == 0) {
+                return stats;
+            }
+            stats.mean = std::chrono::microseconds(total_us_.load(std::memory_order_relaxed) / stats.samples);
+            stats.max = std::chrono::microseconds(max_us_.load(std::memory_order_relaxed));
+            uint64_t threshold = stats.samples - stats.samples / 100, seen = 0;
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                seen += buckets_[i].load(std::memory_order_relaxed);
+                if (seen >= threshold) {
+                    stats.p99 = std::min(stats.max, std::chrono::microseconds(i == 0 ? 0 : (uint64_t(1) << i) - 1));
+                    break;
+                }
+            }
+            return stats;
+        }
+
+        inline void reset() {
+            samples_ = 0;
+            total_us_ = 0;
+            max_us_ = 0;
+            for (auto &bucket : buckets_) {
+                bucket = 0;
+            }
+        }
+    };
+
+} // namespace impulse
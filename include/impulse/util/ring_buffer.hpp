@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace impulse {
+
+    enum struct OverflowPolicy : uint8_t {
+        drop_oldest = 0, // overwrite the oldest element (freshest data wins)
+        drop_newest = 1, // reject the incoming element
+    };
+
+    struct RingStats {
+        uint64_t pushed = 0;
+        uint64_t dropped = 0;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+    // Fixed-capacity FIFO. All slots are constructed up front and reused: producers fill a slot in place and
+    // consumers swap elements out, so element-owned buffers (e.g. string capacity) circulate instead of being
+    // reallocated. Not thread-safe; the owner serializes access.
+    template <typename T> class RingBuffer {
+      private:
+        std::vector<T> slots_;
+        size_t head_ = 0; // oldest element
+        size_t size_ = 0;
+        OverflowPolicy policy_;
+        uint64_t pushed_ = 0;
+        uint64_t dropped_ = 0;
+
+      public:
+        inline explicit RingBuffer(size_t capacity = 256, OverflowPolicy policy = OverflowPolicy::drop_oldest)
+            : slots_(capacity == 0 ? 1 : capacity), policy_(policy) {}
+
+        // Fill the next slot in place with `fill(T &)`. Returns false if the element was dropped.
+        template <typename F> inline bool push_with(F &&fill) {
+            if (size_ == slots_.size()) {
+                ++dropped_;
+                if (policy_ == OverflowPolicy::drop_newest) {
+                    return false;
+                }
+                head_ = (head_ + 1) % slots_.size();
+                --size_;
+            }
+            fill(slots_[(head_ + size_) % slots_.size()]);
+            ++size_;
+            ++pushed_;
+            return true;
+        }
+
+        inline bool push(T &&value) {
+            return push_with([&value](T &slot) { slot = std::move(value); });
+        }
+
+        // Swap up to out.size() oldest elements into `out`; the caller's previous contents become spare slots
+        inline size_t drain(std::span<T> out) {
+            size_t count = std::min(out.size(), size_);
+            for (size_t i = 0; i < count; ++i) {
+                std::swap(out[i], slots_[head_]);
+                head_ = (head_ + 1) % slots_.size();
+            }
+            size_ -= count;
+            return count;
+        }
+
+        inline bool empty() const { return size_ == 0; }
+        inline size_t size() const { return size_; }
+        inline size_t capacity() const { return slots_.size(); }
+        inline void clear() { head_ = size_ = 0; }
+
+        inline RingStats stats() const { return {pushed_, dropped_, size_, slots_.size()}; }
+    };
+
+} // namespace impulse
@@ -0,0 +1,206 @@
+// Counts heap allocations in this test binary; must come before any impulse include
+#define IMPULSE_COUNT_ALLOCATIONS
+#include "impulse/util/memory.hpp"
+
+#include <doctest/doctest.h>
+
+#include "firmware_emulator.hpp"
+#include "impulse/network/interface.hpp"
+#include "impulse/network/lora.hpp"
+#include "impulse/protocol/message.hpp"
+#include "impulse/protocol/transport.hpp"
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using namespace impulse;
+
+namespace {
+
+    // Hands every multicast straight to the receiving side's callback, on the sending thread, allocating nothing
+    class Loopback : public NetworkInterface {
+      public:
+        inline explicit Loopback(const std::string &address) {
+            address_ = address;
+            interface_name_ = "loopback";
+            port_ = 7447;
+        }
+
+        std::function<void(const std::string &)> deliver;
+
+        inline bool start() override { return true; }
+        inline void stop() override {}
+        inline bool is_connected() const override { return true; }
+        inline void send_message(const std::string &, uint16_t, const std::string &msg) override { deliver(msg); }
+        inline void multicast_message(const std::string &msg) override { deliver(msg); }
+        inline void multicast_to_group(const std::vector<std::string> &, uint16_t, const std::string &msg) override {
+            deliver(msg);
+        }
+        inline std::string get_address() const override { return address_; }
+        inline uint16_t get_port() const override { return port_; }
+        inline std::string get_interface_name() const override { return interface_name_; }
+        inline void
+        set_message_callback(std::function<void(const std::string &, const std::string &, uint16_t)>) override {}
+        inline const std::string &from() const { return address_; }
+    };
+
+    // Internal buffers come from a fixed arena; anything the library still allocates shows up in the counts
+    struct Pool {
+        alignas(std::max_align_t) char memory[256 * 1024];
+        std::pmr::monotonic_buffer_resource buffer{memory, sizeof(memory), std::pmr::null_memory_resource()};
+        CountingResource resource{&buffer};
+    };
+
+    struct Counts {
+        uint64_t heap;
+        uint64_t resource;
+    };
+
+    // Allocations made by `count` calls of `step`, heap allocations on this thread only: the firmware emulator
+    // allocates on its own
+    template <typename F> Counts allocations(const CountingResource &resource, int count, F &&step) {
+        uint64_t heap = thread_heap_allocations(), pmr = resource.allocations();
+        for (int i = 0; i < count; ++i) {
+            step(i);
+        }
+        return {thread_heap_allocations() - heap, resource.allocations() - pmr};
+    }
+
+} // namespace
+
+TEST_CASE("sending and receiving Position allocates nothing once warmed up") {
+    Pool pool;
+    Loopback a("fd00:dead:beef::a"), b("fd00:dead:beef::b");
+    Transport<Position> sender("position", &a, Threading::polled), receiver("position", &b, Threading::polled);
+    sender.set_memory_resource(&pool.resource);
+    receiver.set_memory_resource(&pool.resource);
+    uint64_t received = 0;
+    double x = 0;
+    receiver.set_message_handler([&](const Position &msg, const std::string &, uint16_t) {
+        ++received;
+        x = msg.pose.point.x;
+    });
+    a.deliver = [&](const std::string &msg) { receiver.handle_incoming_message(msg, a.from(), 7447); };
+
+    Position position = {};
+    auto send = [&](int i) {
+        position.pose.point.x = i;
+        sender.send_message(position);
+    };
+    allocations(pool.resource, 100, send); // warm-up: buffers grow to their working size
+
+    auto counts = allocations(pool.resource, 5000, send);
+    CHECK(received == 5100);
+    CHECK(x == 4999);
+    CHECK(counts.heap == 0);
+    CHECK(counts.resource == 0);
+}
+
+TEST_CASE("the receive path allocates nothing for views and batches either") {
+    Pool pool;
+    Loopback a("fd00:dead:beef::a");
+    Transport<Position> viewer("position", &a, Threading::polled), batcher("position", &a, Threading::polled);
+    viewer.set_memory_resource(&pool.resource);
+    batcher.set_memory_resource(&pool.resource);
+    uint64_t viewed = 0, batched = 0;
+    viewer.set_view_handler([&](const View<Position> &, const std::string &, uint16_t) { ++viewed; });
+    batcher.set_batch_handler([&](std::span<const Received<Position>> batch) { batched += batch.size(); });
+
+    Position position = {};
+    std::string wire(position.get_size(), '\0');
+    position.serialize(wire.data());
+    auto receive = [&](int i) {
+        viewer.handle_incoming_message(wire, a.from(), 7447);
+        batcher.handle_incoming_message(wire, a.from(), 7447);
+        if (i % 32 == 31) {
+            batcher.end_of_batch();
+        }
+    };
+    allocations(pool.resource, 256, receive);
+
+    auto counts = allocations(pool.resource, 4096, receive);
+    CHECK(viewed == 256 + 4096);
+    CHECK(batched == 256 + 4096);
+    CHECK(counts.heap == 0);
+    CHECK(counts.resource == 0);
+}
+
+TEST_CASE("messages sent on two paths are deduplicated without allocating") {
+    Pool pool;
+    Loopback lan("fd00:dead:beef::a"), radio("fd00:dead:beef::a");
+    Loopback lan_in("fd00:dead:beef::b"), radio_in("fd00:dead:beef::b");
+    Transport<Position> sender("position", &lan, Threading::polled);
+    Transport<Position> receiver("position", &lan_in, Threading::polled);
+    sender.add_path(&radio);
+    receiver.add_path(&radio_in);
+    sender.set_memory_resource(&pool.resource);
+    receiver.set_memory_resource(&pool.resource);
+    // Small enough that the window is full, recycling its oldest sequences, within the warm-up
+    receiver.set_dedup_retention(DedupWindow::DEFAULT_RETENTION, 1024);
+    uint64_t received = 0;
+    receiver.set_message_handler([&](const Position &, const std::string &, uint16_t) { ++received; });
+    lan.deliver = [&](const std::string &msg) { receiver.handle_incoming_message(msg, lan.from(), 7447); };
+    radio.deliver = [&](const std::string &msg) {
+        receiver.handle_incoming_message(msg, radio.from(), 7447, &radio_in);
+    };
+
+    Position position = {};
+    auto send = [&](int) { sender.send_message(position); };
+    allocations(pool.resource, 3000, send);
+
+    auto counts = allocations(pool.resource, 3000, send);
+    CHECK(received == 6000);
+    CHECK(counts.heap == 0);
+    CHECK(counts.resource == 0);
+    auto paths = receiver.get_path_stats();
+    REQUIRE(paths.size() == 2);
+    CHECK(paths[1].first == 6000); // the radio copy goes out first
+    CHECK(paths[0].duplicates == 6000);
+}
+
+TEST_CASE("a polled LoRa interface sends and receives without allocating once warmed up") {
+    Pool pool;
+    test::FirmwareEmulator firmware; // echoes every frame sent back as a frame received from its destination
+    SerialConfig config;
+    config.negotiate_framing = true;
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::a", config);
+    REQUIRE(lora.set_threading(Threading::polled));
+    REQUIRE(lora.set_memory_resource(&pool.resource));
+    lora.set_regional_limits(RegionalLimits::unrestricted());
+    lora.set_tx_pacing(1000.0); // airtime is not what this measures
+    lora.set_neighbor_refresh(std::chrono::hours(1));
+    lora.set_receive_queue(16);
+    uint64_t received = 0;
+    size_t length = 0;
+    lora.set_message_callback([&](const std::string &msg, const std::string &, uint16_t) {
+        ++received;
+        length = msg.size();
+    });
+    REQUIRE(lora.start());
+
+    const std::string peer = "fd00:dead:beef::b", payload(64, 'x');
+    std::array<IncomingMessage, 4> drained;
+    auto round_trip = [&](int) {
+        uint64_t expected = received + 1;
+        lora.send_message(peer, 7447, payload);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (received < expected && std::chrono::steady_clock::now() < deadline) {
+            lora.poll_once(std::chrono::milliseconds(10));
+        }
+        lora.drain_messages(drained);
+    };
+    allocations(pool.resource, 100, round_trip); // warm-up: startup commands, spare frames, ring slots
+
+    auto counts = allocations(pool.resource, 500, round_trip);
+    CHECK(received == 600);
+    CHECK(length == payload.size());
+    CHECK(drained[0].message == payload);
+    CHECK(firmware.command_count(CMD_SEND_MESSAGE) == 600);
+    CHECK(counts.heap == 0);
+    CHECK(counts.resource == 0);
+    lora.stop();
+}
@@ -0,0 +1,193 @@
+#include <doctest/doctest.h>
+
+#include "impulse/network/fec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace impulse;
+
+namespace {
+
+    // One encoder talking to one decoder; frames marked lost never reach it
+    struct Link {
+        FecEncoder encoder;
+        FecDecoder decoder;
+        std::vector<std::string> delivered;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        static std::string frame(const std::array<uint8_t, fec::DATA_HEADER> &header, const std::string &payload) {
+            return std::string(reinterpret_cast<const char *>(header.data()), header.size()) + payload;
+        }
+
+        void receive(const std::string &frame) {
+            std::string_view payload;
+            std::vector<std::string> recovered;
+            if (decoder.receive("fd00::2", false, frame.data(), frame.size(), payload, recovered)) {
+                delivered.emplace_back(payload);
+            }
+            delivered.insert(delivered.end(), recovered.begin(), recovered.end());
+        }
+
+        void send(const std::string &payload, uint8_t group_size, bool lost = false, bool parity_lost = false) {
+            std::array<uint8_t, fec::DATA_HEADER> header;
+            std::string parity;
+            bool closed = encoder.add("fd00::2", reinterpret_cast<const uint8_t *>(payload.data()), payload.size(),
+                                      group_size, now, header, parity);
+            if (!lost) {
+                receive(frame(header, payload));
+            }
+            if (closed && !parity_lost) {
+                receive(parity);
+            }
+        }
+
+        bool got(const std::string &payload) const {
+            return std::count(delivered.begin(), delivered.end(), payload) == 1;
+        }
+    };
+
+    std::string numbered(int i) { return "frame " + std::to_string(i) + std::string(i % 7, '.'); }
+
+} // namespace
+
+TEST_CASE("group size follows the measured loss") {
+    FecConfig config;
+    CHECK(fec_group_size(0.001, config) == 0);
+    CHECK(fec_group_size(0.01, config) == 14); // 15 frames lose two or more with probability 0.96 %
+    CHECK(fec_group_size(0.03, config) < 14);
+    CHECK(fec_group_size(0.1, config) == config.min_group_size);
+    config.fixed_group_size = 5;
+    CHECK(fec_group_size(0.0, config) == 5);
+}
+
+TEST_CASE("a lossless link delivers every frame once and parity adds nothing") {
+    Link link;
+    for (int i = 0; i < 8; ++i) {
+        link.send(numbered(i), 4);
+    }
+    REQUIRE(link.delivered.size() == 8);
+    for (int i = 0; i < 8; ++i) {
+        CHECK(link.delivered[i] == numbered(i));
+    }
+    auto stats = link.encoder.stats(link.decoder.stats());
+    CHECK(stats.data_frames == 8);
+    CHECK(stats.parity_frames == 2);
+    CHECK(stats.frames_lost == 0);
+    CHECK(stats.frames_recovered == 0);
+    CHECK(link.decoder.loss("fd00::2") == 0.0);
+}
+
+TEST_CASE("one lost frame per group is rebuilt from parity, two are not") {
+    Link link;
+    // The longest frame of the first group goes missing, so its length comes from the parity too
+    link.send("a", 4);
+    link.send("a much longer frame", 4, true);
+    link.send("bb", 4);
+    link.send("ccc", 4);
+    CHECK(link.got("a much longer frame"));
+    CHECK(link.decoder.stats().frames_recovered == 1);
+
+    // The last frame of a group: the parity shows it was sent
+    link.send("d", 4);
+    link.send("e", 4);
+    link.send("f", 4);
+    link.send("the tail", 4, true);
+    CHECK(link.got("the tail"));
+
+    link.send("g", 4, true);
+    link.send("h", 4, true);
+    link.send("i", 4);
+    link.send("j", 4);
+    CHECK_FALSE(link.got("g"));
+    CHECK_FALSE(link.got("h"));
+    CHECK(link.delivered.size() == 10);
+
+    auto stats = link.decoder.stats();
+    CHECK(stats.frames_lost == 4);
+    CHECK(stats.frames_recovered == 2);
+    CHECK(link.decoder.loss("fd00::2") > 0.0);
+}
+
+TEST_CASE("sequence numbers wrap without losing recovery") {
+    Link link;
+    // 8-bit sequence numbers wrap after 256 frames; lose one frame in each group around the wrap
+    int lost = 0;
+    for (int i = 0; i < 600; ++i) {
+        bool drop = (i >= 248 && i < 264 && i % 4 == 1) || (i >= 504 && i < 520 && i % 4 == 3);
+        lost += drop;
+        link.send(numbered(i), 4, drop);
+    }
+    CHECK(lost == 8);
+    CHECK(link.delivered.size() == 600);
+    for (int i = 0; i < 600; ++i) {
+        CHECK(link.got(numbered(i)));
+    }
+    CHECK(link.decoder.stats().frames_lost == 8);
+    CHECK(link.decoder.stats().frames_recovered == 8);
+}
+
+TEST_CASE("a retracted frame leaves no gap and no trace in the parity") {
+    Link link;
+    std::array<uint8_t, fec::DATA_HEADER> header;
+    std::string parity;
+    const std::string unsent = "never went on air";
+    const auto *bytes = reinterpret_cast<const uint8_t *>(unsent.data());
+
+    // Taken back from an open group
+    link.send("one", 3);
+    CHECK_FALSE(link.encoder.add("fd00::2", bytes, unsent.size(), 3, link.now, header, parity));
+    link.encoder.retract("fd00::2", bytes, unsent.size(), false, parity);
+    link.send("two", 3, true);
+    link.send("three", 3);
+    CHECK(link.got("two"));
+
+    // Taken back after it closed its group: the parity shrinks to the frames that were sent
+    link.send("four", 3);
+    link.send("five", 3, true);
+    REQUIRE(link.encoder.add("fd00::2", bytes, unsent.size(), 3, link.now, header, parity));
+    link.encoder.retract("fd00::2", bytes, unsent.size(), true, parity);
+    REQUIRE_FALSE(parity.empty());
+    CHECK(static_cast<uint8_t>(parity[2]) == 2);
+    link.receive(parity);
+    CHECK(link.got("five"));
+
+    // The only frame of a group: its parity goes away entirely
+    REQUIRE(link.encoder.add("fd00::2", bytes, unsent.size(), 1, link.now, header, parity));
+    link.encoder.retract("fd00::2", bytes, unsent.size(), true, parity);
+    CHECK(parity.empty());
+
+    link.send("six", 2);
+    link.send("seven", 2);
+    CHECK(link.delivered.size() == 7);
+    CHECK(std::count(link.delivered.begin(), link.delivered.end(), unsent) == 0);
+    auto stats = link.encoder.stats(link.decoder.stats());
+    CHECK(stats.data_frames == 7);
+    CHECK(stats.parity_frames == 3);
+    CHECK(stats.frames_lost == 2); // only the two dropped on purpose
+}
+
+TEST_CASE("a long jump in sequence numbers is a resync, not loss") {
+    Link link;
+    for (int i = 0; i < 4; ++i) {
+        link.send(numbered(i), 0);
+    }
+    for (int i = 0; i < 10; ++i) {
+        link.send("unheard", 0, true);
+    }
+    link.send("after a short gap", 0);
+    CHECK(link.decoder.stats().frames_lost == 10);
+
+    // Further than the resync gap, e.g. the sender restarted or we were away: counted as neither loss nor duplicate
+    for (int i = 0; i < 100; ++i) {
+        link.send("unheard", 0, true);
+    }
+    link.send("after a long gap", 0);
+    CHECK(link.got("after a long gap"));
+    CHECK(link.decoder.stats().frames_lost == 10);
+    CHECK(link.delivered.size() == 6);
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include "impulse/network/lora.hpp"
+#include "impulse/network/serial_framing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <poll.h>
+#include <pty.h>
+#include <set>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace impulse::test {
+
+    // Stands in for the melodi firmware on a pseudo-terminal. Commands are parsed in whichever framing is active,
+    // answered the way the radio answers them, and transmitted messages are looped back as if a peer echoed them.
+    // Emulators joined with connect() share the air instead: each hears what its neighbours send.
+    class FirmwareEmulator {
+      public:
+        struct Options {
+            bool supports_v2 = true; // accepts CMD_SET_FRAMING to v2
+            int corrupt_every = 0;   // damage every Nth frame sent: a v2 body byte, a v1 sync byte (0 = never)
+            bool noise = false;      // junk holding a partial sync word before every 5th frame
+            bool loopback = true;    // echo CMD_SEND_MESSAGE back as RESP_MESSAGE
+        };
+
+      private:
+        Options options_;
+        int master_fd_ = -1;
+        int slave_fd_ = -1;
+        std::string port_;
+        std::thread thread_;
+        std::atomic<bool> running_{false};
+        std::atomic<bool> v2_{false};
+        std::atomic<bool> muted_{false};
+        std::atomic<int64_t> status_delay_ms_{0};
+        std::vector<uint8_t> input_;
+        uint16_t command_sequence_ = 0; // v2 sequence of the command being answered
+        bool damage_next_ = false;
+        uint64_t sent_frames_ = 0;
+        std::atomic<uint32_t> status_answers_{0};
+
+        mutable std::mutex mutex_;
+        std::map<uint8_t, size_t> commands_;
+        std::vector<std::string> transmitted_;
+        std::set<uint32_t> damaged_answers_;
+        std::array<uint8_t, 16> address_ = {0xfd, 0, 0xde, 0xad, 0xbe, 0xef, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+        std::set<FirmwareEmulator *> neighbors_;
+        std::mutex output_mutex_; // neighbours' threads answer on our port too
+
+        // v1 commands carry no length; it follows from the command and its fields (SIZE_MAX = need more bytes)
+        inline static size_t v1_command_length(const uint8_t *data, size_t available) {
+            auto at_least = [&](size_t length) { return available >= length ? length : SIZE_MAX; };
+            switch (data[0]) {
+            case CMD_SEND_MESSAGE:
+                return available < 3 ? SIZE_MAX : at_least(19 + ((data[1] << 8) | data[2]));
+            case CMD_SET_IPV6:
+                return at_least(17);
+            case CMD_SET_CONFIG: {
+                if (available < 2) {
+                    return SIZE_MAX;
+                }
+                // Config types: TX power, frequency, hop limit, SF, bandwidth, per-destination settings
+                static const std::map<uint8_t, size_t> CONFIG_SIZES = {{1, 1}, {2, 4}, {3, 1},
+                                                                       {4, 1}, {5, 4}, {6, 21}};
+                auto it = CONFIG_SIZES.find(data[1]);
+                return at_least(2 + (it == CONFIG_SIZES.end() ? 0 : it->second));
+            }
+            case CMD_GET_NEIGHBORS:
+            case CMD_SET_FRAMING:
+                return at_least(2);
+            case CMD_SET_BAUD:
+                return at_least(5);
+            case CMD_SEND_SHORT:
+                return available < 3 ? SIZE_MAX : at_least(5 + ((data[1] << 8) | data[2]));
+            case CMD_SET_SHORT_ID:
+                return at_least(3);
+            default:
+                return 1;
+            }
+        }
+
+        // Answer the command being handled; `answers_command` false for frames the firmware sends on its own
+        inline void respond(uint8_t type, const std::vector<uint8_t> &data, bool answers_command = true) {
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            std::vector<uint8_t> out;
+            ++sent_frames_;
+            bool corrupt = damage_next_ || (options_.corrupt_every && sent_frames_ % options_.corrupt_every == 0);
+            damage_next_ = false;
+            if (v2_) {
+                SerialFramer::encode_command(FramingVersion::v2, type, data, out,
+                                             answers_command ? command_sequence_ : 0);
+                if (corrupt) {
+                    out[SerialFramer::V2_HEADER] ^= 0x40;
+                }
+            } else {
+                out.assign(SerialFramer::V1_SYNC, SerialFramer::V1_SYNC + sizeof(SerialFramer::V1_SYNC));
+                out.push_back(type);
+                out.insert(out.end(), data.begin(), data.end());
+                if (corrupt) {
+                    out[0] ^= 0x40;
+                }
+            }
+            if (options_.noise && sent_frames_ % 5 == 0) {
+                static const uint8_t JUNK[] = {0x00, 0xAA, 0x17, 0xAA, 0xBB, 0x42};
+                out.insert(out.begin(), JUNK, JUNK + sizeof(JUNK));
+            }
+            ssize_t written = write(master_fd_, out.data(), out.size());
+            (void)written;
+        }
+
+        inline void handle(const std::vector<uint8_t> &command) {
+            uint8_t cmd = command[0];
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++commands_[cmd];
+            }
+            if (muted_) {
+                return;
+            }
+
+            switch (cmd) {
+            case CMD_GET_STATUS: {
+                if (auto delay = status_delay_ms_.load()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+                }
+                // Uptime counts status answers, so a test can tell which probe a response belongs to
+                uint16_t answered = static_cast<uint16_t>(++status_answers_);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    damage_next_ = damaged_answers_.erase(answered) > 0;
+                }
+                std::vector<uint8_t> status;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    status.assign(address_.begin(), address_.end());
+                }
+                status.insert(status.end(), {1, 14, 0x33, 0xB5, 0x73, 0x40, 3});
+                status.push_back(static_cast<uint8_t>(answered >> 8));
+                status.push_back(static_cast<uint8_t>(answered & 0xFF));
+                respond(RESP_STATUS, status);
+                return;
+            }
+            case CMD_SEND_MESSAGE: {
+                size_t length = (command[1] << 8) | command[2];
+                std::string payload(reinterpret_cast<const char *>(command.data()) + 19, length);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    transmitted_.push_back(payload);
+                }
+                respond(RESP_ACK, {cmd});
+                if (options_.loopback) {
+                    std::vector<uint8_t> message = {0};
+                    message.insert(message.end(), command.begin() + 3, command.begin() + 19);
+                    message.insert(message.end(), command.begin() + 1, command.begin() + 3);
+                    message.insert(message.end(), payload.begin(), payload.end());
+                    respond(RESP_MESSAGE, message, false);
+                }
+                std::array<uint8_t, 16> dest;
+                std::copy(command.begin() + 3, command.begin() + 19, dest.begin());
+                bool broadcast = std::all_of(dest.begin(), dest.end(), [](uint8_t b) { return b == 0xFF; });
+                std::set<FirmwareEmulator *> neighbors;
+                std::array<uint8_t, 16> self;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    neighbors = neighbors_;
+                    self = address_;
+                }
+                for (FirmwareEmulator *neighbor : neighbors) {
+                    if (broadcast || neighbor->address() == dest) {
+                        neighbor->hear(self, payload, broadcast);
+                    }
+                }
+                return;
+            }
+            case CMD_SET_IPV6: {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    std::copy(command.begin() + 1, command.begin() + 17, address_.begin());
+                }
+                respond(RESP_ACK, {cmd});
+                return;
+            }
+            case CMD_GET_NEIGHBORS:
+                respond(RESP_NEIGHBORS, {0, command[1], 0});
+                return;
+            case CMD_SET_BAUD:
+                respond(RESP_NACK, {cmd, ERR_INVALID_COMMAND}); // a pty has no line rate to change
+                return;
+            case CMD_SET_FRAMING:
+                if (options_.supports_v2 && command.size() > 1 && command[1] <= 2) {
+                    respond(RESP_ACK, {cmd}); // in the old framing, then switch
+                    v2_ = command[1] == 2;
+                } else {
+                    respond(RESP_NACK, {cmd, ERR_INVALID_COMMAND});
+                }
+                return;
+            default:
+                respond(RESP_ACK, {cmd});
+                return;
+            }
+        }
+
+        // Split the input into commands; returns false when more bytes are needed
+        inline bool next_command(std::vector<uint8_t> &command) {
+            if (input_.empty()) {
+                return false;
+            }
+            if (!v2_) {
+                size_t length = v1_command_length(input_.data(), input_.size());
+                if (length == SIZE_MAX) {
+                    return false;
+                }
+                command.assign(input_.begin(), input_.begin() + length);
+                input_.erase(input_.begin(), input_.begin() + length);
+                command_sequence_ = 0;
+                return true;
+            }
+            while (input_.size() >= SerialFramer::V2_HEADER) {
+                size_t body = (input_[2] << 8) | input_[3];
+                if (input_[0] != SerialFramer::V2_SYNC[0] || input_[1] != SerialFramer::V2_SYNC[1] ||
+                    crc::crc8(input_.data() + 2, 4) != input_[6]) {
+                    input_.erase(input_.begin());
+                    continue;
+                }
+                size_t total = SerialFramer::V2_HEADER + body + SerialFramer::V2_TRAILER;
+                if (input_.size() < total) {
+                    return false;
+                }
+                const uint8_t *payload = input_.data() + SerialFramer::V2_HEADER;
+                bool intact = crc::crc16(payload, body) == ((payload[body] << 8) | payload[body + 1]);
+                command.assign(payload, payload + body);
+                command_sequence_ = (input_[4] << 8) | input_[5];
+                input_.erase(input_.begin(), input_.begin() + total);
+                if (intact) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline void run() {
+            uint8_t buffer[1024];
+            std::vector<uint8_t> command;
+            while (running_) {
+                pollfd pfd{master_fd_, POLLIN, 0};
+                if (poll(&pfd, 1, 20) <= 0) {
+                    continue;
+                }
+                ssize_t n = read(master_fd_, buffer, sizeof(buffer));
+                if (n <= 0) {
+                    continue;
+                }
+                input_.insert(input_.end(), buffer, buffer + n);
+                while (next_command(command)) {
+                    handle(command);
+                }
+            }
+        }
+
+      public:
+        inline explicit FirmwareEmulator(const Options &options) : options_(options) {
+            char name[256];
+            if (openpty(&master_fd_, &slave_fd_, name, nullptr, nullptr) != 0) {
+                throw std::runtime_error("openpty failed");
+            }
+            termios tio;
+            tcgetattr(master_fd_, &tio);
+            cfmakeraw(&tio);
+            tcsetattr(master_fd_, TCSANOW, &tio);
+            port_ = name;
+            running_ = true;
+            thread_ = std::thread(&FirmwareEmulator::run, this);
+        }
+
+        inline FirmwareEmulator() : FirmwareEmulator(Options{}) {}
+
+        inline ~FirmwareEmulator() {
+            for (FirmwareEmulator *neighbor : std::set<FirmwareEmulator *>(neighbors_)) {
+                connect(*this, *neighbor, false);
+            }
+            stop();
+            close(master_fd_);
+            close(slave_fd_);
+        }
+
+        FirmwareEmulator(const FirmwareEmulator &) = delete;
+        FirmwareEmulator &operator=(const FirmwareEmulator &) = delete;
+
+        // Stop reading commands; the port stays open
+        inline void stop() {
+            running_ = false;
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+        }
+
+        inline const std::string &port() const { return port_; }
+        inline bool framing_v2() const { return v2_; }
+
+        // Keep reading commands but answer none of them
+        inline void set_muted(bool muted) { muted_ = muted; }
+        // Come back from a reset the way the radio does, in v1 framing
+        inline void reset() { v2_ = false; }
+        // Answer CMD_GET_STATUS this late; the firmware is serial, so everything behind it waits too
+        inline void set_status_delay(std::chrono::milliseconds delay) { status_delay_ms_ = delay.count(); }
+
+        inline uint32_t status_answers() const { return status_answers_; }
+
+        // Damage the status answers with these numbers (status_answers() counts them) as corrupt_every would
+        inline void damage_status_answers(const std::set<uint32_t> &answers) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            damaged_answers_ = answers;
+        }
+
+        inline size_t command_count(uint8_t cmd) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = commands_.find(cmd);
+            return it == commands_.end() ? 0 : it->second;
+        }
+
+        // Put two radios in (or out of) range of each other
+        inline static void connect(FirmwareEmulator &a, FirmwareEmulator &b, bool in_range = true) {
+            std::scoped_lock lock(a.mutex_, b.mutex_);
+            if (in_range) {
+                a.neighbors_.insert(&b);
+                b.neighbors_.insert(&a);
+            } else {
+                a.neighbors_.erase(&b);
+                b.neighbors_.erase(&a);
+            }
+        }
+
+        inline std::array<uint8_t, 16> address() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return address_;
+        }
+
+        // A neighbour's transmission arriving over the air
+        inline void hear(const std::array<uint8_t, 16> &from, const std::string &payload, bool broadcast) {
+            std::vector<uint8_t> message = {static_cast<uint8_t>(broadcast)};
+            message.insert(message.end(), from.begin(), from.end());
+            message.push_back(static_cast<uint8_t>(payload.size() >> 8));
+            message.push_back(static_cast<uint8_t>(payload.size() & 0xFF));
+            message.insert(message.end(), payload.begin(), payload.end());
+            respond(RESP_MESSAGE, message, false);
+        }
+
+        inline std::vector<std::string> transmitted() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return transmitted_;
+        }
+    };
+
+} // namespace impulse::test
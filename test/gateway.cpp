@@ -0,0 +1,204 @@
+#include <doctest/doctest.h>
+
+#include "impulse/protocol/gateway.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace impulse;
+using namespace std::chrono_literals;
+
+namespace {
+
+    // Keeps what the gateway sends out instead of putting it on a network
+    class Loopback : public NetworkInterface {
+      public:
+        inline explicit Loopback(const std::string &address) {
+            address_ = address;
+            interface_name_ = "loopback";
+            port_ = 7447;
+        }
+
+        std::vector<std::string> sent;
+
+        inline bool start() override { return true; }
+        inline void stop() override {}
+        inline bool is_connected() const override { return true; }
+        inline void send_message(const std::string &, uint16_t, const std::string &msg) override {
+            sent.push_back(msg);
+        }
+        inline void multicast_message(const std::string &msg) override { sent.push_back(msg); }
+        inline void multicast_to_group(const std::vector<std::string> &, uint16_t, const std::string &msg) override {
+            sent.push_back(msg);
+        }
+        inline std::string get_address() const override { return address_; }
+        inline uint16_t get_port() const override { return port_; }
+        inline std::string get_interface_name() const override { return interface_name_; }
+        inline void
+        set_message_callback(std::function<void(const std::string &, const std::string &, uint16_t)>) override {}
+    };
+
+    GatewayTopic prefixed(const std::string &prefix) {
+        GatewayTopic topic;
+        topic.name = prefix;
+        topic.match = [prefix](const std::string &msg) { return msg.compare(0, prefix.size(), prefix) == 0; };
+        return topic;
+    }
+
+    std::string relayed_from(const std::string &origin, const std::string &payload) {
+        std::string out(relay::HEADER_SIZE, '\0');
+        REQUIRE(relay::write_header(out.data(), origin));
+        return out + payload;
+    }
+
+    template <typename F> bool eventually(Gateway &gateway, F &&done, std::chrono::milliseconds timeout = 5s) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!done()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            gateway.poll_once(10ms);
+        }
+        return true;
+    }
+
+} // namespace
+
+TEST_CASE("a message crosses the gateway once and its echo is dropped") {
+    Loopback lan("fd00::1"), lora("fd00::1");
+    GatewayConfig config;
+    config.loop_window = 200ms;
+    Gateway gateway(&lan, &lora, config, Threading::polled);
+    gateway.add_topic(prefixed("pos:"));
+    auto lan_only = prefixed("cmd:");
+    lan_only.to_lora = false;
+    gateway.add_topic(lan_only);
+
+    gateway.handle_lan_message("pos:1", "fd00::a", 7447);
+    REQUIRE(lora.sent.size() == 1);
+    CHECK(lora.sent[0] == relayed_from("fd00::a", "pos:1"));
+
+    // Our own frame heard back on LoRa, and a frame another gateway relayed onto the LAN
+    gateway.handle_lora_message(lora.sent[0], "fd00::2", 7447);
+    gateway.handle_lan_message(relayed_from("fd00::b", "pos:2"), "fd00::3", 7447);
+    // The bare payload coming back within the loop window, from a gateway that does not add relay headers
+    gateway.handle_lora_message("pos:1", "fd00::2", 7447);
+    CHECK(lan.sent.empty());
+    CHECK(lora.sent.size() == 1);
+    auto stats = gateway.get_stats();
+    CHECK(stats.to_lan.loops == 2);
+    CHECK(stats.to_lora.loops == 1);
+
+    gateway.handle_lan_message("cmd:stop", "fd00::a", 7447);
+    gateway.handle_lan_message("unbridged", "fd00::a", 7447);
+    CHECK(gateway.get_stats().to_lora.filtered == 2);
+
+    // Past the loop window the same payload is news again
+    std::this_thread::sleep_for(250ms);
+    gateway.handle_lora_message("pos:1", "fd00::2", 7447);
+    REQUIRE(lan.sent.size() == 1);
+    CHECK(lan.sent[0] == relayed_from("fd00::2", "pos:1"));
+}
+
+TEST_CASE("a message that merely starts with the relay magic is not a loop") {
+    Loopback lan("fd00::1"), lora("fd00::1");
+    Gateway gateway(&lan, &lora, {}, Threading::polled);
+    GatewayTopic raw;
+    raw.name = "raw";
+    raw.match = [](const std::string &msg) { return !msg.empty() && static_cast<uint8_t>(msg[0]) == 0xD7; };
+    gateway.add_topic(raw);
+
+    // Reads as a relay header, but what follows it is not a bridged message
+    std::string msg = relayed_from("fd00::a", "x");
+    gateway.handle_lora_message(msg, "fd00::2", 7447);
+    REQUIRE(lan.sent.size() == 1);
+    CHECK(gateway.get_stats().to_lan.loops == 0);
+}
+
+TEST_CASE("LAN traffic waiting for airtime keeps only the latest per source") {
+    Loopback lan("fd00::1"), lora("fd00::1");
+    GatewayConfig config;
+    config.lora_bytes_per_second = 100.0; // a 24-byte frame every 240 ms
+    config.lora_burst_bytes = 24.0;
+    Gateway gateway(&lan, &lora, config, Threading::polled);
+    gateway.add_topic(prefixed("pos:"));
+
+    gateway.handle_lan_message("pos:a1", "fd00::a", 7447);
+    gateway.handle_lan_message("pos:a2", "fd00::a", 7447);
+    gateway.handle_lan_message("pos:a3", "fd00::a", 7447);
+    gateway.handle_lan_message("pos:b1", "fd00::b", 7447);
+    CHECK(lora.sent.size() == 1);
+    auto stats = gateway.get_stats();
+    CHECK(stats.waiting == 2);
+    CHECK(stats.to_lora.superseded == 1);
+
+    REQUIRE(eventually(gateway, [&] { return lora.sent.size() == 3; }));
+    CHECK(lora.sent[0] == relayed_from("fd00::a", "pos:a1"));
+    CHECK(lora.sent[1] == relayed_from("fd00::a", "pos:a3"));
+    CHECK(lora.sent[2] == relayed_from("fd00::b", "pos:b1"));
+    stats = gateway.get_stats();
+    CHECK(stats.waiting == 0);
+    CHECK(stats.to_lora.forwarded == 3);
+    CHECK(stats.to_lora.bytes == 3 * 24);
+    CHECK(stats.to_lora.throttled == 0);
+}
+
+TEST_CASE("a topic interval holds back a source's next message") {
+    Loopback lan("fd00::1"), lora("fd00::1");
+    Gateway gateway(&lan, &lora, {}, Threading::polled);
+    auto topic = prefixed("pos:");
+    topic.lora_interval = 200ms;
+    gateway.add_topic(topic);
+
+    auto start = std::chrono::steady_clock::now();
+    gateway.handle_lan_message("pos:1", "fd00::a", 7447);
+    gateway.handle_lan_message("pos:2", "fd00::a", 7447);
+    gateway.handle_lan_message("pos:x", "fd00::b", 7447); // another source has its own interval
+    CHECK(lora.sent.size() == 2);
+
+    REQUIRE(eventually(gateway, [&] { return lora.sent.size() == 3; }));
+    CHECK(std::chrono::steady_clock::now() - start >= 200ms);
+    CHECK(lora.sent[2] == relayed_from("fd00::a", "pos:2"));
+}
+
+TEST_CASE("LoRa traffic beyond the LAN byte budget is dropped") {
+    Loopback lan("fd00::1"), lora("fd00::1");
+    GatewayConfig config;
+    config.lan_bytes_per_second = 1.0; // no refill within the test
+    config.lan_burst_bytes = 46.0;     // two 23-byte frames
+    Gateway gateway(&lan, &lora, config, Threading::polled);
+    gateway.add_topic(prefixed("pos:"));
+
+    gateway.handle_lora_message("pos:1", "fd00::a", 7447);
+    gateway.handle_lora_message("pos:2", "fd00::a", 7447);
+    gateway.handle_lora_message("pos:3", "fd00::a", 7447);
+    CHECK(lan.sent.size() == 2);
+    auto stats = gateway.get_stats();
+    CHECK(stats.to_lan.forwarded == 2);
+    CHECK(stats.to_lan.bytes == 46);
+    CHECK(stats.to_lan.throttled == 1);
+
+    // A dropped message was never forwarded, so it is not a loop when it comes again
+    gateway.handle_lora_message("pos:3", "fd00::a", 7447);
+    stats = gateway.get_stats();
+    CHECK(stats.to_lan.throttled == 2);
+    CHECK(stats.to_lan.loops == 0);
+}
+
+TEST_CASE("a frame larger than the burst passes only on a full budget") {
+    Loopback lan("fd00::1"), lora("fd00::1");
+    GatewayConfig config;
+    config.lan_bytes_per_second = 1.0;
+    config.lan_burst_bytes = 10.0;
+    config.preserve_source = false;
+    Gateway gateway(&lan, &lora, config, Threading::polled);
+    gateway.add_topic(prefixed("pos:"));
+
+    gateway.handle_lora_message("pos:larger than the burst", "fd00::a", 7447);
+    gateway.handle_lora_message("pos:small", "fd00::a", 7447);
+    REQUIRE(lan.sent.size() == 1);
+    CHECK(lan.sent[0] == "pos:larger than the burst");
+    CHECK(gateway.get_stats().to_lan.throttled == 1);
+}
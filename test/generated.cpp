@@ -0,0 +1,85 @@
+#include <doctest/doctest.h>
+
+#include "clashes.hpp" // generated by impulse_gen from test/schema/clashes.imp
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using generated::impulse::Clashes;
+using generated::impulse::Other;
+
+namespace {
+
+    Clashes sample() {
+        Clashes msg;
+        msg.ts = 1700000000123;
+        msg.i = -42;
+        msg.buffer = 12.345;
+        msg.out = 7;
+        msg.msg = {1, 2, 65535};
+        msg.wire = {-99.5f, 3.25f};
+        std::strcpy(msg.memcpy, "abc");
+        msg.strnlen = true;
+        msg.impulse = -8;
+        msg.std = 4000000000u;
+        return msg;
+    }
+
+    void check_equal(const Clashes &a, const Clashes &b) {
+        CHECK(a.ts == b.ts);
+        CHECK(a.i == b.i);
+        CHECK(std::abs(a.buffer - b.buffer) < 1e-9); // quantized to exact millimetres
+        CHECK(a.out == b.out);
+        CHECK(a.msg == b.msg);
+        CHECK(std::abs(a.wire[0] - b.wire[0]) < 1e-4);
+        CHECK(std::abs(a.wire[1] - b.wire[1]) < 1e-4);
+        CHECK(std::string(a.memcpy) == b.memcpy);
+        CHECK(a.strnlen == b.strnlen);
+        CHECK(a.impulse == b.impulse);
+        CHECK(a.std == b.std);
+    }
+
+} // namespace
+
+TEST_CASE("generated messages round-trip whatever their fields are called") {
+    static_assert(Clashes::WIRE_SIZE == 2 + 8 + 4 + 4 + 1 + 6 + 4 + 8 + 1 + 1 + 4);
+    Clashes msg = sample();
+    std::array<char, Clashes::WIRE_SIZE> bytes;
+    msg.serialize(bytes.data());
+    CHECK(msg.get_size() == bytes.size());
+    CHECK(Clashes::matches(bytes.data(), bytes.size()));
+    CHECK_FALSE(Other::matches(bytes.data(), bytes.size()));
+    CHECK_FALSE(Clashes::matches(bytes.data(), bytes.size() - 1));
+
+    Clashes copy;
+    copy.deserialize(bytes.data());
+    check_equal(copy, msg);
+
+    Clashes::View view(bytes.data(), bytes.size());
+    REQUIRE(view.ok());
+    CHECK(view.ts() == msg.ts);
+    CHECK(view.i() == msg.i);
+    CHECK(std::abs(view.buffer() - msg.buffer) < 1e-9);
+    CHECK(view.msg(2) == 65535);
+    CHECK(std::abs(view.wire(0) + 99.5f) < 1e-4);
+    CHECK(view.memcpy() == "abc");
+    CHECK(view.strnlen());
+    CHECK(view.impulse() == -8);
+    CHECK(view.std() == msg.std);
+    check_equal(view.materialize(), msg);
+}
+
+TEST_CASE("the timestamp annotation names the field set_timestamp fills") {
+    Clashes msg;
+    msg.set_timestamp(123);
+    CHECK(msg.ts == 123);
+    Other other;
+    other.set_timestamp(456);
+    CHECK(other.value == 456);
+
+    auto text = sample().to_string();
+    CHECK(text.find("Clashes{ts=1700000000123, i=-42,") == 0);
+    CHECK(text.find("memcpy=abc") != std::string::npos);
+}
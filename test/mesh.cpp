@@ -0,0 +1,252 @@
+#include <doctest/doctest.h>
+
+#include "firmware_emulator.hpp"
+#include "impulse/network/lora.hpp"
+#include "impulse/network/mesh.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace impulse;
+using namespace std::chrono_literals;
+
+namespace {
+
+    template <typename F> bool eventually(F &&done, std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!done()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    test::FirmwareEmulator::Options on_air() {
+        test::FirmwareEmulator::Options options;
+        options.loopback = false; // radios only hear their neighbours
+        return options;
+    }
+
+    MeshConfig fast_repair() {
+        MeshConfig config;
+        config.discovery_timeout = 500ms;
+        config.hop_ack_timeout = 300ms;
+        config.link_failures_before_break = 1;
+        return config;
+    }
+
+    // An emulated radio with its LoRaInterface and, unless it plays a raw node, a mesh on top
+    struct Node {
+        test::FirmwareEmulator radio{on_air()};
+        LoRaInterface lora;
+        std::optional<LoRaMeshInterface> mesh;
+        std::mutex mutex;
+        std::vector<std::pair<std::string, std::string>> received; // payload, origin
+
+        explicit Node(const std::string &address) : lora(radio.port(), address) {
+            lora.set_regional_limits(RegionalLimits::unrestricted());
+            lora.set_tx_pacing(1.0, 100000ms);
+        }
+
+        bool start_mesh(const MeshConfig &config) {
+            mesh.emplace(&lora, config);
+            mesh->set_message_callback([this](const std::string &message, const std::string &from, uint16_t) {
+                std::lock_guard<std::mutex> lock(mutex);
+                received.emplace_back(message, from);
+            });
+            return mesh->start();
+        }
+
+        bool got(const std::string &payload, const std::string &origin) {
+            std::lock_guard<std::mutex> lock(mutex);
+            return std::find(received.begin(), received.end(), std::make_pair(payload, origin)) != received.end();
+        }
+
+        std::optional<MeshRoute> route_to(const std::string &dest) {
+            for (const auto &route : mesh->get_routes()) {
+                if (route.destination == dest) {
+                    return route;
+                }
+            }
+            return std::nullopt;
+        }
+    };
+
+    // Every node stops transmitting before any radio goes away
+    struct Network {
+        std::vector<std::unique_ptr<Node>> nodes;
+
+        Node &add(const std::string &address) {
+            nodes.push_back(std::make_unique<Node>(address));
+            REQUIRE(nodes.back()->lora.start());
+            return *nodes.back();
+        }
+
+        ~Network() {
+            for (auto &node : nodes) {
+                if (node->mesh) {
+                    node->mesh->stop();
+                }
+                node->lora.stop();
+            }
+            for (auto &node : nodes) {
+                node->radio.stop();
+            }
+        }
+    };
+
+    void link(Node &a, Node &b, bool in_range = true) { test::FirmwareEmulator::connect(a.radio, b.radio, in_range); }
+
+    std::string address_bytes(const std::string &address) {
+        std::string bytes(16, '\0');
+        inet_pton(AF_INET6, address.c_str(), bytes.data());
+        return bytes;
+    }
+
+    // RREP [ttl][origin:16][target:16][tseq:2][metric:2][hops], as a neighbour answering for `target` would send it
+    std::string route_reply(const std::string &origin, const std::string &target, uint16_t seq, uint16_t metric) {
+        std::string frame = {0x4D, 3, 8};
+        frame += address_bytes(origin) + address_bytes(target);
+        frame += {static_cast<char>(seq >> 8), static_cast<char>(seq & 0xFF)};
+        frame += {static_cast<char>(metric >> 8), static_cast<char>(metric & 0xFF)};
+        frame.push_back(1);
+        return frame;
+    }
+
+} // namespace
+
+TEST_CASE("routes are discovered across several hops") {
+    Network net;
+    Node &a = net.add("fd00::a"), &b = net.add("fd00::b"), &c = net.add("fd00::c"), &d = net.add("fd00::d");
+    link(a, b);
+    link(b, c);
+    link(c, d);
+    for (Node *node : {&a, &b, &c, &d}) {
+        REQUIRE(node->start_mesh(fast_repair()));
+    }
+
+    a.mesh->send_message("fd00::d", 0, "over three hops");
+    REQUIRE(eventually([&] { return d.got("over three hops", "fd00::a"); }));
+
+    auto forward = a.route_to("fd00::d");
+    REQUIRE(forward);
+    CHECK(forward->next_hop == "fd00::b");
+    CHECK(forward->hops == 3);
+    CHECK(forward->sequence != 0);
+    auto reverse = d.route_to("fd00::a");
+    REQUIRE(reverse);
+    CHECK(reverse->next_hop == "fd00::c");
+    CHECK(a.mesh->get_stats().discoveries == 1);
+    CHECK(b.mesh->get_stats().forwarded == 1);
+    CHECK(c.mesh->get_stats().forwarded == 1);
+}
+
+TEST_CASE("a broken link is reported upstream and routed around") {
+    Network net;
+    Node &a = net.add("fd00::a"), &b = net.add("fd00::b"), &c = net.add("fd00::c"), &d = net.add("fd00::d");
+    Node &e = net.add("fd00::e");
+    link(a, b);
+    link(b, c);
+    link(c, d);
+    for (Node *node : {&a, &b, &c, &d, &e}) {
+        REQUIRE(node->start_mesh(fast_repair()));
+    }
+    a.mesh->send_message("fd00::d", 0, "before");
+    REQUIRE(eventually([&] { return d.got("before", "fd00::a"); }));
+    uint16_t before = a.route_to("fd00::d")->sequence;
+
+    // C notices when D stops acknowledging; the error travels back through B to A
+    link(c, d, false);
+    a.mesh->send_message("fd00::d", 0, "lost");
+    CHECK(eventually([&] { return !a.route_to("fd00::d"); }));
+    CHECK_FALSE(b.route_to("fd00::d"));
+    CHECK_FALSE(c.route_to("fd00::d"));
+    CHECK(c.mesh->get_stats().broken_links == 1);
+
+    // The next message rediscovers a path through E, with a fresher sequence number than the broken one
+    link(b, e);
+    link(e, d);
+    a.mesh->send_message("fd00::d", 0, "after");
+    REQUIRE(eventually([&] { return d.got("after", "fd00::a"); }));
+    CHECK_FALSE(d.got("lost", "fd00::a"));
+    auto repaired = a.route_to("fd00::d");
+    REQUIRE(repaired);
+    CHECK(repaired->next_hop == "fd00::b");
+    CHECK(static_cast<int16_t>(repaired->sequence - before) >= 2);
+    CHECK(b.route_to("fd00::d")->next_hop == "fd00::e");
+}
+
+TEST_CASE("a stale route reply cannot replace a fresher route") {
+    Network net;
+    Node &a = net.add("fd00::a"), &fresh = net.add("fd00::b"), &stale = net.add("fd00::c");
+    link(a, fresh);
+    link(a, stale);
+    MeshConfig config;
+    config.hop_acks = false;
+    REQUIRE(a.start_mesh(config));
+
+    a.mesh->send_message("fd00::d", 0, "waiting for a route");
+    fresh.lora.send_message("fd00::a", route_reply("fd00::a", "fd00::d", 10, 16 * 4), {});
+    REQUIRE(eventually([&] { return a.route_to("fd00::d").has_value(); }));
+    CHECK(a.route_to("fd00::d")->next_hop == "fd00::b");
+
+    // A shorter path, but learned before the one we have: ignored
+    stale.lora.send_message("fd00::a", route_reply("fd00::a", "fd00::d", 9, 0), {});
+    std::this_thread::sleep_for(300ms);
+    CHECK(a.route_to("fd00::d")->next_hop == "fd00::b");
+    // The same number with a better metric, then a newer number with a worse one: both taken
+    stale.lora.send_message("fd00::a", route_reply("fd00::a", "fd00::d", 10, 0), {});
+    REQUIRE(eventually([&] { return a.route_to("fd00::d")->next_hop == "fd00::c"; }));
+    fresh.lora.send_message("fd00::a", route_reply("fd00::a", "fd00::d", 11, 16 * 6), {});
+    REQUIRE(eventually([&] { return a.route_to("fd00::d")->sequence == 11; }));
+    CHECK(a.route_to("fd00::d")->next_hop == "fd00::b");
+}
+
+TEST_CASE("the mesh gives back the hop limit of a radio it did not start") {
+    Network net;
+    Node &a = net.add("fd00::a");
+    REQUIRE(a.lora.set_hop_limit(5));
+    REQUIRE(a.start_mesh({}));
+    CHECK(a.lora.get_hop_limit() == 1);
+    a.mesh->stop();
+    CHECK(a.lora.get_hop_limit() == 5);
+    CHECK(a.lora.is_connected());
+}
+
+TEST_CASE("a polled mesh routes from the application's thread") {
+    test::FirmwareEmulator radio_a{on_air()}, radio_b{on_air()};
+    test::FirmwareEmulator::connect(radio_a, radio_b);
+    LoRaInterface lora_a(radio_a.port(), "fd00::a"), lora_b(radio_b.port(), "fd00::b");
+    LoRaMeshInterface mesh_a(&lora_a, fast_repair()), mesh_b(&lora_b, fast_repair());
+    REQUIRE(mesh_a.set_threading(Threading::polled));
+    REQUIRE(mesh_b.set_threading(Threading::polled));
+    std::vector<std::string> received;
+    mesh_b.set_message_callback(
+        [&](const std::string &message, const std::string &, uint16_t) { received.push_back(message); });
+    REQUIRE(mesh_a.start()); // brings the radio up polled as well
+    REQUIRE(mesh_b.start());
+    CHECK(lora_a.get_threading() == Threading::polled);
+
+    Poller poller;
+    poller.add(&mesh_a);
+    poller.add(&mesh_b);
+    mesh_a.send_message("fd00::b", 0, "polled hop");
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (received.empty() && std::chrono::steady_clock::now() < deadline) {
+        poller.poll_once(10ms);
+    }
+    CHECK(received == std::vector<std::string>{"polled hop"});
+    CHECK(mesh_a.get_stats().discoveries == 1);
+    mesh_a.stop();
+    mesh_b.stop();
+}
@@ -0,0 +1,113 @@
+#include <doctest/doctest.h>
+
+#include "firmware_emulator.hpp"
+#include "impulse/network/multi_lora.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace impulse;
+
+namespace {
+
+    template <typename F> bool eventually(F &&done, std::chrono::milliseconds timeout = std::chrono::seconds(2)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!done()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    test::FirmwareEmulator::Options silent() {
+        test::FirmwareEmulator::Options options;
+        options.loopback = false;
+        return options;
+    }
+
+    size_t sent(const test::FirmwareEmulator &radio, const std::string &payload) {
+        auto transmitted = radio.transmitted();
+        return std::count(transmitted.begin(), transmitted.end(), payload);
+    }
+
+    // fd00::9, the peer in these tests
+    constexpr std::array<uint8_t, 16> PEER = {0xfd, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9};
+
+} // namespace
+
+TEST_CASE("a peer on an unknown channel is probed one channel at a time") {
+    test::FirmwareEmulator first(silent()), second(silent());
+    MultiLoRaInterface multi({{first.port(), 868100000}, {second.port(), 869525000}}, "fd00::1");
+    REQUIRE(multi.start());
+
+    // Each channel once, then the default channel; never every radio for one message
+    for (const char *message : {"probe 1", "probe 2", "probe 3"}) {
+        multi.send_message("fd00::9", 0, message);
+    }
+    REQUIRE(eventually([&] { return sent(first, "probe 3") == 1; }));
+    CHECK(sent(first, "probe 1") == 1);
+    CHECK(sent(second, "probe 1") == 0);
+    CHECK(sent(second, "probe 2") == 1);
+    CHECK(sent(first, "probe 2") == 0);
+    CHECK(sent(second, "probe 3") == 0);
+
+    REQUIRE(multi.set_default_channel(1));
+    multi.send_message("fd00::9", 0, "default");
+    CHECK(eventually([&] { return sent(second, "default") == 1; }));
+
+    // Once the peer is heard, replies follow it to its channel
+    REQUIRE(multi.set_default_channel(0));
+    second.hear(PEER, "hello", false);
+    REQUIRE(eventually([&] { return multi.get_channel_stats()[1].received == 1; }));
+    multi.send_message("fd00::9", 0, "reply");
+    CHECK(eventually([&] { return sent(second, "reply") == 1; }));
+    CHECK(sent(first, "reply") == 0);
+    multi.stop();
+}
+
+TEST_CASE("the channel classifier may call back into the interface") {
+    test::FirmwareEmulator first(silent()), second(silent());
+    MultiLoRaInterface multi({{first.port(), 868100000}, {second.port(), 869525000}}, "fd00::1");
+    REQUIRE(multi.start());
+
+    int classified = 0;
+    multi.set_channel_classifier([&](const std::string &dest, const std::string &) -> std::optional<size_t> {
+        ++classified;
+        multi.assign_peer(dest, 1); // remembered for next time
+        return 1;
+    });
+    multi.send_message("fd00::9", 0, "classified");
+    multi.send_message("fd00::9", 0, "assigned");
+    CHECK(eventually([&] { return sent(second, "assigned") == 1; }));
+    CHECK(sent(second, "classified") == 1);
+    CHECK(classified == 1);
+    multi.stop();
+}
+
+TEST_CASE("a polled multi-radio interface polls every radio") {
+    test::FirmwareEmulator first(silent()), second(silent());
+    MultiLoRaInterface multi({{first.port(), 868100000}, {second.port(), 869525000}}, "fd00::1");
+    REQUIRE(multi.set_threading(Threading::polled));
+    REQUIRE(multi.start());
+    CHECK(multi.get_poll_fds().size() == 4);
+
+    multi.multicast_message("everywhere");
+    second.hear(PEER, "hello", false);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!(sent(first, "everywhere") == 1 && sent(second, "everywhere") == 1 &&
+             multi.get_channel_stats()[1].received == 1) &&
+           std::chrono::steady_clock::now() < deadline) {
+        multi.poll_once(std::chrono::milliseconds(10));
+    }
+    CHECK(sent(first, "everywhere") == 1);
+    CHECK(sent(second, "everywhere") == 1);
+    CHECK(multi.get_channel_stats()[1].received == 1);
+    multi.stop();
+}
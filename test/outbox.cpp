@@ -0,0 +1,175 @@
+#include <doctest/doctest.h>
+
+#include "impulse/protocol/outbox.hpp"
+
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace impulse;
+
+namespace {
+
+    // File layout the tests poke at: a 64-byte file header, then 32-byte record headers padded to 8 bytes
+    constexpr size_t FILE_HEADER = 64;
+    constexpr size_t RECORD_HEADER = 32;
+    constexpr size_t STATE = 5; // offset of the state byte in a record header
+
+    // A fresh outbox file per test, removed afterwards
+    struct TempOutbox {
+        std::string path;
+        OutboxConfig config;
+
+        explicit TempOutbox(const std::string &name) {
+            path = (std::filesystem::temp_directory_path() /
+                    ("impulse-" + name + "-" + std::to_string(getpid()) + ".outbox"))
+                       .string();
+            std::filesystem::remove(path);
+            config.capacity = FILE_HEADER + 4096; // the smallest outbox
+        }
+        ~TempOutbox() { std::filesystem::remove(path); }
+
+        // Overwrite bytes of the closed file, as a crash or a torn write would leave them
+        void poke(size_t offset, const void *bytes, size_t size) const {
+            int fd = ::open(path.c_str(), O_WRONLY);
+            REQUIRE(fd >= 0);
+            REQUIRE(pwrite(fd, bytes, size, static_cast<off_t>(offset)) == static_cast<ssize_t>(size));
+            ::close(fd);
+        }
+    };
+
+    bool push(Outbox &outbox, const std::string &payload, uint8_t priority = 0, uint64_t dedup_key = 0) {
+        return outbox.push(payload.data(), payload.size(), priority, dedup_key);
+    }
+
+    std::vector<std::string> drain(Outbox &outbox) {
+        std::vector<std::string> out;
+        std::string payload;
+        while (outbox.front(payload)) {
+            out.push_back(payload);
+            outbox.pop();
+        }
+        return out;
+    }
+
+} // namespace
+
+TEST_CASE("pending records survive a reopen in delivery order") {
+    TempOutbox file("reopen");
+    {
+        Outbox outbox;
+        REQUIRE(outbox.open(file.path, file.config));
+        REQUIRE(push(outbox, "low"));
+        REQUIRE(push(outbox, "high", 3));
+        REQUIRE(push(outbox, "sent"));
+        REQUIRE(push(outbox, "low again"));
+        std::string payload;
+        REQUIRE(outbox.front(payload));
+        CHECK(payload == "high");
+        outbox.pop();
+    }
+
+    Outbox outbox;
+    REQUIRE(outbox.open(file.path, file.config));
+    CHECK(outbox.size() == 3);
+    CHECK(drain(outbox) == std::vector<std::string>{"low", "sent", "low again"});
+    CHECK(outbox.stats().bytes_used == FILE_HEADER); // drained: rewound to an empty file
+}
+
+TEST_CASE("a torn record at the tail is dropped on reopen") {
+    TempOutbox file("torn");
+    {
+        Outbox outbox;
+        REQUIRE(outbox.open(file.path, file.config));
+        REQUIRE(push(outbox, "complete")); // 8 bytes: a 40-byte record
+        REQUIRE(push(outbox, "torn apart"));
+    }
+    // The second record's length no longer fits inside the committed tail
+    uint32_t garbage = 0x7FFF;
+    file.poke(FILE_HEADER + RECORD_HEADER + 8, &garbage, sizeof(garbage));
+
+    Outbox outbox;
+    REQUIRE(outbox.open(file.path, file.config));
+    CHECK(outbox.size() == 1);
+    CHECK(outbox.stats().bytes_used == FILE_HEADER + RECORD_HEADER + 8);
+
+    // Appends continue where the good records end
+    REQUIRE(push(outbox, "next"));
+    outbox.close();
+    REQUIRE(outbox.open(file.path, file.config));
+    CHECK(drain(outbox) == std::vector<std::string>{"complete", "next"});
+}
+
+TEST_CASE("a full outbox evicts the oldest of the lowest priority") {
+    TempOutbox file("evict");
+    Outbox outbox;
+    REQUIRE(outbox.open(file.path, file.config));
+    // 232-byte records: 17 fit in the 4096 bytes behind the header
+    const std::string filler(200, 'x');
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(push(outbox, "low " + std::to_string(i) + filler));
+    }
+    for (int i = 0; i < 7; ++i) {
+        REQUIRE(push(outbox, "high " + std::to_string(i) + filler, 5));
+    }
+    CHECK(outbox.stats().evicted == 0);
+
+    // Room for the newcomer and some slack, so the next push does not compact again
+    REQUIRE(push(outbox, "high 7" + filler, 5));
+    CHECK(outbox.stats().evicted == 2);
+    CHECK(outbox.size() == 16);
+    REQUIRE(push(outbox, "high 8" + filler, 5));
+    CHECK(outbox.stats().evicted == 2);
+
+    auto order = drain(outbox);
+    REQUIRE(order.size() == 17);
+    for (int i = 0; i < 9; ++i) {
+        CHECK(order[i] == "high " + std::to_string(i) + filler);
+    }
+    for (int i = 2; i < 10; ++i) {
+        CHECK(order[9 + i - 2] == "low " + std::to_string(i) + filler);
+    }
+}
+
+TEST_CASE("a lower priority never evicts a higher one") {
+    TempOutbox file("reject");
+    Outbox outbox;
+    REQUIRE(outbox.open(file.path, file.config));
+    const std::string filler(200, 'x');
+    for (int i = 0; i < 17; ++i) {
+        REQUIRE(push(outbox, filler, 5));
+    }
+    CHECK_FALSE(push(outbox, filler, 1));
+    CHECK(outbox.stats().rejected == 1);
+    CHECK(outbox.stats().evicted == 0);
+    CHECK(outbox.size() == 17);
+    CHECK_FALSE(push(outbox, std::string(4096, 'x'), 9)); // larger than the whole file
+}
+
+TEST_CASE("a dedup key replaces the pending message across reopens") {
+    TempOutbox file("dedup");
+    {
+        Outbox outbox;
+        REQUIRE(outbox.open(file.path, file.config));
+        REQUIRE(push(outbox, "position 1", 0, 42));
+        REQUIRE(push(outbox, "other"));
+    }
+    {
+        Outbox outbox;
+        REQUIRE(outbox.open(file.path, file.config));
+        REQUIRE(push(outbox, "position 2", 0, 42));
+        CHECK(outbox.size() == 2);
+        CHECK(outbox.stats().superseded == 1);
+    }
+
+    // A crash between appending the new record and retiring the old one leaves both pending; the later one wins
+    uint8_t pending = 0;
+    file.poke(FILE_HEADER + STATE, &pending, sizeof(pending));
+    Outbox outbox;
+    REQUIRE(outbox.open(file.path, file.config));
+    CHECK(outbox.stats().superseded == 1);
+    CHECK(drain(outbox) == std::vector<std::string>{"other", "position 2"});
+}
@@ -0,0 +1,114 @@
+// Counts heap allocations in this test binary; must come before any impulse include
+#define IMPULSE_COUNT_ALLOCATIONS
+#include "impulse/util/memory.hpp"
+
+#include <doctest/doctest.h>
+
+#include "impulse/protocol/redundancy.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+using namespace impulse;
+using namespace std::chrono_literals;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    bool accept(DedupWindow &window, uint32_t origin, uint32_t sequence, Clock::time_point now) {
+        Clock::duration lag;
+        return window.accept(origin, sequence, now, lag);
+    }
+
+    // Accepts [first, last) and counts the ones that were new
+    uint32_t accept_range(DedupWindow &window, uint32_t origin, uint32_t first, uint32_t last, Clock::time_point now) {
+        uint32_t fresh = 0;
+        for (uint32_t sequence = first; sequence < last; ++sequence) {
+            fresh += accept(window, origin, sequence, now);
+        }
+        return fresh;
+    }
+
+} // namespace
+
+TEST_CASE("the first copy is delivered and later ones report their lag") {
+    DedupWindow window;
+    auto start = Clock::now();
+    Clock::duration lag;
+    CHECK(window.accept(1, 7, start, lag));
+    CHECK_FALSE(window.accept(1, 7, start + 30ms, lag));
+    CHECK(lag == 30ms);
+    CHECK(window.accept(2, 7, start, lag)); // origins keep separate sequence spaces
+
+    // A copy far behind the newest sequence is still recognised, such as one drained from an outbox
+    CHECK(window.accept(1, 1000, start, lag));
+    CHECK(window.accept(1, 3, start, lag));
+    CHECK_FALSE(window.accept(1, 3, start, lag));
+
+    // Once a later sequence took the lag slot the duplicate is still dropped, without a lag
+    CHECK(window.accept(1, 7 + DedupWindow::WINDOW, start, lag));
+    CHECK_FALSE(window.accept(1, 7, start + 50ms, lag));
+    CHECK(lag == Clock::duration::zero());
+}
+
+TEST_CASE("sequences are forgotten after the retention period") {
+    DedupWindow window(256, 10s);
+    auto start = Clock::now();
+    REQUIRE(accept(window, 1, 5, start));
+    REQUIRE(accept(window, 1, 70, start));
+    CHECK_FALSE(accept(window, 1, 5, start + 5s)); // a duplicate does not keep its block alive
+    REQUIRE(accept(window, 1, 71, start + 5s));    // a new sequence does
+
+    CHECK_FALSE(accept(window, 1, 5, start + 9s));
+    CHECK(accept(window, 1, 5, start + 11s)); // its block expired
+    CHECK_FALSE(accept(window, 1, 70, start + 11s));
+
+    // Shortening the retention applies to blocks already held
+    window.set_retention(1s);
+    CHECK(accept(window, 1, 70, start + 13s));
+}
+
+TEST_CASE("an origin holds at most max_sequences, dropping its oldest block") {
+    DedupWindow window(256, DedupWindow::DEFAULT_RETENTION, 2 * DedupWindow::WINDOW);
+    auto start = Clock::now();
+    REQUIRE(accept_range(window, 1, 0, 2 * DedupWindow::WINDOW, start) == 2 * DedupWindow::WINDOW);
+    REQUIRE(accept(window, 1, 2 * DedupWindow::WINDOW, start));
+
+    // Sequences 0..63 went with the first block; the rest are still known
+    CHECK(accept(window, 1, 0, start));
+    CHECK_FALSE(accept(window, 1, 2 * DedupWindow::WINDOW, start));
+    CHECK(accept_range(window, 1, DedupWindow::WINDOW, 2 * DedupWindow::WINDOW, start) == DedupWindow::WINDOW);
+
+    // Other origins have their own allowance
+    CHECK(accept_range(window, 2, 0, 2 * DedupWindow::WINDOW, start) == 2 * DedupWindow::WINDOW);
+    CHECK_FALSE(accept(window, 1, DedupWindow::WINDOW, start));
+}
+
+TEST_CASE("the least recently heard origin goes when there are too many") {
+    DedupWindow window(2);
+    auto start = Clock::now();
+    REQUIRE(accept(window, 1, 0, start));
+    REQUIRE(accept(window, 2, 0, start + 1s));
+    REQUIRE(accept(window, 3, 0, start + 2s));
+    CHECK_FALSE(accept(window, 2, 0, start + 3s));
+    CHECK_FALSE(accept(window, 3, 0, start + 3s));
+    CHECK(accept(window, 1, 0, start + 3s));
+}
+
+TEST_CASE("blocks are reused clean, without allocating") {
+    DedupWindow window(256, 10s, 4 * DedupWindow::WINDOW);
+    auto start = Clock::now();
+    REQUIRE(accept_range(window, 1, 0, 4 * DedupWindow::WINDOW, start) == 4 * DedupWindow::WINDOW);
+
+    // Every expired block comes back for a new range, with none of its old bits set
+    uint64_t before = heap_allocations();
+    CHECK(accept_range(window, 1, 4 * DedupWindow::WINDOW, 8 * DedupWindow::WINDOW, start + 11s) ==
+          4 * DedupWindow::WINDOW);
+    // A full origin recycles its oldest block the same way
+    CHECK(accept_range(window, 1, 0, 2 * DedupWindow::WINDOW, start + 12s) == 2 * DedupWindow::WINDOW);
+    CHECK(heap_allocations() == before);
+
+    CHECK(accept(window, 1, 4 * DedupWindow::WINDOW, start + 12s)); // its block was the one recycled
+    CHECK_FALSE(accept(window, 1, 7 * DedupWindow::WINDOW, start + 12s));
+}
@@ -0,0 +1,98 @@
+#include <doctest/doctest.h>
+
+#include "impulse/util/ring_buffer.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace impulse;
+
+TEST_CASE("elements come out in order across the wrap-around") {
+    RingBuffer<int> ring(4);
+    std::vector<int> out(3);
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(ring.push(round * 10 + i));
+        }
+        REQUIRE(ring.drain(out) == 3);
+        CHECK(out == std::vector<int>{round * 10, round * 10 + 1, round * 10 + 2});
+    }
+    CHECK(ring.empty());
+    CHECK(ring.stats().pushed == 15);
+    CHECK(ring.stats().dropped == 0);
+}
+
+TEST_CASE("drop_oldest keeps the freshest elements") {
+    RingBuffer<int> ring(3, OverflowPolicy::drop_oldest);
+    for (int i = 1; i <= 5; ++i) {
+        CHECK(ring.push(int(i)));
+    }
+    std::vector<int> out(5);
+    REQUIRE(ring.drain(out) == 3);
+    CHECK(out[0] == 3);
+    CHECK(out[1] == 4);
+    CHECK(out[2] == 5);
+    auto stats = ring.stats();
+    CHECK(stats.pushed == 5);
+    CHECK(stats.dropped == 2);
+    CHECK(stats.size == 0);
+    CHECK(stats.capacity == 3);
+}
+
+TEST_CASE("drop_newest rejects what does not fit") {
+    RingBuffer<int> ring(2, OverflowPolicy::drop_newest);
+    CHECK(ring.push(1));
+    CHECK(ring.push(2));
+    CHECK_FALSE(ring.push(3));
+    CHECK(ring.size() == 2);
+    CHECK(ring.stats().dropped == 1);
+    std::vector<int> out(2);
+    REQUIRE(ring.drain(out) == 2);
+    CHECK(out == std::vector<int>{1, 2});
+}
+
+TEST_CASE("a short drain leaves the rest queued") {
+    RingBuffer<int> ring(8);
+    for (int i = 0; i < 5; ++i) {
+        ring.push(int(i));
+    }
+    std::vector<int> out(2);
+    CHECK(ring.drain(out) == 2);
+    CHECK(out == std::vector<int>{0, 1});
+    CHECK(ring.size() == 3);
+    CHECK(ring.drain(std::span<int>()) == 0);
+    ring.clear();
+    CHECK(ring.empty());
+    CHECK(ring.drain(out) == 0);
+}
+
+TEST_CASE("string capacity circulates between the ring and the caller") {
+    RingBuffer<std::string> ring(1);
+    std::string long_message(1000, 'x');
+    ring.push_with([&](std::string &slot) { slot.assign(long_message); });
+
+    std::vector<std::string> out(1);
+    REQUIRE(ring.drain(out) == 1);
+    CHECK(out[0] == long_message);
+    const char *buffer = out[0].data();
+
+    // Draining again hands the caller's string back as the spare slot, which the next push fills in place
+    ring.push_with([](std::string &slot) { slot.assign("short"); });
+    REQUIRE(ring.drain(out) == 1);
+    CHECK(out[0] == "short");
+    ring.push_with([](std::string &slot) { slot.assign("again"); });
+    REQUIRE(ring.drain(out) == 1);
+    CHECK(out[0] == "again");
+    CHECK(out[0].data() == buffer);
+    CHECK(out[0].capacity() >= 1000);
+}
+
+TEST_CASE("a ring always has room for one element") {
+    RingBuffer<int> ring(0);
+    CHECK(ring.capacity() == 1);
+    CHECK(ring.push(7));
+    CHECK(ring.push(8));
+    std::vector<int> out(1);
+    REQUIRE(ring.drain(out) == 1);
+    CHECK(out[0] == 8);
+}
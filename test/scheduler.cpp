@@ -0,0 +1,177 @@
+#include <doctest/doctest.h>
+
+#include "impulse/network/scheduler.hpp"
+
+#include <chrono>
+#include <string>
+
+using namespace impulse;
+using namespace std::chrono_literals;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    TxFrame frame_to(const std::string &dest, size_t payload_size, TxOptions options = {}) {
+        TxFrame frame;
+        frame.dest_addr = dest;
+        frame.payload_size = payload_size;
+        frame.options = options;
+        return frame;
+    }
+
+    // One 1 % sub-band observed over 100 s (a 1 s budget); pacing out of the way unless a test sets it
+    TxScheduler one_percent() {
+        TxSchedulerConfig config;
+        config.limits = {{{868000000, 868600000, 0.01}}, 1.0, std::chrono::seconds(100)};
+        config.frequency_hz = 868100000;
+        config.pacing_rate = 1.0;
+        config.pacing_burst = std::chrono::milliseconds(100000);
+        return TxScheduler(config);
+    }
+
+} // namespace
+
+TEST_CASE("time on air follows the Semtech formula") {
+    LoRaModulation modulation; // SF7, 125 kHz, 4/5, 8 preamble symbols, explicit header, CRC, 4 bytes framing
+    CHECK(modulation.time_on_air(10) == 46336us);
+    CHECK_FALSE(modulation.low_data_rate_optimize());
+
+    modulation.spreading_factor = 12; // symbols of 32.768 ms, so low data rate optimisation is on
+    CHECK(modulation.low_data_rate_optimize());
+    CHECK(modulation.time_on_air(10) == 1155072us);
+
+    modulation.spreading_factor = 10;
+    CHECK_FALSE(modulation.low_data_rate_optimize());
+    modulation.spreading_factor = 11;
+    CHECK(modulation.low_data_rate_optimize());
+}
+
+TEST_CASE("frames wait for the duty-cycle window once the budget is spent") {
+    TxScheduler scheduler = one_percent();
+    auto airtime = scheduler.modulation().time_on_air(10);
+    auto start = Clock::now();
+    size_t fit = 1000000 / airtime.count(); // frames that fit in the 1 s budget
+    for (size_t i = 0; i <= fit; ++i) {
+        REQUIRE(scheduler.enqueue(frame_to("fd00::2", 10), start));
+    }
+
+    Clock::time_point wake_at;
+    for (size_t i = 0; i < fit; ++i) {
+        REQUIRE(scheduler.pop_ready(start + i * 1ms, wake_at));
+    }
+    CHECK(scheduler.airtime_used() == airtime * fit);
+    CHECK_FALSE(scheduler.pop_ready(start + fit * 1ms, wake_at));
+    CHECK(wake_at == start + 100s); // when the first frame leaves the window
+
+    CHECK(scheduler.pop_ready(wake_at, wake_at));
+    CHECK(scheduler.stats().sent == fit + 1);
+    CHECK(scheduler.stats().airtime == airtime * (fit + 1));
+}
+
+TEST_CASE("pacing spreads frames out at the configured rate") {
+    TxScheduler scheduler = one_percent();
+    auto airtime = scheduler.modulation().time_on_air(10);
+    scheduler.set_pacing(0.5, std::chrono::duration_cast<std::chrono::milliseconds>(airtime) + 1ms);
+    auto start = Clock::now();
+    scheduler.enqueue(frame_to("fd00::2", 10), start);
+    scheduler.enqueue(frame_to("fd00::2", 10), start);
+
+    Clock::time_point wake_at;
+    REQUIRE(scheduler.pop_ready(start, wake_at));
+    CHECK_FALSE(scheduler.pop_ready(start, wake_at));
+    CHECK(wake_at > start + airtime); // half the channel: the bucket refills at half speed
+    CHECK(wake_at <= start + 2 * airtime);
+    CHECK(scheduler.pop_ready(wake_at, wake_at));
+}
+
+TEST_CASE("higher priorities go first and expired or coalesced frames never go out") {
+    TxScheduler scheduler = one_percent();
+    auto start = Clock::now();
+    TxOptions bulk{TxPriority::bulk};
+    TxOptions control{TxPriority::control};
+    TxOptions position{TxPriority::high, 100ms, 7};
+    scheduler.enqueue(frame_to("fd00::2", 10, bulk), start);
+    scheduler.enqueue(frame_to("fd00::2", 20, position), start);
+    scheduler.enqueue(frame_to("fd00::2", 30, position), start); // replaces the queued position
+    scheduler.enqueue(frame_to("fd00::3", 40, position), start); // another destination keeps its own
+    scheduler.enqueue(frame_to("fd00::2", 50, control), start);
+    CHECK(scheduler.size() == 4);
+    CHECK(scheduler.stats().coalesced == 1);
+
+    Clock::time_point wake_at;
+    auto first = scheduler.pop_ready(start, wake_at);
+    REQUIRE(first);
+    CHECK(first->payload_size == 50);
+    auto second = scheduler.pop_ready(start, wake_at);
+    REQUIRE(second);
+    CHECK(second->payload_size == 30);
+
+    // The other position update is past its max_age by now
+    auto third = scheduler.pop_ready(start + 200ms, wake_at);
+    REQUIRE(third);
+    CHECK(third->payload_size == 10);
+    CHECK(scheduler.stats().expired == 1);
+    CHECK(scheduler.empty());
+}
+
+TEST_CASE("a full queue sheds lower priorities and refuses frames it cannot make room for") {
+    TxSchedulerConfig config;
+    config.limits = RegionalLimits::unrestricted();
+    config.max_queued_frames = 2;
+    TxScheduler scheduler(config);
+    auto start = Clock::now();
+
+    CHECK(scheduler.enqueue(frame_to("fd00::2", 10, {TxPriority::bulk}), start));
+    CHECK(scheduler.enqueue(frame_to("fd00::2", 11, {TxPriority::normal}), start));
+    CHECK(scheduler.enqueue(frame_to("fd00::2", 12, {TxPriority::control}), start)); // the bulk frame goes
+    CHECK_FALSE(scheduler.enqueue(frame_to("fd00::2", 13, {TxPriority::bulk}), start));
+    CHECK(scheduler.stats().dropped == 2);
+
+    Clock::time_point wake_at;
+    CHECK(scheduler.pop_ready(start, wake_at)->payload_size == 12);
+    CHECK(scheduler.pop_ready(start, wake_at)->payload_size == 11);
+    CHECK(scheduler.empty());
+}
+
+TEST_CASE("a frame longer than the whole budget is refused") {
+    TxSchedulerConfig config;
+    config.limits = {{{868000000, 868600000, 0.0001}}, 1.0, std::chrono::seconds(100)}; // 10 ms budget
+    TxScheduler scheduler(config);
+    CHECK(scheduler.exceeds_budget(frame_to("fd00::2", 10)));
+    CHECK_FALSE(scheduler.enqueue(frame_to("fd00::2", 10), Clock::now()));
+    CHECK(scheduler.stats().oversized == 1);
+    CHECK(scheduler.empty());
+}
+
+TEST_CASE("a requeued frame is charged its airtime once") {
+    TxScheduler scheduler = one_percent();
+    auto airtime = scheduler.modulation().time_on_air(10);
+    auto start = Clock::now();
+    scheduler.enqueue(frame_to("fd00::2", 10, {TxPriority::normal, 50ms}), start);
+    scheduler.enqueue(frame_to("fd00::2", 99), start);
+
+    Clock::time_point wake_at;
+    auto frame = scheduler.pop_ready(start, wake_at);
+    REQUIRE(frame);
+    CHECK(scheduler.airtime_used() == airtime);
+
+    // The link went down before it was written: nothing was spent, and it stays ahead of later frames
+    scheduler.requeue(std::move(*frame));
+    CHECK(scheduler.airtime_used() == 0us);
+    CHECK(scheduler.stats().sent == 0);
+    CHECK(scheduler.stats().airtime == 0us);
+
+    frame = scheduler.pop_ready(start + 10ms, wake_at);
+    REQUIRE(frame);
+    CHECK(frame->payload_size == 10);
+    CHECK(scheduler.airtime_used() == airtime);
+    CHECK(scheduler.stats().sent == 1);
+
+    // Requeueing keeps the original expiry
+    scheduler.requeue(std::move(*frame));
+    frame = scheduler.pop_ready(start + 60ms, wake_at);
+    REQUIRE(frame);
+    CHECK(frame->payload_size == 99);
+    CHECK(scheduler.stats().expired == 1);
+}
@@ -0,0 +1,346 @@
+#include <doctest/doctest.h>
+
+#include "firmware_emulator.hpp"
+#include "impulse/network/lora.hpp"
+#include "impulse/network/serial_framing.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace impulse;
+
+namespace {
+
+    size_t no_v1_length(const uint8_t *, size_t) { return SIZE_MAX; }
+
+    std::vector<uint8_t> v2_frame(uint8_t type, const std::vector<uint8_t> &data) {
+        std::vector<uint8_t> out;
+        SerialFramer::encode_command(FramingVersion::v2, type, data, out);
+        return out;
+    }
+
+    void feed(SerialFramer &framer, const std::vector<uint8_t> &bytes) { framer.feed(bytes.data(), bytes.size()); }
+
+    template <typename F> bool eventually(F &&done, std::chrono::milliseconds timeout = std::chrono::seconds(2)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!done()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+} // namespace
+
+TEST_CASE("v2 frames survive being split at any byte") {
+    SerialFramer framer(no_v1_length);
+    framer.set_version(FramingVersion::v2);
+    auto first = v2_frame(RESP_ACK, {CMD_SET_IPV6});
+    auto second = v2_frame(RESP_STATUS, std::vector<uint8_t>(25, 0x42));
+
+    std::vector<uint8_t> stream = first;
+    stream.insert(stream.end(), second.begin(), second.end());
+    uint8_t type;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> types;
+    for (uint8_t byte : stream) {
+        framer.feed(&byte, 1);
+        while (framer.next(type, data)) {
+            types.push_back(type);
+        }
+    }
+
+    REQUIRE(types.size() == 2);
+    CHECK(types[0] == RESP_ACK);
+    CHECK(types[1] == RESP_STATUS);
+    CHECK(data == std::vector<uint8_t>(25, 0x42));
+    CHECK(framer.stats().frames == 2);
+    CHECK(framer.stats().discarded_bytes == 0);
+}
+
+TEST_CASE("a corrupt v2 body is dropped whole and the next frame still parses") {
+    SerialFramer framer(no_v1_length);
+    framer.set_version(FramingVersion::v2);
+    auto damaged = v2_frame(RESP_MESSAGE, std::vector<uint8_t>(40, 0xAA)); // body full of sync-like bytes
+    damaged[SerialFramer::V2_HEADER + 7] ^= 0x01;
+    auto intact = v2_frame(RESP_ACK, {CMD_GET_STATUS});
+    feed(framer, damaged);
+    feed(framer, intact);
+
+    uint8_t type;
+    std::vector<uint8_t> data;
+    REQUIRE(framer.next(type, data));
+    CHECK(type == RESP_ACK);
+    CHECK(data == std::vector<uint8_t>{CMD_GET_STATUS});
+    CHECK_FALSE(framer.next(type, data));
+    CHECK(framer.stats().crc_errors == 1);
+    CHECK(framer.stats().discarded_bytes == damaged.size());
+}
+
+TEST_CASE("noise with a partial sync word in front of a frame is skipped") {
+    SerialFramer framer(no_v1_length);
+    framer.set_version(FramingVersion::v2);
+    std::vector<uint8_t> noise = {0x00, 0xAA, 0x55, 0x00, 0x13, 0x77, 0xAA};
+    auto frame = v2_frame(RESP_NACK, {CMD_SET_BAUD, ERR_INVALID_COMMAND});
+    feed(framer, noise);
+    feed(framer, frame);
+
+    uint8_t type;
+    std::vector<uint8_t> data;
+    REQUIRE(framer.next(type, data));
+    CHECK(type == RESP_NACK);
+    CHECK(framer.stats().header_errors >= 1);
+    CHECK(framer.stats().discarded_bytes == noise.size());
+}
+
+TEST_CASE("LoRaInterface negotiates framing v2 and carries messages over it") {
+    test::FirmwareEmulator firmware;
+    SerialConfig config;
+    config.negotiate_framing = true;
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::1", config);
+    std::atomic<int> received{0};
+    lora.set_message_callback([&](const std::string &message, const std::string &, uint16_t) {
+        if (message == "hello over v2") {
+            ++received;
+        }
+    });
+
+    REQUIRE(lora.start());
+    CHECK(lora.get_framing() == FramingVersion::v2);
+    CHECK(firmware.framing_v2());
+
+    lora.send_message("fd00:dead:beef::2", 0, "hello over v2");
+    CHECK(eventually([&] { return received == 1; }));
+    CHECK(lora.get_framing_stats().crc_errors == 0);
+    lora.stop();
+}
+
+TEST_CASE("firmware without v2 keeps the link on v1") {
+    test::FirmwareEmulator::Options options;
+    options.supports_v2 = false;
+    test::FirmwareEmulator firmware(options);
+    SerialConfig config;
+    config.negotiate_framing = true;
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::1", config);
+
+    REQUIRE(lora.start());
+    CHECK(lora.get_framing() == FramingVersion::v1);
+    CHECK(lora.submit_command(CMD_GET_STATUS).get().ok());
+    lora.stop();
+}
+
+TEST_CASE("commands keep completing over a noisy v2 link") {
+    test::FirmwareEmulator::Options options;
+    options.corrupt_every = 7;
+    options.noise = true;
+    test::FirmwareEmulator firmware(options);
+    SerialConfig config;
+    config.negotiate_framing = true;
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::1", config);
+    REQUIRE(lora.start());
+    REQUIRE(lora.get_framing() == FramingVersion::v2);
+
+    std::vector<std::future<CommandResult>> probes;
+    for (int i = 0; i < 70; ++i) {
+        probes.push_back(lora.submit_command(CMD_GET_STATUS, {}, std::chrono::milliseconds(500)));
+    }
+    int completed = 0;
+    for (auto &probe : probes) {
+        completed += probe.get().completed;
+    }
+
+    // One frame in seven is damaged and dropped whole; the link carries on with the rest
+    CHECK(completed >= 55);
+    CHECK(completed < 70);
+    auto stats = lora.get_framing_stats();
+    CHECK(stats.crc_errors >= 1);
+    CHECK(stats.crc_errors == static_cast<uint64_t>(70 - completed));
+    lora.stop();
+}
+
+namespace {
+
+    // The emulator counts status answers in the uptime field, so each answer names the probe it belongs to
+    uint16_t answer_number(const CommandResult &result) { return (result.response[23] << 8) | result.response[24]; }
+
+} // namespace
+
+TEST_CASE("v2 answers reach the command they belong to when frames are dropped") {
+    test::FirmwareEmulator firmware;
+    SerialConfig config;
+    config.negotiate_framing = true;
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::1", config);
+    REQUIRE(lora.start());
+    REQUIRE(lora.get_framing() == FramingVersion::v2);
+
+    uint32_t answered = firmware.status_answers();
+    firmware.set_status_delay(std::chrono::milliseconds(2)); // keep them all in flight
+    firmware.damage_status_answers({answered + 4, answered + 12});
+    std::vector<std::future<CommandResult>> probes;
+    for (int i = 0; i < 20; ++i) {
+        probes.push_back(lora.submit_command(CMD_GET_STATUS, {}, std::chrono::milliseconds(500)));
+    }
+
+    // Only the probes whose own answer was damaged fail; every other one gets its own answer
+    for (size_t i = 0; i < probes.size(); ++i) {
+        CommandResult result = probes[i].get();
+        if (i == 3 || i == 11) {
+            CHECK_FALSE(result.completed);
+        } else {
+            REQUIRE(result.completed);
+            CHECK(answer_number(result) == answered + i + 1);
+        }
+    }
+    CHECK(lora.get_framing_stats().crc_errors == 2);
+    lora.stop();
+}
+
+TEST_CASE("a dropped v1 answer fails the commands it could be confused with") {
+    test::FirmwareEmulator firmware;
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::1");
+    REQUIRE(lora.start());
+    REQUIRE(lora.get_framing() == FramingVersion::v1);
+
+    uint32_t answered = firmware.status_answers();
+    firmware.set_status_delay(std::chrono::milliseconds(20));
+    firmware.damage_status_answers({answered + 3}); // loses its sync word
+    std::vector<std::future<CommandResult>> probes;
+    for (int i = 0; i < 10; ++i) {
+        probes.push_back(lora.submit_command(CMD_GET_STATUS, {}, std::chrono::milliseconds(300)));
+    }
+    for (size_t i = 0; i < probes.size(); ++i) {
+        CommandResult result = probes[i].get();
+        if (i < 2) {
+            REQUIRE(result.completed);
+            CHECK(answer_number(result) == answered + i + 1);
+        } else {
+            CHECK_FALSE(result.completed);
+        }
+    }
+
+    // Held back until the late answers to the failed probes have been discarded, then answered in step again
+    CommandResult next = lora.submit_command(CMD_GET_STATUS).get();
+    REQUIRE(next.completed);
+    CHECK(answer_number(next) == answered + 11);
+    lora.stop();
+}
+
+TEST_CASE("a radio that stops answering is reopened and gets its configuration back") {
+    test::FirmwareEmulator firmware;
+    SerialConfig config;
+    config.negotiate_framing = true;
+    config.heartbeat_interval = std::chrono::seconds(1);
+    config.max_missed_heartbeats = 1;
+    config.reconnect_backoff_min = std::chrono::milliseconds(50);
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::1", config);
+    lora.set_command_timeout(std::chrono::milliseconds(300));
+    REQUIRE(lora.start());
+    REQUIRE(lora.set_tx_power(14));
+    size_t configured = firmware.command_count(CMD_SET_CONFIG);
+
+    firmware.set_muted(true);
+    REQUIRE(eventually([&] { return lora.get_reconnect_count() >= 1; }, std::chrono::seconds(5)));
+    CHECK_FALSE(lora.is_connected());
+    firmware.reset();
+    firmware.set_muted(false);
+
+    // Replayed in the background: framing first, then the settings, then transmissions resume
+    REQUIRE(eventually([&] { return lora.is_connected(); }, std::chrono::seconds(5)));
+    CHECK(lora.get_framing() == FramingVersion::v2);
+    CHECK(firmware.framing_v2());
+    CHECK(firmware.command_count(CMD_SET_CONFIG) > configured);
+    lora.send_message("fd00:dead:beef::2", 0, "after the reset");
+    CHECK(eventually([&] {
+        auto sent = firmware.transmitted();
+        return std::find(sent.begin(), sent.end(), "after the reset") != sent.end();
+    }));
+    lora.stop();
+}
+
+namespace {
+
+    // Drive `item` from this thread until `done`, as an application's event loop would
+    template <typename F>
+    bool polled_until(Pollable &item, F &&done, std::chrono::milliseconds timeout = std::chrono::seconds(2)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!done()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            item.poll_once(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+} // namespace
+
+TEST_CASE("a polled LoRaInterface does its work from poll_once") {
+    test::FirmwareEmulator firmware;
+    SerialConfig config;
+    config.negotiate_framing = true;
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::1", config);
+    REQUIRE(lora.set_threading(Threading::polled));
+    auto caller = std::this_thread::get_id();
+    int received = 0;
+    bool on_caller = true;
+    lora.set_message_callback([&](const std::string &message, const std::string &, uint16_t) {
+        received += message == "polled";
+        on_caller = on_caller && std::this_thread::get_id() == caller;
+    });
+
+    // start() reads the answers it waits for on this thread
+    REQUIRE(lora.start());
+    CHECK(lora.get_framing() == FramingVersion::v2);
+    CHECK(lora.get_poll_fds().size() == 2);
+    CHECK_FALSE(lora.set_threading(Threading::threads));
+
+    lora.send_message("fd00:dead:beef::2", 0, "polled");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(firmware.transmitted().empty()); // nothing happens between polls
+
+    Poller poller;
+    poller.add(&lora);
+    REQUIRE(polled_until(poller, [&] { return received == 1; }));
+    CHECK(on_caller);
+    CHECK(firmware.transmitted() == std::vector<std::string>{"polled"});
+    CHECK(lora.get_status().radio_active);
+    CHECK(lora.next_deadline() != std::chrono::steady_clock::time_point::max()); // the next heartbeat
+    lora.stop();
+}
+
+TEST_CASE("a polled radio that stops answering is reopened from poll_once") {
+    test::FirmwareEmulator firmware;
+    SerialConfig config;
+    config.negotiate_framing = true;
+    config.heartbeat_interval = std::chrono::seconds(1);
+    config.max_missed_heartbeats = 1;
+    config.reconnect_backoff_min = std::chrono::milliseconds(50);
+    LoRaInterface lora(firmware.port(), "fd00:dead:beef::1", config);
+    REQUIRE(lora.set_threading(Threading::polled));
+    lora.set_command_timeout(std::chrono::milliseconds(300));
+    REQUIRE(lora.start());
+    REQUIRE(lora.set_tx_power(14));
+    size_t configured = firmware.command_count(CMD_SET_CONFIG);
+
+    firmware.set_muted(true);
+    REQUIRE(polled_until(lora, [&] { return lora.get_reconnect_count() >= 1; }, std::chrono::seconds(5)));
+    firmware.reset();
+    firmware.set_muted(false);
+
+    REQUIRE(polled_until(lora, [&] { return lora.is_connected(); }, std::chrono::seconds(5)));
+    CHECK(lora.get_framing() == FramingVersion::v2);
+    CHECK(firmware.command_count(CMD_SET_CONFIG) > configured);
+    lora.send_message("fd00:dead:beef::2", 0, "after the reset");
+    CHECK(polled_until(lora, [&] {
+        auto sent = firmware.transmitted();
+        return std::find(sent.begin(), sent.end(), "after the reset") != sent.end();
+    }));
+    lora.stop();
+}
@@ -0,0 +1,77 @@
+#include <doctest/doctest.h>
+
+#include "impulse/network/short_address.hpp"
+
+#include <string>
+
+using namespace impulse;
+
+TEST_CASE("fleet addresses map to their interface ID and back") {
+    ShortAddressTable table;
+    CHECK(table.lookup("fd00:dead:beef::1234") == 0x1234);
+    CHECK(table.lookup("fd00:dead:beef::a") == 0x000a);
+    CHECK(table.expand_to_string(0x1234) == "fd00:dead:beef::1234");
+
+    // Outside the prefix, beyond 16 bits, or one of the reserved IDs: no short form without an assignment
+    CHECK_FALSE(table.lookup("fd00:1::1234"));
+    CHECK_FALSE(table.lookup("fd00:dead:beef::1:1234"));
+    CHECK_FALSE(table.lookup("fd00:dead:beef::"));
+    CHECK_FALSE(table.lookup("fd00:dead:beef::ffff"));
+    CHECK_FALSE(table.lookup("not an address"));
+}
+
+TEST_CASE("broadcast has its own ID") {
+    ShortAddressTable table;
+    CHECK(table.lookup("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff") == ShortAddressTable::BROADCAST);
+    CHECK(table.expand_to_string(ShortAddressTable::BROADCAST) == "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff");
+    CHECK_FALSE(table.expand(ShortAddressTable::UNASSIGNED));
+}
+
+TEST_CASE("explicit assignments cover addresses outside the fleet prefix") {
+    ShortAddressTable table("fd00:1:2::");
+    CHECK(table.lookup("fd00:1:2::7") == 7);
+    CHECK_FALSE(table.lookup("2001:db8::42"));
+
+    REQUIRE(table.assign("2001:db8::42", 0x0100));
+    CHECK(table.lookup("2001:db8::42") == 0x0100);
+    CHECK(table.expand_to_string(0x0100) == "2001:db8::42");
+
+    CHECK_FALSE(table.assign("2001:db8::43", 0x0100)); // taken
+    CHECK_FALSE(table.assign("fd00:1:2::7", 8));       // derivable addresses keep their ID
+    CHECK(table.assign("fd00:1:2::7", 7));             // ... which may be made explicit
+    CHECK_FALSE(table.assign("2001:db8::44", 0));      // reserved
+    CHECK_FALSE(table.assign("2001:db8::44", 0xFFFF)); // reserved
+    CHECK_FALSE(table.assign("not an address", 5));
+}
+
+TEST_CASE("an explicit ID shadows the fleet node that would derive it") {
+    ShortAddressTable table;
+    REQUIRE(table.assign("2001:db8::42", 0x0005));
+    CHECK_FALSE(table.lookup("fd00:dead:beef::5")); // falls back to its full address
+    CHECK(table.expand_to_string(5) == "2001:db8::42");
+}
+
+TEST_CASE("reassigning an address frees its old ID") {
+    ShortAddressTable table;
+    REQUIRE(table.assign("2001:db8::42", 0x0100));
+    REQUIRE(table.assign("2001:db8::42", 0x0200));
+    CHECK(table.lookup("2001:db8::42") == 0x0200);
+    CHECK(table.expand_to_string(0x0100) == "fd00:dead:beef::100");
+    CHECK(table.assign("2001:db8::43", 0x0100));
+}
+
+TEST_CASE("tables agree on their fingerprint only when they hold the same assignments") {
+    ShortAddressTable a, b, other_prefix("fd00:1:2::");
+    CHECK(a.fingerprint() == b.fingerprint());
+    CHECK(a.fingerprint() != other_prefix.fingerprint());
+
+    a.assign("2001:db8::1", 0x0100);
+    a.assign("2001:db8::2", 0x0101);
+    CHECK(a.fingerprint() != b.fingerprint());
+    b.assign("2001:db8::2", 0x0101); // in another order
+    b.assign("2001:db8::1", 0x0100);
+    CHECK(a.fingerprint() == b.fingerprint());
+
+    b.assign("2001:db8::1", 0x0102);
+    CHECK(a.fingerprint() != b.fingerprint());
+}
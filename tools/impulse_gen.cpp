@@ -0,0 +1,575 @@
+// impulse_gen: message schemas -> C++ message types
+//
+//   impulse_gen <schema.imp> <output.hpp>
+//
+// A schema declares a namespace and any number of messages:
+//
+//   namespace robots.fleet;
+//
+//   message Pose2D 0x0011 {                       // type ID; omitted: derived from the qualified name
+//       u64 timestamp [timestamp];                // filled in by Transport broadcasts
+//       f64 x [quantize i32, scale 0.001];        // metres in memory, millimetres on the wire
+//       f32 yaw [quantize i16, scale 0.0001, offset 0];
+//       u8[4] flags;                              // fixed-size array
+//       char[16] name;                            // fixed-size, zero-padded string
+//   }
+//
+// Scalar types: u8 u16 u32 u64 i8 i16 i32 i64 f32 f64 bool. Each message becomes a struct deriving from
+// impulse::Message whose wire form is [type ID:2][fields], little-endian with no padding, written and read field
+// by field through impulse/protocol/wire.hpp. Type IDs 0x6AD7 and 0x5ED7 are taken: on the wire they read as the
+// relay header and redundancy envelope. Names must not be C++ keywords; field names must not start with impulse_
+// or repeat a member of the generated struct.
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Scalar {
+        std::string cpp;
+        size_t size;
+        bool floating;
+    };
+
+    const std::map<std::string, Scalar> SCALARS = {
+        {"u8", {"uint8_t", 1, false}},   {"u16", {"uint16_t", 2, false}}, {"u32", {"uint32_t", 4, false}},
+        {"u64", {"uint64_t", 8, false}}, {"i8", {"int8_t", 1, false}},    {"i16", {"int16_t", 2, false}},
+        {"i32", {"int32_t", 4, false}},  {"i64", {"int64_t", 8, false}},  {"f32", {"float", 4, true}},
+        {"f64", {"double", 8, true}},    {"bool", {"bool", 1, false}},
+    };
+
+    // Members of the generated struct and its View, and the types its code names unqualified. Parameters and
+    // locals of the generated functions start with GENERATED_PREFIX, which fields may not.
+    const std::set<std::string> RESERVED = {"TYPE_ID",     "WIRE_SIZE", "View",      "matches",       "serialize",
+                                            "deserialize", "get_size",  "to_string", "set_timestamp", "materialize",
+                                            "data",        "size",      "data_",     "ok",            "ok_",
+                                            "uint8_t",     "uint16_t",  "uint32_t",  "uint64_t",      "int8_t",
+                                            "int16_t",     "int32_t",   "int64_t",   "size_t"};
+    const std::string GENERATED_PREFIX = "impulse_";
+
+    // C++20 keywords and alternative tokens: not usable as field, message or namespace names
+    const std::set<std::string> KEYWORDS = {
+        "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch",
+        "char", "char8_t", "char16_t", "char32_t", "class", "compl", "concept", "const", "consteval", "constexpr",
+        "constinit", "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype", "default", "delete",
+        "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for",
+        "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+        "nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register", "reinterpret_cast",
+        "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct",
+        "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename",
+        "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq"};
+
+    // Names of the generated code's parameters and locals
+    const std::string BUFFER = GENERATED_PREFIX + "buffer_";
+    const std::string INDEX = GENERATED_PREFIX + "i_";
+    const std::string OUT = GENERATED_PREFIX + "out_";
+    const std::string VALUE = GENERATED_PREFIX + "timestamp_";
+    const std::string COPY = GENERATED_PREFIX + "msg_";
+
+    // Leading bytes D7 6A and D7 5E read as little-endian type IDs (relay.hpp and redundancy.hpp)
+    constexpr uint32_t RELAY_ID = 0x6AD7;
+    constexpr uint32_t ENVELOPE_ID = 0x5ED7;
+
+    struct Field {
+        std::string name;
+        std::string type;   // scalar type, or "char" for strings
+        size_t count = 0;   // array length; 0 for a single value
+        bool timestamp = false;
+        std::string quantize; // wire type of a quantized float
+        std::string scale = "1.0";
+        std::string offset = "0.0";
+        int line = 0;
+
+        size_t wire_size() const {
+            size_t element = type == "char" ? 1 : SCALARS.at(quantize.empty() ? type : quantize).size;
+            return element * (count ? count : 1);
+        }
+    };
+
+    struct MessageDef {
+        std::string name;
+        uint32_t id = 0;
+        bool explicit_id = false;
+        std::vector<Field> fields;
+        int line = 0;
+    };
+
+    struct Token {
+        enum Kind { identifier, number, punctuation, end } kind;
+        std::string text;
+        int line;
+    };
+
+    class Parser {
+      private:
+        std::string path_;
+        std::vector<Token> tokens_;
+        size_t pos_ = 0;
+
+        [[noreturn]] void fail(int line, const std::string &message) {
+            std::cerr << path_ << ":" << line << ": error: " << message << std::endl;
+            std::exit(1);
+        }
+
+        void tokenize(const std::string &text) {
+            int line = 1;
+            for (size_t i = 0; i < text.size();) {
+                char c = text[i];
+                if (c == '\n') {
+                    ++line;
+                    ++i;
+                } else if (isspace(static_cast<unsigned char>(c))) {
+                    ++i;
+                } else if (c == '/' && i + 1 < text.size() && text[i + 1] == '/') {
+                    while (i < text.size() && text[i] != '\n') {
+                        ++i;
+                    }
+                } else if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                    size_t start = i;
+                    while (i < text.size() &&
+                           (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_' || text[i] == '.')) {
+                        ++i;
+                    }
+                    tokens_.push_back({Token::identifier, text.substr(start, i - start), line});
+                } else if (isdigit(static_cast<unsigned char>(c)) || c == '-' || c == '+' || c == '.') {
+                    size_t start = i++;
+                    while (i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '.' ||
+                                               ((text[i] == '-' || text[i] == '+') &&
+                                                (text[i - 1] == 'e' || text[i - 1] == 'E')))) {
+                        ++i;
+                    }
+                    tokens_.push_back({Token::number, text.substr(start, i - start), line});
+                } else if (std::string("{}[];,").find(c) != std::string::npos) {
+                    tokens_.push_back({Token::punctuation, std::string(1, c), line});
+                    ++i;
+                } else {
+                    fail(line, std::string("unexpected character '") + c + "'");
+                }
+            }
+            tokens_.push_back({Token::end, "", line});
+        }
+
+        const Token &peek() const { return tokens_[pos_]; }
+
+        Token next() { return tokens_[pos_ < tokens_.size() - 1 ? pos_++ : pos_]; }
+
+        bool accept(const std::string &text) {
+            if (peek().kind != Token::end && peek().text == text) {
+                ++pos_;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(const std::string &text) {
+            if (!accept(text)) {
+                fail(peek().line, "expected '" + text + "', found '" + peek().text + "'");
+            }
+        }
+
+        // Dotted names are only allowed where `dotted` is set (the namespace)
+        std::string identifier(bool dotted = false) {
+            Token token = next();
+            if (token.kind != Token::identifier || (!dotted && token.text.find('.') != std::string::npos)) {
+                fail(token.line, "expected a name, found '" + token.text + "'");
+            }
+            return token.text;
+        }
+
+        // A name that ends up in the generated C++
+        std::string declared_name(const std::string &what) {
+            int line = peek().line;
+            std::string name = identifier(what == "namespace");
+            std::stringstream parts(name);
+            for (std::string part; std::getline(parts, part, '.');) {
+                if (part.empty()) {
+                    fail(line, "expected a name, found '" + name + "'");
+                }
+                if (KEYWORDS.count(part)) {
+                    fail(line, "'" + part + "' is a C++ keyword and cannot name a " + what);
+                }
+                if (part.find("__") != std::string::npos ||
+                    (part[0] == '_' && part.size() > 1 && isupper(static_cast<unsigned char>(part[1])))) {
+                    fail(line, "'" + part + "' is reserved in C++ and cannot name a " + what);
+                }
+            }
+            return name;
+        }
+
+        std::string number() {
+            Token token = next();
+            char *end = nullptr;
+            strtod(token.text.c_str(), &end);
+            if (token.kind != Token::number || (*end != '\0' && token.text.rfind("0x", 0) != 0)) {
+                fail(token.line, "expected a number, found '" + token.text + "'");
+            }
+            return token.text;
+        }
+
+        void annotations(Field &field) {
+            do {
+                int line = peek().line;
+                std::string key = identifier();
+                if (key == "timestamp") {
+                    field.timestamp = true;
+                } else if (key == "quantize") {
+                    field.quantize = identifier();
+                    auto it = SCALARS.find(field.quantize);
+                    if (it == SCALARS.end() || it->second.floating || field.quantize == "bool") {
+                        fail(line, "quantize needs an integer wire type, not '" + field.quantize + "'");
+                    }
+                } else if (key == "scale") {
+                    field.scale = number();
+                    if (strtod(field.scale.c_str(), nullptr) == 0.0) {
+                        fail(line, "scale must not be zero");
+                    }
+                } else if (key == "offset") {
+                    field.offset = number();
+                } else {
+                    fail(line, "unknown annotation '" + key + "'");
+                }
+            } while (accept(","));
+            expect("]");
+        }
+
+        Field field() {
+            Field field;
+            field.line = peek().line;
+            field.type = identifier();
+            if (field.type != "char" && !SCALARS.count(field.type)) {
+                fail(field.line, "unknown type '" + field.type + "'");
+            }
+            if (accept("[")) {
+                std::string count = number();
+                field.count = strtoul(count.c_str(), nullptr, 0);
+                if (field.count == 0) {
+                    fail(field.line, "array length must be positive");
+                }
+                expect("]");
+            } else if (field.type == "char") {
+                fail(field.line, "char is only used for fixed-size strings, e.g. char[16]");
+            }
+            field.name = declared_name("field");
+            if (accept("[")) {
+                annotations(field);
+            }
+            expect(";");
+
+            if (field.timestamp && (field.type != "u64" || field.count)) {
+                fail(field.line, "the timestamp field must be a single u64");
+            }
+            if (!field.quantize.empty() && (field.type == "char" || !SCALARS.at(field.type).floating)) {
+                fail(field.line, "only f32 and f64 fields can be quantized");
+            }
+            return field;
+        }
+
+      public:
+        std::string ns;
+        std::vector<MessageDef> messages;
+
+        Parser(const std::string &path, const std::string &text) : path_(path) { tokenize(text); }
+
+        void parse() {
+            while (peek().kind != Token::end) {
+                int line = peek().line;
+                std::string keyword = identifier();
+                if (keyword == "namespace") {
+                    for (char c : declared_name("namespace")) {
+                        ns += c == '.' ? std::string("::") : std::string(1, c);
+                    }
+                    expect(";");
+                } else if (keyword == "message") {
+                    MessageDef message;
+                    message.line = line;
+                    message.name = declared_name("message");
+                    if (RESERVED.count(message.name)) {
+                        fail(line, "'" + message.name + "' is taken by the generated code");
+                    }
+                    if (peek().kind == Token::number) {
+                        message.id = strtoul(number().c_str(), nullptr, 0);
+                        message.explicit_id = true;
+                        if (message.id > 0xFFFF) {
+                            fail(line, "type IDs are 16 bits");
+                        }
+                    }
+                    expect("{");
+                    std::set<std::string> names;
+                    while (!accept("}")) {
+                        Field f = field();
+                        if (!names.insert(f.name).second) {
+                            fail(f.line, "duplicate field '" + f.name + "'");
+                        }
+                        if (RESERVED.count(f.name) || f.name.rfind(GENERATED_PREFIX, 0) == 0) {
+                            fail(f.line, "'" + f.name + "' is taken by the generated code");
+                        }
+                        if (f.name == message.name) {
+                            fail(f.line, "a field cannot have the name of its message");
+                        }
+                        message.fields.push_back(f);
+                    }
+                    messages.push_back(message);
+                } else {
+                    fail(line, "expected 'namespace' or 'message', found '" + keyword + "'");
+                }
+            }
+
+            std::map<uint32_t, std::string> ids;
+            for (auto &message : messages) {
+                if (!message.explicit_id) {
+                    // FNV-1a of the qualified name, folded to 16 bits
+                    uint32_t hash = 2166136261u;
+                    for (char c : ns + "::" + message.name) {
+                        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+                    }
+                    message.id = (hash >> 16) ^ (hash & 0xFFFF);
+                }
+                // A message starting with these would be taken for a relay header or a redundancy envelope
+                if (message.id == RELAY_ID || message.id == ENVELOPE_ID) {
+                    fail(message.line, message.name + (message.explicit_id ? "'s type ID" : "'s derived type ID") +
+                                           " is the magic of a relay header or redundancy envelope; pick another");
+                }
+                auto [it, inserted] = ids.emplace(message.id, message.name);
+                if (!inserted) {
+                    fail(message.line, message.name + " has the same type ID as " + it->second);
+                }
+            }
+        }
+    };
+
+    std::string cpp_type(const Field &field) {
+        return field.type == "char" ? "char" : SCALARS.at(field.type).cpp;
+    }
+
+    std::string wire_type(const Field &field) {
+        return SCALARS.at(field.quantize.empty() ? field.type : field.quantize).cpp;
+    }
+
+    // Address of element i of an array field starting at `at`
+    std::string element_at(const Field &field, const std::string &at) {
+        size_t step = field.wire_size() / field.count;
+        return at + " + " + INDEX + (step == 1 ? "" : " * " + std::to_string(step));
+    }
+
+    // Statement writing one element `value` at `at`
+    std::string write_element(const Field &field, const std::string &at, const std::string &value) {
+        const std::string wire = "::impulse::wire::";
+        if (field.quantize.empty()) {
+            return wire + "put<" + wire_type(field) + ">(" + at + ", " + value + ");";
+        }
+        return wire + "put<" + wire_type(field) + ">(" + at + ", " + wire + "quantize<" + wire_type(field) + ">(" +
+               value + ", " + field.scale + ", " + field.offset + "));";
+    }
+
+    std::string read_element(const Field &field, const std::string &at) {
+        const std::string wire = "::impulse::wire::";
+        if (field.quantize.empty()) {
+            return wire + "get<" + wire_type(field) + ">(" + at + ")";
+        }
+        std::string value = wire + "dequantize(" + wire + "get<" + wire_type(field) + ">(" + at + "), " + field.scale +
+                            ", " + field.offset + ")";
+        return field.type == "f32" ? "static_cast<float>(" + value + ")" : value;
+    }
+
+    void generate(std::ostream &out, const Parser &schema, const std::string &source) {
+        out << "// Generated by impulse_gen from " << source << "; do not edit\n"
+            << "#pragma once\n\n"
+            << "#include \"impulse/protocol/message.hpp\"\n"
+            << "#include \"impulse/protocol/wire.hpp\"\n\n"
+            << "#include <array>\n#include <cassert>\n#include <cstddef>\n#include <cstdint>\n#include <cstring>\n"
+            << "#include <string>\n#include <string_view>\n\n";
+        std::string indent;
+        if (!schema.ns.empty()) {
+            out << "namespace " << schema.ns << " {\n\n";
+            indent = "    ";
+        }
+
+        for (const auto &message : schema.messages) {
+            const std::string i1 = indent + "    ", i2 = i1 + "    ", i3 = i2 + "    ";
+            size_t size = 2;
+            for (const auto &field : message.fields) {
+                size += field.wire_size();
+            }
+
+            char id[8];
+            snprintf(id, sizeof(id), "0x%04X", message.id);
+            out << indent << "struct " << message.name << " : public ::impulse::Message {\n"
+                << i1 << "static constexpr uint16_t TYPE_ID = " << id << ";\n"
+                << i1 << "static constexpr uint32_t WIRE_SIZE = " << size << ";\n\n";
+            for (const auto &field : message.fields) {
+                out << i1;
+                if (field.type == "char") {
+                    out << "char " << field.name << "[" << field.count << "] = {};";
+                } else if (field.count) {
+                    out << "std::array<" << cpp_type(field) << ", " << field.count << "> " << field.name << "{};";
+                } else {
+                    out << cpp_type(field) << " " << field.name << " = {};";
+                }
+                if (!field.quantize.empty()) {
+                    out << " // " << field.quantize << " on the wire, step " << field.scale;
+                }
+                out << "\n";
+            }
+
+            // Type check on received bytes
+            out << "\n"
+                << i1 << "inline static bool matches(const char *data, size_t size) {\n"
+                << i2 << "return size == WIRE_SIZE && ::impulse::wire::get<uint16_t>(data) == TYPE_ID;\n"
+                << i1 << "}\n\n";
+
+            // Accessors over the received bytes; matches() has checked the size, so they read unchecked
+            out << i1 << "// Fields read in place from received bytes that matches() accepted; the constructor\n"
+                << i1 << "// asserts it, and ok() tells in release builds\n"
+                << i1 << "class View {\n"
+                << i1 << "  private:\n"
+                << i2 << "const char *data_;\n"
+                << i2 << "bool ok_;\n\n"
+                << i1 << "  public:\n"
+                << i2 << "inline View(const char *data, size_t size) : data_(data), ok_(matches(data, size)) {\n"
+                << i3 << "assert(ok_ && \"view over bytes that are not a " << message.name << "\");\n"
+                << i2 << "}\n"
+                << i2 << "inline bool ok() const { return ok_; }\n";
+            size_t offset = 2;
+            for (const auto &field : message.fields) {
+                std::string at = "data_ + " + std::to_string(offset);
+                std::string type = field.type == "char" ? "std::string_view" : cpp_type(field);
+                out << i2 << "inline " << type << " " << field.name;
+                if (field.type == "char") {
+                    out << "() const { return std::string_view(" << at << ", ::strnlen(" << at << ", " << field.count
+                        << ")); }\n";
+                } else if (field.count) {
+                    out << "(size_t " << INDEX << ") const { return " << read_element(field, element_at(field, at))
+                        << "; } // " << field.count << " elements\n";
+                } else {
+                    out << "() const { return " << read_element(field, at) << "; }\n";
+                }
+                offset += field.wire_size();
+            }
+            out << i2 << "inline " << message.name << " materialize() const {\n"
+                << i3 << message.name << " " << COPY << ";\n"
+                << i3 << COPY << ".deserialize(data_);\n"
+                << i3 << "return " << COPY << ";\n"
+                << i2 << "}\n"
+                << i2 << "inline const char *data() const { return data_; }\n"
+                << i2 << "inline size_t size() const { return WIRE_SIZE; }\n"
+                << i1 << "};\n\n";
+
+            const std::string loop = "for (size_t " + INDEX + " = 0; " + INDEX + " < ";
+            const std::string element = "[" + INDEX + "]";
+            out << i1 << "inline void serialize(char *" << BUFFER << ") const override {\n"
+                << i2 << "::impulse::wire::put<uint16_t>(" << BUFFER << ", TYPE_ID);\n";
+            offset = 2;
+            for (const auto &field : message.fields) {
+                std::string at = BUFFER + " + " + std::to_string(offset);
+                if (field.type == "char") {
+                    out << i2 << "std::memcpy(" << at << ", " << field.name << ", " << field.count << ");\n";
+                } else if (field.count) {
+                    out << i2 << loop << field.count << "; ++" << INDEX << ") {\n"
+                        << i3 << write_element(field, element_at(field, at), field.name + element)
+                        << "\n"
+                        << i2 << "}\n";
+                } else {
+                    out << i2 << write_element(field, at, field.name) << "\n";
+                }
+                offset += field.wire_size();
+            }
+            out << i1 << "}\n\n";
+
+            out << i1 << "inline void deserialize(const char *" << BUFFER << ") override {\n";
+            offset = 2;
+            for (const auto &field : message.fields) {
+                std::string at = BUFFER + " + " + std::to_string(offset);
+                if (field.type == "char") {
+                    out << i2 << "std::memcpy(" << field.name << ", " << at << ", " << field.count << ");\n";
+                } else if (field.count) {
+                    out << i2 << loop << field.count << "; ++" << INDEX << ") {\n"
+                        << i3 << field.name << element << " = " << read_element(field, element_at(field, at))
+                        << ";\n"
+                        << i2 << "}\n";
+                } else {
+                    out << i2 << field.name << " = " << read_element(field, at) << ";\n";
+                }
+                offset += field.wire_size();
+            }
+            out << i1 << "}\n\n";
+
+            out << i1 << "inline uint32_t get_size() const override { return WIRE_SIZE; }\n\n";
+
+            const Field *timestamp = nullptr;
+            for (const auto &field : message.fields) {
+                if (field.timestamp) {
+                    timestamp = &field;
+                }
+            }
+            if (timestamp) {
+                out << i1 << "inline void set_timestamp(uint64_t " << VALUE << ") override { " << timestamp->name
+                    << " = " << VALUE << "; }\n\n";
+            } else {
+                out << i1 << "inline void set_timestamp(uint64_t) override {}\n\n";
+            }
+
+            out << i1 << "inline std::string to_string() const override {\n"
+                << i2 << "std::string " << OUT << ";\n"
+                << i2 << OUT << ".reserve(" << 16 + 24 * message.fields.size() << ");\n"
+                << i2 << OUT << " += \"" << message.name << "{";
+            bool first = true;
+            for (const auto &field : message.fields) {
+                out << (first ? "" : ", ") << field.name << "=\";\n";
+                first = false;
+                if (field.type == "char") {
+                    out << i2 << OUT << " += std::string_view(" << field.name << ", ::strnlen(" << field.name << ", "
+                        << field.count << "));\n";
+                } else if (field.count) {
+                    out << i2 << loop << field.count << "; ++" << INDEX << ") {\n"
+                        << i3 << OUT << " += " << INDEX << " ? \",\" : \"[\";\n"
+                        << i3 << "::impulse::wire::append(" << OUT << ", " << field.name << element << ");\n"
+                        << i2 << "}\n"
+                        << i2 << OUT << " += \"]\";\n";
+                } else {
+                    out << i2 << "::impulse::wire::append(" << OUT << ", " << field.name << ");\n";
+                }
+                out << i2 << OUT << " += \"";
+            }
+            out << "}\";\n" << i2 << "return " << OUT << ";\n" << i1 << "}\n" << indent << "};\n\n";
+        }
+
+        if (!schema.ns.empty()) {
+            out << "} // namespace " << schema.ns << "\n";
+        }
+    }
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <schema.imp> <output.hpp>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "Cannot read " << argv[1] << std::endl;
+        return 1;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+
+    Parser schema(argv[1], text.str());
+    schema.parse();
+
+    std::string source = argv[1];
+    std::ofstream out(argv[2]);
+    generate(out, schema, source.substr(source.find_last_of('/') + 1));
+    if (!out) {
+        std::cerr << "Cannot write " << argv[2] << std::endl;
+        return 1;
+    }
+    return 0;
+}